@@ -45,6 +45,19 @@
 #  define CHANNELER_ANONYMOUS
 #endif
 
+/**
+ * Exception support can be disabled, e.g. with meson's -Dcpp_eh=none. The
+ * library then aborts where it would otherwise throw; the packet processing
+ * paths do not throw in the first place.
+ */
+#if !defined(CHANNELER_EXCEPTIONS)
+#  if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#    define CHANNELER_EXCEPTIONS 1
+#  else
+#    define CHANNELER_EXCEPTIONS 0
+#  endif
+#endif
+
 /**
  * Decide what to include globally
  **/
@@ -55,6 +55,14 @@ enum capability_index : std::size_t
   // Close-on-loss behaviour. Note that "loss" is defined as the final state
   // when all resend attempts have failed.
   CAP_CLOSE_ON_LOSS = 2,
+
+  // Compress data message payloads with LZ4, where that makes them smaller.
+  CAP_COMPRESSION = 3,
+
+  // Compress small data message payloads with zstd and a shared dictionary.
+  // Only granted if both peers loaded the same dictionary, see the
+  // dictionary field of MSG_CHANNEL_NEW.
+  CAP_COMPRESSION_DICTIONARY = 4,
 };
 
 
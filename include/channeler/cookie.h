@@ -26,6 +26,7 @@
 
 #include <channeler.h>
 
+#include <channeler/capabilities.h>
 #include <channeler/channelid.h>
 #include <channeler/peerid.h>
 
@@ -40,17 +41,25 @@ namespace channeler {
  * The purpose of cookies is to provide some kind of validation that some
  * secret is known - for that reason, something like an HMAC should be used.
  *
- * XXX For the time being, we're using a CRC32 checksum, which is not very
- *     secure. But it helps get the protocol off the ground without requiring
- *     a crypto library just yet.
+ * Cookies are a SipHash-2-4 MAC keyed with the secret, folded to 32 bits
+ * to keep the wire format. Unlike a checksum, flipping bits in the inputs
+ * (e.g. the capabilities) does not let a peer predict the new cookie.
  */
 using cookie = liberate::checksum::crc32_checksum;
 using cookie_serialize = liberate::checksum::crc32_serialize;
 
+/**
+ * Responder cookies are only valid for a limited time. The responder counts
+ * time in epochs, and includes the epoch a cookie was issued in in its
+ * inputs.
+ */
+using cookie_epoch = uint32_t;
+
 /**
  * We're using two cookies: one in the first part of the handshake, and one
  * in a latter. In the first part, the full channelid is not yet known. The
- * second part has the channel identifier.
+ * second part has the channel identifier, and covers the capabilities the
+ * responder granted as well as the epoch it was issued in.
  */
 CHANNELER_API
 cookie
@@ -67,7 +76,9 @@ create_cookie_responder(
     byte const * secret, std::size_t secret_size,
     peerid_wrapper const & initiator,
     peerid_wrapper const & responder,
-    channelid const & id);
+    channelid const & id,
+    capabilities_t const & capabilities,
+    cookie_epoch epoch);
 
 
 /**
@@ -89,10 +100,12 @@ validate_cookie(cookie const & c,
     byte const * secret, std::size_t secret_size,
     peerid_wrapper const & initiator,
     peerid_wrapper const & responder,
-    channelid const & id)
+    channelid const & id,
+    capabilities_t const & capabilities,
+    cookie_epoch epoch)
 {
   return c == create_cookie_responder(secret, secret_size, initiator,
-      responder, id);
+      responder, id, capabilities, epoch);
 }
 
 
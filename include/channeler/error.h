@@ -102,6 +102,14 @@ CHANNELER_ERRDEF(ERR_DATA_UNAVAILABLE,
     11,
     "No data available.")
 
+CHANNELER_ERRDEF(ERR_CHANNELID_EXHAUSTED,
+    12,
+    "No more channel identifiers are available.")
+
+CHANNELER_ERRDEF(ERR_READ,
+    13,
+    "Read error.")
+
 CHANNELER_END_ERRORS
 
 
@@ -162,6 +170,14 @@ private:
 };
 
 
+/**
+ * Throw an exception with the given code and details. Without exception
+ * support, this logs the error message to stderr and aborts instead.
+ **/
+[[noreturn]] CHANNELER_API void throw_exception(error_t code,
+    std::string const & details = std::string());
+
+
 } // namespace channeler
 
 #endif // CHANNELER_ERROR_FUNCTIONS
@@ -35,6 +35,7 @@
 #include <channeler/channelid.h>
 #include <channeler/capabilities.h>
 #include <channeler/cookie.h>
+#include <channeler/result.h>
 
 namespace channeler {
 
@@ -63,6 +64,18 @@ enum message_type : message_type_base
   // Transmission related
   MSG_DATA = 20,
 
+  // Data with a compressed payload; only sent on channels with the
+  // CAP_COMPRESSION capability.
+  MSG_DATA_COMPRESSED = 21,
+
+  // Data at an offset into a larger whole, e.g. a file. The payload starts
+  // with the offset, see DATA_OFFSET_SIZE. Receivers can place the data
+  // regardless of the order in which packets arrive.
+  MSG_DATA_AT = 22,
+
+  // Congestion feedback
+  MSG_ECN_FEEDBACK = 30,
+
   // TODO
   // MSG_DATA_PROGRESS,
   // MSG_DATA_RECEIVE_WINDOW,
@@ -73,6 +86,13 @@ enum message_type : message_type_base
   // https://gitlab.com/interpeer/channeler/-/issues/3
 };
 
+/**
+ * Size of the offset preceding the data in MSG_DATA_AT payloads; it is a
+ * big endian unsigned integer.
+ */
+constexpr std::size_t DATA_OFFSET_SIZE = sizeof(uint64_t);
+
+
 inline std::ostream &
 operator<<(std::ostream & os, message_type type)
 {
@@ -126,6 +146,13 @@ struct message
   std::pair<error_t, std::string>
   parse();
 
+  /**
+   * Parse the input buffer without throwing on malformed input, for use on
+   * the ingress path.
+   */
+  static result<message>
+  create(byte const * buf, std::size_t max) noexcept;
+
   /**
    * Serialized size of the message. This is type dependent.
    */
@@ -142,6 +169,12 @@ protected:
     : type{t}
   {
   }
+
+  /**
+   * Does the work for parse() and create(). The reason for failure is a
+   * static string, so that rejecting a message does not allocate.
+   */
+  error_t parse_fields(char const * & reason) noexcept;
 };
 
 
@@ -175,13 +208,12 @@ extract_message_features(message const & msg);
 inline std::unique_ptr<message>
 parse_message(byte const * buffer, std::size_t size)
 {
-  message msg{buffer, size, false};
-  auto err = msg.parse();
-  if (ERR_SUCCESS != err.first) {
+  auto msg = message::create(buffer, size);
+  if (!msg) {
     return {};
   }
 
-  return extract_message_features(msg);
+  return extract_message_features(*msg);
 }
 
 
@@ -208,12 +240,18 @@ struct message_channel_new
 {
   channelid::half_type  initiator_part = DEFAULT_CHANNELID.initiator;
   cookie                cookie1 = {};
+  capabilities_t        capabilities = {}; // requested by the initiator
+  uint32_t              dictionary = 0; // compression dictionary id, or 0
 
   inline message_channel_new(channelid::half_type const & initiator,
-      cookie const & _cookie1)
+      cookie const & _cookie1,
+      capabilities_t const & _capabilities = {},
+      uint32_t _dictionary = 0)
     : message{MSG_CHANNEL_NEW}
     , initiator_part{initiator}
     , cookie1{_cookie1}
+    , capabilities{_capabilities}
+    , dictionary{_dictionary}
   {
   }
 
@@ -234,14 +272,17 @@ struct message_channel_acknowledge
   channelid       id = DEFAULT_CHANNELID;
   cookie          cookie1 = {};
   cookie          cookie2 = {};
+  capabilities_t  capabilities = {}; // granted by the responder
 
   inline message_channel_acknowledge(channelid const & _id,
       cookie const & _cookie1,
-      cookie const & _cookie2)
+      cookie const & _cookie2,
+      capabilities_t const & _capabilities = {})
     : message{MSG_CHANNEL_ACKNOWLEDGE}
     , id{_id}
     , cookie1{_cookie1}
     , cookie2{_cookie2}
+    , capabilities{_capabilities}
   {
   }
 
@@ -292,6 +333,14 @@ struct message_channel_cookie
   cookie          either_cookie = {};
   capabilities_t  capabilities = {};
 
+  inline message_channel_cookie(cookie const & _either_cookie,
+      capabilities_t const & _capabilities)
+    : message{MSG_CHANNEL_COOKIE}
+    , either_cookie{_either_cookie}
+    , capabilities{_capabilities}
+  {
+  }
+
   static std::unique_ptr<message>
   extract_features(message const & wrap);
 
@@ -303,6 +352,37 @@ private:
 };
 
 
+/**
+ * ECN feedback carries the receiver's running counts of ECN codepoints in
+ * received packets back to the sender. Counts wrap around; the sender only
+ * considers increases since the previous feedback.
+ */
+struct message_ecn_feedback
+  : public message
+{
+  uint32_t  ect0 = 0;
+  uint32_t  ect1 = 0;
+  uint32_t  ce = 0;
+
+  inline message_ecn_feedback(uint32_t _ect0, uint32_t _ect1, uint32_t _ce)
+    : message{MSG_ECN_FEEDBACK}
+    , ect0{_ect0}
+    , ect1{_ect1}
+    , ce{_ce}
+  {
+  }
+
+  static std::unique_ptr<message>
+  extract_features(message const & wrap);
+
+  static std::size_t
+  serialize(byte * out, std::size_t max, message_ecn_feedback const & msg);
+
+private:
+  explicit message_ecn_feedback(message const & wrap);
+};
+
+
 struct message_data
   : public message
 {
@@ -317,12 +397,15 @@ struct message_data
    *
    * This *must* create messages that take ownership of data, so that is
    * what we do here. That means that the vector version moves the data.
+   *
+   * The vector version also creates MSG_DATA_COMPRESSED messages, if the
+   * data is an already compressed payload.
    */
   static std::unique_ptr<message>
   create(byte const * buf, std::size_t max);
 
   static std::unique_ptr<message>
-  create(std::vector<byte> & data);
+  create(std::vector<byte> & data, message_type type = MSG_DATA);
 
   static std::unique_ptr<message>
   extract_features(message const & wrap);
@@ -334,6 +417,8 @@ private:
   explicit message_data(message const & wrap);
   explicit message_data(std::vector<byte> && data);
 
+  static std::unique_ptr<message> adopt(std::vector<byte> && data);
+
   std::vector<byte>  owned_buffer;
 };
 
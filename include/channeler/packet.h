@@ -36,6 +36,7 @@
 #include <channeler/peerid.h>
 #include <channeler/channelid.h>
 #include <channeler/message.h>
+#include <channeler/result.h>
 
 namespace channeler {
 
@@ -247,6 +248,11 @@ struct CHANNELER_API footer_fields
  * of the packet header fields and messages.
  *
  * This class does not *own* the data buffer it receives.
+ *
+ * All header fields are decoded when the packet is validated, so the field
+ * accessors never modify the wrapper, and a validated packet can be read
+ * from several threads at once. The exception is buffer(), which writes the
+ * fields back into the buffer.
  */
 class CHANNELER_API packet_wrapper
   : public ::liberate::cpp::comparison_operators<packet_wrapper>
@@ -272,6 +278,14 @@ public:
   packet_wrapper(byte * buf, size_t buffer_size,
       bool validate_now = true);
 
+  /**
+   * Wrap and validate a received buffer. Unlike the validating constructor,
+   * this does not throw on malformed input, and is meant for the ingress
+   * path.
+   */
+  static result<packet_wrapper>
+  create(byte * buf, size_t buffer_size) noexcept;
+
   /**
    * The constructor just remembers the buffer, and parses and validates only
    * as required. This function performs the parsing and validation parts.
@@ -478,6 +492,9 @@ public:
 
   bool is_equal_to(packet_wrapper const & other) const;
   bool is_less_than(packet_wrapper const & other) const;
+
+private:
+  error_t decode(char const * & reason) noexcept;
 };
 
 
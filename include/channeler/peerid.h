@@ -33,6 +33,8 @@
 #include <liberate/cpp/operators/comparison.h>
 #include <liberate/cpp/hash.h>
 
+#include <channeler/result.h>
+
 namespace channeler {
 
 // Size of a peer identifier
@@ -62,6 +64,13 @@ struct CHANNELER_API peerid_wrapper
    */
   peerid_wrapper(byte const * start, size_t bufsize);
 
+  /**
+   * As the constructor, but reports a buffer that is too small instead of
+   * throwing.
+   */
+  static result<peerid_wrapper>
+  create(byte const * start, size_t bufsize) noexcept;
+
   std::string display() const;
   size_t hash() const;
 
@@ -31,8 +31,10 @@ namespace channeler {
 // Protocol ID type
 using protoid = uint32_t;
 
-// protoid.py "Testing v0.1" -- see protoid.py
-constexpr protoid const PROTOID = uint32_t(0x0c229d94);
+// protoid.py "Testing v0.2" -- see protoid.py
+// v0.2 added capabilities to MSG_CHANNEL_NEW and MSG_CHANNEL_ACKNOWLEDGE,
+// and the compression dictionary id to MSG_CHANNEL_NEW.
+constexpr protoid const PROTOID = uint32_t(0xe65ea29e);
 
 } // namespace channeler
 
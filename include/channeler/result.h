@@ -0,0 +1,156 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_RESULT_H
+#define CHANNELER_RESULT_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace channeler {
+
+/**
+ * Tag for constructing a result that holds an error, analogous to
+ * std::unexpected. Using a tag avoids ambiguity for value types that can be
+ * constructed from an error_t.
+ */
+struct failure
+{
+  error_t code;
+};
+
+
+/**
+ * A result holds either a value or an error code, much like std::expected
+ * does in C++23.
+ *
+ * Code that parses untrusted input returns results instead of throwing, so
+ * that malformed packets cost a branch rather than stack unwinding, and so
+ * that it can be noexcept. A result without a value never reports
+ * ERR_SUCCESS.
+ */
+template <
+  typename T
+>
+class result
+{
+public:
+  using value_type = T;
+
+  inline result(T const & value)
+      noexcept(std::is_nothrow_copy_constructible_v<T>)
+    : m_value{value}
+  {
+  }
+
+  inline result(T && value)
+      noexcept(std::is_nothrow_move_constructible_v<T>)
+    : m_value{std::move(value)}
+  {
+  }
+
+  inline result(failure const & fail) noexcept
+    : m_error{fail.code == ERR_SUCCESS ? ERR_UNEXPECTED : fail.code}
+  {
+  }
+
+  inline bool has_value() const noexcept
+  {
+    return m_value.has_value();
+  }
+
+  inline explicit operator bool() const noexcept
+  {
+    return has_value();
+  }
+
+  /**
+   * ERR_SUCCESS if the result holds a value.
+   */
+  inline error_t error() const noexcept
+  {
+    return m_error;
+  }
+
+  /**
+   * Checked access; raises the held error if there is no value.
+   */
+  inline T & value() &
+  {
+    check();
+    return *m_value;
+  }
+
+  inline T const & value() const &
+  {
+    check();
+    return *m_value;
+  }
+
+  inline T && value() &&
+  {
+    check();
+    return std::move(*m_value);
+  }
+
+  /**
+   * Unchecked access; only valid if has_value() is true.
+   */
+  inline T & operator*() noexcept
+  {
+    return *m_value;
+  }
+
+  inline T const & operator*() const noexcept
+  {
+    return *m_value;
+  }
+
+  inline T * operator->() noexcept
+  {
+    return &*m_value;
+  }
+
+  inline T const * operator->() const noexcept
+  {
+    return &*m_value;
+  }
+
+private:
+  inline void check() const
+  {
+    if (!m_value) {
+      throw_exception(m_error);
+    }
+  }
+
+  std::optional<T>  m_value = {};
+  error_t           m_error = ERR_SUCCESS;
+};
+
+} // namespace channeler
+
+#endif // guard
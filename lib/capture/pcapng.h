@@ -0,0 +1,482 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_CAPTURE_PCAPNG_H
+#define CHANNELER_CAPTURE_PCAPNG_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <channeler/error.h>
+
+#include "../support/async_writer.h"
+
+namespace channeler::capture {
+
+/**
+ * Minimal pcapng encoding, see
+ * https://datatracker.ietf.org/doc/draft-tuexen-opsawg-pcapng/
+ *
+ * A capture consists of a section header block, a single interface
+ * description block and one enhanced packet block per packet. Blocks are
+ * written in host byte order, which the section header's byte order magic
+ * tells readers about.
+ *
+ * Channeler packets have no registered link type, so by default one of the
+ * link types reserved for private use is recorded; dissectors can be
+ * configured to decode it.
+ */
+constexpr uint16_t PCAPNG_LINKTYPE_USER0 = 147;
+
+constexpr uint32_t PCAPNG_BLOCK_SECTION_HEADER = 0x0a0d0d0a;
+constexpr uint32_t PCAPNG_BLOCK_INTERFACE_DESCRIPTION = 0x00000001;
+constexpr uint32_t PCAPNG_BLOCK_ENHANCED_PACKET = 0x00000006;
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+constexpr uint16_t PCAPNG_OPT_ENDOFOPT = 0;
+constexpr uint16_t PCAPNG_OPT_EPB_FLAGS = 2;
+constexpr uint16_t PCAPNG_OPT_IF_TSRESOL = 9;
+
+constexpr std::size_t PCAPNG_SECTION_HEADER_SIZE = 28;
+constexpr std::size_t PCAPNG_INTERFACE_DESCRIPTION_SIZE = 20;
+// Block header and trailer, interface, timestamp, lengths and the
+// epb_flags option including end of options.
+constexpr std::size_t PCAPNG_ENHANCED_PACKET_OVERHEAD = 32 + 12;
+
+/**
+ * Packet direction, as encoded in the epb_flags option.
+ */
+enum capture_direction : uint32_t
+{
+  CAPTURE_UNKNOWN = 0,
+  CAPTURE_INBOUND = 1,
+  CAPTURE_OUTBOUND = 2,
+};
+
+
+namespace detail {
+
+template <typename T>
+inline byte *
+put(byte * out, T value)
+{
+  std::memcpy(out, &value, sizeof(value));
+  return out + sizeof(value);
+}
+
+constexpr std::size_t
+pad4(std::size_t size)
+{
+  return (size + 3) & ~std::size_t{3};
+}
+
+} // namespace detail
+
+
+inline std::size_t
+pcapng_enhanced_packet_size(std::size_t captured)
+{
+  return PCAPNG_ENHANCED_PACKET_OVERHEAD + detail::pad4(captured);
+}
+
+
+/**
+ * Write the section header and interface description blocks; the buffer
+ * must hold PCAPNG_SECTION_HEADER_SIZE + PCAPNG_INTERFACE_DESCRIPTION_SIZE
+ * Bytes.
+ */
+inline byte *
+pcapng_write_header(byte * out, uint16_t link_type, uint32_t snaplen)
+{
+  // Section header
+  out = detail::put(out, PCAPNG_BLOCK_SECTION_HEADER);
+  out = detail::put(out, static_cast<uint32_t>(PCAPNG_SECTION_HEADER_SIZE));
+  out = detail::put(out, PCAPNG_BYTE_ORDER_MAGIC);
+  out = detail::put(out, uint16_t{1}); // Major version
+  out = detail::put(out, uint16_t{0}); // Minor version
+  out = detail::put(out, int64_t{-1}); // Section length unknown
+  out = detail::put(out, static_cast<uint32_t>(PCAPNG_SECTION_HEADER_SIZE));
+
+  // Interface description; the default timestamp resolution is
+  // microseconds.
+  out = detail::put(out, PCAPNG_BLOCK_INTERFACE_DESCRIPTION);
+  out = detail::put(out, static_cast<uint32_t>(PCAPNG_INTERFACE_DESCRIPTION_SIZE));
+  out = detail::put(out, link_type);
+  out = detail::put(out, uint16_t{0}); // Reserved
+  out = detail::put(out, snaplen);
+  out = detail::put(out, static_cast<uint32_t>(PCAPNG_INTERFACE_DESCRIPTION_SIZE));
+  return out;
+}
+
+
+/**
+ * Write an enhanced packet block of pcapng_enhanced_packet_size(captured)
+ * Bytes.
+ */
+inline byte *
+pcapng_write_packet(byte * out, capture_direction direction,
+    std::chrono::microseconds timestamp,
+    byte const * data, std::size_t captured, std::size_t original)
+{
+  auto total = static_cast<uint32_t>(pcapng_enhanced_packet_size(captured));
+  auto ts = static_cast<uint64_t>(timestamp.count());
+
+  out = detail::put(out, PCAPNG_BLOCK_ENHANCED_PACKET);
+  out = detail::put(out, total);
+  out = detail::put(out, uint32_t{0}); // Interface
+  out = detail::put(out, static_cast<uint32_t>(ts >> 32));
+  out = detail::put(out, static_cast<uint32_t>(ts & 0xffffffff));
+  out = detail::put(out, static_cast<uint32_t>(captured));
+  out = detail::put(out, static_cast<uint32_t>(original));
+
+  std::memcpy(out, data, captured);
+  std::memset(out + captured, 0, detail::pad4(captured) - captured);
+  out += detail::pad4(captured);
+
+  out = detail::put(out, PCAPNG_OPT_EPB_FLAGS);
+  out = detail::put(out, uint16_t{4});
+  out = detail::put(out, static_cast<uint32_t>(direction));
+  out = detail::put(out, PCAPNG_OPT_ENDOFOPT);
+  out = detail::put(out, uint16_t{0});
+
+  out = detail::put(out, total);
+  return out;
+}
+
+
+
+/**
+ * A packet read back from a capture. The data points into the buffer
+ * passed to pcapng_read(), which must outlive the record.
+ */
+struct capture_record
+{
+  capture_direction         direction = CAPTURE_UNKNOWN;
+  std::chrono::nanoseconds  timestamp = {};
+  byte const *              data = nullptr;
+  std::size_t               captured = 0;
+  std::size_t               original = 0;
+};
+
+
+namespace detail {
+
+template <typename T>
+inline T
+get(byte const * in)
+{
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  return value;
+}
+
+
+/**
+ * Timestamp resolution from the if_tsresol option value, as a multiplier
+ * to nanoseconds; zero if we cannot represent it.
+ */
+inline uint64_t
+tsresol_multiplier(uint8_t tsresol)
+{
+  uint64_t mult = 1;
+  if (tsresol & 0x80) {
+    // Power of two resolutions are not exact in nanoseconds; only accept
+    // whole seconds.
+    return (tsresol & 0x7f) ? 0 : 1'000'000'000;
+  }
+  if (tsresol > 9) {
+    return 0;
+  }
+  for (uint8_t i = tsresol ; i < 9 ; ++i) {
+    mult *= 10;
+  }
+  return mult;
+}
+
+
+/**
+ * Invoke func(code, value, length) for each option in the buffer.
+ */
+template <typename funcT>
+inline void
+for_each_option(byte const * opt, byte const * end, funcT && func)
+{
+  while (opt + 4 <= end) {
+    auto code = get<uint16_t>(opt);
+    auto length = get<uint16_t>(opt + 2);
+    opt += 4;
+    if (PCAPNG_OPT_ENDOFOPT == code || opt + length > end) {
+      return;
+    }
+    func(code, opt, length);
+    opt += pad4(length);
+  }
+}
+
+} // namespace detail
+
+
+/**
+ * Read enhanced packet blocks from a pcapng capture in the buffer. Blocks
+ * other than section headers, interface descriptions and enhanced packets
+ * are skipped.
+ *
+ * Only captures in host byte order can be read, which includes all
+ * captures written by packet_capture on the same kind of machine.
+ */
+inline error_t
+pcapng_read(byte const * buf, std::size_t size,
+    std::vector<capture_record> & records)
+{
+  if (nullptr == buf) {
+    return ERR_INVALID_REFERENCE;
+  }
+
+  // One nanosecond multiplier per interface in the current section.
+  std::vector<uint64_t> interfaces;
+  bool have_section = false;
+
+  std::size_t offset = 0;
+  while (offset < size) {
+    if (size - offset < 12) {
+      return ERR_DECODE;
+    }
+    auto block = buf + offset;
+    auto type = detail::get<uint32_t>(block);
+    auto length = detail::get<uint32_t>(block + 4);
+    if (length < 12 || length % 4 || length > size - offset
+        || detail::get<uint32_t>(block + length - 4) != length)
+    {
+      return ERR_DECODE;
+    }
+    auto body = block + 8;
+    auto body_end = block + length - 4;
+
+    switch (type) {
+      case PCAPNG_BLOCK_SECTION_HEADER:
+        if (length < PCAPNG_SECTION_HEADER_SIZE
+            || detail::get<uint32_t>(body) != PCAPNG_BYTE_ORDER_MAGIC)
+        {
+          return ERR_DECODE;
+        }
+        have_section = true;
+        interfaces.clear();
+        break;
+
+      case PCAPNG_BLOCK_INTERFACE_DESCRIPTION:
+        {
+          if (!have_section || length < PCAPNG_INTERFACE_DESCRIPTION_SIZE) {
+            return ERR_DECODE;
+          }
+          uint64_t mult = 1000; // Microseconds by default
+          detail::for_each_option(body + 8, body_end,
+              [&mult](uint16_t code, byte const * value, uint16_t len)
+              {
+                if (PCAPNG_OPT_IF_TSRESOL == code && len >= 1) {
+                  mult = detail::tsresol_multiplier(
+                      std::to_integer<uint8_t>(value[0]));
+                }
+              });
+          interfaces.push_back(mult);
+        }
+        break;
+
+      case PCAPNG_BLOCK_ENHANCED_PACKET:
+        {
+          // Block header, fixed fields and trailer
+          if (!have_section || length < 32) {
+            return ERR_DECODE;
+          }
+          auto iface = detail::get<uint32_t>(body);
+          if (iface >= interfaces.size() || !interfaces[iface]) {
+            return ERR_DECODE;
+          }
+
+          capture_record rec;
+          uint64_t ts = (uint64_t{detail::get<uint32_t>(body + 4)} << 32)
+            | detail::get<uint32_t>(body + 8);
+          rec.timestamp = std::chrono::nanoseconds{ts * interfaces[iface]};
+          rec.captured = detail::get<uint32_t>(body + 12);
+          rec.original = detail::get<uint32_t>(body + 16);
+          if (20 + detail::pad4(rec.captured)
+              > static_cast<std::size_t>(body_end - body))
+          {
+            return ERR_DECODE;
+          }
+          rec.data = body + 20;
+
+          detail::for_each_option(rec.data + detail::pad4(rec.captured), body_end,
+              [&rec](uint16_t code, byte const * value, uint16_t len)
+              {
+                if (PCAPNG_OPT_EPB_FLAGS == code && len >= 4) {
+                  rec.direction = static_cast<capture_direction>(
+                      detail::get<uint32_t>(value) & 0x3);
+                }
+              });
+
+          records.push_back(rec);
+        }
+        break;
+
+      default:
+        // Skip
+        break;
+    }
+
+    offset += length;
+  }
+
+  return ERR_SUCCESS;
+}
+
+
+
+/**
+ * Capture options
+ */
+struct capture_options
+{
+  // Capture at most this many Bytes of each packet.
+  std::size_t snaplen = 0xffff;
+
+  // Capture one in this many packets.
+  std::size_t sample_every = 1;
+
+  // Size of each of the writer's two buffers.
+  std::size_t buffer_size = 1024 * 1024;
+
+  uint16_t    link_type = PCAPNG_LINKTYPE_USER0;
+};
+
+
+/**
+ * Packet capture to pcapng.
+ *
+ * capture() is called from the packet path, and only ever copies the
+ * (truncated) packet into the writer's buffer. Packets that do not fit
+ * because the sink falls behind are dropped and counted.
+ */
+class packet_capture
+{
+public:
+  inline packet_capture(support::async_writer::sink sink,
+      capture_options const & options = {})
+    : m_options{options}
+    , m_writer{sink, options.buffer_size}
+  {
+    if (!m_options.sample_every) {
+      throw_exception(ERR_UNEXPECTED, "Capture sample rate must be non-zero.");
+    }
+    m_writer.write(PCAPNG_SECTION_HEADER_SIZE + PCAPNG_INTERFACE_DESCRIPTION_SIZE,
+        [this](byte * out)
+        {
+          pcapng_write_header(out, m_options.link_type,
+              static_cast<uint32_t>(m_options.snaplen));
+        });
+  }
+
+  /**
+   * Capture the packet, subject to sampling. Returns true if the packet was
+   * written.
+   */
+  inline bool capture(capture_direction direction, byte const * data,
+      std::size_t size,
+      std::chrono::system_clock::time_point when = std::chrono::system_clock::now())
+  {
+    if (m_seen++ % m_options.sample_every) {
+      return false;
+    }
+
+    auto captured = std::min(size, m_options.snaplen);
+    auto timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        when.time_since_epoch());
+
+    auto ret = m_writer.write(pcapng_enhanced_packet_size(captured),
+        [&](byte * out)
+        {
+          pcapng_write_packet(out, direction, timestamp, data, captured, size);
+        });
+    if (ret) {
+      ++m_captured;
+    }
+    return ret;
+  }
+
+  inline void flush()
+  {
+    m_writer.flush();
+  }
+
+  /**
+   * Statistics
+   */
+  inline std::size_t seen() const
+  {
+    return m_seen;
+  }
+
+  inline std::size_t captured() const
+  {
+    return m_captured;
+  }
+
+  inline std::size_t dropped() const
+  {
+    return m_writer.dropped();
+  }
+
+  /**
+   * A sink writing to the given file.
+   */
+  static inline support::async_writer::sink file_sink(std::string const & path)
+  {
+    std::shared_ptr<std::FILE> file{std::fopen(path.c_str(), "wb"),
+      [](std::FILE * f) { if (f) { std::fclose(f); } }};
+    if (!file) {
+      throw_exception(ERR_WRITE, "Could not open capture file.");
+    }
+    return [file](byte const * data, std::size_t size)
+    {
+      std::fwrite(data, 1, size, file.get());
+      std::fflush(file.get());
+    };
+  }
+
+private:
+  capture_options           m_options;
+  std::atomic<std::size_t>  m_seen = 0;
+  std::atomic<std::size_t>  m_captured = 0;
+  support::async_writer     m_writer;
+};
+
+} // namespace channeler::capture
+
+#endif // guard
@@ -0,0 +1,158 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_CAPTURE_REPLAY_H
+#define CHANNELER_CAPTURE_REPLAY_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <channeler/error.h>
+
+#include "pcapng.h"
+
+namespace channeler::capture {
+
+/**
+ * Statistics gathered while replaying a trace.
+ *
+ * Stage timings are wall clock time spent in the respective connection API
+ * call. Ingress includes the egress processing of any responses, because the
+ * API bundles them within received_packet().
+ */
+struct replay_stats
+{
+  using duration = std::chrono::nanoseconds;
+
+  std::size_t packets = 0;
+  std::size_t bytes = 0;
+  std::size_t skipped = 0;
+  std::size_t errors = 0;
+
+  // Time covered by the trace, i.e. what the virtual clock advanced by.
+  duration    trace_time = {};
+
+  duration    total_time = {};
+  duration    ingress_time = {};
+  duration    timeouts_time = {};
+
+  inline double packets_per_second() const
+  {
+    return per_second(packets);
+  }
+
+  inline double bytes_per_second() const
+  {
+    return per_second(bytes);
+  }
+
+private:
+  inline double per_second(std::size_t amount) const
+  {
+    if (!total_time.count()) {
+      return 0;
+    }
+    return amount * 1e9 / total_time.count();
+  }
+};
+
+
+/**
+ * Replay the inbound packets of a trace into a connection API.
+ *
+ * Between packets, the gap in capture timestamps is handed to
+ * process_timeouts(), so the timing of the trace is reproduced by whatever
+ * sleep function the connection's node uses: a support::virtual_clock
+ * replays as fast as possible, or with the original timing if it paces in
+ * real time.
+ *
+ * Packets that were truncated at capture time, or do not fit into a pool
+ * slot, are skipped. Outbound packets are skipped, too; they are the
+ * recorded responses, which the API generates afresh. Packets of unknown
+ * direction are treated as inbound.
+ */
+template <
+  typename apiT
+>
+inline replay_stats
+replay(apiT & api, std::vector<capture_record> const & records,
+    typename apiT::address_type const & source = {},
+    typename apiT::address_type const & destination = {})
+{
+  using clock = std::chrono::steady_clock;
+  replay_stats stats;
+
+  auto start = clock::now();
+  bool first = true;
+  std::chrono::nanoseconds previous{};
+
+  for (auto & rec : records) {
+    if (CAPTURE_OUTBOUND == rec.direction) {
+      continue;
+    }
+
+    // Advance time to the packet's timestamp
+    if (!first && rec.timestamp > previous) {
+      auto gap = rec.timestamp - previous;
+      auto before = clock::now();
+      api.process_timeouts(gap);
+      stats.timeouts_time += clock::now() - before;
+      stats.trace_time += gap;
+    }
+    if (first || rec.timestamp > previous) {
+      previous = rec.timestamp;
+    }
+    first = false;
+
+    if (rec.captured < rec.original) {
+      ++stats.skipped;
+      continue;
+    }
+    auto slot = api.allocate();
+    if (rec.captured > slot.size()) {
+      ++stats.skipped;
+      continue;
+    }
+    std::memcpy(slot.data(), rec.data, rec.captured);
+
+    auto before = clock::now();
+    auto err = api.received_packet(source, destination, slot);
+    stats.ingress_time += clock::now() - before;
+
+    if (ERR_SUCCESS != err) {
+      ++stats.errors;
+    }
+    ++stats.packets;
+    stats.bytes += rec.captured;
+  }
+
+  stats.total_time = clock::now() - start;
+  return stats;
+}
+
+} // namespace channeler::capture
+
+#endif // guard
@@ -26,12 +26,17 @@
 
 #include <channeler.h>
 
+#include <chrono>
+#include <list>
 #include <map>
 #include <vector>
 
+#include <channeler/capabilities.h>
 #include <channeler/channelid.h>
+#include <channeler/cookie.h>
 
 #include "memory/packet_buffer.h"
+#include "support/token_bucket.h"
 
 namespace channeler {
 
@@ -50,8 +55,19 @@ struct channel_data
   using buffer_type = memory::packet_buffer<POOL_BLOCK_SIZE, lock_policyT>;
   using slot_type = typename buffer_type::pool_type::slot;
 
+  // Messages may carry a deadline after which they are no longer worth
+  // sending. Messages without a deadline use time_point::max().
+  using clock_type = std::chrono::steady_clock;
+  using time_point = clock_type::time_point;
+
+  struct egress_message_entry
+  {
+    std::unique_ptr<message>  msg;
+    time_point                deadline;
+  };
+
   // Output buffer can likely be optimized
-  using egress_message_buffer = std::list<std::unique_ptr<message>>;
+  using egress_message_buffer = std::list<egress_message_entry>;
 
   inline channel_data(channelid const & id, lock_policyT * lock = nullptr)
     : m_id{id}
@@ -67,9 +83,10 @@ struct channel_data
     return m_ingress_buffer.push(packet, slot);
   }
 
-  inline error_t egress_buffer_push(packet_wrapper const & packet, slot_type slot)
+  inline error_t egress_buffer_push(packet_wrapper const & packet, slot_type slot,
+      time_point const & deadline = time_point::max())
   {
-    return m_egress_buffer.push(packet, slot);
+    return m_egress_buffer.push(packet, slot, deadline);
   }
 
   inline typename buffer_type::buffer_entry egress_buffer_pop()
@@ -103,22 +120,67 @@ struct channel_data
     return m_id;
   }
 
+  /**
+   * Capabilities negotiated during channel establishment. Filters check them
+   * per packet; e.g. the egress compress filter passes packets on unchanged
+   * for channels without CAP_COMPRESSION. There are no pipelines specialised
+   * per capability set.
+   */
+  inline capabilities_t const & capabilities() const
+  {
+    return m_capabilities;
+  }
+
+  inline void set_capabilities(capabilities_t const & caps)
+  {
+    m_capabilities = caps;
+  }
+
+  /**
+   * The responder cookie received during establishment. Initiators can use
+   * it to later resume the channel without a full handshake.
+   */
+  inline cookie const & resumption_cookie() const
+  {
+    return m_resumption_cookie;
+  }
+
+  inline void set_resumption_cookie(cookie const & cookie2)
+  {
+    m_resumption_cookie = cookie2;
+  }
+
+  /**
+   * An optional rate limiter for the channel's egress packets. The bucket
+   * is owned elsewhere, and may be shared with other channels.
+   */
+  inline support::token_bucket * rate_limiter() const
+  {
+    return m_rate_limiter;
+  }
+
+  inline void set_rate_limiter(support::token_bucket * limiter)
+  {
+    m_rate_limiter = limiter;
+  }
+
   inline bool has_egress_data_pending() const
   {
     return !m_output_buffer.empty();
   }
 
 
-  inline void enqueue_egress_message(std::unique_ptr<message> msg)
+  inline void enqueue_egress_message(std::unique_ptr<message> msg,
+      time_point const & deadline = time_point::max())
   {
     // TODO order e.g. by timestamp? Most likely by insertion time is
     // good enough.
-    m_output_buffer.push_back(std::move(msg));
+    m_output_buffer.push_back({std::move(msg), deadline});
   }
 
   inline std::unique_ptr<message> dequeue_egress_message()
   {
-    auto ret = std::move(m_output_buffer.front());
+    auto ret = std::move(m_output_buffer.front().msg);
     m_output_buffer.pop_front();
     return ret;
   }
@@ -130,16 +192,79 @@ struct channel_data
       return 0;
     }
 
-    return (*iter)->serialized_size();
+    return iter->msg->serialized_size();
+  }
+
+  /**
+   * The deadline of the next message in the egress queue, or
+   * time_point::max() if there is none.
+   */
+  inline time_point next_egress_message_deadline() const
+  {
+    if (m_output_buffer.empty()) {
+      return time_point::max();
+    }
+    return m_output_buffer.front().deadline;
+  }
+
+  /**
+   * Drop all messages from the egress queue whose deadline has passed by
+   * the given time point. Returns the number of messages dropped.
+   */
+  inline std::size_t drop_expired_egress_messages(
+      time_point const & now = clock_type::now())
+  {
+    auto before = m_output_buffer.size();
+    m_output_buffer.remove_if([&now](egress_message_entry const & entry)
+    {
+      return entry.deadline <= now;
+    });
+    auto dropped = before - m_output_buffer.size();
+    m_expired_egress_messages += dropped;
+    return dropped;
+  }
+
+  /**
+   * The total number of egress messages that expired before being sent.
+   */
+  inline std::size_t expired_egress_messages() const
+  {
+    return m_expired_egress_messages;
+  }
+
+  /**
+   * Drop all packets from the egress buffer whose deadline has passed by
+   * the given time point, i.e. packets in which every message expired
+   * while waiting to be sent. Returns the number of packets dropped.
+   */
+  inline std::size_t drop_expired_egress_packets(
+      time_point const & now = clock_type::now())
+  {
+    auto dropped = m_egress_buffer.drop_expired(now);
+    m_expired_egress_packets += dropped;
+    return dropped;
+  }
+
+  /**
+   * The total number of egress packets that expired before being sent.
+   */
+  inline std::size_t expired_egress_packets() const
+  {
+    return m_expired_egress_packets;
   }
 
 
   channelid       m_id;
+  capabilities_t  m_capabilities = {};
+  cookie          m_resumption_cookie = {};
+  support::token_bucket * m_rate_limiter = nullptr;
   lock_policyT *  m_lock;
   buffer_type     m_ingress_buffer;
   buffer_type     m_egress_buffer;
 
   egress_message_buffer  m_output_buffer;
+  std::size_t            m_expired_egress_messages = 0;
+  std::size_t            m_expired_egress_packets = 0;
 };
 
 } // namespace channeler
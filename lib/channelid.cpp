@@ -21,21 +21,31 @@
 
 #include <channeler/channelid.h>
 
-#include <liberate/random/unsafe_bits.h>
+#include "support/random_bits.h"
 
 namespace channeler {
 
-channelid create_new_channelid()
+namespace {
+
+inline channelid::half_type
+random_half()
 {
-  liberate::random::unsafe_bits<uint16_t> rng;
+  support::random_bits<channelid::half_type> rng;
 
-  uint16_t cur;
+  channelid::half_type cur;
   do {
     cur = rng.get();
   } while (cur == DEFAULT_CHANNELID.initiator);
+  return cur;
+}
 
+} // anonymous namespace
+
+
+channelid create_new_channelid()
+{
   channelid id{};
-  id.initiator = cur;
+  id.initiator = random_half();
   return id;
 }
 
@@ -54,14 +64,7 @@ error_t complete_channelid(channelid & id)
   }
 
   // Generate
-  liberate::random::unsafe_bits<uint16_t> rng;
-
-  uint16_t cur;
-  do {
-    cur = rng.get();
-  } while (cur == DEFAULT_CHANNELID.initiator);
-
-  id.responder = cur;
+  id.responder = random_half();
   return ERR_SUCCESS;
 }
 
@@ -31,6 +31,9 @@
 #include <unordered_set>
 
 #include <channeler/channelid.h>
+#include <channeler/error.h>
+
+#include "support/bitmap_allocator.h"
 
 namespace channeler {
 
@@ -132,6 +135,7 @@ public:
   {
     // TODO we can use remove() for that
     m_pending.erase(initiator);
+    update_allocated(initiator);
   }
 
   inline channelid get_established_id(channelid::half_type const & initiator) const
@@ -169,6 +173,7 @@ public:
         id,
         std::make_shared<channelT>(id)
       };
+      update_allocated(id.initiator);
       return ERR_SUCCESS;
     }
 
@@ -176,6 +181,7 @@ public:
       // This is pending, so we can just overwrite existing identifiers. It
       // makes no difference.
       m_pending[id.initiator] = std::make_shared<channelT>(id);
+      update_allocated(id.initiator);
       return ERR_SUCCESS;
     }
 
@@ -217,6 +223,7 @@ public:
       id,
       std::make_shared<channelT>(id),
     };
+    update_allocated(id.initiator);
 
     return ERR_SUCCESS;
   }
@@ -250,33 +257,125 @@ public:
 
   /**
    * Create a new pending channel identifier not currently in the set.
+   *
+   * While the set is sparse, a random identifier is almost always free, so
+   * we just draw a few. Once the set grows beyond DENSE_THRESHOLD channels,
+   * or if we were unlucky, used identifiers are tracked in a bitmap from
+   * which a free one can be found in bounded time.
+   *
+   * Returns ERR_CHANNELID_EXHAUSTED if all identifiers are in use.
    */
-  inline channelid::half_type new_pending_channel()
+  inline error_t new_pending_channel(channelid::half_type & initiator)
   {
     channelid id;
-    do {
-      id = create_new_channelid();
-    } while (has_channel(id));
+    if (!m_allocated && size() < DENSE_THRESHOLD) {
+      for (std::size_t i = 0 ; i < SPARSE_ATTEMPTS ; ++i) {
+        id = create_new_channelid();
+        if (!has_channel(id)) {
+          add(id);
+          initiator = id.initiator;
+          return ERR_SUCCESS;
+        }
+      }
+    }
+
+    track_allocated();
+
+    id = create_new_channelid();
+    if (!m_allocated->allocate(id.initiator, id.initiator)) {
+      return ERR_CHANNELID_EXHAUSTED;
+    }
 
-    // We don't have this channel, so add it.
     add(id);
-    return id.initiator;
+    initiator = id.initiator;
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * As above, but throws on exhaustion.
+   */
+  inline channelid::half_type new_pending_channel()
+  {
+    channelid::half_type initiator;
+    auto err = new_pending_channel(initiator);
+    if (ERR_SUCCESS != err) {
+      throw_exception(err);
+    }
+    return initiator;
   }
 
 
   inline void remove(channelid const & id)
   {
-    m_pending.erase(id.initiator);
-    m_established.erase(id.initiator);
+    remove(id.initiator);
   }
 
   inline void remove(channelid::half_type const & initiator)
   {
     m_pending.erase(initiator);
     m_established.erase(initiator);
+    update_allocated(initiator);
+  }
+
+  /**
+   * Number of pending and established channels.
+   */
+  inline std::size_t size() const
+  {
+    return m_pending.size() + m_established.size();
+  }
+
+
+  /**
+   * Invoke func with the identifier and channel pointer of each established
+   * channel.
+   */
+  template <
+    typename funcT
+  >
+  inline void for_each_established(funcT && func) const
+  {
+    for (auto & [initiator, entry] : m_established) {
+      func(entry.id, entry.data);
+    }
   }
 
 private:
+  // Below this many channels, picking a random identifier collides rarely
+  // enough that tracking identifiers in a bitmap is not worth its memory.
+  static constexpr std::size_t DENSE_THRESHOLD = 4096;
+  static constexpr std::size_t SPARSE_ATTEMPTS = 8;
+
+  using allocator_type = support::bitmap_allocator<channelid::half_type>;
+
+  inline void track_allocated()
+  {
+    if (m_allocated) {
+      return;
+    }
+    m_allocated = std::make_unique<allocator_type>();
+    m_allocated->set(DEFAULT_CHANNELID.initiator);
+    for (auto & [initiator, _] : m_pending) {
+      m_allocated->set(initiator);
+    }
+    for (auto & [initiator, _] : m_established) {
+      m_allocated->set(initiator);
+    }
+  }
+
+  inline void update_allocated(channelid::half_type const & initiator)
+  {
+    if (!m_allocated || initiator == DEFAULT_CHANNELID.initiator) {
+      return;
+    }
+    if (has_channel(initiator)) {
+      m_allocated->set(initiator);
+    }
+    else {
+      m_allocated->reset(initiator);
+    }
+  }
+
   // We need to keep a set of channel identifiers under establishment.
   // TODO instead of having two maps, we can have one map in which pending channels are marked by
   //      not containing a full channelid?
@@ -294,6 +393,9 @@ private:
 
   using channel_map_t = std::unordered_map<channelid::half_type, value_type>;
   channel_map_t m_established;
+
+  // Only allocated once the set becomes dense.
+  std::unique_ptr<allocator_type> m_allocated;
 };
 
 } // namespace channeler
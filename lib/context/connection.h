@@ -26,6 +26,8 @@
 
 #include <channeler.h>
 
+#include <channeler/capabilities.h>
+
 #include <functional>
 #include <vector>
 
@@ -94,12 +96,43 @@ struct connection
     return m_node;
   }
 
+  /**
+   * The channel capabilities this side supports on the connection. Channel
+   * establishment grants no others, whatever the initiator requests.
+   */
+  inline capabilities_t const & capabilities() const
+  {
+    return m_capabilities;
+  }
+
+  inline capabilities_t & capabilities()
+  {
+    return m_capabilities;
+  }
+
+  /**
+   * The id of the compression dictionary loaded on this side, or 0. It is
+   * sent along with requests for CAP_COMPRESSION_DICTIONARY, and compared
+   * against such requests from the peer.
+   */
+  inline uint32_t dictionary() const
+  {
+    return m_dictionary;
+  }
+
+  inline uint32_t & dictionary()
+  {
+    return m_dictionary;
+  }
+
 private:
   // *** Data members
   node_type &       m_node;
   peerid            m_peer;
   channel_set_type  m_channels;
   timeouts_type     m_timeouts;
+  capabilities_t    m_capabilities = {};
+  uint32_t          m_dictionary = 0;
 };
 
 
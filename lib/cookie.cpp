@@ -25,10 +25,29 @@
 #include <vector>
 
 #include <liberate/serialization/integer.h>
-#include <liberate/checksum/crc32.h>
+
+#include "support/siphash.h"
 
 namespace channeler {
 
+namespace {
+
+/**
+ * Keyed MAC over the cookie inputs. The buffer starts with the secret, which
+ * is also folded into the SipHash key; without the secret, neither the key
+ * nor the input is known. The 64 bit result is folded to the cookie size.
+ */
+inline cookie
+cookie_mac(byte const * secret, std::size_t secret_size,
+    std::vector<byte> const & buf)
+{
+  auto key = support::siphash_key::from_bytes(secret, secret_size);
+  auto mac = support::siphash24(key, buf.data(), buf.size());
+  return static_cast<cookie>(mac ^ (mac >> 32));
+}
+
+} // anonymous namespace
+
 
 cookie
 create_cookie_initiator(
@@ -57,10 +76,8 @@ create_cookie_initiator(
   liberate::serialization::serialize_int(offs, buf.size() - (offs - buf.data()),
       initiator_part);
 
-  // Checksum
-  cookie res = liberate::checksum::crc32<liberate::checksum::CRC32>(
-      buf.begin(), buf.end());
-  return res;
+  // MAC
+  return cookie_mac(secret, secret_size, buf);
 }
 
 
@@ -70,11 +87,14 @@ create_cookie_responder(
     byte const * secret, std::size_t secret_size,
     peerid_wrapper const & initiator,
     peerid_wrapper const & responder,
-    channelid const & id)
+    channelid const & id,
+    capabilities_t const & capabilities,
+    cookie_epoch epoch)
 {
   // Buffer for the cookie inputs
   std::vector<byte> buf;
-  buf.resize(secret_size + (PEERID_SIZE_BYTES * 2) + sizeof(channelid));
+  buf.resize(secret_size + (PEERID_SIZE_BYTES * 2) + sizeof(channelid)
+      + sizeof(capability_bits_t) + sizeof(cookie_epoch));
 
   // First the secret
   byte * offs = &buf[0];
@@ -90,14 +110,19 @@ create_cookie_responder(
   ::memcpy(offs, responder.raw, responder.size());
   offs += responder.size();
 
-  // Channel id part
+  // Channel id
+  offs += liberate::serialization::serialize_int(offs,
+      buf.size() - (offs - buf.data()), id.full);
+
+  // Capabilities and epoch
+  offs += liberate::serialization::serialize_int(offs,
+      buf.size() - (offs - buf.data()),
+      static_cast<capability_bits_t>(capabilities.to_ullong()));
   liberate::serialization::serialize_int(offs, buf.size() - (offs - buf.data()),
-      id.full);
+      epoch);
 
-  // Checksum
-  cookie res = liberate::checksum::crc32<liberate::checksum::CRC32>(
-      buf.begin(), buf.end());
-  return res;
+  // MAC
+  return cookie_mac(secret, secret_size, buf);
 }
 
 
@@ -19,6 +19,9 @@
  **/
 #include <channeler/error.h>
 
+#include <cstdio>
+#include <cstdlib>
+
 /**
  * Stringify the symbol passed to CHANNELER_SPRINGIFY()
  **/
@@ -103,16 +106,20 @@ void
 combine_error(std::string & result, error_t code,
     std::string const & details)
 {
+#if CHANNELER_EXCEPTIONS
   try {
+#endif
     result = "[" + std::string{error_name(code)} + "] ";
     result += std::string{error_message(code)};
     if (!details.empty()) {
       result += " // ";
       result += details;
     }
+#if CHANNELER_EXCEPTIONS
   } catch (...) {
     result = "Error copying error message.";
   }
+#endif
 }
 
 } // anonymous namespace
@@ -160,4 +167,18 @@ exception::code() const throw()
 }
 
 
+
+void
+throw_exception(error_t code, std::string const & details /* = "" */)
+{
+#if CHANNELER_EXCEPTIONS
+  throw exception{code, details};
+#else
+  exception ex{code, details};
+  std::fprintf(stderr, "%s\n", ex.what());
+  std::abort();
+#endif
+}
+
+
 } // namespace channeler
@@ -0,0 +1,274 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_FIXED_PACKET_H
+#define CHANNELER_FIXED_PACKET_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include <liberate/checksum/crc32.h>
+
+#include <channeler/packet.h>
+#include <channeler/error.h>
+
+#include "support/wire.h"
+
+namespace channeler {
+
+/**
+ * A packet view for a packet size known at compile time.
+ *
+ * packet_wrapper accepts any buffer size, and so computes offsets such as
+ * that of the footer at run-time, and keeps a decoded copy of the headers.
+ * Deployments typically use a single packet size, for which fixed_packet
+ * makes every offset, the maximum payload size and thus the padding a
+ * constant. Fields are read from and written to the buffer directly.
+ *
+ * The buffer must be at least PACKET_SIZE Bytes in size; this is the
+ * caller's responsibility, as with packet pool slots of the same size.
+ *
+ * Use packet_wrapper for nodes that need to handle mixed packet sizes.
+ */
+template <
+  std::size_t PACKET_SIZE
+>
+class fixed_packet
+  : public public_header_layout
+  , public private_header_layout
+  , public footer_layout
+{
+public:
+  static constexpr std::size_t packet_size = PACKET_SIZE;
+  static constexpr std::size_t envelope_size = packet_wrapper::envelope_size();
+
+  static_assert(PACKET_SIZE >= envelope_size,
+      "Packet size must accomodate the packet envelope.");
+  static_assert(PACKET_SIZE <= std::numeric_limits<packet_size_t>::max(),
+      "Packet size must be representable in the packet header.");
+
+  static constexpr std::size_t PAYLOAD_OFFSET = PUB_SIZE + PRIV_SIZE;
+  static constexpr std::size_t FOOTER_OFFSET = PACKET_SIZE - FOOT_SIZE;
+  static constexpr std::size_t MAX_PAYLOAD_SIZE = FOOTER_OFFSET - PAYLOAD_OFFSET;
+
+  inline explicit fixed_packet(byte * buf)
+    : m_buffer{buf}
+  {
+  }
+
+  /**
+   * Write all header fields that do not depend on the payload.
+   */
+  inline void initialize(peerid_wrapper const & sender,
+      peerid_wrapper const & recipient, channelid const & channel,
+      flags_t const & flags = {})
+  {
+    support::store_be<protoid>(m_buffer + PUB_OFFS_PROTO, PROTOID);
+    std::memcpy(m_buffer + PUB_OFFS_SENDER, sender.raw, peerid::size());
+    std::memcpy(m_buffer + PUB_OFFS_RECIPIENT, recipient.raw, peerid::size());
+    set_channel(channel);
+    set_flags(flags);
+    support::store_be<packet_size_t>(m_buffer + PUB_OFFS_PACKET_SIZE,
+        PACKET_SIZE);
+  }
+
+  /**
+   * Record the payload size, pad the remainder of the packet and update the
+   * checksum. After this, the buffer is ready for sending.
+   */
+  inline error_t finalize(payload_size_t payload_size)
+  {
+    if (payload_size > MAX_PAYLOAD_SIZE) {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+    set_payload_size(payload_size);
+
+    // Same PKCS#7 variant as when bundling messages into packet_wrapper.
+    auto remaining = MAX_PAYLOAD_SIZE - payload_size;
+    std::memset(m_buffer + PAYLOAD_OFFSET + payload_size,
+        static_cast<int>(remaining % 0xff), remaining);
+
+    update_checksum();
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * Check that the buffer holds a packet of exactly this size. This does
+   * not include the checksum; see has_valid_checksum().
+   */
+  inline std::pair<error_t, std::string> validate() const
+  {
+    if (proto() != PROTOID) {
+      return {ERR_DECODE, "Invalid protocol identifier."};
+    }
+    if (encoded_packet_size() != PACKET_SIZE) {
+      return {ERR_DECODE, "Packet size does not match fixed packet size."};
+    }
+    if (payload_size() > MAX_PAYLOAD_SIZE) {
+      return {ERR_DECODE, "Payload size exceeds available buffer size."};
+    }
+    return {ERR_SUCCESS, {}};
+  }
+
+  /**
+   * Field accessors
+   */
+  inline protoid proto() const
+  {
+    return support::load_be<protoid>(m_buffer + PUB_OFFS_PROTO);
+  }
+
+  inline peerid_wrapper sender() const
+  {
+    return {m_buffer + PUB_OFFS_SENDER, peerid::size()};
+  }
+
+  inline peerid_wrapper recipient() const
+  {
+    return {m_buffer + PUB_OFFS_RECIPIENT, peerid::size()};
+  }
+
+  inline channelid channel() const
+  {
+    channelid id;
+    id.full = support::load_be<channelid::full_type>(
+        m_buffer + PUB_OFFS_CHANNELID);
+    return id;
+  }
+
+  inline void set_channel(channelid const & id)
+  {
+    support::store_be(m_buffer + PUB_OFFS_CHANNELID, id.full);
+  }
+
+  inline flags_t flags() const
+  {
+    return flags_t{support::load_be<flags_bits_t>(m_buffer + PUB_OFFS_FLAGS)};
+  }
+
+  inline void set_flags(flags_t const & flags)
+  {
+    support::store_be(m_buffer + PUB_OFFS_FLAGS,
+        static_cast<flags_bits_t>(flags.to_ulong()));
+  }
+
+  inline packet_size_t encoded_packet_size() const
+  {
+    return support::load_be<packet_size_t>(m_buffer + PUB_OFFS_PACKET_SIZE);
+  }
+
+  inline sequence_no_t sequence_no() const
+  {
+    return support::load_be<sequence_no_t>(
+        m_buffer + PUB_SIZE + PRIV_OFFS_SEQUENCE_NO);
+  }
+
+  inline void set_sequence_no(sequence_no_t sequence_no)
+  {
+    support::store_be(m_buffer + PUB_SIZE + PRIV_OFFS_SEQUENCE_NO,
+        sequence_no);
+  }
+
+  inline payload_size_t payload_size() const
+  {
+    return support::load_be<payload_size_t>(
+        m_buffer + PUB_SIZE + PRIV_OFFS_PAYLOAD_SIZE);
+  }
+
+  inline void set_payload_size(payload_size_t payload_size)
+  {
+    support::store_be(m_buffer + PUB_SIZE + PRIV_OFFS_PAYLOAD_SIZE,
+        payload_size);
+  }
+
+  inline std::size_t padding_size() const
+  {
+    return MAX_PAYLOAD_SIZE - payload_size();
+  }
+
+  inline byte * payload()
+  {
+    return m_buffer + PAYLOAD_OFFSET;
+  }
+
+  inline byte const * payload() const
+  {
+    return m_buffer + PAYLOAD_OFFSET;
+  }
+
+  inline byte * buffer()
+  {
+    return m_buffer;
+  }
+
+  inline byte const * buffer() const
+  {
+    return m_buffer;
+  }
+
+  /**
+   * Checksum
+   */
+  inline liberate::checksum::crc32_checksum checksum() const
+  {
+    return support::load_be<liberate::checksum::crc32_serialize>(
+        m_buffer + FOOTER_OFFSET);
+  }
+
+  inline liberate::checksum::crc32_checksum calculate_checksum() const
+  {
+    using namespace liberate::checksum;
+    return crc32<CRC32C>(m_buffer, m_buffer + FOOTER_OFFSET);
+  }
+
+  inline void update_checksum()
+  {
+    liberate::checksum::crc32_serialize sum = calculate_checksum();
+    support::store_be(m_buffer + FOOTER_OFFSET, sum);
+  }
+
+  inline bool has_valid_checksum() const
+  {
+    return checksum() == calculate_checksum();
+  }
+
+  /**
+   * Runtime-sized view of the same buffer, e.g. for passing packets into the
+   * pipes.
+   */
+  inline packet_wrapper wrapper(bool validate_now = true) const
+  {
+    return packet_wrapper{m_buffer, PACKET_SIZE, validate_now};
+  }
+
+private:
+  byte * m_buffer;
+};
+
+} // namespace channeler
+
+#endif // guard
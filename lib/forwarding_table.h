@@ -0,0 +1,108 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_FORWARDING_TABLE_H
+#define CHANNELER_FORWARDING_TABLE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <functional>
+#include <map>
+
+#include <channeler/peerid.h>
+
+namespace channeler {
+
+/**
+ * The forwarding table lets a node relay packets that are not addressed to
+ * itself: it maps recipient peer identifiers to the transport address of the
+ * next hop.
+ *
+ * Lookups take the peerid_wrapper from a parsed public header, so that
+ * forwarding decisions need neither a copy of the identifier nor any parsing
+ * beyond the public header.
+ */
+template <
+  typename addressT
+>
+class forwarding_table
+{
+public:
+  inline explicit forwarding_table(peerid const & self)
+    : m_self{self}
+  {
+  }
+
+  inline peerid const & self() const
+  {
+    return m_self;
+  }
+
+  inline bool is_self(peerid_wrapper const & id) const
+  {
+    return id == m_self;
+  }
+
+  /**
+   * Add or replace the next hop for a recipient.
+   */
+  inline void add(peerid const & recipient, addressT const & next_hop)
+  {
+    m_routes[recipient] = next_hop;
+  }
+
+  inline bool remove(peerid_wrapper const & recipient)
+  {
+    auto iter = m_routes.find(recipient);
+    if (iter == m_routes.end()) {
+      return false;
+    }
+    m_routes.erase(iter);
+    return true;
+  }
+
+  /**
+   * Return the next hop for the recipient, or nullptr if there is none.
+   */
+  inline addressT const * lookup(peerid_wrapper const & recipient) const
+  {
+    auto iter = m_routes.find(recipient);
+    if (iter == m_routes.end()) {
+      return nullptr;
+    }
+    return &(iter->second);
+  }
+
+  inline std::size_t size() const
+  {
+    return m_routes.size();
+  }
+
+private:
+  peerid                                        m_self;
+  std::map<peerid, addressT, std::less<>>       m_routes;
+};
+
+} // namespace channeler
+
+#endif // guard
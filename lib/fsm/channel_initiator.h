@@ -26,6 +26,7 @@
 
 #include <channeler.h>
 
+#include <chrono>
 #include <functional>
 
 #include "base.h"
@@ -67,7 +68,7 @@ namespace channeler::fsm {
  */
 constexpr uint16_t CHANNEL_NEW_TIMEOUT_TAG{0xc411};
 constexpr uint16_t CHANNEL_TIMEOUT_TAG{0x114c};
-using timeout_unit_type = uint64_t;
+using timeout_unit_type = uint64_t; // microseconds
 constexpr timeout_unit_type DEFAULT_CHANNEL_NEW_TIMEOUT{200 * 1000}; // 200 msec
 constexpr timeout_unit_type DEFAULT_CHANNEL_TIMEOUT{60 * 1000 * 1000}; // 1 min
 
@@ -126,7 +127,8 @@ struct fsm_channel_initiator
         {
           auto new_ev = reinterpret_cast<new_channel_event_type *>(to_process);
           return initiate_new_channel(new_ev->sender, new_ev->recipient,
-              result_actions, output_events);
+              new_ev->capabilities, new_ev->dictionary, result_actions,
+              output_events);
         }
 
       case pipe::ET_MESSAGE:
@@ -154,12 +156,24 @@ struct fsm_channel_initiator
   inline bool initiate_new_channel(
       ::channeler::peerid const & sender, // ourselves!
       ::channeler::peerid const & recipient,
+      capabilities_t const & capabilities,
+      uint32_t dictionary,
       ::channeler::pipe::action_list_type & result_actions [[maybe_unused]],
       ::channeler::pipe::event_list_type & output_events [[maybe_unused]])
   {
     // Create pending channel in the channel set. This also initialises a
     // pending FSM, if the channel data holds one (it should!)
-    auto id = m_channels.new_pending_channel();
+    channelid::half_type id;
+    auto err = m_channels.new_pending_channel(id);
+    if (ERR_SUCCESS != err) {
+      result_actions.push_back(
+          std::make_unique<::channeler::pipe::error_action>(err));
+      return true;
+    }
+
+    // The pending channel remembers which capabilities we asked for, so we
+    // never accept more than that from the responder.
+    m_channels.get(id)->set_capabilities(capabilities);
 
     // Create a cookie
     auto secret = m_secret_generator();
@@ -168,7 +182,8 @@ struct fsm_channel_initiator
         id);
 
     // Create and return MSG_CHANNEL_NEW in output_events
-    auto init = std::make_unique<message_channel_new>(id, cookie1);
+    auto init = std::make_unique<message_channel_new>(id, cookie1,
+        capabilities, dictionary);
     auto ev = std::make_unique<channeler::pipe::message_out_event>(
           DEFAULT_CHANNELID,
           std::move(init)
@@ -178,7 +193,7 @@ struct fsm_channel_initiator
     // Use timout provider to set a timeout with the context being a tuple
     // of a channel tag and the initiator part.
     m_timeouts.add({CHANNEL_NEW_TIMEOUT_TAG, id},
-        ::channeler::support::timeouts::duration{CHANNEL_NEW_TIMEOUT});
+        std::chrono::microseconds{CHANNEL_NEW_TIMEOUT});
 
     return true;
   }
@@ -199,7 +214,8 @@ struct fsm_channel_initiator
     LIBLOG_DEBUG("MSG_CHANNEL_ACKNOWLEDGE(channel["
         << std::hex << msg->id << "]/"
         << "cookie1[" << std::hex << msg->cookie1 << "]/"
-        << "cookie2[" << std::hex << msg->cookie2 << "])"
+        << "cookie2[" << std::hex << msg->cookie2 << "]/"
+        << "capabilities[" << std::hex << msg->capabilities << "])"
         << std::dec);
 
     // Pick channel identifier from message, grab channel data for it. 
@@ -248,6 +264,10 @@ struct fsm_channel_initiator
       return true;
     }
 
+    // The negotiated capabilities are those we requested, and the responder
+    // granted. Grab them before the pending channel data goes away.
+    auto caps = channel->capabilities() & msg->capabilities;
+
     // We'll upgrade the channel to full in the channel set.
     auto res = m_channels.make_full(msg->id);
     if (res != ERR_SUCCESS) {
@@ -276,7 +296,14 @@ struct fsm_channel_initiator
     // (much longer) CHANNEL_TIEMOUT.
     m_timeouts.remove({CHANNEL_NEW_TIMEOUT_TAG, msg->id.initiator});
     m_timeouts.add({CHANNEL_TIMEOUT_TAG, msg->id.initiator},
-        ::channeler::support::timeouts::duration{CHANNEL_TIMEOUT});
+        std::chrono::microseconds{CHANNEL_TIMEOUT});
+
+    auto established = m_channels.get(msg->id);
+    established->set_capabilities(caps);
+
+    // Keep the responder cookie around; it allows resuming the channel later
+    // with data in the very first packet.
+    established->set_resumption_cookie(msg->cookie2);
 
     // Construct the finalize or cookie messages, respectively.
     if (channel->has_egress_data_pending()) {
@@ -288,8 +315,7 @@ struct fsm_channel_initiator
       // MSG_CHANNEL_FINALIZE
       LIBLOG_DEBUG("Sending MSG_CHANNEL_FINALIZE: " << msg->id);
       auto response = std::make_unique<message_channel_finalize>(msg->id, msg->cookie2,
-          capabilities_t{}); // TODO capabilities not used yet.
-                             // https://gitlab.com/interpeer/channeler/-/issues/14
+          caps);
       auto ev = std::make_unique<channeler::pipe::message_out_event>(
             DEFAULT_CHANNELID,
             std::move(response)
@@ -26,7 +26,9 @@
 
 #include <channeler.h>
 
+#include <chrono>
 #include <functional>
+#include <set>
 
 #include "base.h"
 
@@ -35,9 +37,27 @@
 #include "../macros.h"
 #include "../channels.h"
 #include "../channel_data.h"
+#include "../support/timeouts.h"
 
 namespace channeler::fsm {
 
+/**
+ * Responder cookies, and with them resumption tickets, expire after the
+ * resumption lifetime. The responder advances its cookie epoch every half
+ * lifetime, and accepts cookies from the current and the previous epoch.
+ */
+constexpr uint16_t RESUMPTION_EPOCH_TIMEOUT_TAG{0xe90c};
+constexpr uint64_t DEFAULT_RESUMPTION_LIFETIME{10ULL * 60 * 1000 * 1000}; // 10 min, in usec
+
+/**
+ * The number of resumptions the responder accepts per epoch. It has to
+ * remember each of them until the ticket expires, in order to reject
+ * replayed resumption packets. Beyond the limit, resumptions are rejected,
+ * and initiators fall back to a full handshake.
+ */
+constexpr std::size_t RESUMPTION_REPLAY_LIMIT = 1024;
+
+
 /**
  * Implement the channel responder part.
  *
@@ -85,11 +105,18 @@ namespace channeler::fsm {
  *    this failure silently. The initiator will eventually consider the channel
  *    establishment process a failure, and may start over with a new
  *    MSG_CHANNEL_NEW.
+ *
+ * c) Finally, the responder counts time in cookie epochs, advanced by a
+ *    timeout every half RESUMPTION_LIFETIME. The epoch and the granted
+ *    capabilities are part of the responder cookie, so that neither can be
+ *    changed by the initiator, and cookies expire after at most
+ *    RESUMPTION_LIFETIME.
  */
 template <
   typename addressT,
   std::size_t POOL_BLOCK_SIZE,
-  typename channelT
+  typename channelT,
+  uint64_t RESUMPTION_LIFETIME = DEFAULT_RESUMPTION_LIFETIME
 >
 struct fsm_channel_responder
   : public fsm_base
@@ -97,17 +124,39 @@ struct fsm_channel_responder
   using channel_set = ::channeler::channels<channelT>;
   using secret_type = std::vector<byte>;
   using secret_generator = std::function<secret_type ()>;
+  using capabilities_func = std::function<capabilities_t ()>;
+  using dictionary_func = std::function<uint32_t ()>;
 
   using message_event_type = ::channeler::pipe::message_event<addressT, POOL_BLOCK_SIZE, channelT>;
+  using timeout_event_type = ::channeler::pipe::timeout_event<
+    ::channeler::support::timeout_scoped_tag_type
+  >;
 
   /**
    * Need to keep a reference to a channel_set as well as the function for
-   * producing the cookie secret.
+   * producing the cookie secret. The timeouts advance the cookie epoch.
+   *
+   * The optional capabilities function returns the capabilities we support
+   * on this connection. Of the capabilities an initiator requests, only
+   * those are granted. Without it, no capabilities are granted.
+   *
+   * The optional dictionary function returns the id of the compression
+   * dictionary we loaded, or 0. CAP_COMPRESSION_DICTIONARY is only granted
+   * if the initiator's dictionary id matches it.
    */
-  inline fsm_channel_responder(channel_set & channels, secret_generator generator)
-    : m_channels{channels}
+  inline fsm_channel_responder(
+      ::channeler::support::timeouts & timeouts,
+      channel_set & channels,
+      secret_generator generator,
+      capabilities_func supported = {},
+      dictionary_func dictionary = {})
+    : m_timeouts{timeouts}
+    , m_channels{channels}
     , m_secret_generator{generator}
+    , m_supported{supported}
+    , m_dictionary{dictionary}
   {
+    arm_epoch_timeout();
   }
 
   /**
@@ -119,6 +168,10 @@ struct fsm_channel_responder
   {
     namespace pipe = channeler::pipe;
 
+    if (to_process->type == pipe::ET_TIMEOUT) {
+      return handle_timeout(reinterpret_cast<timeout_event_type *>(to_process));
+    }
+
     // Ensure correct event and message type(s)
     if (to_process->type != pipe::ET_MESSAGE) {
       LIBLOG_WARN("Event type not handled by channel_responder: " << to_process->type);
@@ -161,7 +214,9 @@ struct fsm_channel_responder
   {
     LIBLOG_DEBUG("MSG_CHANNEL_NEW(init["
         << std::hex << msg->initiator_part << "]/"
-        << "cookie1[" << std::hex << msg->cookie1 << "])"
+        << "cookie1[" << std::hex << msg->cookie1 << "]/"
+        << "capabilities[" << std::hex << msg->capabilities << "]/"
+        << "dictionary[" << std::hex << msg->dictionary << "])"
         << std::dec);
     // If we got a MSG_CHANNEL_NEW, we have one of three possible situations to
     // consider:
@@ -204,13 +259,22 @@ struct fsm_channel_responder
       }
     }
 
-    // With the full identifier established, generate a responder cookie.
+    // With the full identifier established, generate a responder cookie
+    // over the capabilities we grant. A shared dictionary is only of use if
+    // both sides have the same one.
+    auto caps = granted(msg->capabilities);
+    if (caps[CAP_COMPRESSION_DICTIONARY]
+        && (!msg->dictionary || !m_dictionary
+          || m_dictionary() != msg->dictionary))
+    {
+      caps[CAP_COMPRESSION_DICTIONARY] = false;
+    }
     auto secret = m_secret_generator();
 
     // Since we're responding to the MSG_CHANNEL_NEW, the packet sender is
     // the initiator, and the recipient (us) is the responder.
     auto cookie2 = create_cookie_responder(secret.data(), secret.size(),
-        packet.sender(), packet.recipient(), full_id);
+        packet.sender(), packet.recipient(), full_id, caps, m_epoch);
 
     // Construct message. If we have channel information for this channel,
     // and there is pending data for it (unlikely), we want to send a
@@ -225,8 +289,10 @@ struct fsm_channel_responder
       // MSG_CHANNEL_ACKNOWLEDGE
       LIBLOG_DEBUG("Sending MSG_CHANNEL_ACKNOWLEDGE: " << full_id
           << " with cookie1 " << std::hex << msg->cookie1
-          << " and cookie2 " << cookie2 << std::dec);
-      auto response = std::make_unique<message_channel_acknowledge>(full_id, msg->cookie1, cookie2);
+          << " and cookie2 " << cookie2
+          << " granting " << caps << std::dec);
+      auto response = std::make_unique<message_channel_acknowledge>(full_id,
+          msg->cookie1, cookie2, caps);
       auto ev = std::make_unique<channeler::pipe::message_out_event>(
             packet.channel(), // XXX should be DEFAULT_CHANNELID
             std::move(response)
@@ -285,18 +351,11 @@ struct fsm_channel_responder
     // XXX: Note that the secret generator could have shifted state between us
     //      sending the cookie, and processing this message. In that case, the
     //      cookie check will fail.
-    auto secret = m_secret_generator();
-
-    auto cookie = create_cookie_responder(secret.data(), secret.size(),
-        packet.sender(), packet.recipient(), msg->id);
-
-    // Check the cookies match.
-    if (msg->cookie2 != cookie) {
+    if (!valid_cookie(msg->cookie2, packet, msg->id, msg->capabilities)) {
       // TODO report this?
       // https://gitlab.com/interpeer/channeler/-/issues/17
-      LIBLOG_ERROR("Ignoring finalize due to mismatching cookie: " << msg->id
-          << " calculated: " << std::hex << cookie << " but got "
-          << msg->cookie2 << std::dec);
+      LIBLOG_ERROR("Ignoring finalize due to mismatching or expired cookie: "
+          << msg->id << " got " << std::hex << msg->cookie2 << std::dec);
       return false;
     }
 
@@ -310,6 +369,11 @@ struct fsm_channel_responder
       return false;
     }
 
+    // Remember the negotiated capabilities; they determine how the channel
+    // is treated from here on. The initiator echoes what we granted, but we
+    // never accept more than we support.
+    m_channels.get(msg->id)->set_capabilities(granted(msg->capabilities));
+
     LIBLOG_DEBUG("Channel fully established: " << msg->id);
     result_actions.push_back(std::move(
         std::make_unique<::channeler::pipe::notify_channel_established_action>(msg->id)
@@ -323,24 +387,168 @@ struct fsm_channel_responder
   }
 
 
-  inline bool handle_cookie(message_channel_cookie * msg [[maybe_unused]],
-      ::channeler::packet_wrapper const & packet [[maybe_unused]],
-      ::channeler::pipe::action_list_type & result_actions [[maybe_unused]],
+  /**
+   * A MSG_CHANNEL_COOKIE arriving on an unknown, complete channel identifier
+   * resumes a channel: the initiator kept the responder cookie from a
+   * previous handshake, and sends it along with data in the first packet.
+   * Because the cookie is derived from our secret, the peers, the full
+   * channel identifier, the granted capabilities and the cookie epoch, we
+   * can validate it without having kept any state. Expired cookies are
+   * rejected.
+   *
+   * To reject replays of such a packet, we remember the channels resumed
+   * while their cookies are valid, and refuse to resume them again. The
+   * initiator then has to fall back to a full handshake.
+   *
+   * This memory does not survive the responder. After a restart with the
+   * same secret, an unexpired ticket can be used once more. Data sent along
+   * with a resumption must therefore be safe to process more than once,
+   * unless the secret changes whenever the responder restarts.
+   */
+  inline bool handle_cookie(message_channel_cookie * msg,
+      ::channeler::packet_wrapper const & packet,
+      ::channeler::pipe::action_list_type & result_actions,
       ::channeler::pipe::event_list_type & output_events [[maybe_unused]])
   {
-    LIBLOG_DEBUG("TODO: MSG_CHANNEL_COOKIE");
-    // TODO
-    // https://gitlab.com/interpeer/channeler/-/issues/13
+    auto const & id = packet.channel();
+    LIBLOG_DEBUG("MSG_CHANNEL_COOKIE(channel["
+        << std::hex << id << "]/"
+        << "cookie[" << std::hex << msg->either_cookie << "]/"
+        << "capabilities[" << std::hex << msg->capabilities << "])"
+        << std::dec);
+
+    if (!id.is_complete()) {
+      LIBLOG_ERROR("Ignoring cookie on incomplete channel identifier: " << id);
+      return false;
+    }
+
+    // As with MSG_CHANNEL_FINALIZE, a pending channel means crossed wires.
+    if (m_channels.has_pending_channel(id.initiator)) {
+      m_channels.drop_pending_channel(id.initiator);
+      LIBLOG_ERROR("Received a cookie for a pending channel; we'll abort.");
+      return false;
+    }
+
+    // Established channels need no further processing.
+    if (m_channels.has_established_channel(id)) {
+      LIBLOG_DEBUG("Ignoring cookie; the channel is already established.");
+      return true;
+    }
+
+    if (m_resumed.find(id) != m_resumed.end()
+        || m_resumed_previous.find(id) != m_resumed_previous.end())
+    {
+      LIBLOG_ERROR("Ignoring cookie; channel was resumed recently: " << id);
+      return false;
+    }
+
+    if (m_resumed.size() >= RESUMPTION_REPLAY_LIMIT) {
+      LIBLOG_ERROR("Ignoring cookie; too many resumptions in this epoch: " << id);
+      return false;
+    }
+
+    if (!valid_cookie(msg->either_cookie, packet, id, msg->capabilities)) {
+      LIBLOG_ERROR("Ignoring cookie due to mismatch or expiry: " << id
+          << " got " << std::hex << msg->either_cookie << std::dec);
+      return false;
+    }
+
+    auto err = m_channels.add(id);
+    if (ERR_SUCCESS != err) {
+      LIBLOG_ET("Could not add channel: " << id, err);
+      return false;
+    }
+    m_channels.get(id)->set_capabilities(granted(msg->capabilities));
+
+    // Remember the resumption until the cookie has expired.
+    m_resumed.insert(id);
+
+    LIBLOG_DEBUG("Channel resumed: " << id);
+    result_actions.push_back(
+        std::make_unique<::channeler::pipe::notify_channel_established_action>(id)
+    );
     return true;
   }
 
 
 
-  virtual ~fsm_channel_responder() = default;
+  /**
+   * Advance the cookie epoch. Cookies issued two epochs ago expire, and so
+   * does the replay protection for them.
+   */
+  inline bool handle_timeout(timeout_event_type * event)
+  {
+    if (event->context.scope != RESUMPTION_EPOCH_TIMEOUT_TAG) {
+      return false;
+    }
+
+    ++m_epoch;
+    m_resumed_previous = std::move(m_resumed);
+    m_resumed.clear();
+    LIBLOG_DEBUG("Advanced cookie epoch to: " << m_epoch);
+
+    arm_epoch_timeout();
+    return true;
+  }
+
+
+  inline cookie_epoch epoch() const
+  {
+    return m_epoch;
+  }
+
+
+  virtual ~fsm_channel_responder()
+  {
+    m_timeouts.remove({RESUMPTION_EPOCH_TIMEOUT_TAG, 0});
+  }
 
 private:
-  channel_set &     m_channels;
-  secret_generator  m_secret_generator;
+  inline capabilities_t granted(capabilities_t const & requested) const
+  {
+    if (!m_supported) {
+      return {};
+    }
+    return requested & m_supported();
+  }
+
+
+  inline void arm_epoch_timeout()
+  {
+    m_timeouts.add({RESUMPTION_EPOCH_TIMEOUT_TAG, 0},
+        std::chrono::microseconds{RESUMPTION_LIFETIME / 2});
+  }
+
+
+  /**
+   * Cookies are valid if they were issued in the current or the previous
+   * epoch. The packet sender is the initiator, and we are the responder.
+   */
+  inline bool valid_cookie(cookie const & c,
+      ::channeler::packet_wrapper const & packet,
+      channelid const & id, capabilities_t const & capabilities) const
+  {
+    auto secret = m_secret_generator();
+    if (validate_cookie(c, secret.data(), secret.size(),
+          packet.sender(), packet.recipient(), id, capabilities, m_epoch))
+    {
+      return true;
+    }
+    return m_epoch > 0 && validate_cookie(c, secret.data(), secret.size(),
+        packet.sender(), packet.recipient(), id, capabilities, m_epoch - 1);
+  }
+
+  ::channeler::support::timeouts &  m_timeouts;
+  channel_set &                     m_channels;
+  secret_generator                  m_secret_generator;
+  capabilities_func                 m_supported;
+  dictionary_func                   m_dictionary;
+
+  cookie_epoch                      m_epoch = 0;
+
+  // Channels resumed in the current and previous epoch.
+  std::set<channelid>               m_resumed = {};
+  std::set<channelid>               m_resumed_previous = {};
 };
 
 
@@ -125,7 +125,13 @@ struct fsm_data
       ::channeler::pipe::action_list_type & result_actions [[maybe_unused]],
       ::channeler::pipe::event_list_type & output_events)
   {
-    if (event->message->type != MSG_DATA) {
+    if (event->message->type == MSG_ECN_FEEDBACK) {
+      return handle_ecn_feedback(event, result_actions);
+    }
+
+    if (event->message->type != MSG_DATA
+        && event->message->type != MSG_DATA_AT)
+    {
       // We process only data messages.
       LIBLOG_DEBUG("Data FSM handles only data messages.");
       return false;
@@ -158,6 +164,27 @@ struct fsm_data
   }
 
 
+  /**
+   * ECN feedback is passed on to the API as an action; congestion control
+   * is not part of the data transport.
+   */
+  inline bool handle_ecn_feedback(message_event_type * event,
+      ::channeler::pipe::action_list_type & result_actions)
+  {
+    if (!m_channels.has_established_channel(event->packet.channel())) {
+      LIBLOG_DEBUG("Cannot handle ECN feedback; channel is not established. Dropping message.");
+      return true;
+    }
+
+    auto msg = reinterpret_cast<message_ecn_feedback const *>(
+        event->message.get());
+    result_actions.push_back(
+        std::make_unique<::channeler::pipe::ecn_feedback_action>(
+          event->packet.channel(), msg->ect0, msg->ect1, msg->ce));
+    return true;
+  }
+
+
   inline bool handle_user_data_written(data_written_event_type * event,
       ::channeler::pipe::action_list_type & result_actions,
       ::channeler::pipe::event_list_type & output_events)
@@ -179,7 +206,8 @@ struct fsm_data
     auto msg = message_data::create(event->data);
     auto ev = std::make_unique<channeler::pipe::message_out_event>(
         event->channel,
-        std::move(msg)
+        std::move(msg),
+        event->deadline
     );
     output_events.push_back(std::move(ev));
 
@@ -71,8 +71,11 @@ get_standard_registry(connection_contextT & conn_ctx)
     typename connection_contextT::channel_type
   >;
   auto resp = std::make_unique<resp_fsm_t>(
+      conn_ctx.timeouts(),
       conn_ctx.channels(),
-      conn_ctx.node().secret_generator()
+      conn_ctx.node().secret_generator(),
+      [&conn_ctx]() { return conn_ctx.capabilities(); },
+      [&conn_ctx]() { return conn_ctx.dictionary(); }
   );
   reg.add_move(std::move(resp));
 
@@ -26,12 +26,23 @@
 
 #include <channeler.h>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <set>
 
+#include <channeler/capabilities.h>
 #include <channeler/channelid.h>
+#include <channeler/cookie.h>
 #include <channeler/error.h>
+#include <channeler/message.h>
 
 #include "../macros.h"
+#include "../support/ecn.h"
+#include "../support/keepalive.h"
+#include "../support/wire.h"
+#include "../snapshot.h"
 
 #include "../fsm/default.h"
 #include "../pipe/ingress.h"
@@ -40,6 +51,17 @@
 
 namespace channeler::internal {
 
+/**
+ * Timeout scope for idle channels in the warm channel pool.
+ */
+constexpr uint16_t WARM_CHANNEL_TIMEOUT_TAG{0x3a4d};
+
+/**
+ * Timeout scope for channels whose next egress packet is rate limited.
+ */
+constexpr uint16_t RATE_LIMIT_TIMEOUT_TAG{0x7a7e};
+
+
 /**
  * This file contains the *internal* API for channeler, i.e. an API that is
  * allows the user to add channeler's protocol support to an existing
@@ -71,6 +93,16 @@ struct connection_api
 
   using buffer_entry = typename connection_contextT::channel_type::buffer_type::buffer_entry;
 
+  using forwarding_table_type = forwarding_table<address_type>;
+  using forward_callback = std::function<void (address_type const &, slot_type const &)>;
+
+  using data_source = std::function<error_t (uint64_t, byte *, std::size_t)>;
+  using data_sink = std::function<error_t (uint64_t, byte const *, std::size_t)>;
+
+  static constexpr std::size_t DEFAULT_MAX_PENDING_PACKETS = 64;
+
+  using keepalive_type = support::keepalive_scheduler<connection_api *>;
+
   /**
    * Constructor accepts:
    * TODO
@@ -117,6 +149,11 @@ struct connection_api
       std::bind(&connection_api::handle_notification_event, this, _1);
   }
 
+  inline ~connection_api()
+  {
+    set_keepalive(nullptr);
+  }
+
   // *** Channel interface
 
   /**
@@ -126,6 +163,10 @@ struct connection_api
    * and does not indicate overall success. On overall success,
    * the channel establishment callback will be invoked.
    *
+   * The channel is requested with the given capabilities, as far as we
+   * support them on this connection. The responder grants those it also
+   * supports; the channel's capabilities() are the result.
+   *
    * Note that this does not permit the user to tie a *purpose* to a particular
    * channel, which is less than ideal.
    *
@@ -133,7 +174,8 @@ struct connection_api
    *       establishment callback can be used to tie a new channel back to
    *       the user's action.
    */
-  inline error_t establish_channel(peerid const & peer)
+  inline error_t establish_channel(peerid const & peer,
+      capabilities_t const & capabilities = {})
   {
     // Channel establishment happens on the default channel; we need to create a
     // default channel entry if we haven't already.
@@ -141,13 +183,14 @@ struct connection_api
 
     // Establishing a channel means sending an appropriate user
     // event to the FSM.
-    auto event = pipe::new_channel_event(m_context.node().id(), peer);
+    auto event = pipe::new_channel_event(m_context.node().id(), peer,
+        capabilities & m_context.capabilities(), m_context.dictionary());
 
     pipe::action_list_type result_actions;
     pipe::event_list_type result_events;
     auto processed = m_registry.process(&event, result_actions, result_events);
     if (!processed || result_events.empty()) {
-      return ERR_STATE;
+      return reported_error(result_actions);
     }
 
     auto ev = std::move(result_events.front());
@@ -167,10 +210,9 @@ struct connection_api
     // Since this is ET_MESSAGE_OUT, feed this to the egress pipe. The pipe
     // then produces callbacks as necessary.
     result_actions = m_egress.consume(std::move(ev));
-    if (!result_actions.empty()) {
-      // TODO handle better
-      LIBLOG_ERROR("TODO");
-      return ERR_UNEXPECTED;
+    auto err = egress_error(result_actions);
+    if (ERR_SUCCESS != err) {
+      return err;
     }
 
     LIBLOG_DEBUG("Channel established successfully.");
@@ -178,6 +220,270 @@ struct connection_api
   }
 
 
+  /**
+   * Initiate multiple channels at once.
+   *
+   * This behaves like establish_channel(), except that all MSG_CHANNEL_NEW
+   * messages are bundled into as few packets as possible. The responder
+   * answers in kind, so that establishing many channels costs a number of
+   * packets rather than a number of handshakes.
+   *
+   * The establishment callback is invoked once per channel. If an error is
+   * returned, no channel from this call remains pending, and the callback is
+   * not invoked for any of them.
+   */
+  inline error_t establish_channels(peerid const & peer, std::size_t count,
+      capabilities_t const & capabilities = {})
+  {
+    return initiate_channels(peer, count, capabilities);
+  }
+
+
+  /**
+   * Keep a pool of warm channels to the given peer.
+   *
+   * The connection establishes up to pool_size channels ahead of demand, and
+   * acquire_warm_channel() hands them out without any handshake latency.
+   * The pool is refilled whenever a channel is handed out, with at most
+   * max_in_flight establishments pending at any time.
+   *
+   * Warm channels that are not acquired within idle_timeout expire; the
+   * pool is then only refilled on the next acquisition, so that an unused
+   * pool drains over time. Timeouts are processed in process_timeouts().
+   *
+   * Warm channels do not trigger the channel establishment callback. They
+   * are requested with the given capabilities, as in establish_channel().
+   */
+  inline error_t set_warm_pool(peerid const & peer, std::size_t pool_size,
+      std::size_t max_in_flight,
+      support::timeouts::duration const & idle_timeout,
+      capabilities_t const & capabilities = {})
+  {
+    m_warm.peer = peer;
+    m_warm.size = pool_size;
+    m_warm.max_in_flight = max_in_flight;
+    m_warm.idle_timeout = idle_timeout;
+    m_warm.capabilities = capabilities;
+    return refill_warm_pool();
+  }
+
+
+  /**
+   * Hand out a warm channel, if one is available. Returns
+   * ERR_DATA_UNAVAILABLE if the pool is empty; the caller can then fall
+   * back to establish_channel().
+   */
+  inline error_t acquire_warm_channel(channelid & id)
+  {
+    while (!m_warm.ready.empty()) {
+      auto candidate = m_warm.ready.front();
+      m_warm.ready.pop_front();
+      m_context.timeouts().remove({WARM_CHANNEL_TIMEOUT_TAG, candidate.initiator});
+
+      // Channels may have timed out underneath us.
+      if (m_context.channels().has_established_channel(candidate)) {
+        id = candidate;
+        refill_warm_pool();
+        return ERR_SUCCESS;
+      }
+    }
+
+    refill_warm_pool();
+    return ERR_DATA_UNAVAILABLE;
+  }
+
+
+  inline std::size_t warm_channels() const
+  {
+    return m_warm.ready.size();
+  }
+
+
+  /**
+   * Wait for the given duration via the connection's timeouts, and process
+   * all timeouts that expired in the meantime.
+   */
+  inline void process_timeouts(support::timeouts::duration const & amount)
+  {
+    auto expired = m_context.timeouts().wait(amount);
+    for (auto & tag : expired) {
+      if (tag.scope == WARM_CHANNEL_TIMEOUT_TAG) {
+        expire_warm_channel(tag.tag);
+        continue;
+      }
+
+      if (tag.scope == RATE_LIMIT_TIMEOUT_TAG) {
+        release_delayed(tag.tag);
+        continue;
+      }
+
+      if (tag.scope == fsm::CHANNEL_NEW_TIMEOUT_TAG) {
+        m_warm.pending.erase(tag.tag);
+      }
+
+      pipe::timeout_event<support::timeout_scoped_tag_type> event{tag};
+      pipe::action_list_type result_actions;
+      pipe::event_list_type result_events;
+      m_registry.process(&event, result_actions, result_events);
+    }
+  }
+
+
+  /**
+   * A resumption ticket holds everything an initiator needs to resume a
+   * channel later without a full handshake: the full channel identifier,
+   * the responder's cookie, and the negotiated capabilities.
+   */
+  struct resumption_ticket
+  {
+    channelid       id = DEFAULT_CHANNELID;
+    cookie          cookie2 = {};
+    capabilities_t  capabilities = {};
+  };
+
+  /**
+   * Retrieve the resumption ticket for a channel this side initiated. Keep
+   * it around if the channel should be resumed after it was closed.
+   */
+  inline error_t get_resumption_ticket(channelid const & id,
+      resumption_ticket & ticket)
+  {
+    auto channel = m_context.channels().get(id);
+    if (!channel || !m_context.channels().has_established_channel(id)) {
+      return ERR_INVALID_CHANNELID;
+    }
+    if (channel->resumption_cookie() == cookie{}) {
+      // Not initiated by us.
+      return ERR_STATE;
+    }
+
+    ticket = {id, channel->resumption_cookie(), channel->capabilities()};
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Resume a channel with a ticket from a previous establishment, sending
+   * data in the very same packet (0-RTT). The packet leads with a
+   * MSG_CHANNEL_COOKIE, which lets the responder validate the ticket without
+   * any further exchange.
+   *
+   * On success, the channel is established locally right away. If the
+   * responder rejects the resumption, e.g. because its cookie secret changed,
+   * the ticket expired or it considers the packet a replay, the data is lost;
+   * the channel should then be established anew.
+   *
+   * Tickets expire after fsm::DEFAULT_RESUMPTION_LIFETIME at the latest.
+   * Within that lifetime, a responder that restarted with the same secret
+   * cannot detect a replay, so the data must be safe to process twice.
+   */
+  inline error_t resume_channel(resumption_ticket const & ticket,
+      byte const * data, std::size_t length, std::size_t & written)
+  {
+    written = 0;
+    if (!ticket.id.is_complete()
+        || m_context.channels().has_channel(ticket.id.initiator))
+    {
+      return ERR_INVALID_CHANNELID;
+    }
+
+    auto err = m_context.channels().add(ticket.id);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+
+    auto channel = m_context.channels().get(ticket.id);
+    channel->set_capabilities(ticket.capabilities);
+    channel->set_resumption_cookie(ticket.cookie2);
+
+    // The cookie message goes into the channel's queue first, so that message
+    // bundling places it ahead of the data.
+    channel->enqueue_egress_message(std::make_unique<message_channel_cookie>(
+          ticket.cookie2, ticket.capabilities));
+
+    err = channel_write(ticket.id, data, length, written);
+    if (ERR_SUCCESS != err) {
+      m_context.channels().remove(ticket.id);
+    }
+    return err;
+  }
+
+  inline error_t resume_channel(resumption_ticket const & ticket,
+      char const * data, std::size_t length, std::size_t & written)
+  {
+    return resume_channel(ticket,
+        reinterpret_cast<byte const *>(data),
+        length, written);
+  }
+
+
+  /**
+   * Capture the connection state for a fast restart: the established
+   * channels and the node's cookie secret. Save the snapshot with
+   * save_snapshot() from snapshot_file.h, and add any socket file
+   * descriptors that are handed over to the new process to it beforehand.
+   */
+  inline void snapshot(connection_snapshot & snap) const
+  {
+    snap.self = m_context.node().id();
+    snap.peer = m_context.peer();
+    snap.secret = m_context.node().secret_generator()();
+
+    snap.channels.clear();
+    m_context.channels().for_each_established(
+        [&snap](channelid const & id, auto const & channel)
+        {
+          snap.channels.push_back({id, channel->capabilities(),
+              channel->resumption_cookie()});
+        });
+  }
+
+
+  /**
+   * Restore the established channels from a snapshot of a connection to the
+   * same peer. No messages are exchanged; the peer never noticed that the
+   * channels went away.
+   *
+   * The node's secret generator must produce the snapshot's secret, so that
+   * cookies issued before the restart remain valid; otherwise ERR_STATE is
+   * returned. If a channel cannot be restored, the channels restored before
+   * it are removed again.
+   *
+   * The responder's memory of resumed channels is not restored; see
+   * connection_snapshot.
+   */
+  inline error_t restore(connection_snapshot const & snap)
+  {
+    if (snap.self != m_context.node().id() || snap.peer != m_context.peer()) {
+      return ERR_STATE;
+    }
+    if (snap.secret != m_context.node().secret_generator()()) {
+      LIBLOG_ERROR("Snapshot was taken with a different cookie secret.");
+      return ERR_STATE;
+    }
+
+    std::vector<channelid> restored;
+    for (auto & entry : snap.channels) {
+      bool existed = m_context.channels().has_channel(entry.id);
+      auto err = m_context.channels().add(entry.id);
+      if (ERR_SUCCESS != err) {
+        for (auto & id : restored) {
+          m_context.channels().remove(id);
+        }
+        return err;
+      }
+      if (!existed) {
+        restored.push_back(entry.id);
+      }
+
+      auto channel = m_context.channels().get(entry.id);
+      channel->set_capabilities(entry.capabilities);
+      channel->set_resumption_cookie(entry.resumption_cookie);
+    }
+    return ERR_SUCCESS;
+  }
+
+
   /**
    * Write data to a channel.
    *
@@ -186,9 +492,15 @@ struct connection_api
    *
    * Note that for simplicity's sake, this API does *not* currently break down
    * too-large data chunks into individual packets. TODO
+   *
+   * If a deadline is given, data that could not be sent by then is dropped
+   * from the channel's egress queue, or from its egress buffer if it was
+   * already packed, instead of being sent late. Data in the buffer is only
+   * dropped when every message in its packet has expired.
    */
   inline error_t channel_write(channelid const & id, byte const * data,
-      std::size_t length, std::size_t & written)
+      std::size_t length, std::size_t & written,
+      pipe::message_deadline const & deadline = pipe::message_deadline::max())
   {
     written = 0;
     if (id == DEFAULT_CHANNELID || !id.has_responder()) {
@@ -198,13 +510,14 @@ struct connection_api
     // The user data event carries unbounded amounts of data. It's up to the
     // FSM to split this up.
     std::vector<byte> payload{data, data + length};
-    auto event = pipe::user_data_written_event(id, std::move(payload));
+    auto event = pipe::user_data_written_event(id, std::move(payload),
+        deadline);
 
     pipe::action_list_type result_actions;
     pipe::event_list_type result_events;
     auto processed = m_registry.process(&event, result_actions, result_events);
     if (!processed || result_events.empty()) {
-      return ERR_STATE;
+      return reported_error(result_actions);
     }
 
     auto ev = std::move(result_events.front());
@@ -224,10 +537,9 @@ struct connection_api
     // Since this is ET_MESSAGE_OUT, feed this to the egress pipe. The pipe
     // then produces callbacks as necessary.
     result_actions = m_egress.consume(std::move(ev));
-    if (!result_actions.empty()) {
-      // TODO handle better
-      LIBLOG_ERROR("TODO");
-      return ERR_UNEXPECTED;
+    auto err = egress_error(result_actions);
+    if (ERR_SUCCESS != err) {
+      return err;
     }
 
     LIBLOG_DEBUG("Data written successfully.");
@@ -244,6 +556,153 @@ struct connection_api
   }
 
 
+  /**
+   * Write data to a channel with a time-to-live, i.e. a deadline relative to
+   * now. This suits e.g. media or telemetry data, which is useless when late.
+   */
+  inline error_t channel_write(channelid const & id, byte const * data,
+      std::size_t length, std::size_t & written,
+      std::chrono::nanoseconds const & ttl)
+  {
+    return channel_write(id, data, length, written,
+        pipe::message_deadline::clock::now() + ttl);
+  }
+
+
+  /**
+   * Write the same data to each of the channels in [begin, end), e.g. to
+   * publish to many subscribers.
+   *
+   * The data is wrapped in a message and serialized only once, and only
+   * packet headers are produced per channel. Unlike channel_write(), this
+   * sends immediately, one packet per channel; the data must fit into a
+   * single packet.
+   *
+   * All channel identifiers are checked before anything is sent; written
+   * is set to the number of channels the data was sent on.
+   */
+  template <
+    typename iterT
+  >
+  inline error_t channel_write_many(iterT begin, iterT end,
+      byte const * data, std::size_t length, std::size_t & written)
+  {
+    written = 0;
+    for (auto iter = begin ; iter != end ; ++iter) {
+      if (*iter == DEFAULT_CHANNELID || !iter->has_responder()
+          || !m_context.channels().has_established_channel(*iter))
+      {
+        return ERR_INVALID_CHANNELID;
+      }
+    }
+
+    std::vector<byte> payload{data, data + length};
+    auto msg = message_data::create(payload);
+
+    // On errors, written still counts the channels the data was sent on.
+    auto result_actions = m_egress.fan_out(begin, end, msg, written);
+    auto err = egress_error(result_actions);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+
+    LIBLOG_DEBUG("Data written to " << written << " channel(s).");
+    return ERR_SUCCESS;
+  }
+
+
+
+  /**
+   * Send length Bytes of a file, starting at offset, on the channel. The
+   * source - e.g. support::fd_source - is asked for the file in chunks,
+   * which it writes straight into packet slots, one MSG_DATA_AT message per
+   * packet, so the file is never held in memory as a whole.
+   *
+   * Each message carries the file offset of its chunk, so the receiving
+   * sink places it correctly even if packets are lost or reordered.
+   *
+   * Transports may drain the egress buffer only after the packet_to_send
+   * callback returns. To keep the memory footprint fixed, sending stops
+   * early once max_pending packets wait in the channel's egress buffer.
+   * The number of Bytes sent is returned in written; the caller resumes at
+   * offset + written once the transport caught up. This also holds if an
+   * error is returned.
+   */
+  inline error_t channel_send_file(channelid const & id, data_source source,
+      uint64_t offset, std::size_t length, std::size_t & written,
+      std::size_t max_pending = DEFAULT_MAX_PENDING_PACKETS)
+  {
+    written = 0;
+    if (id == DEFAULT_CHANNELID || !id.has_responder()) {
+      return ERR_INVALID_CHANNELID;
+    }
+    auto channel = m_context.channels().get(id);
+    if (!channel || !m_context.channels().has_established_channel(id)) {
+      return ERR_INVALID_CHANNELID;
+    }
+
+    auto chunk = m_egress.max_data_at_size();
+    if (!chunk) {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+
+    while (written < length && channel->egress_buffer().size() < max_pending) {
+      auto size = std::min(chunk, length - written);
+      uint64_t chunk_offset = offset + written;
+
+      pipe::action_list_type result_actions;
+      auto err = m_egress.bundle_in_place(id, chunk_offset, size,
+          [&source, chunk_offset](byte * buf, std::size_t buf_size) -> error_t
+          {
+            return source(chunk_offset, buf, buf_size);
+          },
+          result_actions);
+      if (ERR_SUCCESS != err) {
+        return err;
+      }
+
+      // Error actions mean the packet was not enqueued; anything else
+      // leaves it on its way.
+      err = egress_error(result_actions);
+      if (ERR_SUCCESS != err) {
+        return err;
+      }
+      written += size;
+    }
+
+    LIBLOG_DEBUG("Sent " << written << " of " << length << " Bytes from file.");
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Pass file data received on the channel - see channel_send_file() - to
+   * the sink, e.g. support::fd_sink or support::memory_sink, instead of
+   * buffering it for channel_read(). The sink receives each chunk with its
+   * offset, in the order in which packets arrive. The data_available
+   * callback is not invoked for data that the sink consumed.
+   *
+   * Data written with channel_write() carries no offset, and is always
+   * buffered.
+   *
+   * If the sink fails, it is removed, and data is buffered as usual from
+   * then on; see has_channel_sink().
+   */
+  inline void set_channel_sink(channelid const & id, data_sink sink)
+  {
+    m_sinks[id] = sink;
+  }
+
+  inline void clear_channel_sink(channelid const & id)
+  {
+    m_sinks.erase(id);
+  }
+
+  inline bool has_channel_sink(channelid const & id) const
+  {
+    return m_sinks.find(id) != m_sinks.end();
+  }
+
 
   /**
    * Read data from channel.
@@ -278,10 +737,15 @@ struct connection_api
       // XXX skip safeguards here (for now), because we're the only one
       //     writign this kind of event here.
       auto converted = reinterpret_cast<pipe::user_data_to_read_event<connection_contextT::POOL_BLOCK_SIZE> *>(ev.get());
-      std::size_t to_copy = std::min(converted->message->payload_size, max);
-      LIBLOG_DEBUG("Copying " << to_copy << " Bytes of " << converted->message->payload_size
+      uint64_t offset = 0;
+      byte const * payload = nullptr;
+      std::size_t size = 0;
+      split_data(*converted->message, offset, payload, size);
+
+      std::size_t to_copy = std::min(size, max);
+      LIBLOG_DEBUG("Copying " << to_copy << " Bytes of " << size
           << " to buffer of size " << max);
-      ::memcpy(data, converted->message->payload, to_copy);
+      ::memcpy(data, payload, to_copy);
 
       // FIXME This is not taking into account partial reads of a message, so
       //       this needs fixing.
@@ -317,6 +781,17 @@ struct connection_api
   }
 
 
+  /**
+   * A received packet, for batched consumption.
+   */
+  struct received_entry
+  {
+    address_type  source;
+    address_type  destination;
+    slot_type     slot;
+  };
+
+
   /**
    * Consume received packets.
    *
@@ -327,16 +802,52 @@ struct connection_api
       address_type const & destination,
       slot_type const & slot)
   {
-    LIBLOG_DEBUG("Received packet: " << slot.size());
-    auto ev = std::make_unique<
-      pipe::raw_buffer_event<
-        address_type, connection_contextT::POOL_BLOCK_SIZE
-      >
-    >(source, destination, slot);
+    received_entry entry{source, destination, slot};
+    return received_packets(&entry, &entry + 1);
+  }
+
+
+  /**
+   * Consume a batch of received packets, given as a range of
+   * received_entry.
+   *
+   * Egress events produced while processing the batch are collected, and
+   * only passed to the egress pipe once the whole batch has been processed.
+   * Responses to messages in different packets of the batch can therefore
+   * be bundled into the same outgoing packet.
+   */
+  template <
+    typename iterT
+  >
+  inline error_t received_packets(iterT begin, iterT end)
+  {
+    pipe::action_list_type actions;
+
+    if (m_keepalive && begin != end) {
+      m_keepalive->touch(this);
+    }
+
+    // Feed into default ingress pipe.
+    m_defer_egress = true;
+    for ( ; begin != end ; ++begin) {
+      LIBLOG_DEBUG("Received packet: " << begin->slot.size());
+      auto ev = std::make_unique<
+        pipe::raw_buffer_event<
+          address_type, connection_contextT::POOL_BLOCK_SIZE
+        >
+      >(begin->source, begin->destination, begin->slot);
+
+      auto ingress_actions = m_ingress.consume(std::move(ev));
+      actions.splice(actions.end(), ingress_actions);
+    }
+    m_defer_egress = false;
 
-    // Feed into default ingress pipe
-    auto actions = m_ingress.consume(std::move(ev));
+    pipe::event_list_type deferred;
+    deferred.swap(m_deferred_egress);
+    auto egress_actions = m_egress.consume_all(std::move(deferred));
+    actions.splice(actions.end(), egress_actions);
 
+    error_t result = ERR_SUCCESS;
     for (auto & act : actions) {
       // We cannot handle all actions. However, we do expect a channel
       // establishment notification action here.
@@ -346,19 +857,78 @@ struct connection_api
           {
             auto actconv = reinterpret_cast<pipe::notify_channel_established_action *>(act.get());
             LIBLOG_DEBUG("FSM reports channel established: " << actconv->channel);
+            if (warm_channel_established(actconv->channel)) {
+              refill_warm_pool();
+              break;
+            }
             m_remote_establishment_cb(ERR_SUCCESS, actconv->channel);
           }
           break;
 
+        case pipe::AT_FORWARD_PACKET:
+          {
+            auto actconv = reinterpret_cast<
+              pipe::forward_packet_action<address_type, slot_type> *
+            >(act.get());
+            if (m_forward_cb) {
+              m_forward_cb(actconv->next_hop, actconv->slot);
+            }
+          }
+          break;
+
+        case pipe::AT_ECN_FEEDBACK:
+          {
+            auto actconv = reinterpret_cast<pipe::ecn_feedback_action *>(
+                act.get());
+            if (m_congestion_controller) {
+              m_congestion_controller->on_feedback({actconv->ect0,
+                  actconv->ect1, actconv->ce});
+            }
+          }
+          break;
+
+        case pipe::AT_ERROR:
+          // Malformed packets are rejected by the pipe. Report the first
+          // error, but do not let it affect the rest of the batch.
+          {
+            auto actconv = reinterpret_cast<pipe::error_action *>(act.get());
+            LIBLOG_ET("Ingress pipe rejected packet", actconv->error);
+            if (ERR_SUCCESS == result) {
+              result = actconv->error;
+            }
+          }
+          break;
+
+        case pipe::AT_FILTER_TRANSPORT:
+        case pipe::AT_FILTER_PEER:
+          // The route filter applies peer bans; there is no transport level
+          // filter to pass address bans to yet.
+          LIBLOG_DEBUG("Ingress pipe requests filtering: " << act->type);
+          break;
+
         default:
+          // Like errors, this must not cost the other packets in the batch
+          // their actions.
           LIBLOG_ERROR("Ingress pipe reports action we don't understand: "
               << act->type);
-          return ERR_UNEXPECTED;
+          if (ERR_SUCCESS == result) {
+            result = ERR_UNEXPECTED;
+          }
+          break;
       }
     }
 
-    LIBLOG_DEBUG("Packet processed after receipt.");
-    return ERR_SUCCESS;
+    LIBLOG_DEBUG("Packets processed after receipt.");
+    return result;
+  }
+
+
+  /**
+   * The size of every packet this connection sends.
+   */
+  inline std::size_t packet_size() const
+  {
+    return m_context.node().packet_size();
   }
 
 
@@ -367,18 +937,349 @@ struct connection_api
    *
    * Also buffers for outgoing packets are taken from a pool, so the
    * API just returns the slot. If the slot is empty, there is no more
-   * data ready for sending.
+   * data ready for sending, or the next packet is rate limited; see
+   * release_delay().
    */
   inline buffer_entry packet_to_send(channelid const & channel)
   {
-    auto ptr = m_context.channels().get(channel);
     // TODO in future, don't just pop - we might have to resend something
-    return ptr->egress_buffer_pop();
+    auto entry = m_egress.release(channel);
+    schedule_release(channel);
+    return entry;
+  }
+
+
+  /**
+   * Dequeue up to max packets ready for sending on the channel, appending
+   * them to the output container. Returns the number of packets dequeued.
+   *
+   * Transports that send in batches can drain a channel with a single call,
+   * rather than one call per packet_to_send callback.
+   */
+  template <
+    typename containerT
+  >
+  inline std::size_t packets_to_send(channelid const & channel,
+      containerT & out, std::size_t max)
+  {
+    std::size_t count = 0;
+    for ( ; count < max ; ++count) {
+      auto entry = m_egress.release(channel);
+      if (!entry.data.size()) {
+        break;
+      }
+      out.push_back(std::move(entry));
+    }
+    schedule_release(channel);
+    return count;
+  }
+
+
+  /**
+   * Rate limit egress packets with token buckets. The limiter set here
+   * applies to all channels of the connection; to limit a peer across
+   * several connections, set the same limiter on each. Channels can have
+   * their own limiter in addition. Limiters must outlive their use here;
+   * pass nullptr to remove them.
+   *
+   * Rate limited packets remain in the channel's egress buffer. A timeout
+   * is armed for when the next one can be sent; once it expires in
+   * process_timeouts(), the packet_to_send callback is invoked. If a limiter
+   * does not refill at all, no timeout is armed. Use release_delay() to find
+   * when the next packet can be sent.
+   */
+  using rate_limiter = support::token_bucket;
+
+  inline void set_rate_limiter(rate_limiter * limiter)
+  {
+    m_egress.set_rate_limiter(limiter);
+  }
+
+  inline error_t set_channel_rate_limiter(channelid const & id,
+      rate_limiter * limiter)
+  {
+    auto channel = m_context.channels().get(id);
+    if (!channel) {
+      return ERR_INVALID_CHANNELID;
+    }
+    channel->set_rate_limiter(limiter);
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * The time until the next packet on the channel can be sent; zero if it
+   * can be sent now, and duration::max() if there is none.
+   */
+  inline rate_limiter::duration release_delay(channelid const & channel)
+  {
+    return m_egress.release_delay(channel);
+  }
+
+
+  /**
+   * Report the ECN codepoint counts of packets received from the peer back
+   * to it, e.g. from the transport's counts after each received batch. The
+   * peer's congestion controller then reacts to CE marks.
+   */
+  inline error_t send_ecn_feedback(channelid const & id,
+      support::ecn_counts const & counts)
+  {
+    if (!m_context.channels().has_established_channel(id)
+        || id == DEFAULT_CHANNELID)
+    {
+      return ERR_INVALID_CHANNELID;
+    }
+
+    auto ev = std::make_unique<pipe::message_out_event>(id,
+        std::make_unique<message_ecn_feedback>(counts.ect0, counts.ect1,
+          counts.ce));
+    auto result_actions = m_egress.consume(std::move(ev));
+    return egress_error(result_actions);
+  }
+
+
+  /**
+   * Pass ECN feedback received from the peer to the congestion controller.
+   * The controller must outlive its use here; pass nullptr to ignore
+   * feedback.
+   */
+  inline void set_congestion_controller(
+      support::ecn_rate_controller * controller)
+  {
+    m_congestion_controller = controller;
+  }
+
+
+  /**
+   * Relay received packets addressed to other peers: the callback is
+   * invoked with the next hop from the table, and the unchanged slot the
+   * packet was received in, for sending on the appropriate transport.
+   *
+   * The table must outlive its use here; pass nullptr to stop relaying.
+   */
+  inline void set_forwarding(forwarding_table_type const * table,
+      forward_callback callback)
+  {
+    m_ingress.set_forwarding_table(table);
+    m_forward_cb = callback;
+  }
+
+
+  /**
+   * Register this connection with a node-wide keepalive scheduler, which
+   * invokes its probe function with the connection when it was idle for an
+   * interval; the probe should then call send_keepalive() on it. Traffic in
+   * either direction counts as activity.
+   *
+   * Connections are registered individually, so several connections to the
+   * same peer - e.g. over different transports - are kept alive
+   * independently.
+   *
+   * The scheduler must outlive its use here; pass nullptr to unregister.
+   */
+  inline void set_keepalive(keepalive_type * scheduler)
+  {
+    if (m_keepalive) {
+      m_keepalive->remove(this);
+    }
+    m_keepalive = scheduler;
+    if (m_keepalive) {
+      m_keepalive->add(this);
+    }
+  }
+
+
+  /**
+   * Send a packet without messages on the default channel, to keep the
+   * connection's NAT bindings alive.
+   */
+  inline void send_keepalive()
+  {
+    m_context.channels().add(DEFAULT_CHANNELID);
+    m_egress.keepalive(DEFAULT_CHANNELID);
+  }
+
+
+  /**
+   * Compress data on channels with the CAP_COMPRESSION or
+   * CAP_COMPRESSION_DICTIONARY capabilities, and decompress received data.
+   * The compression instance must outlive its use here; pass nullptr to stop
+   * compressing.
+   *
+   * The capabilities are only negotiated for channels established while a
+   * compression instance is set: CAP_COMPRESSION if LZ4 is available, and
+   * CAP_COMPRESSION_DICTIONARY if the instance has a dictionary loaded, so
+   * load it before calling this.
+   */
+  inline void set_compression(support::payload_compression * compression)
+  {
+    auto & caps = m_context.capabilities();
+    caps[CAP_COMPRESSION] = compression
+      && support::payload_compression::available(support::CODEC_LZ4);
+    caps[CAP_COMPRESSION_DICTIONARY] = compression
+      && compression->has_dictionary();
+    m_context.dictionary() = compression ? compression->dictionary_id() : 0;
+    m_ingress.set_compression(compression,
+        &m_context.node().packet_pool());
+    m_egress.set_compression(compression);
+  }
+
+
+  /**
+   * Record ingress and egress packets to the given capture. The capture
+   * must outlive its use here; pass nullptr to stop capturing.
+   */
+  inline void set_packet_capture(capture::packet_capture * pcap)
+  {
+    m_ingress.set_capture(pcap);
+    m_egress.set_capture(pcap);
   }
 
 
 private:
 
+  /**
+   * If the registry did not produce the expected events, the FSMs may have
+   * reported why in an error action. Otherwise, it's a state error.
+   */
+  inline error_t reported_error(pipe::action_list_type const & actions) const
+  {
+    auto err = pipe::first_error(actions);
+    return (ERR_SUCCESS == err) ? ERR_STATE : err;
+  }
+
+
+  /**
+   * The egress pipe reports packets it could not enqueue as error actions;
+   * anything else it returns is unexpected, and only logged.
+   */
+  inline error_t egress_error(pipe::action_list_type const & actions) const
+  {
+    for (auto & action : actions) {
+      if (action && action->type != pipe::AT_ERROR) {
+        LIBLOG_WARN("Unexpected egress action: " << action->type);
+      }
+    }
+    return pipe::first_error(actions);
+  }
+
+
+  inline error_t initiate_channels(peerid const & peer, std::size_t count,
+      capabilities_t const & capabilities,
+      std::set<channelid::half_type> * initiated = nullptr)
+  {
+    m_context.channels().add(DEFAULT_CHANNELID);
+
+    std::vector<channelid::half_type> created;
+    pipe::event_list_type out_events;
+    error_t err = ERR_SUCCESS;
+    for (std::size_t i = 0 ; i < count && ERR_SUCCESS == err ; ++i) {
+      auto event = pipe::new_channel_event(m_context.node().id(), peer,
+          capabilities & m_context.capabilities(), m_context.dictionary());
+
+      pipe::action_list_type result_actions;
+      pipe::event_list_type result_events;
+      auto processed = m_registry.process(&event, result_actions, result_events);
+      if (!processed || result_events.empty()) {
+        err = reported_error(result_actions);
+        break;
+      }
+
+      for (auto & ev : result_events) {
+        if (!ev || ev->type != pipe::ET_MESSAGE_OUT) {
+          LIBLOG_ERROR("Registry did not produce an outgoing message!");
+          err = ERR_STATE;
+          break;
+        }
+
+        auto converted = reinterpret_cast<pipe::message_out_event *>(ev.get());
+        if (converted->message->type == MSG_CHANNEL_NEW) {
+          auto msg = reinterpret_cast<message_channel_new *>(
+              converted->message.get());
+          created.push_back(msg->initiator_part);
+          if (initiated) {
+            initiated->insert(msg->initiator_part);
+          }
+        }
+        out_events.push_back(std::move(ev));
+      }
+    }
+
+    if (ERR_SUCCESS == err) {
+      auto result_actions = m_egress.consume_all(std::move(out_events));
+      err = egress_error(result_actions);
+    }
+
+    if (ERR_SUCCESS != err) {
+      // Drop all channels pending from this call. If some of their requests
+      // were sent nonetheless, the responses are ignored.
+      for (auto & half : created) {
+        m_context.timeouts().remove({fsm::CHANNEL_NEW_TIMEOUT_TAG, half});
+        m_context.channels().remove(half);
+        if (initiated) {
+          initiated->erase(half);
+        }
+      }
+      LIBLOG_ERROR("Could not initiate channels, dropped " << created.size()
+          << " pending: " << error_name(err));
+      return err;
+    }
+
+    LIBLOG_DEBUG("Channel establishment initiated for " << count << " channels.");
+    return ERR_SUCCESS;
+  }
+
+
+  inline error_t refill_warm_pool()
+  {
+    auto have = m_warm.ready.size() + m_warm.pending.size();
+    if (have >= m_warm.size || m_warm.pending.size() >= m_warm.max_in_flight) {
+      return ERR_SUCCESS;
+    }
+
+    auto count = std::min(m_warm.size - have,
+        m_warm.max_in_flight - m_warm.pending.size());
+
+    // The channels are marked as pending *before* sending; responses may
+    // arrive while we're still in the egress pipe.
+    return initiate_channels(m_warm.peer, count, m_warm.capabilities,
+        &m_warm.pending);
+  }
+
+
+  /**
+   * Returns true if the channel was established for the warm pool.
+   */
+  inline bool warm_channel_established(channelid const & id)
+  {
+    auto iter = m_warm.pending.find(id.initiator);
+    if (iter == m_warm.pending.end()) {
+      return false;
+    }
+    m_warm.pending.erase(iter);
+
+    LIBLOG_DEBUG("Warm channel ready: " << id);
+    m_warm.ready.push_back(id);
+    m_context.timeouts().add({WARM_CHANNEL_TIMEOUT_TAG, id.initiator},
+        m_warm.idle_timeout);
+    return true;
+  }
+
+
+  inline void expire_warm_channel(channelid::half_type const & initiator)
+  {
+    auto iter = std::find_if(m_warm.ready.begin(), m_warm.ready.end(),
+        [&initiator](channelid const & id) { return id.initiator == initiator; });
+    if (iter == m_warm.ready.end()) {
+      return;
+    }
+
+    LIBLOG_DEBUG("Warm channel expired: " << *iter);
+    m_context.channels().remove(*iter);
+    m_warm.ready.erase(iter);
+  }
+
+
   pipe::action_list_type redirect_egress_event(std::unique_ptr<pipe::event> ev)
   {
     LIBLOG_DEBUG("Egress event produced: " << ev->category << " / " << ev->type);
@@ -390,10 +1291,24 @@ private:
           >(ev.get());
           auto channel = converted->channel->id();
           LIBLOG_DEBUG("Notifying packet available on channel: " << channel);
+          if (m_keepalive) {
+            m_keepalive->touch(this);
+          }
           m_packet_to_send_cb(channel);
         }
         break;
 
+      case pipe::ET_PACKET_OUT_DELAYED:
+        {
+          auto converted = reinterpret_cast<
+            pipe::packet_out_delayed_event<typename connection_contextT::channel_type> *
+          >(ev.get());
+          auto channel = converted->channel->id();
+          LIBLOG_DEBUG("Packet on channel is rate limited: " << channel);
+          schedule_release(channel);
+        }
+        break;
+
       default:
         break;
     }
@@ -402,6 +1317,52 @@ private:
     return {};
   }
 
+
+  /**
+   * Arm a timeout for when the next packet on the channel can be released,
+   * if it is rate limited. A timeout that is already armed is kept.
+   */
+  inline void schedule_release(channelid const & channel)
+  {
+    auto delay = m_egress.release_delay(channel);
+    if (delay == rate_limiter::duration::zero()
+        || delay == rate_limiter::duration::max())
+    {
+      return;
+    }
+    m_context.timeouts().add({RATE_LIMIT_TIMEOUT_TAG, channel.initiator},
+        std::chrono::ceil<support::timeouts::duration>(delay));
+  }
+
+
+  /**
+   * Notify that the channel's next packets can be sent, or wait some more;
+   * the timeouts' clock need not agree with the rate limiters'.
+   */
+  inline void release_delayed(channelid::half_type const & initiator)
+  {
+    auto id = m_context.channels().get_established_id(initiator);
+    if (id == DEFAULT_CHANNELID && initiator != DEFAULT_CHANNELID.initiator) {
+      // Channel was closed in the meantime
+      return;
+    }
+    auto channel = m_context.channels().get(id);
+    if (!channel) {
+      return;
+    }
+
+    // Announce each packet that can be sent now, but no more than are
+    // buffered, in case the callback does not release them right away.
+    auto pending = channel->egress_buffer().size();
+    while (pending-- > 0
+        && m_egress.release_delay(id) == rate_limiter::duration::zero())
+    {
+      LIBLOG_DEBUG("Rate limited packet can be sent on channel: " << id);
+      m_packet_to_send_cb(id);
+    }
+    schedule_release(id);
+  }
+
   pipe::action_list_type handle_ingress_event(std::unique_ptr<pipe::event> ev)
   {
     LIBLOG_DEBUG("Handling ingress event of type: " << ev->type);
@@ -419,6 +1380,10 @@ private:
   pipe::action_list_type handle_egress_event(std::unique_ptr<pipe::event> ev)
   {
     LIBLOG_DEBUG("Handling egress event of type: " << ev->type);
+    if (m_defer_egress) {
+      m_deferred_egress.push_back(std::move(ev));
+      return {};
+    }
     return m_egress.consume(std::move(ev));
   }
 
@@ -436,6 +1401,35 @@ private:
     return {};
   }
 
+  /**
+   * Find the application data in a data message. MSG_DATA_AT payloads start
+   * with the offset of the data; for other data messages, it is zero.
+   */
+  static inline bool split_data(message const & msg, uint64_t & offset,
+      byte const * & data, std::size_t & size)
+  {
+    switch (msg.type) {
+      case MSG_DATA:
+        offset = 0;
+        data = msg.payload;
+        size = msg.payload_size;
+        return true;
+
+      case MSG_DATA_AT:
+        if (msg.payload_size < DATA_OFFSET_SIZE) {
+          return false;
+        }
+        offset = support::load_be<uint64_t>(msg.payload);
+        data = msg.payload + DATA_OFFSET_SIZE;
+        size = msg.payload_size - DATA_OFFSET_SIZE;
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
   pipe::action_list_type handle_notification_event(std::unique_ptr<pipe::event> ev)
   {
     LIBLOG_DEBUG("Handling notification event of type: " << ev->type);
@@ -446,13 +1440,31 @@ private:
             pipe::user_data_to_read_event<connection_contextT::POOL_BLOCK_SIZE> *
           >(ev.get());
 
-          if (converted->message->type != MSG_DATA) {
-            LIBLOG_ERROR("Unknown message type for user data available: " << converted->message->type);
+          uint64_t offset = 0;
+          byte const * payload = nullptr;
+          std::size_t size = 0;
+          if (!split_data(*converted->message, offset, payload, size)) {
+            LIBLOG_ERROR("Unknown or malformed message for user data available: "
+                << converted->message->type);
             return {};
           }
 
           auto id = converted->channel;
-          auto size = converted->message->payload_size;
+
+          auto sink = m_sinks.find(id);
+          if (sink != m_sinks.end() && converted->message->type == MSG_DATA_AT) {
+            auto err = sink->second(offset, payload, size);
+            if (ERR_SUCCESS == err) {
+              auto channel = m_context.channels().get(id);
+              if (channel) {
+                channel->ingress_buffer().release(converted->slot);
+              }
+              return {};
+            }
+            LIBLOG_ERROR("Channel sink failed, buffering data instead: "
+                << error_name(err));
+            m_sinks.erase(sink);
+          }
 
           m_user_data_buffer[id].push_back(std::move(ev));
 
@@ -481,11 +1493,33 @@ private:
   channel_establishment_callback  m_remote_establishment_cb;
   packet_to_send_callback         m_packet_to_send_cb;
   data_available_callback         m_data_available_cb;
+  forward_callback                m_forward_cb = {};
+  keepalive_type *                m_keepalive = nullptr;
+  support::ecn_rate_controller *  m_congestion_controller = nullptr;
 
   // XXX This we'd like to have more efficient with improved buffer management
   //     in the next milestone.
   using user_data_buffer = std::map<channelid, pipe::event_list_type>;
   user_data_buffer                m_user_data_buffer = {};
+
+  // Channels whose data is passed to a sink instead.
+  std::map<channelid, data_sink>  m_sinks = {};
+
+  // Warm channel pool
+  struct
+  {
+    peerid                          peer = {};
+    std::size_t                     size = 0;
+    std::size_t                     max_in_flight = 0;
+    support::timeouts::duration     idle_timeout = {};
+    capabilities_t                  capabilities = {};
+    std::set<channelid::half_type>  pending = {};
+    std::deque<channelid>           ready = {};
+  } m_warm;
+
+  // Egress events are deferred while a received packet is processed.
+  bool                            m_defer_egress = false;
+  pipe::event_list_type           m_deferred_egress = {};
 };
 
 
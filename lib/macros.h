@@ -43,7 +43,7 @@
     }                                                               \
     flowcontrol << "Control should never have reached this line: "  \
       << __FILE__ << ":" << __LINE__;                               \
-    throw exception(ERR_UNEXPECTED, flowcontrol.str());             \
+    throw_exception(ERR_UNEXPECTED, flowcontrol.str());             \
   }
 
 #define CHANNELER_FLOW_CONTROL_GUARD CHANNELER_FLOW_CONTROL_GUARD_WITH("")
@@ -214,8 +214,8 @@ public:
     // We will do one runtime check, which is whether the slot actually belongs
     // to this block.
     if (&(s.m_block) != this) {
-      throw exception{ERR_INVALID_REFERENCE,
-        "Memory slot does not belong to the current block."};
+      throw_exception(ERR_INVALID_REFERENCE,
+        "Memory slot does not belong to the current block.");
     }
 
     // Unused slots are detected by pointing at capacity
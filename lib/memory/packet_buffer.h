@@ -26,6 +26,7 @@
 
 #include <channeler.h>
 
+#include <chrono>
 #include <list>
 
 #include "packet_pool.h"
@@ -75,11 +76,15 @@ class packet_buffer
 public:
   using pool_type = packet_pool<POOL_BLOCK_SIZE, lock_policyT>;
   using slot_type = typename pool_type::slot;
+  using time_point = std::chrono::steady_clock::time_point;
 
+  // Packets may carry a deadline after which they are no longer worth
+  // sending; packets without one use time_point::max().
   struct buffer_entry
   {
     packet_wrapper  packet;
     slot_type       data;
+    time_point      deadline = time_point::max();
   };
 
   // TODO also take pool?
@@ -89,9 +94,10 @@ public:
   }
 
 
-  inline error_t push(packet_wrapper const & packet, slot_type slot)
+  inline error_t push(packet_wrapper const & packet, slot_type slot,
+      time_point const & deadline = time_point::max())
   {
-    buffer_entry entry{packet, slot};
+    buffer_entry entry{packet, slot, deadline};
     m_buffer.push_back(entry);
     return ERR_SUCCESS;
   }
@@ -103,6 +109,14 @@ public:
     return entry;
   }
 
+  /**
+   * The entry pop() would return next; the buffer must not be empty.
+   */
+  inline buffer_entry const & front() const
+  {
+    return m_buffer.front();
+  }
+
   inline void release(slot_type slot)
   {
     auto iter = m_buffer.begin();
@@ -114,6 +128,20 @@ public:
     }
   }
 
+  /**
+   * Remove all entries whose deadline has passed by the given time point.
+   * Returns the number of entries removed.
+   */
+  inline std::size_t drop_expired(time_point const & now)
+  {
+    auto before = m_buffer.size();
+    m_buffer.remove_if([&now](buffer_entry const & entry)
+    {
+      return entry.deadline <= now;
+    });
+    return before - m_buffer.size();
+  }
+
   inline bool empty() const
   {
     return m_buffer.empty();
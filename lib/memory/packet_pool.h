@@ -131,11 +131,12 @@ public:
       return m_impl == other.m_impl;
     }
 
+    // An empty slot, with no data and zero size.
+    inline slot() = default;
+
   private:
     friend class packet_pool;
 
-    inline slot() = default;
-
     inline slot(packet_pool & pool, block_entry * block,
         typename block_type::slot const & bs)
       : m_impl{new slot_impl{pool, block, bs}}
@@ -168,6 +169,11 @@ public:
   }
 
   // Size accessors
+  inline std::size_t packet_size() const
+  {
+    return m_packet_size;
+  }
+
   inline std::size_t size() const
   {
     guard g{m_lock};
@@ -262,8 +268,8 @@ public:
     // We will do one runtime check, which is whether the slot actually belongs
     // to this block.
     if (&(s.m_impl->pool) != this) {
-      throw exception{ERR_INVALID_REFERENCE,
-        "Memory slot does not belong to the current pool."};
+      throw_exception(ERR_INVALID_REFERENCE,
+        "Memory slot does not belong to the current pool.");
     }
 
     guard g{m_lock};
@@ -25,14 +25,50 @@
 #include <channeler/capabilities.h>
 #include <channeler/cookie.h>
 
-#include <liberate/serialization/integer.h>
 #include <liberate/serialization/varint.h>
 
+#include "support/wire.h"
+
 namespace channeler {
 
 
 namespace {
 
+/**
+ * Payload layouts of the constant size messages.
+ */
+using channel_new_layout = support::fixed_layout<
+  channelid::half_type,     // initiator part
+  cookie_serialize,         // cookie1
+  capability_bits_t,        // requested capabilities
+  uint32_t                  // compression dictionary id
+>;
+
+using channel_acknowledge_layout = support::fixed_layout<
+  channelid::full_type,     // channel id
+  cookie_serialize,         // cookie1
+  cookie_serialize,         // cookie2
+  capability_bits_t         // granted capabilities
+>;
+
+using channel_finalize_layout = support::fixed_layout<
+  channelid::full_type,     // channel id
+  cookie_serialize,         // cookie2
+  capability_bits_t         // capabilities
+>;
+
+using channel_cookie_layout = support::fixed_layout<
+  cookie_serialize,         // either cookie
+  capability_bits_t         // capabilities
+>;
+
+using ecn_feedback_layout = support::fixed_layout<
+  uint32_t,                 // ECT(0) count
+  uint32_t,                 // ECT(1) count
+  uint32_t                  // CE count
+>;
+
+
 inline std::size_t
 serialize_header(byte * buf, std::size_t max, message_type type,
     std::size_t payload_size = 0)
@@ -40,11 +76,7 @@ serialize_header(byte * buf, std::size_t max, message_type type,
   std::size_t total = 0;
 
   // We know the message type, and need to serialize it.
-  auto tmp = static_cast<liberate::types::varint>(type);
-  auto used = liberate::serialization::serialize_varint(
-      buf + total,
-      max - total,
-      tmp);
+  auto used = support::encode_varint(buf + total, max - total, type);
   if (used <= 0) {
     return 0;
   }
@@ -52,11 +84,7 @@ serialize_header(byte * buf, std::size_t max, message_type type,
 
   // Also serialize size, if it is given.
   if (payload_size > 0) {
-    tmp = static_cast<liberate::types::varint>(payload_size);
-    used = liberate::serialization::serialize_varint(
-        buf + total,
-        max - total,
-        tmp);
+    used = support::encode_varint(buf + total, max - total, payload_size);
     if (used <= 0) {
       return 0;
     }
@@ -67,10 +95,25 @@ serialize_header(byte * buf, std::size_t max, message_type type,
 }
 
 
+/**
+ * Constant size messages are serialized with a single bounds check.
+ */
+template <
+  typename layoutT,
+  typename... fieldsT
+>
 inline std::size_t
-serialize_header(byte * buf, std::size_t max, message const & msg)
+serialize_fixed(byte * out, std::size_t max, message const & msg,
+    fieldsT const &... fields)
 {
-  return serialize_header(buf, max, msg.type);
+  auto header = support::varint_size(msg.type);
+  if (header + layoutT::size > max) {
+    return 0;
+  }
+
+  support::encode_varint(out, header, msg.type);
+  layoutT::write(out + header, fields...);
+  return header + layoutT::size;
 }
 
 
@@ -84,29 +127,24 @@ message_payload_size(message_type_base type)
   //      https://gitlab.com/interpeer/channeler/-/issues/1
   switch (type) {
     case MSG_CHANNEL_NEW:
-      // - channelid.initiator
-      // - cookie1
-      return sizeof(channelid::half_type) + sizeof(cookie_serialize);
+      return channel_new_layout::size;
 
     case MSG_CHANNEL_ACKNOWLEDGE:
-      // - channelid.full
-      // - cookie2
-      return sizeof(channelid::full_type) + sizeof(cookie_serialize) * 2;
+      return channel_acknowledge_layout::size;
 
     case MSG_CHANNEL_FINALIZE:
-      // - channelid.full
-      // - cookie2
-      // - capability bits
-      return sizeof(channelid::full_type) + sizeof(cookie_serialize)
-        + sizeof(capability_bits_t);
+      return channel_finalize_layout::size;
 
     case MSG_CHANNEL_COOKIE:
-      // - channelid.full // In header
-      // - either cookie
-      // - capability bits
-      return sizeof(cookie_serialize) + sizeof(capability_bits_t);
+      // The channel id is in the packet header.
+      return channel_cookie_layout::size;
+
+    case MSG_ECN_FEEDBACK:
+      return ecn_feedback_layout::size;
 
     case MSG_DATA:
+    case MSG_DATA_COMPRESSED:
+    case MSG_DATA_AT:
       return -1;
 
     default:
@@ -126,35 +164,65 @@ message::message(byte const * buf, std::size_t max,
   if (parse_now) {
     auto err = parse();
     if (err.first != ERR_SUCCESS) {
-      throw exception{err.first, err.second};
+      throw_exception(err.first, err.second);
     }
   }
 }
 
 
 
+result<message>
+message::create(byte const * buf, std::size_t max) noexcept
+{
+  message msg{buf, max, false};
+  char const * reason = nullptr;
+  auto err = msg.parse_fields(reason);
+  if (err != ERR_SUCCESS) {
+    return failure{err};
+  }
+  return msg;
+}
+
+
+
 std::pair<error_t, std::string>
 message::parse()
+{
+  char const * reason = nullptr;
+  auto err = parse_fields(reason);
+  if (err != ERR_SUCCESS) {
+    return {err, reason};
+  }
+  return {ERR_SUCCESS, {}};
+}
+
+
+
+error_t
+message::parse_fields(char const * & reason) noexcept
 {
   // Extract the type, and ensure it is known.
-  liberate::types::varint tmp;
-  auto used = liberate::serialization::deserialize_varint(tmp, buffer, input_size);
+  std::size_t tmp;
+  auto used = support::decode_varint(tmp, buffer, input_size);
   if (!used) {
-    return {ERR_DECODE, "Could not decode message type"};
+    reason = "Could not decode message type";
+    return ERR_DECODE;
   }
 
   message_type_base the_type = static_cast<message_type_base>(tmp);
   ssize_t fixed_size = message_payload_size(the_type);
   if (fixed_size == -2) {
-    return {ERR_INVALID_MESSAGE_TYPE, "The message type encoded in the buffer is unsupported."};
+    reason = "The message type encoded in the buffer is unsupported.";
+    return ERR_INVALID_MESSAGE_TYPE;
   }
   *const_cast<message_type *>(&type) = static_cast<message_type>(the_type);
 
   // For fixed message types, we can just use the known message size.
   if (fixed_size >= 0) {
     // The size can be applied to the buffer already.
-    if (static_cast<std::size_t>(fixed_size) > input_size) {
-      return {ERR_INSUFFICIENT_BUFFER_SIZE, "The message type requires a bigger input buffer."};
+    if (static_cast<std::size_t>(fixed_size) + used > input_size) {
+      reason = "The message type requires a bigger input buffer.";
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
     }
     *const_cast<std::size_t *>(&buffer_size) = fixed_size + used;
     *const_cast<byte const **>(&payload) = buffer + used;
@@ -162,18 +230,23 @@ message::parse()
   }
   else {
     // Variable length messages have the payload size included as a varint
-    auto used2 = liberate::serialization::deserialize_varint(tmp, buffer + used, input_size - used);
+    auto used2 = support::decode_varint(tmp, buffer + used, input_size - used);
     if (!used2) {
-      return {ERR_DECODE, "Could not decode message length"};
+      reason = "Could not decode message length";
+      return ERR_DECODE;
+    }
+    if (tmp > input_size - used - used2) {
+      reason = "The message length exceeds the input buffer.";
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
     }
-    *const_cast<std::size_t *>(&payload_size) = static_cast<std::size_t>(tmp);
+    *const_cast<std::size_t *>(&payload_size) = tmp;
     *const_cast<std::size_t *>(&buffer_size) = payload_size + used + used2;
     *const_cast<byte const **>(&payload) = buffer + used + used2;
   }
 
   // Payload processing is part of subtypes, and not happening here.
 
-  return {ERR_SUCCESS, {}};
+  return ERR_SUCCESS;
 }
 
 
@@ -181,24 +254,25 @@ message::parse()
 std::size_t
 message::serialized_size() const
 {
-  auto t = static_cast<::liberate::types::varint>(type);
-  std::size_t result = ::liberate::serialization::serialized_size(t);
-
+  // This is called for every message in the egress queue whenever packets
+  // are assembled, so avoid anything but table lookups.
   auto pl_size = message_payload_size(type);
-  if (pl_size> 0) {
-    result += pl_size;
-  }
-  else if (pl_size == -1) {
-    t = static_cast<::liberate::types::varint>(payload_size);
-    result += ::liberate::serialization::serialized_size(t);
-    result += payload_size;
+  if (pl_size >= 0) {
+    return support::varint_size(type) + pl_size;
   }
-  else if (pl_size < -2) {
-    // Error, unknown message type
-    return 0;
+
+  if (pl_size == -1) {
+    // Variable sized messages are always backed by a buffer holding the
+    // serialized message, see message_data.
+    if (buffer_size) {
+      return buffer_size;
+    }
+    return support::varint_size(type) + support::varint_size(payload_size)
+      + payload_size;
   }
 
-  return result;
+  // Error, unknown message type
+  return 0;
 }
 
 
@@ -227,11 +301,21 @@ message_data::message_data(std::vector<byte> && data)
 {
   *const_cast<byte const **>(&buffer) = &owned_buffer[0];
   *const_cast<std::size_t *>(&input_size) = owned_buffer.size();
+}
+
+
 
-  auto err = parse();
-  if (err.first != ERR_SUCCESS) {
-    throw exception{err.first, err.second};
+std::unique_ptr<message>
+message_data::adopt(std::vector<byte> && data)
+{
+  // The serialized header is parsed from the owned buffer, but that cannot
+  // fail unless it could not be serialized in the first place.
+  std::unique_ptr<message_data> ptr{new message_data{std::move(data)}};
+  char const * reason = nullptr;
+  if (ERR_SUCCESS != ptr->parse_fields(reason)) {
+    return {};
   }
+  return ptr;
 }
 
 
@@ -253,14 +337,14 @@ message_data::create(byte const * buf, std::size_t size)
   result.resize(size + used);
   memcpy(&result[0] + used, buf, size);
 
-  auto ptr = new message_data{std::move(result)};
-  return std::unique_ptr<message>(ptr);
+  return adopt(std::move(result));
 }
 
 
 
 std::unique_ptr<message>
-message_data::create(std::vector<byte> & data)
+message_data::create(std::vector<byte> & data,
+    message_type type /* = MSG_DATA */)
 {
   if (data.empty()) {
     return {};
@@ -272,15 +356,14 @@ message_data::create(std::vector<byte> & data)
   std::size_t reserved = liberate::serialization::VARINT_MAX_BUFSIZE * 2;
   result.resize(data.size() + reserved);
   auto used = serialize_header(&result[0], reserved,
-      MSG_DATA, data.size());
+      type, data.size());
 
   result.resize(used);
   result.insert(result.end(),
       std::make_move_iterator(data.begin()),
       std::make_move_iterator(data.end()));
 
-  auto ptr = new message_data{std::move(result)};
-  return std::unique_ptr<message>(ptr);
+  return adopt(std::move(result));
 }
 
 
@@ -307,38 +390,18 @@ message_data::serialize(byte * out, std::size_t max,
 std::unique_ptr<message>
 message_channel_new::extract_features(message const & wrap)
 {
-  auto * ptr = new message_channel_new{wrap};
-  byte const * offset = ptr->payload;
-  std::size_t size = ptr->payload_size;
-
-  // First comes the partial channel id
-  auto used = liberate::serialization::deserialize_int(ptr->initiator_part,
-      offset, size);
-  if (used != sizeof(ptr->initiator_part)) {
-    delete ptr;
+  if (wrap.payload_size != channel_new_layout::size) {
     return {};
   }
-  offset += used;
-  size -= used;
 
-  // And the cookie
+  auto * ptr = new message_channel_new{wrap};
+
   cookie_serialize s;
-  used = liberate::serialization::deserialize_int(s,
-      offset, size);
-  if (used != sizeof(s)) {
-    delete ptr;
-    return {};
-  }
+  capability_bits_t bits;
+  channel_new_layout::read(ptr->payload, ptr->initiator_part, s, bits,
+      ptr->dictionary);
   ptr->cookie1 = s;
-
-  offset += used;
-  size -= used;
-
-  if (size > 0) {
-    // We didn't consume the entire payload
-    delete ptr;
-    return {};
-  }
+  ptr->capabilities = bits;
 
   return std::unique_ptr<message>(ptr);
 }
@@ -356,45 +419,11 @@ std::size_t
 message_channel_new::serialize(byte * out, std::size_t max,
     message_channel_new const & msg)
 {
-  // We know the buffer size, as it's fixed.
-  if (msg.serialized_size() > max) {
-    return 0;
-  }
-
-  std::size_t remaining = msg.serialized_size();
-  byte * offset = out;
-
-  // Serialize message header
-  auto used = serialize_header(offset, remaining, msg);
-  if (used <= 0) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the half id.
-  used = liberate::serialization::serialize_int(offset, remaining,
-      msg.initiator_part);
-  if (used != sizeof(msg.initiator_part)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the cookie
-  cookie_serialize tmp = msg.cookie1;
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp);
-  if (used != sizeof(tmp)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  if (remaining != 0) {
-    return 0;
-  }
-  return (offset - out);
+  return serialize_fixed<channel_new_layout>(out, max, msg,
+      msg.initiator_part,
+      static_cast<cookie_serialize>(msg.cookie1),
+      static_cast<capability_bits_t>(msg.capabilities.to_ullong()),
+      msg.dictionary);
 }
 
 
@@ -405,50 +434,19 @@ message_channel_new::serialize(byte * out, std::size_t max,
 std::unique_ptr<message>
 message_channel_acknowledge::extract_features(message const & wrap)
 {
-  auto * ptr = new message_channel_acknowledge{wrap};
-  byte const * offset = ptr->payload;
-  std::size_t size = ptr->payload_size;
-
-  // First comes the channel id
-  auto used = liberate::serialization::deserialize_int(ptr->id.full,
-      offset, size);
-  if (used != sizeof(ptr->id.full)) {
-    delete ptr;
-    return {};
-  }
-  offset += used;
-  size -= used;
-
-  // And cookie1
-  cookie_serialize s;
-  used = liberate::serialization::deserialize_int(s,
-      offset, size);
-  if (used != sizeof(s)) {
-    delete ptr;
-    return {};
-  }
-  ptr->cookie1 = s;
-
-  offset += used;
-  size -= used;
-
-  // cookie2
-  used = liberate::serialization::deserialize_int(s,
-      offset, size);
-  if (used != sizeof(s)) {
-    delete ptr;
+  if (wrap.payload_size != channel_acknowledge_layout::size) {
     return {};
   }
-  ptr->cookie2 = s;
 
-  offset += used;
-  size -= used;
+  auto * ptr = new message_channel_acknowledge{wrap};
 
-  if (size > 0) {
-    // We didn't consume the entire payload
-    delete ptr;
-    return {};
-  }
+  cookie_serialize s1;
+  cookie_serialize s2;
+  capability_bits_t bits;
+  channel_acknowledge_layout::read(ptr->payload, ptr->id.full, s1, s2, bits);
+  ptr->cookie1 = s1;
+  ptr->cookie2 = s2;
+  ptr->capabilities = bits;
 
   return std::unique_ptr<message>(ptr);
 }
@@ -466,55 +464,11 @@ std::size_t
 message_channel_acknowledge::serialize(byte * out, std::size_t max,
     message_channel_acknowledge const & msg)
 {
-  // We know the buffer size, as it's fixed.
-  if (msg.serialized_size() > max) {
-    return 0;
-  }
-
-  std::size_t remaining = msg.serialized_size();
-  byte * offset = out;
-
-  // Serialize message header
-  auto used = serialize_header(offset, remaining, msg);
-  if (used <= 0) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the full id.
-  used = liberate::serialization::serialize_int(offset, remaining,
-      msg.id.full);
-  if (used != sizeof(msg.id.full)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize cookie1
-  cookie_serialize tmp = msg.cookie1;
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp);
-  if (used != sizeof(tmp)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize cookie2
-  tmp = msg.cookie2;
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp);
-  if (used != sizeof(tmp)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  if (remaining != 0) {
-    return 0;
-  }
-  return (offset - out);
+  return serialize_fixed<channel_acknowledge_layout>(out, max, msg,
+      msg.id.full,
+      static_cast<cookie_serialize>(msg.cookie1),
+      static_cast<cookie_serialize>(msg.cookie2),
+      static_cast<capability_bits_t>(msg.capabilities.to_ullong()));
 }
 
 
@@ -525,53 +479,18 @@ message_channel_acknowledge::serialize(byte * out, std::size_t max,
 std::unique_ptr<message>
 message_channel_finalize::extract_features(message const & wrap)
 {
-  auto * ptr = new message_channel_finalize{wrap};
-  byte const * offset = ptr->payload;
-  std::size_t size = ptr->payload_size;
-
-  // First comes the channel id
-  auto used = liberate::serialization::deserialize_int(ptr->id.full,
-      offset, size);
-  if (used != sizeof(ptr->id.full)) {
-    delete ptr;
+  if (wrap.payload_size != channel_finalize_layout::size) {
     return {};
   }
-  offset += used;
-  size -= used;
 
-  // And the cookie
-  cookie_serialize s;
-  used = liberate::serialization::deserialize_int(s,
-      offset, size);
-  if (used != sizeof(s)) {
-    delete ptr;
-    return {};
-  }
-  ptr->cookie2 = s;
-
-  offset += used;
-  size -= used;
+  auto * ptr = new message_channel_finalize{wrap};
 
-  // Also the capabilities
+  cookie_serialize s;
   capability_bits_t bits;
-  used = liberate::serialization::deserialize_int(bits,
-      offset, size);
-  if (used != sizeof(bits)) {
-    delete ptr;
-    return {};
-  }
+  channel_finalize_layout::read(ptr->payload, ptr->id.full, s, bits);
+  ptr->cookie2 = s;
   ptr->capabilities = bits;
 
-  offset += used;
-  size -= used;
-
-
-  if (size > 0) {
-    // We didn't consume the entire payload
-    delete ptr;
-    return {};
-  }
-
   return std::unique_ptr<message>(ptr);
 }
 
@@ -588,55 +507,10 @@ std::size_t
 message_channel_finalize::serialize(byte * out, std::size_t max,
     message_channel_finalize const & msg)
 {
-  // We know the buffer size, as it's fixed.
-  if (msg.serialized_size() > max) {
-    return 0;
-  }
-
-  std::size_t remaining = msg.serialized_size();
-  byte * offset = out;
-
-  // Serialize message header
-  auto used = serialize_header(offset, remaining, msg);
-  if (used <= 0) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the full id.
-  used = liberate::serialization::serialize_int(offset, remaining,
-      msg.id.full);
-  if (used != sizeof(msg.id.full)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the cookie
-  cookie_serialize tmp = msg.cookie2;
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp);
-  if (used != sizeof(tmp)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Capabilities
-  capability_bits_t tmp2 = msg.capabilities.to_ullong();
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp2);
-  if (used != sizeof(tmp2)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  if (remaining != 0) {
-    return 0;
-  }
-  return (offset - out);
+  return serialize_fixed<channel_finalize_layout>(out, max, msg,
+      msg.id.full,
+      static_cast<cookie_serialize>(msg.cookie2),
+      static_cast<capability_bits_t>(msg.capabilities.to_ullong()));
 }
 
 
@@ -647,43 +521,18 @@ message_channel_finalize::serialize(byte * out, std::size_t max,
 std::unique_ptr<message>
 message_channel_cookie::extract_features(message const & wrap)
 {
-  auto * ptr = new message_channel_cookie{wrap};
-  byte const * offset = ptr->payload;
-  std::size_t size = ptr->payload_size;
-
-  // The cookie...
-  cookie_serialize s;
-  auto used = liberate::serialization::deserialize_int(s,
-      offset, size);
-  if (used != sizeof(s)) {
-    delete ptr;
+  if (wrap.payload_size != channel_cookie_layout::size) {
     return {};
   }
-  ptr->either_cookie = s;
 
-  offset += used;
-  size -= used;
+  auto * ptr = new message_channel_cookie{wrap};
 
-  // Also the capabilities
+  cookie_serialize s;
   capability_bits_t bits;
-  used = liberate::serialization::deserialize_int(bits,
-      offset, size);
-  if (used != sizeof(bits)) {
-    delete ptr;
-    return {};
-  }
+  channel_cookie_layout::read(ptr->payload, s, bits);
+  ptr->either_cookie = s;
   ptr->capabilities = bits;
 
-  offset += used;
-  size -= used;
-
-
-  if (size > 0) {
-    // We didn't consume the entire payload
-    delete ptr;
-    return {};
-  }
-
   return std::unique_ptr<message>(ptr);
 }
 
@@ -700,46 +549,43 @@ std::size_t
 message_channel_cookie::serialize(byte * out, std::size_t max,
     message_channel_cookie const & msg)
 {
-  // We know the buffer size, as it's fixed.
-  if (msg.serialized_size() > max) {
-    return 0;
-  }
+  return serialize_fixed<channel_cookie_layout>(out, max, msg,
+      static_cast<cookie_serialize>(msg.either_cookie),
+      static_cast<capability_bits_t>(msg.capabilities.to_ullong()));
+}
 
-  std::size_t remaining = msg.serialized_size();
-  byte * offset = out;
 
-  // Serialize message header
-  auto used = serialize_header(offset, remaining, msg);
-  if (used <= 0) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Serialize the cookie
-  cookie_serialize tmp = msg.either_cookie;
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp);
-  if (used != sizeof(tmp)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
-
-  // Capabilities
-  capability_bits_t tmp2 = msg.capabilities.to_ullong();
-  used = liberate::serialization::serialize_int(offset, remaining,
-      tmp2);
-  if (used != sizeof(tmp2)) {
-    return 0;
-  }
-  offset += used;
-  remaining -= used;
 
-  if (remaining != 0) {
-    return 0;
+/**
+ * message_ecn_feedback
+ */
+std::unique_ptr<message>
+message_ecn_feedback::extract_features(message const & wrap)
+{
+  if (wrap.payload_size != ecn_feedback_layout::size) {
+    return {};
   }
-  return (offset - out);
+
+  auto * ptr = new message_ecn_feedback{wrap};
+  ecn_feedback_layout::read(ptr->payload, ptr->ect0, ptr->ect1, ptr->ce);
+  return std::unique_ptr<message>(ptr);
+}
+
+
+
+message_ecn_feedback::message_ecn_feedback(message const & wrap)
+  : message{wrap}
+{
+}
+
+
+
+std::size_t
+message_ecn_feedback::serialize(byte * out, std::size_t max,
+    message_ecn_feedback const & msg)
+{
+  return serialize_fixed<ecn_feedback_layout>(out, max, msg,
+      msg.ect0, msg.ect1, msg.ce);
 }
 
 
@@ -767,7 +613,12 @@ extract_message_features(message const & msg)
     case MSG_CHANNEL_COOKIE:
       return message_channel_cookie::extract_features(msg);
 
+    case MSG_ECN_FEEDBACK:
+      return message_ecn_feedback::extract_features(msg);
+
     case MSG_DATA:
+    case MSG_DATA_COMPRESSED:
+    case MSG_DATA_AT:
       // Must make copy
       return message_data::extract_features(msg);
 
@@ -810,7 +661,14 @@ serialize_message(byte * output, std::size_t max,
           *reinterpret_cast<message_channel_cookie const *>(msg.get())
       );
 
+    case MSG_ECN_FEEDBACK:
+      return message_ecn_feedback::serialize(output, max,
+          *reinterpret_cast<message_ecn_feedback const *>(msg.get())
+      );
+
     case MSG_DATA:
+    case MSG_DATA_COMPRESSED:
+    case MSG_DATA_AT:
       return message_data::serialize(output, max,
           *reinterpret_cast<message_data const *>(msg.get())
       );
@@ -25,138 +25,62 @@
 
 #include <liberate/serialization/integer.h>
 
+#include "support/wire.h"
+
 namespace channeler {
 
 namespace {
 
-inline
-std::pair<error_t, std::string>
-update_from_buffer(
+/**
+ * Decode the packet fields from the buffer. The size fields bound all
+ * further accesses into the buffer, so they are checked first.
+ *
+ * Error reasons are static strings, so that rejecting a packet does not
+ * allocate.
+ */
+inline error_t
+decode_fields(
     public_header_fields & pub_header,
-    byte const * buffer,
-    size_t buffer_size)
-{
-  // Read proto ID from buffer
-  auto res = liberate::serialization::deserialize_int(pub_header.proto,
-      buffer + public_header_layout::PUB_OFFS_PROTO,
-      sizeof(pub_header.proto));
-  if (res != sizeof(pub_header.proto)) {
-    return {ERR_DECODE, "Could not deserialize protocol identifier."};
-  }
-
-  // Channel ID
-  res = liberate::serialization::deserialize_int(pub_header.channel.full,
-      buffer + public_header_layout::PUB_OFFS_CHANNELID,
-      sizeof(pub_header.channel));
-  if (res != sizeof(pub_header.channel)) {
-    return {ERR_DECODE, "Could not deserialize channel identifier."};
-  }
-
-  // Flags
-  flags_bits_t bits = 0;
-  res = liberate::serialization::deserialize_int(bits,
-      buffer + public_header_layout::PUB_OFFS_FLAGS,
-      sizeof(bits));
-  if (res != sizeof(bits)) {
-    return {ERR_DECODE, "Could not deserialize flags."};
-  }
-  pub_header.flags = flags_t{bits};
-
-  // Packet size
-  res = liberate::serialization::deserialize_int(pub_header.packet_size,
-      buffer + public_header_layout::PUB_OFFS_PACKET_SIZE,
-      sizeof(pub_header.packet_size));
-  if (res != sizeof(pub_header.packet_size)) {
-    return {ERR_DECODE, "Could not deserialize packet size."};
-  }
-
-  if (pub_header.packet_size > buffer_size) {
-    return {ERR_DECODE, "Packet size exceeds buffer size."};
-  }
-
-  return {ERR_SUCCESS, {}};
-}
-
-
-inline
-std::pair<error_t, std::string>
-update_from_buffer(
     private_header_fields & priv_header,
-    byte const * buffer,
-    size_t packet_size)
-{
-  // Sequence number
-  auto res = liberate::serialization::deserialize_int(priv_header.sequence_no,
-      buffer + private_header_layout::PRIV_OFFS_SEQUENCE_NO,
-      sizeof(priv_header.sequence_no));
-  if (res != sizeof(priv_header.sequence_no)) {
-    return {ERR_DECODE, "Could not deserialize sequence number."};
-  }
-
-  // Payload size
-  res = liberate::serialization::deserialize_int(priv_header.payload_size,
-      buffer + private_header_layout::PRIV_OFFS_PAYLOAD_SIZE,
-      sizeof(priv_header.payload_size));
-  if (res != sizeof(priv_header.payload_size)) {
-    return {ERR_DECODE, "Could not deserialize payload size."};
-  }
-
-  if (priv_header.payload_size > (packet_size - packet_wrapper::envelope_size())) {
-    return {ERR_DECODE, "Payload size exceeds available buffer size."};
-  }
-
-  return {ERR_SUCCESS, {}};
-}
-
-
-
-inline
-std::pair<error_t, std::string>
-update_from_buffer(
     footer_fields & footer,
     byte const * buffer,
-    size_t buffer_size)
+    size_t buffer_size,
+    char const * & reason) noexcept
 {
-  // Read checksum from buffer.
-  uint32_t tmp = 0;
-  auto res = liberate::serialization::deserialize_int(
-      tmp,
-      buffer + buffer_size - footer.FOOT_SIZE,
-      sizeof(tmp));
-  if (res != sizeof(tmp)) {
-    return {ERR_DECODE, "Could not deserialize checksum."};
+  pub_header.packet_size = support::load_be<packet_size_t>(
+      buffer + public_header_layout::PUB_OFFS_PACKET_SIZE);
+  if (pub_header.packet_size > buffer_size) {
+    reason = "Packet size exceeds buffer size.";
+    return ERR_DECODE;
   }
-  footer.checksum = tmp;
-
-  return {ERR_SUCCESS, {}};
-}
-
-
-
-inline
-std::pair<error_t, std::string>
-update_from_buffer(
-    public_header_fields & pub_header,
-    private_header_fields & priv_header,
-    footer_fields & footer,
-    byte const * buffer,
-    size_t buffer_size)
-{
-  auto err = update_from_buffer(pub_header, buffer, buffer_size);
-  if (err.first != ERR_SUCCESS) {
-    return err;
+  if (pub_header.packet_size < packet_wrapper::envelope_size()) {
+    reason = "Packet size is smaller than the packet envelope.";
+    return ERR_DECODE;
   }
 
-  err = update_from_buffer(priv_header, buffer + pub_header.PUB_SIZE,
-      pub_header.packet_size);
-  if (err.first != ERR_SUCCESS) {
-    return err;
+  byte const * priv = buffer + public_header_layout::PUB_SIZE;
+  priv_header.sequence_no = support::load_be<sequence_no_t>(
+      priv + private_header_layout::PRIV_OFFS_SEQUENCE_NO);
+  priv_header.payload_size = support::load_be<payload_size_t>(
+      priv + private_header_layout::PRIV_OFFS_PAYLOAD_SIZE);
+  if (priv_header.payload_size > (pub_header.packet_size - packet_wrapper::envelope_size())) {
+    reason = "Payload size exceeds available buffer size.";
+    return ERR_DECODE;
   }
 
+  pub_header.proto = support::load_be<protoid>(
+      buffer + public_header_layout::PUB_OFFS_PROTO);
+  pub_header.channel.full = support::load_be<channelid::full_type>(
+      buffer + public_header_layout::PUB_OFFS_CHANNELID);
+  pub_header.flags = flags_t{support::load_be<flags_bits_t>(
+      buffer + public_header_layout::PUB_OFFS_FLAGS)};
+
   // Since we've decoded the packet size, we need to calculate the buffer
   // offsets from that size.
-  update_from_buffer(footer, buffer, pub_header.packet_size);
-  return err;
+  footer.checksum = support::load_be<liberate::checksum::crc32_serialize>(
+      buffer + pub_header.packet_size - footer_fields::FOOT_SIZE);
+
+  return ERR_SUCCESS;
 }
 
 
@@ -297,24 +221,54 @@ packet_wrapper::packet_wrapper(byte * buf, size_t buffer_size,
   if (validate_now) {
     auto err = validate();
     if (err.first != ERR_SUCCESS) {
-      throw exception{err.first, err.second};
+      throw_exception(err.first, err.second);
     }
   }
 }
 
 
 
+result<packet_wrapper>
+packet_wrapper::create(byte * buf, size_t buffer_size) noexcept
+{
+  if (!buf) {
+    return failure{ERR_INVALID_REFERENCE};
+  }
+
+  packet_wrapper packet{buf, buffer_size, false};
+  char const * reason = nullptr;
+  auto err = packet.decode(reason);
+  if (err != ERR_SUCCESS) {
+    return failure{err};
+  }
+  return packet;
+}
+
+
+
 std::pair<error_t, std::string>
 packet_wrapper::validate()
+{
+  char const * reason = nullptr;
+  auto err = decode(reason);
+  if (err != ERR_SUCCESS) {
+    return {err, reason};
+  }
+  return {ERR_SUCCESS, {}};
+}
+
+
+
+error_t
+packet_wrapper::decode(char const * & reason) noexcept
 {
   if (m_size < public_envelope_size()) {
-    throw exception{ERR_INSUFFICIENT_BUFFER_SIZE,
-      "Buffer passed to packet_wrapper is too small to accomodate envelope!"};
+    reason = "Buffer passed to packet_wrapper is too small to accomodate envelope!";
+    return ERR_INSUFFICIENT_BUFFER_SIZE;
   }
 
-  // Update (some) fields from buffer
-  return update_from_buffer(m_public_header, m_private_header, m_footer, m_buffer,
-      m_size);
+  return decode_fields(m_public_header, m_private_header, m_footer, m_buffer,
+      m_size, reason);
 }
 
 
@@ -345,7 +299,7 @@ packet_wrapper::buffer() const
       m_private_header,
       m_footer);
   if (err.first != ERR_SUCCESS) {
-    throw exception{err.first, err.second};
+    throw_exception(err.first, err.second);
   }
   return m_buffer;
 }
@@ -362,7 +316,7 @@ packet_wrapper::buffer()
       m_private_header,
       m_footer);
   if (err.first != ERR_SUCCESS) {
-    throw exception{err.first, err.second};
+    throw_exception(err.first, err.second);
   }
   return m_buffer;
 }
@@ -412,7 +366,7 @@ packet_wrapper::update_checksum()
 bool
 packet_wrapper::has_valid_checksum() const
 {
-  return m_footer.checksum == calculate_checksum();
+  return checksum() == calculate_checksum();
 }
 
 
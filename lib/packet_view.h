@@ -0,0 +1,177 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_PACKET_VIEW_H
+#define CHANNELER_PACKET_VIEW_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <liberate/checksum/crc32.h>
+
+#include <channeler/packet.h>
+#include <channeler/error.h>
+
+#include "support/wire.h"
+
+namespace channeler {
+
+/**
+ * A read-only packet view over a received buffer.
+ *
+ * packet_wrapper decodes all header fields when it validates a buffer.
+ * Ingress filters that may drop a packet early - e.g. because its peers are
+ * banned, it is relayed, or its checksum does not match - need only a few
+ * fields, so packet_view reads each field from the buffer when it is
+ * accessed, and never writes to the view or the buffer. It can be read from
+ * several threads at once.
+ *
+ * Unlike fixed_packet, the packet size is read from the buffer, so
+ * validate() must succeed before any accessor other than sender(),
+ * recipient() and packet_size() is used.
+ */
+class packet_view
+  : public public_header_layout
+  , public private_header_layout
+  , public footer_layout
+{
+public:
+  inline packet_view(byte const * buf, std::size_t buffer_size)
+    : m_buffer{buf}
+    , m_size{buffer_size}
+  {
+  }
+
+  /**
+   * Check that the size fields fit the buffer, as packet_wrapper does. This
+   * decodes nothing else. Error reasons are static strings, so that
+   * rejecting a packet does not allocate.
+   */
+  inline error_t validate(char const * & reason) const noexcept
+  {
+    if (m_size < packet_wrapper::public_envelope_size()) {
+      reason = "Buffer is too small to accomodate envelope!";
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+
+    auto size = packet_size();
+    if (size > m_size) {
+      reason = "Packet size exceeds buffer size.";
+      return ERR_DECODE;
+    }
+    if (size < packet_wrapper::envelope_size()) {
+      reason = "Packet size is smaller than the packet envelope.";
+      return ERR_DECODE;
+    }
+    if (payload_size() > size - packet_wrapper::envelope_size()) {
+      reason = "Payload size exceeds available buffer size.";
+      return ERR_DECODE;
+    }
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * Field accessors
+   */
+  inline protoid proto() const
+  {
+    return support::load_be<protoid>(m_buffer + PUB_OFFS_PROTO);
+  }
+
+  inline peerid_wrapper sender() const
+  {
+    return {m_buffer + PUB_OFFS_SENDER, peerid::size()};
+  }
+
+  inline peerid_wrapper recipient() const
+  {
+    return {m_buffer + PUB_OFFS_RECIPIENT, peerid::size()};
+  }
+
+  inline channelid channel() const
+  {
+    channelid id;
+    id.full = support::load_be<channelid::full_type>(
+        m_buffer + PUB_OFFS_CHANNELID);
+    return id;
+  }
+
+  inline flags_t flags() const
+  {
+    return flags_t{support::load_be<flags_bits_t>(m_buffer + PUB_OFFS_FLAGS)};
+  }
+
+  inline packet_size_t packet_size() const
+  {
+    return support::load_be<packet_size_t>(m_buffer + PUB_OFFS_PACKET_SIZE);
+  }
+
+  inline sequence_no_t sequence_no() const
+  {
+    return support::load_be<sequence_no_t>(
+        m_buffer + PUB_SIZE + PRIV_OFFS_SEQUENCE_NO);
+  }
+
+  inline payload_size_t payload_size() const
+  {
+    return support::load_be<payload_size_t>(
+        m_buffer + PUB_SIZE + PRIV_OFFS_PAYLOAD_SIZE);
+  }
+
+  inline byte const * payload() const
+  {
+    return m_buffer + PUB_SIZE + PRIV_SIZE;
+  }
+
+  inline byte const * buffer() const
+  {
+    return m_buffer;
+  }
+
+  /**
+   * Checksum
+   */
+  inline liberate::checksum::crc32_checksum checksum() const
+  {
+    return support::load_be<liberate::checksum::crc32_serialize>(
+        m_buffer + packet_size() - FOOT_SIZE);
+  }
+
+  inline liberate::checksum::crc32_checksum calculate_checksum() const
+  {
+    using namespace liberate::checksum;
+    return crc32<CRC32C>(m_buffer, m_buffer + packet_size() - FOOT_SIZE);
+  }
+
+  inline bool has_valid_checksum() const
+  {
+    return checksum() == calculate_checksum();
+  }
+
+private:
+  byte const *  m_buffer;
+  std::size_t   m_size;
+};
+
+} // namespace channeler
+
+#endif // guard
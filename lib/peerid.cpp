@@ -28,7 +28,8 @@
 
 #include <liberate/string/hexencode.h>
 #include <liberate/cpp/hash.h>
-#include <liberate/random/unsafe_bits.h>
+
+#include "support/random_bits.h"
 
 namespace channeler {
 
@@ -37,9 +38,20 @@ peerid_wrapper::peerid_wrapper(byte const * start, size_t bufsize)
   : raw{start}
 {
   if (!raw || bufsize < size()) {
-    throw exception{ERR_INSUFFICIENT_BUFFER_SIZE,
-      "Input buffer too small for a peer identifier."};
+    throw_exception(ERR_INSUFFICIENT_BUFFER_SIZE,
+      "Input buffer too small for a peer identifier.");
+  }
+}
+
+
+
+result<peerid_wrapper>
+peerid_wrapper::create(byte const * start, size_t bufsize) noexcept
+{
+  if (!start || bufsize < size()) {
+    return failure{ERR_INSUFFICIENT_BUFFER_SIZE};
   }
+  return peerid_wrapper{start, bufsize};
 }
 
 
@@ -96,7 +108,8 @@ peerid_wrapper &
 peerid_wrapper::operator=(peerid_wrapper const & other)
 {
   if (!raw || !other.raw) {
-    throw std::logic_error("Should never happen; see regular ctor.");
+    throw_exception(ERR_UNEXPECTED,
+        "Should never happen; see regular ctor.");
   }
   if (raw != other.raw) {
     memcpy(const_cast<byte*>(raw), other.raw, size());
@@ -110,12 +123,8 @@ peerid_wrapper::operator=(peerid_wrapper const & other)
 peerid::peerid()
   : peerid_wrapper{buffer, PEERID_SIZE_BYTES}
 {
-  liberate::random::unsafe_bits<unsigned char> rng;
-  byte * offset = buffer;
-  while (offset < buffer + PEERID_SIZE_BYTES) {
-    *offset = static_cast<byte>(rng.get());
-    ++offset;
-  }
+  // Peer identifiers should not be guessable.
+  support::secure_random_fill(buffer, PEERID_SIZE_BYTES);
 }
 
 
@@ -137,22 +146,22 @@ peerid::peerid(char const * buf, size_t bufsize)
     start += 2;
     buflen -= 2;
     if (bufsize < (PEERID_SIZE_BYTES * 2) + 2) {
-      throw exception{ERR_INSUFFICIENT_BUFFER_SIZE,
-        "Peer identifier buffer is too small."};
+      throw_exception(ERR_INSUFFICIENT_BUFFER_SIZE,
+        "Peer identifier buffer is too small.");
     }
   }
   else {
     if (bufsize < PEERID_SIZE_BYTES * 2) {
-      throw exception{ERR_INSUFFICIENT_BUFFER_SIZE,
-        "Peer identifier buffer is too small."};
+      throw_exception(ERR_INSUFFICIENT_BUFFER_SIZE,
+        "Peer identifier buffer is too small.");
     }
   }
 
   auto used = liberate::string::hexdecode(buffer, PEERID_SIZE_BYTES,
       reinterpret_cast<byte const *>(start), buflen);
   if (used != PEERID_SIZE_BYTES) {
-    throw exception{ERR_DECODE,
-      "Could not decode hexadecimal peer identifier."};
+    throw_exception(ERR_DECODE,
+      "Could not decode hexadecimal peer identifier.");
   }
 }
 
@@ -47,6 +47,10 @@ enum action_type : uint_fast16_t
   AT_FILTER_PEER,
 
   AT_NOTIFY_CHANNEL_ESTABLISHED,
+
+  AT_FORWARD_PACKET,      // Relay a packet addressed to another peer
+
+  AT_ECN_FEEDBACK,        // Peer reported received ECN codepoints
 };
 
 
@@ -128,6 +132,34 @@ struct error_action
 };
 
 
+/**
+ * Filters abort processing of invalid input by returning just an error
+ * action, rather than throwing.
+ */
+inline action_list_type
+error_actions(error_t err)
+{
+  action_list_type res;
+  res.push_back(std::make_unique<error_action>(err));
+  return res;
+}
+
+
+/**
+ * The first error reported in the action list, or ERR_SUCCESS.
+ */
+inline error_t
+first_error(action_list_type const & actions)
+{
+  for (auto & act : actions) {
+    if (act && act->type == AT_ERROR) {
+      return reinterpret_cast<error_action const *>(act.get())->error;
+    }
+  }
+  return ERR_SUCCESS;
+}
+
+
 
 /**
  * Action for reporting channel established
@@ -148,6 +180,58 @@ struct notify_channel_established_action
 
 
 
+/**
+ * Action for relaying a packet unchanged to the next hop. The slot is the
+ * one the packet was received in.
+ */
+template <
+  typename addressT,
+  typename slotT
+>
+struct forward_packet_action
+  : public action
+{
+  addressT  next_hop;
+  slotT     slot;
+
+  inline forward_packet_action(addressT const & hop, slotT const & _slot)
+    : action{AT_FORWARD_PACKET}
+    , next_hop{hop}
+    , slot{_slot}
+  {
+  }
+
+  virtual ~forward_packet_action() = default;
+};
+
+
+
+/**
+ * Action for passing the peer's ECN feedback on to congestion control.
+ */
+struct ecn_feedback_action
+  : public action
+{
+  channelid channel;
+  uint32_t  ect0;
+  uint32_t  ect1;
+  uint32_t  ce;
+
+  inline ecn_feedback_action(channelid const & id, uint32_t _ect0,
+      uint32_t _ect1, uint32_t _ce)
+    : action{AT_ECN_FEEDBACK}
+    , channel{id}
+    , ect0{_ect0}
+    , ect1{_ect1}
+    , ce{_ce}
+  {
+  }
+
+  virtual ~ecn_feedback_action() = default;
+};
+
+
+
 } // namespace channeler::pipe
 
 #endif // guard
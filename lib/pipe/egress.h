@@ -30,9 +30,11 @@
 
 #include "egress/callback.h"
 #include "egress/out_buffer.h"
+#include "egress/capture.h"
 #include "egress/add_checksum.h"
 #include "egress/message_bundling.h"
 #include "egress/enqueue_message.h"
+#include "egress/compress.h"
 
 #include "../channel_data.h"
 
@@ -66,10 +68,14 @@ struct default_egress
     channel_type,
     callback, typename callback::input_event
   >;
-  using add_checksum = add_checksum_filter<
+  using capture = egress_capture_filter<
     address_type, POOL_BLOCK_SIZE,
     out_buffer, typename out_buffer::input_event
   >;
+  using add_checksum = add_checksum_filter<
+    address_type, POOL_BLOCK_SIZE,
+    capture, typename capture::input_event
+  >;
   using message_bundling = message_bundling_filter<
     address_type, POOL_BLOCK_SIZE,
     channel_type,
@@ -79,6 +85,10 @@ struct default_egress
     channel_type,
     message_bundling, typename message_bundling::input_event
   >;
+  using compress = compress_filter<
+    channel_type,
+    enqueue_message, typename enqueue_message::input_event
+  >;
 
   using peerid_function = typename message_bundling::peerid_function;
 
@@ -91,24 +101,124 @@ struct default_egress
     )
     : m_callback{cb}
     , m_out_buffer{&m_callback, channels}
-    , m_add_checksum{&m_out_buffer}
+    , m_capture{&m_out_buffer}
+    , m_add_checksum{&m_capture}
     , m_message_bundling{&m_add_checksum, channels, pool,
       own_peerid_func, peer_peerid_func}
     , m_enqueue_message{&m_message_bundling, channels}
+    , m_compress{&m_enqueue_message, channels, pool.packet_size()}
   {
   }
 
 
   inline action_list_type consume(std::unique_ptr<event> ev)
   {
-    return m_enqueue_message.consume(std::move(ev));
+    return m_compress.consume(std::move(ev));
+  }
+
+  inline action_list_type consume_all(event_list_type events)
+  {
+    return m_compress.consume_all(std::move(events));
+  }
+
+
+  /**
+   * Produce a single data message packet in place; see
+   * message_bundling_filter::bundle_in_place().
+   */
+  inline std::size_t max_data_at_size() const
+  {
+    return m_message_bundling.max_data_at_size();
+  }
+
+  template <
+    typename fillT
+  >
+  inline error_t bundle_in_place(channelid const & channel, uint64_t offset,
+      std::size_t size, fillT && fill, action_list_type & actions)
+  {
+    return m_message_bundling.bundle_in_place(channel, offset, size,
+        std::forward<fillT>(fill), actions);
+  }
+
+
+  /**
+   * Produce an empty packet on the channel; see
+   * message_bundling_filter::keepalive().
+   */
+  inline action_list_type keepalive(channelid const & channel)
+  {
+    action_list_type actions;
+    m_message_bundling.keepalive(channel, actions);
+    return actions;
+  }
+
+
+  /**
+   * Send the same message on several channels; see
+   * message_bundling_filter::fan_out().
+   */
+  template <
+    typename iterT
+  >
+  inline action_list_type fan_out(iterT begin, iterT end,
+      std::unique_ptr<message> const & msg, std::size_t & sent)
+  {
+    return m_message_bundling.fan_out(begin, end, msg, sent);
+  }
+
+
+  /**
+   * Release packets from channel egress buffers, subject to rate limits;
+   * see out_buffer_filter.
+   */
+  using buffer_entry = typename out_buffer::buffer_entry;
+  using rate_limiter = typename out_buffer::rate_limiter;
+
+  inline buffer_entry release(channelid const & channel)
+  {
+    return m_out_buffer.release(channel);
+  }
+
+  inline typename rate_limiter::duration
+  release_delay(channelid const & channel)
+  {
+    return m_out_buffer.release_delay(channel);
+  }
+
+  inline void set_rate_limiter(rate_limiter * limiter)
+  {
+    m_out_buffer.set_rate_limiter(limiter);
+  }
+
+
+  /**
+   * Compress data messages on channels with the compression capability;
+   * pass nullptr to stop compressing.
+   */
+  inline void set_compression(
+      ::channeler::support::payload_compression * compression)
+  {
+    m_compress.set_compression(compression);
+  }
+
+
+  /**
+   * Record finished egress packets to the given capture; pass nullptr to
+   * stop capturing.
+   */
+  inline void set_capture(::channeler::capture::packet_capture * pcap)
+  {
+    m_capture.set_capture(pcap);
   }
 
   callback          m_callback;
   out_buffer        m_out_buffer;
+  capture           m_capture;
   add_checksum      m_add_checksum;
   message_bundling  m_message_bundling;
   enqueue_message   m_enqueue_message;
+  compress          m_compress;
 };
 
 
@@ -70,12 +70,14 @@ struct add_checksum_filter
   {
     auto in = event_as<input_event>("egress:add_checksum", ev.get(), ET_PACKET_OUT);
 
-    // Set checksum
-    auto err = in->packet.update_checksum();
-    if (ERR_SUCCESS != err) {
-      // Uh-oh, some kind of error.
-      // TODO add an action
-      return {};
+    // Set checksum, unless the producer of the packet already did so.
+    if (!in->checksummed) {
+      auto err = in->packet.update_checksum();
+      if (ERR_SUCCESS != err) {
+        // Uh-oh, some kind of error.
+        // TODO add an action
+        return {};
+      }
     }
 
     return m_next->consume(std::move(ev));
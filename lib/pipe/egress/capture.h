@@ -0,0 +1,92 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_PIPE_EGRESS_CAPTURE_H
+#define CHANNELER_PIPE_EGRESS_CAPTURE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <memory>
+
+#include "../event.h"
+#include "../action.h"
+#include "../event_as.h"
+
+#include "../../capture/pcapng.h"
+
+
+namespace channeler::pipe {
+
+/**
+ * The egress capture filter records finished packets to a packet capture,
+ * and passes them on unmodified. Without a capture set, it does nothing
+ * else.
+ *
+ * It must be placed after the checksum is added, so that the captured
+ * packets are exactly what goes on the wire.
+ */
+template <
+  typename addressT,
+  std::size_t POOL_BLOCK_SIZE,
+  typename next_filterT,
+  typename next_eventT
+>
+struct egress_capture_filter
+{
+  using input_event = packet_out_event<POOL_BLOCK_SIZE>;
+
+  inline egress_capture_filter(next_filterT * next,
+      ::channeler::capture::packet_capture * capture = nullptr)
+    : m_next{next}
+    , m_capture{capture}
+  {
+  }
+
+
+  inline action_list_type consume(std::unique_ptr<event> ev)
+  {
+    if (m_capture) {
+      auto in = event_as<input_event const>("egress:capture", ev.get(),
+          ET_PACKET_OUT);
+      m_capture->capture(::channeler::capture::CAPTURE_OUTBOUND,
+          in->packet.buffer(), in->packet.packet_size());
+    }
+
+    return m_next->consume(std::move(ev));
+  }
+
+
+  inline void set_capture(::channeler::capture::packet_capture * capture)
+  {
+    m_capture = capture;
+  }
+
+
+  next_filterT *                          m_next;
+  ::channeler::capture::packet_capture *  m_capture;
+};
+
+
+} // namespace channeler::pipe
+
+#endif // guard
@@ -0,0 +1,144 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_PIPE_EGRESS_COMPRESS_H
+#define CHANNELER_PIPE_EGRESS_COMPRESS_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <memory>
+#include <vector>
+
+#include "../../channels.h"
+#include "../../support/compression.h"
+#include "../event.h"
+#include "../action.h"
+#include "../event_as.h"
+
+#include <channeler/capabilities.h>
+#include <channeler/message.h>
+
+
+namespace channeler::pipe {
+
+/**
+ * The compress filter replaces data messages with compressed data messages,
+ * before they are enqueued for bundling.
+ *
+ * This only happens on channels with the CAP_COMPRESSION (LZ4) or
+ * CAP_COMPRESSION_DICTIONARY (zstd with the shared dictionary) capability,
+ * using only the codecs granted, and if compression actually shrinks the
+ * payload. Data that would not fit
+ * into a packet uncompressed is also left alone, because the receiver
+ * decompresses into a single pool slot.
+ *
+ * Without a compression instance set, all messages are passed on
+ * unchanged.
+ */
+template <
+  typename channelT,
+  typename next_filterT,
+  typename next_eventT
+>
+struct compress_filter
+{
+  using input_event = message_out_event;
+  using channel_set = ::channeler::channels<channelT>;
+  using compression_type = ::channeler::support::payload_compression;
+
+  inline compress_filter(next_filterT * next,
+      channel_set & channels,
+      std::size_t packet_size,
+      compression_type * compression = nullptr)
+    : m_next{next}
+    , m_channels{channels}
+    , m_packet_size{packet_size}
+    , m_compression{compression}
+  {
+  }
+
+
+  inline void set_compression(compression_type * compression)
+  {
+    m_compression = compression;
+  }
+
+
+  inline action_list_type consume(std::unique_ptr<event> ev)
+  {
+    auto in = event_as<input_event>("egress:compress", ev.get(), ET_MESSAGE_OUT);
+    compress(*in);
+    return m_next->consume(std::move(ev));
+  }
+
+
+  inline action_list_type consume_all(event_list_type events)
+  {
+    for (auto & ev : events) {
+      auto in = event_as<input_event>("egress:compress", ev.get(),
+          ET_MESSAGE_OUT);
+      compress(*in);
+    }
+    return m_next->consume_all(std::move(events));
+  }
+
+
+  inline void compress(input_event & in)
+  {
+    if (!m_compression || !in.message || in.message->type != MSG_DATA) {
+      return;
+    }
+    if (in.message->serialized_size() > m_packet_size) {
+      return;
+    }
+
+    auto ch = m_channels.get(in.channel);
+    if (!ch) {
+      return;
+    }
+    bool lz4 = ch->capabilities()[CAP_COMPRESSION];
+    bool dictionary = ch->capabilities()[CAP_COMPRESSION_DICTIONARY];
+    if (!lz4 && !dictionary) {
+      return;
+    }
+
+    std::vector<byte> payload;
+    if (!m_compression->compress(payload, in.message->payload,
+          in.message->payload_size, lz4, dictionary))
+    {
+      return;
+    }
+    in.message = message_data::create(payload, MSG_DATA_COMPRESSED);
+  }
+
+
+  next_filterT *      m_next;
+  channel_set &       m_channels;
+  std::size_t         m_packet_size;
+  compression_type *  m_compression;
+};
+
+
+} // namespace channeler::pipe
+
+#endif // guard
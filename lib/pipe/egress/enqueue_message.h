@@ -26,7 +26,9 @@
 
 #include <channeler.h>
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "../../memory/packet_pool.h"
 #include "../event.h"
@@ -78,7 +80,7 @@ struct enqueue_message_filter
     }
 
     // Enqueue message
-    ch->enqueue_egress_message(std::move(in->message));
+    ch->enqueue_egress_message(std::move(in->message), in->deadline);
 
     // Create output event
     auto out = std::make_unique<message_out_enqueued_event>(in->channel);
@@ -86,6 +88,42 @@ struct enqueue_message_filter
   }
 
 
+  /**
+   * Enqueue a batch of messages, and only then pass on one event per
+   * channel. This lets the next filter bundle all messages for a channel
+   * into as few packets as possible.
+   */
+  inline action_list_type consume_all(event_list_type events)
+  {
+    std::vector<channelid> enqueued;
+    for (auto & ev : events) {
+      auto in = event_as<input_event>("egress:enqueue_message", ev.get(),
+          ET_MESSAGE_OUT);
+
+      auto ch = m_channels.get(in->channel);
+      if (!ch) {
+        // TODO see above
+        continue;
+      }
+      ch->enqueue_egress_message(std::move(in->message), in->deadline);
+
+      if (std::find(enqueued.begin(), enqueued.end(), in->channel)
+          == enqueued.end())
+      {
+        enqueued.push_back(in->channel);
+      }
+    }
+
+    action_list_type actions;
+    for (auto & channel : enqueued) {
+      auto out = std::make_unique<message_out_enqueued_event>(channel);
+      auto ret = m_next->consume(std::move(out));
+      actions.merge(ret);
+    }
+    return actions;
+  }
+
+
   next_filterT *  m_next;
   channel_set &   m_channels;
 };
@@ -26,9 +26,15 @@
 
 #include <channeler.h>
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
+#include <liberate/checksum/crc32.h>
+
 #include "../../memory/packet_pool.h"
+#include "../../support/crc32_combine.h"
+#include "../../support/wire.h"
 #include "../event.h"
 #include "../action.h"
 #include "../event_as.h"
@@ -42,8 +48,11 @@ namespace channeler::pipe {
 /**
  * The message_bundling filter packs messages into a packet.
  *
- * TODO: For the time being, every message gets its own packet. A future
- *       revision of the filter should take into account:
+ * All messages queued for the channel are packed into as few packets as
+ * possible, each packet holding as many messages as fit.
+ *
+ * TODO: For the time being, packets are produced as soon as messages are
+ *       enqueued. A future revision of the filter should take into account:
  *       a) a time slot mechanism, whereby incomplete packets are sent when
  *          a timeout expires, but otherwise are held back for more messages
  *          to accumulate
@@ -69,6 +78,8 @@ struct message_bundling_filter
   using slot_type = typename pool_type::slot;
   using channel_set = ::channeler::channels<channelT>;
   using peerid_function = std::function<peerid()>;
+  // CRC32C, as used for packet checksums, in reflected form.
+  using checksum_shift = ::channeler::support::crc32_shift<0x82F63B78>;
 
   inline message_bundling_filter(next_filterT * next,
       channel_set & channels,
@@ -90,13 +101,45 @@ struct message_bundling_filter
     auto in = event_as<input_event const>("egress:message_bundling", ev.get(),
         ET_MESSAGE_OUT_ENQUEUED);
 
-    // Let's be paranoid and check that there is egress data.
+    // Messages that expired while waiting in the queue are not worth the
+    // bandwidth; drop them before bundling. Let's also be paranoid and check
+    // that there is egress data left.
     auto ch = m_channels.get(in->channel);
+    auto expired = ch->drop_expired_egress_messages();
+    if (expired) {
+      LIBLOG_DEBUG("Dropped " << expired << " expired message(s) on channel "
+          << in->channel);
+    }
     if (!ch->has_egress_data_pending()) {
       // TODO what to do here?
       return {};
     }
 
+    // Pack messages into as many packets as it takes to drain the channel's
+    // queue.
+    action_list_type actions;
+    while (ch->has_egress_data_pending()) {
+      auto packed = bundle_packet(in->channel, ch, actions);
+      if (!packed) {
+        // The next message does not fit even into an empty packet; there is
+        // no point in trying again.
+        LIBLOG_ERROR("Message too large for packet on channel: " << in->channel);
+        break;
+      }
+    }
+    return actions;
+  }
+
+
+  /**
+   * Bundle the next messages in the channel's queue into a single packet and
+   * pass it on. Returns the number of messages packed; if it is zero, no
+   * packet is produced.
+   */
+  inline std::size_t bundle_packet(channelid const & channel,
+      typename channel_set::channel_ptr const & ch,
+      action_list_type & actions)
+  {
     // Allocate memory. This is for creating the packet header, which is useful
     // for understanding the maximum payload size.
     slot_type slot = m_pool.allocate();
@@ -107,7 +150,7 @@ struct message_bundling_filter
                                         // payloads
     packet.sender() = m_own_peerid_func();
     packet.recipient() = m_peer_peerid_func();
-    packet.channel() = in->channel;
+    packet.channel() = channel;
     // TODO flags
 
     // Grab the channel; we'll pack as many messages as fit into the packet
@@ -121,6 +164,10 @@ struct message_bundling_filter
 
     size_t remaining = packet.max_payload_size();
     byte * offset = packet.payload();
+    std::size_t packed = 0;
+
+    // The packet is worth sending until the last of its messages expires.
+    message_deadline deadline = message_deadline::min();
 
     do {
       std::size_t next_size = ch->next_egress_message_size();
@@ -128,32 +175,231 @@ struct message_bundling_filter
         break;
       }
 
+      deadline = std::max(deadline, ch->next_egress_message_deadline());
       auto used = serialize_message(offset, remaining,
           std::move(ch->dequeue_egress_message()));
       offset += used;
       remaining -= used;
+      ++packed;
     } while (remaining > 0);
 
+    if (!packed) {
+      return 0;
+    }
+
     // Update packet payload size. The remaining buffer is part of the packet
     // size, but not of the payload size.
     packet.payload_size() = packet.max_payload_size() - remaining;
 
-    // Fill the remaining bytes with padding. We use a variant of PKCS#7
-    // https://tools.ietf.org/html/rfc5652#section-6.3
-    // The main difference is that we do have a packet size encoded, so
-    // we do not care about the length of the padding being below 256
-    // Bytes.
-    uint8_t pad_value = remaining % 0xff;
-    for (std::size_t i = 0 ; i < remaining ; ++i) {
-      offset[i] = static_cast<byte>(pad_value);
-    }
+    add_padding(offset, remaining);
 
     // Pass slot and packet on to next filter
+    auto next = std::make_unique<next_eventT>(
+        std::move(slot),
+        std::move(packet),
+        false,
+        deadline
+    );
+    auto ret = m_next->consume(std::move(next));
+    actions.merge(ret);
+    return packed;
+  }
+
+
+  /**
+   * The largest amount of data that fits into a single MSG_DATA_AT message
+   * in a packet.
+   */
+  inline std::size_t max_data_at_size() const
+  {
+    std::size_t payload = m_pool.packet_size()
+      - ::channeler::packet_wrapper::envelope_size();
+    std::size_t header = support::varint_size(MSG_DATA_AT)
+      + support::varint_size(payload) + DATA_OFFSET_SIZE;
+    return payload > header ? payload - header : 0;
+  }
+
+
+  /**
+   * Produce a packet with a single MSG_DATA_AT message on the channel,
+   * carrying size Bytes at the given offset, and bypassing the channel's
+   * egress queue. Instead of copying data, the fill function is invoked with
+   * the location of the data in the packet, and the size, and must write
+   * exactly that many Bytes there.
+   *
+   * Returns an error if size exceeds max_data_at_size(), or the fill
+   * function returns an error; in either case no packet is produced.
+   * Otherwise, the actions of the remaining pipe are added to actions; errors
+   * among them mean the packet could not be enqueued.
+   */
+  template <
+    typename fillT
+  >
+  inline error_t bundle_in_place(channelid const & channel, uint64_t offset,
+      std::size_t size, fillT && fill, action_list_type & actions)
+  {
+    if (!size || size > max_data_at_size()) {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+
+    slot_type slot = m_pool.allocate();
+    ::channeler::packet_wrapper packet{slot.data(), slot.size(), false};
+
+    packet.packet_size() = slot.size();
+    packet.sender() = m_own_peerid_func();
+    packet.recipient() = m_peer_peerid_func();
+    packet.channel() = channel;
+
+    // Message header, as serialized by message_data, and the offset
+    byte * buf = packet.payload();
+    std::size_t remaining = packet.max_payload_size();
+    auto used = support::encode_varint(buf, remaining, MSG_DATA_AT);
+    used += support::encode_varint(buf + used, remaining - used,
+        DATA_OFFSET_SIZE + size);
+    support::store_be<uint64_t>(buf + used, offset);
+    used += DATA_OFFSET_SIZE;
+
+    auto err = fill(buf + used, size);
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+    used += size;
+
+    packet.payload_size() = used;
+    add_padding(buf + used, remaining - used);
+
     auto next = std::make_unique<next_eventT>(
         std::move(slot),
         std::move(packet)
     );
-    return m_next->consume(std::move(next));
+    auto ret = m_next->consume(std::move(next));
+    actions.merge(ret);
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Produce a packet without any messages on the channel. It carries no
+   * data, but keeps the connection's NAT bindings alive.
+   */
+  inline void keepalive(channelid const & channel, action_list_type & actions)
+  {
+    slot_type slot = m_pool.allocate();
+    ::channeler::packet_wrapper packet{slot.data(), slot.size(), false};
+
+    packet.packet_size() = slot.size();
+    packet.sender() = m_own_peerid_func();
+    packet.recipient() = m_peer_peerid_func();
+    packet.channel() = channel;
+    packet.payload_size() = 0;
+    add_padding(packet.payload(), packet.max_payload_size());
+
+    auto next = std::make_unique<next_eventT>(
+        std::move(slot),
+        std::move(packet)
+    );
+    auto ret = m_next->consume(std::move(next));
+    actions.merge(ret);
+  }
+
+
+  /**
+   * Send the same message on each of the given channels, one packet per
+   * channel, bypassing the channels' egress queues.
+   *
+   * Everything between packet header and footer - the message and the
+   * padding - is identical for all packets, so it is serialized and
+   * checksummed only once. Per channel, only the header is written and
+   * checksummed, and the checksum is combined with the shared one. Each
+   * packet still receives a copy of the shared body, because egress buffers
+   * hold contiguous packets.
+   *
+   * The number of packets produced is returned in sent. Fanning out stops
+   * at the first packet the next filter reports an error for; that packet
+   * is not counted.
+   */
+  template <
+    typename iterT
+  >
+  inline action_list_type fan_out(iterT begin, iterT end,
+      std::unique_ptr<message> const & msg, std::size_t & sent)
+  {
+    sent = 0;
+    if (begin == end) {
+      return {};
+    }
+
+    // Serialize the message into a template packet. Its header is never
+    // used, but provides the offsets and sizes for all other packets.
+    slot_type shared = m_pool.allocate();
+    ::channeler::packet_wrapper layout{shared.data(), shared.size(), false};
+    layout.packet_size() = shared.size();
+
+    std::size_t const header_size = layout.payload() - shared.data();
+    std::size_t const body_size = layout.max_payload_size();
+    byte * body = layout.payload();
+
+    auto used = serialize_message(body, body_size, msg);
+    if (!used) {
+      LIBLOG_ERROR("Message too large for packet in fan-out.");
+      return error_actions(ERR_INSUFFICIENT_BUFFER_SIZE);
+    }
+    add_padding(body + used, body_size - used);
+
+    using namespace liberate::checksum;
+    auto body_checksum = crc32<CRC32C>(body, body + body_size);
+    if (!m_fanout_shift || m_fanout_shift->length() != body_size) {
+      m_fanout_shift = std::make_unique<checksum_shift>(body_size);
+    }
+
+    action_list_type actions;
+    for ( ; begin != end ; ++begin) {
+      slot_type slot = m_pool.allocate();
+      ::channeler::packet_wrapper packet{slot.data(), slot.size(), false};
+
+      packet.packet_size() = slot.size();
+      packet.sender() = m_own_peerid_func();
+      packet.recipient() = m_peer_peerid_func();
+      packet.channel() = *begin;
+      packet.payload_size() = used;
+      std::memcpy(packet.payload(), body, body_size);
+
+      // Serialize the header, and checksum only that.
+      byte const * buf = packet.buffer();
+      auto header_checksum = crc32<CRC32C>(buf, buf + header_size);
+      packet.checksum() = m_fanout_shift->combine(header_checksum,
+          body_checksum);
+
+      auto next = std::make_unique<next_eventT>(
+          std::move(slot),
+          std::move(packet),
+          true
+      );
+      auto ret = m_next->consume(std::move(next));
+      auto err = first_error(ret);
+      actions.merge(ret);
+      if (ERR_SUCCESS != err) {
+        break;
+      }
+      ++sent;
+    }
+    return actions;
+  }
+
+
+  /**
+   * Fill the remaining bytes with padding. We use a variant of PKCS#7
+   * https://tools.ietf.org/html/rfc5652#section-6.3
+   * The main difference is that we do have a packet size encoded, so
+   * we do not care about the length of the padding being below 256
+   * Bytes.
+   */
+  static inline void add_padding(byte * offset, std::size_t remaining)
+  {
+    uint8_t pad_value = remaining % 0xff;
+    for (std::size_t i = 0 ; i < remaining ; ++i) {
+      offset[i] = static_cast<byte>(pad_value);
+    }
   }
 
 
@@ -162,6 +408,7 @@ struct message_bundling_filter
   pool_type &     m_pool;
   peerid_function m_own_peerid_func;
   peerid_function m_peer_peerid_func;
+  std::unique_ptr<checksum_shift> m_fanout_shift = {};
 };
 
 
@@ -26,12 +26,15 @@
 
 #include <channeler.h>
 
+#include <algorithm>
 #include <memory>
 
 #include "../event.h"
 #include "../action.h"
 #include "../event_as.h"
 
+#include "../../support/token_bucket.h"
+
 
 namespace channeler::pipe {
 
@@ -45,6 +48,17 @@ namespace channeler::pipe {
  *
  *       We'll leave this out for now. When encryption is added, we can
  *       pick that issue up again. TODO
+ *
+ * Packets are released from the buffer via release(), subject to rate
+ * limits: the channel's own limiter, if any, and the one set on the filter
+ * for the whole connection. Both must allow the packet. The next filter is
+ * notified of packets that can be released right away with a
+ * packet_out_enqueued_event, and of others with a packet_out_delayed_event;
+ * for those, release_delay() tells when to try again.
+ *
+ * Packets whose deadline passes while they wait in the buffer - e.g. because
+ * they are rate limited, or the transport does not collect them - are
+ * dropped instead of released.
  */
 template <
   typename addressT,
@@ -58,6 +72,8 @@ struct out_buffer_filter
   using input_event = packet_out_event<POOL_BLOCK_SIZE>;
   using channel_set = ::channeler::channels<channelT>;
   using channel_ptr = typename channel_set::channel_ptr;
+  using buffer_entry = typename channelT::buffer_type::buffer_entry;
+  using rate_limiter = ::channeler::support::token_bucket;
 
   inline out_buffer_filter(
       next_filterT * next,
@@ -76,19 +92,24 @@ struct out_buffer_filter
 
     auto ptr = m_channels.get(in->packet.channel());
     if (!ptr) {
-      // Uh-oh, error.
-      // FIXME
-      return {};
+      // The channel went away; the packet is dropped.
+      return error_actions(ERR_INVALID_CHANNELID);
     }
 
     // The packet is finished, so it'll have to go into the egress buffer.
-    auto err = ptr->egress_buffer_push(in->packet, in->slot);
+    auto err = ptr->egress_buffer_push(in->packet, in->slot, in->deadline);
     if (ERR_SUCCESS != err) {
       // Uh-oh, error. - this is a buffer overflow, must be reported to
       // the user
       return {};
     }
 
+    // Rate limited packets stay in the buffer until they can be released.
+    if (!releasable(*ptr, rate_limiter::clock_type::now())) {
+      auto out = std::make_unique<packet_out_delayed_event<channelT>>(ptr);
+      return m_next->consume(std::move(out));
+    }
+
     // The next filter just gets a notification that the egress packet buffer
     // has data - we don't want to send a packet or slot, because it's up to
     // the buffer class to provide the output order.
@@ -97,8 +118,97 @@ struct out_buffer_filter
   }
 
 
+  /**
+   * Set the rate limiter for all channels; pass nullptr to remove it. The
+   * limiter must outlive its use here.
+   */
+  inline void set_rate_limiter(rate_limiter * limiter)
+  {
+    m_rate_limiter = limiter;
+  }
+
+
+  /**
+   * Release the next packet from the channel's egress buffer, consuming
+   * rate limiter tokens. If there is no packet, or it is rate limited, the
+   * returned entry has no data.
+   */
+  inline buffer_entry release(channelid const & channel)
+  {
+    auto ptr = m_channels.get(channel);
+    auto now = rate_limiter::clock_type::now();
+    if (ptr) {
+      drop_expired(*ptr, now);
+    }
+    if (!ptr || !releasable(*ptr, now)) {
+      return {packet_wrapper{nullptr, 0, false}, {}};
+    }
+
+    auto size = ptr->egress_buffer().front().data.size();
+    if (ptr->rate_limiter()) {
+      ptr->rate_limiter()->consume(size, now);
+    }
+    if (m_rate_limiter) {
+      m_rate_limiter->consume(size, now);
+    }
+    return ptr->egress_buffer_pop();
+  }
+
+
+  /**
+   * The time until the next packet on the channel can be released; zero if
+   * it can be released now, and duration::max() if there is none.
+   */
+  inline rate_limiter::duration release_delay(channelid const & channel)
+  {
+    auto ptr = m_channels.get(channel);
+    auto now = rate_limiter::clock_type::now();
+    if (ptr) {
+      drop_expired(*ptr, now);
+    }
+    if (!ptr || ptr->egress_buffer().empty()) {
+      return rate_limiter::duration::max();
+    }
+
+    auto size = ptr->egress_buffer().front().data.size();
+    auto delay = rate_limiter::duration::zero();
+    if (ptr->rate_limiter()) {
+      delay = ptr->rate_limiter()->delay(size, now);
+    }
+    if (m_rate_limiter) {
+      delay = std::max(delay, m_rate_limiter->delay(size, now));
+    }
+    return delay;
+  }
+
+
+  inline void drop_expired(channelT & ch,
+      rate_limiter::time_point const & now) const
+  {
+    auto expired = ch.drop_expired_egress_packets(now);
+    if (expired) {
+      LIBLOG_DEBUG("Dropped " << expired << " expired packet(s) on channel "
+          << ch.id());
+    }
+  }
+
+
+  inline bool releasable(channelT & ch,
+      rate_limiter::time_point const & now) const
+  {
+    if (ch.egress_buffer().empty()) {
+      return false;
+    }
+    auto size = ch.egress_buffer().front().data.size();
+    if (ch.rate_limiter() && !ch.rate_limiter()->allows(size, now)) {
+      return false;
+    }
+    return !m_rate_limiter || m_rate_limiter->allows(size, now);
+  }
+
   next_filterT *  m_next;
   channel_set &   m_channels;
+  rate_limiter *  m_rate_limiter = nullptr;
 };
 
 
@@ -26,6 +26,7 @@
 
 #include <channeler.h>
 
+#include <chrono>
 #include <list>
 #include <memory>
 
@@ -88,6 +89,7 @@ enum event_type : uint_fast16_t
   ET_MESSAGE_OUT_ENQUEUED,
   ET_PACKET_OUT,          // Contains an outbound/egress packet
   ET_PACKET_OUT_ENQUEUED, // Same, but added to an output buffer
+  ET_PACKET_OUT_DELAYED,  // Same, but rate limited
 
   // ** EC_USER
   ET_NEW_CHANNEL,       // User creates new channel
@@ -311,6 +313,13 @@ struct message_event
 };
 
 
+/**
+ * Deadline for outgoing messages; messages that have not been sent by the
+ * deadline are dropped. The default is to never expire.
+ */
+using message_deadline = std::chrono::steady_clock::time_point;
+
+
 /**
  * Outgoing messages
  */
@@ -321,16 +330,19 @@ struct message_out_event
   using message_type = typename messages::value_type;
 
   // *** Data members
-  channelid     channel;
-  message_type  message;
+  channelid         channel;
+  message_type      message;
+  message_deadline  deadline;
 
   // *** Constructor
   inline message_out_event(
       channelid const & _channel,
-      message_type && msg)
+      message_type && msg,
+      message_deadline const & _deadline = message_deadline::max())
     : event{EC_EGRESS, ET_MESSAGE_OUT}
     , channel{_channel}
     , message{std::move(msg)}
+    , deadline{_deadline}
   {
   }
 
@@ -379,15 +391,21 @@ struct packet_out_event
   // *** Data members
   slot_type                   slot;
   ::channeler::packet_wrapper packet;
+  bool                        checksummed;  // Checksum already set
+  message_deadline            deadline;     // Latest of its messages'
 
   // *** Constructor
   inline packet_out_event(
       slot_type && _slot,
-      ::channeler::packet_wrapper && _packet
+      ::channeler::packet_wrapper && _packet,
+      bool _checksummed = false,
+      message_deadline const & _deadline = message_deadline::max()
     )
     : event{EC_EGRESS, ET_PACKET_OUT}
     , slot{std::move(_slot)}
     , packet{std::move(_packet)}
+    , checksummed{_checksummed}
+    , deadline{_deadline}
   {
   }
 
@@ -426,6 +444,29 @@ struct packet_out_enqueued_event
 };
 
 
+/**
+ * Outgoing packets (enqueued, but rate limited)
+ */
+template <
+  typename channelT
+>
+struct packet_out_delayed_event
+  : public packet_out_enqueued_event<channelT>
+{
+  // *** Constructor
+  inline packet_out_delayed_event(
+      typename packet_out_enqueued_event<channelT>::channel_ptr _channel
+    )
+    : packet_out_enqueued_event<channelT>{_channel}
+  {
+    *const_cast<event_type *>(&(this->type)) = ET_PACKET_OUT_DELAYED;
+  }
+
+
+  virtual ~packet_out_delayed_event() = default;
+};
+
+
 
 /**
  * Event for a new channel
@@ -434,15 +475,21 @@ struct new_channel_event
   : public event
 {
   // *** Data members
-  peerid        sender;
-  peerid        recipient;
+  peerid          sender;
+  peerid          recipient;
+  capabilities_t  capabilities; // requested for the channel
+  uint32_t        dictionary;   // compression dictionary id, or 0
 
   inline new_channel_event(
       peerid const & _sender,
-      peerid const & _recipient)
+      peerid const & _recipient,
+      capabilities_t const & _capabilities = {},
+      uint32_t _dictionary = 0)
     : event{EC_USER, ET_NEW_CHANNEL}
     , sender{_sender}
     , recipient{_recipient}
+    , capabilities{_capabilities}
+    , dictionary{_dictionary}
   {
   }
 
@@ -490,17 +537,20 @@ struct timeout_event<void>
 struct user_data_written_event
   : public event
 {
-  channelid               channel;
+  channelid          channel;
   // TODO would be nice to have a pool reference instead of an allocation here,
   //      but we can deal with that later.
   std::vector<byte>  data;
+  message_deadline   deadline;
 
   inline user_data_written_event(
       channelid const & _channel,
-      std::vector<byte> const & _data)
+      std::vector<byte> const & _data,
+      message_deadline const & _deadline = message_deadline::max())
     : event{EC_USER, ET_USER_DATA_WRITTEN}
     , channel{_channel}
     , data{_data}
+    , deadline{_deadline}
   {
   }
 
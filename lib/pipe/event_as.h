@@ -38,7 +38,7 @@ event_assert_set(char const * caller, event * raw)
 #if defined(DEBUG) && !defined(NDEBUG)
   if (!raw) {
     LIBLOG_ERROR(caller << " received empty event.");
-    throw exception{ERR_INVALID_REFERENCE};
+    throw_exception(ERR_INVALID_REFERENCE);
   }
   LIBLOG_DEBUG(caller << " received event type: " << raw->type);
 #endif // DEBUG
@@ -63,7 +63,7 @@ event_as(char const * caller, event * raw, event_type expected_type)
   if (raw->type != expected_type) {
     LIBLOG_ERROR(caller << " received unexpected event type: " << raw->type
       << " (wanted: " << expected_type << ")");
-    throw exception{ERR_INVALID_PIPE_EVENT};
+    throw_exception(ERR_INVALID_PIPE_EVENT);
   }
 #endif // DEBUG
 
@@ -86,10 +86,17 @@ struct filter_classifier
   }
 
 
+  /**
+   * The packet may be a packet_wrapper or a packet_view; only its peer
+   * identifiers are used.
+   */
+  template <
+    typename packetT
+  >
   inline action_list_type process(
       addressT const & transport_source,
       addressT const & transport_destination,
-      ::channeler::packet_wrapper const & packet)
+      packetT const & packet)
   {
     action_list_type res;
 
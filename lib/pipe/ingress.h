@@ -34,6 +34,7 @@
 #include "ingress/validate.h"
 #include "ingress/route.h"
 #include "ingress/de_envelope.h"
+#include "ingress/capture.h"
 
 #include "../fsm/default.h"
 
@@ -95,6 +96,10 @@ struct default_ingress
     address_type, POOL_BLOCK_SIZE,
     route, typename route::input_event
   >;
+  using capture = ingress_capture_filter<
+    address_type, POOL_BLOCK_SIZE,
+    de_envelope, typename de_envelope::input_event
+  >;
 
   inline default_ingress(
       fsm_registry_type & registry,
@@ -109,13 +114,47 @@ struct default_ingress
     , m_validate{&m_channel_assign, peer_p, trans_p}
     , m_route{&m_validate}
     , m_de_envelope{&m_route}
+    , m_capture{&m_de_envelope}
   {
   }
 
 
   inline action_list_type consume(std::unique_ptr<event> ev)
   {
-    return m_de_envelope.consume(std::move(ev));
+    return m_capture.consume(std::move(ev));
+  }
+
+
+  /**
+   * Relay packets addressed to other peers according to the forwarding
+   * table; pass nullptr to process all packets locally.
+   */
+  inline void set_forwarding_table(
+      typename route::forwarding_table_type const * forwarding)
+  {
+    m_route.set_forwarding_table(forwarding);
+  }
+
+
+  /**
+   * Decompress compressed data messages into slots from the given pool;
+   * pass nullptr to stop decompressing.
+   */
+  inline void set_compression(
+      ::channeler::support::payload_compression * compression,
+      typename message_parsing::pool_type * pool)
+  {
+    m_message_parsing.set_compression(compression, pool);
+  }
+
+
+  /**
+   * Record raw ingress buffers to the given capture; pass nullptr to stop
+   * capturing.
+   */
+  inline void set_capture(::channeler::capture::packet_capture * pcap)
+  {
+    m_capture.set_capture(pcap);
   }
 
   state_handling  m_state_handling;
@@ -124,6 +163,7 @@ struct default_ingress
   validate        m_validate;
   route           m_route;
   de_envelope     m_de_envelope;
+  capture         m_capture;
 };
 
 
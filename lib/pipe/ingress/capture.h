@@ -0,0 +1,104 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_PIPE_INGRESS_CAPTURE_H
+#define CHANNELER_PIPE_INGRESS_CAPTURE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "../event.h"
+#include "../action.h"
+#include "../event_as.h"
+
+#include "../../capture/pcapng.h"
+#include "../../support/wire.h"
+
+#include <channeler/packet.h>
+
+
+namespace channeler::pipe {
+
+/**
+ * The ingress capture filter records raw buffers to a packet capture, and
+ * passes them on unmodified. Without a capture set, it does nothing else.
+ *
+ * The captured length is the packet size from the public header, so that
+ * the unused remainder of the pool slot is not recorded.
+ */
+template <
+  typename addressT,
+  std::size_t POOL_BLOCK_SIZE,
+  typename next_filterT,
+  typename next_eventT
+>
+struct ingress_capture_filter
+{
+  using input_event = raw_buffer_event<addressT, POOL_BLOCK_SIZE>;
+
+  inline ingress_capture_filter(next_filterT * next,
+      ::channeler::capture::packet_capture * capture = nullptr)
+    : m_next{next}
+    , m_capture{capture}
+  {
+  }
+
+
+  inline action_list_type consume(std::unique_ptr<event> ev)
+  {
+    if (m_capture) {
+      auto in = event_as<input_event const>("ingress:capture", ev.get(),
+          ET_RAW_BUFFER);
+
+      auto size = in->data.size();
+      if (nullptr != in->data.data()
+          && size >= public_header_layout::PUB_SIZE)
+      {
+        auto packet_size = ::channeler::support::load_be<packet_size_t>(
+            in->data.data() + public_header_layout::PUB_OFFS_PACKET_SIZE);
+        size = std::min<std::size_t>(size, packet_size);
+        m_capture->capture(::channeler::capture::CAPTURE_INBOUND,
+            in->data.data(), size);
+      }
+    }
+
+    return m_next->consume(std::move(ev));
+  }
+
+
+  inline void set_capture(::channeler::capture::packet_capture * capture)
+  {
+    m_capture = capture;
+  }
+
+
+  next_filterT *                          m_next;
+  ::channeler::capture::packet_capture *  m_capture;
+};
+
+
+} // namespace channeler::pipe
+
+#endif // guard
@@ -83,7 +83,7 @@ struct channel_assign_filter
     , m_classifier{peer_p, trans_p}
   {
     if (nullptr == m_channel_set) {
-      throw exception{ERR_INVALID_REFERENCE};
+      throw_exception(ERR_INVALID_REFERENCE);
     }
   }
 
@@ -92,9 +92,9 @@ struct channel_assign_filter
   {
     auto in = event_as<input_event>("ingress:channel_assign", ev.get(), ET_DECRYPTED_PACKET);
 
-    // If there is no data passed, we should also throw.
+    // If there is no data passed, report an error.
     if (nullptr == in->data.data()) {
-      throw exception{ERR_INVALID_REFERENCE};
+      return error_actions(ERR_INVALID_REFERENCE);
     }
 
     // Channels are *added* in the protocol handling filter. Here, we
@@ -115,9 +115,25 @@ struct channel_assign_filter
     //    initiators. Since the responder then clearly accepted our channel,
     //    we could pass the channel structure. But later filters should
     //    be able to distinguish this, so we pass an empty channel pointer.
-    // c) We do not have either kind of channel. This we must reject.
+    // c) We do not have either kind of channel. This we must reject, unless
+    //    the initiator is resuming the channel: in that case, the packet
+    //    leads with a MSG_CHANNEL_COOKIE, which the responder FSM validates.
+    //    Until then, the channel structure is empty just as in b).
     auto ptr = m_channel_set->get(in->packet.channel());
     if (!ptr) {
+      if (is_resumption(in->packet)) {
+        LIBLOG_DEBUG("Passing on resumption packet for unknown channel: "
+            << in->packet.channel());
+        auto next = std::make_unique<next_eventT>(
+            in->transport.source,
+            in->transport.destination,
+            in->packet,
+            in->data,
+            ptr
+        );
+        return m_next->consume(std::move(next));
+      }
+
       return m_classifier.process(in->transport.source,
           in->transport.destination, in->packet);
     }
@@ -151,6 +167,25 @@ struct channel_assign_filter
   }
 
 
+  /**
+   * A resumption packet is on a complete channel identifier, and starts with
+   * a MSG_CHANNEL_COOKIE.
+   */
+  inline bool is_resumption(::channeler::packet_wrapper const & packet) const
+  {
+    if (!packet.channel().is_complete()) {
+      return false;
+    }
+    auto msgs = packet.get_messages();
+    auto iter = msgs.begin();
+    if (iter == msgs.end()) {
+      return false;
+    }
+    auto msg = *iter;
+    return msg && msg->type == MSG_CHANNEL_COOKIE;
+  }
+
+
   next_filterT *  m_next;
   channel_set *   m_channel_set;
   classifier      m_classifier; // TODO ptr or ref for shared state?
@@ -71,9 +71,9 @@ struct de_envelope_filter
   {
     auto in = event_as<input_event const>("ingress:de_envelope", ev.get(), ET_RAW_BUFFER);
 
-    // If there is no data passed, we should also throw.
+    // If there is no data passed, report an error.
     if (nullptr == in->data.data()) {
-      throw exception{ERR_INVALID_REFERENCE};
+      return error_actions(ERR_INVALID_REFERENCE);
     }
 
     // Parse header data, and pass on a new event to the next filter
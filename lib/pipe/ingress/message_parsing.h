@@ -31,6 +31,8 @@
 
 #include "../../memory/packet_pool.h"
 #include "../../channels.h"
+#include "../../support/compression.h"
+#include "../../support/wire.h"
 #include "../event.h"
 #include "../action.h"
 #include "../filter_classifier.h"
@@ -42,6 +44,27 @@
 
 namespace channeler::pipe {
 
+/**
+ * A message that keeps the pool slot it is parsed from alive; used for
+ * decompressed data messages.
+ */
+template <
+  typename slotT
+>
+struct pooled_message
+  : public message
+{
+  slotT slot;
+
+  inline pooled_message(slotT && _slot, std::size_t size)
+    : message{_slot.data(), size}
+    , slot{std::move(_slot)}
+  {
+  }
+
+  virtual ~pooled_message() = default;
+};
+
 
 /**
  * Parses messages in a packet. Follow-on filters will receive individual
@@ -71,6 +94,9 @@ struct message_parsing_filter
   using input_event = enqueued_packet_event<addressT, POOL_BLOCK_SIZE, channelT>;
   using channel_set = ::channeler::channels<channelT>;
   using classifier = filter_classifier<addressT, peer_failure_policyT, transport_failure_policyT>;
+  using pool_type = ::channeler::memory::packet_pool<POOL_BLOCK_SIZE>;
+  using slot_type = typename pool_type::slot;
+  using compression_type = ::channeler::support::payload_compression;
 
   inline message_parsing_filter(next_filterT * next)
     : m_next{next}
@@ -78,35 +104,62 @@ struct message_parsing_filter
   }
 
 
+  /**
+   * Decompress compressed data messages into slots from the given pool.
+   * Without a compression instance, such messages are passed on as they are.
+   */
+  inline void set_compression(compression_type * compression,
+      pool_type * pool)
+  {
+    m_compression = compression;
+    m_pool = pool;
+  }
+
+
   inline action_list_type consume(std::unique_ptr<event> ev)
   {
     auto in = event_as<input_event>("ingress:message_parsing", ev.get(), ET_ENQUEUED_PACKET);
 
-    // If there is no data passed, we should also throw.
+    // If there is no data passed, report an error.
     if (nullptr == in->data.data()) {
-      throw exception{ERR_INVALID_REFERENCE};
+      return error_actions(ERR_INVALID_REFERENCE);
     }
 
     // We have a packet and it belongs to a channel. Now we need to push
     // messages down the pipeline.
-    // TODO if the packet channel is pending, then this packet should
-    //      contain a MSG_PACKET_COOKIE. We need to process that message
-    //      *first* in order to be able to process the others. This may
-    //      require two iterations.
-    //      https://gitlab.com/interpeer/channeler/-/issues/13
+    //
+    // If the packet channel is pending or unknown, then this packet should
+    // contain a MSG_CHANNEL_COOKIE. We need to process that message *first*
+    // in order to be able to process the others, so we iterate twice: once
+    // for cookies, once for everything else.
     action_list_type actions;
-    for (auto msg : in->packet.get_messages()) {
-      // Need to construct a new event per message
-      auto next = std::make_unique<next_eventT>(
-          in->transport.source,
-          in->transport.destination,
-          in->packet,
-          in->data,
-          in->channel,
-          std::move(msg)
-      );
-      auto ret = m_next->consume(std::move(next));
-      actions.merge(ret);
+    bool const cookies[] = { true, false };
+    for (auto cookie_pass : cookies) {
+      for (auto msg : in->packet.get_messages()) {
+        if (!msg || (msg->type == MSG_CHANNEL_COOKIE) != cookie_pass) {
+          continue;
+        }
+
+        if (msg->type == MSG_DATA_COMPRESSED && m_compression) {
+          msg = decompress(*msg);
+          if (!msg) {
+            LIBLOG_ERROR("Could not decompress data message; dropping it.");
+            continue;
+          }
+        }
+
+        // Need to construct a new event per message
+        auto next = std::make_unique<next_eventT>(
+            in->transport.source,
+            in->transport.destination,
+            in->packet,
+            in->data,
+            in->channel,
+            std::move(msg)
+        );
+        auto ret = m_next->consume(std::move(next));
+        actions.merge(ret);
+      }
     }
 
     // The nice thing about the iterator interface is that if there were no
@@ -119,7 +172,41 @@ struct message_parsing_filter
   }
 
 
-  next_filterT *  m_next;
+  /**
+   * Decompress straight into a pool slot, which then holds the serialized
+   * (uncompressed) data message.
+   */
+  inline std::unique_ptr<message> decompress(message const & msg)
+  {
+    auto original = compression_type::original_size(msg.payload,
+        msg.payload_size);
+    if (!original || !m_pool) {
+      return {};
+    }
+
+    slot_type slot = m_pool->allocate();
+    std::size_t header = support::varint_size(MSG_DATA)
+      + support::varint_size(original);
+    if (header + original > slot.size()) {
+      return {};
+    }
+    auto used = support::encode_varint(slot.data(), header, MSG_DATA);
+    support::encode_varint(slot.data() + used, header - used, original);
+
+    auto size = m_compression->decompress(slot.data() + header, original,
+        msg.payload, msg.payload_size);
+    if (size != original) {
+      return {};
+    }
+
+    return std::make_unique<pooled_message<slot_type>>(std::move(slot),
+        header + original);
+  }
+
+
+  next_filterT *      m_next;
+  compression_type *  m_compression = nullptr;
+  pool_type *         m_pool = nullptr;
 };
 
 
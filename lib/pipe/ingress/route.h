@@ -34,6 +34,9 @@
 #include "../action.h"
 #include "../event_as.h"
 
+#include "../../forwarding_table.h"
+#include "../../packet_view.h"
+
 #include <channeler/packet.h>
 #include <channeler/error.h>
 
@@ -44,15 +47,11 @@ namespace channeler::pipe {
  * Route packets.
  *
  * For the time being, this means dropping packets with unacceptable source
- * or destination addresses.
- *
- * Expects the next_eventT constructor to take
- * - transport source address
- * - transport destination address
- * - packet_wrapper
- * - a pool slot
+ * or destination addresses, and malformed packets.
  *
- * such as e.g. decrypted_packet_event
+ * Only the peer identifiers and size fields are read; other header fields
+ * are not decoded. The input event is passed on, so next_eventT must be the
+ * parsed_header_event.
  *
  * TODO:
  * - unban action or interface
@@ -68,10 +67,26 @@ template <
 struct route_filter
 {
   using input_event = parsed_header_event<addressT, POOL_BLOCK_SIZE>;
+  using forwarding_table_type = ::channeler::forwarding_table<addressT>;
+  using forward_action = forward_packet_action<addressT,
+        typename input_event::slot_type>;
 
-  inline route_filter(next_filterT * next)
+  inline route_filter(next_filterT * next,
+      forwarding_table_type const * forwarding = nullptr)
     : m_next{next}
+    , m_forwarding{forwarding}
+  {
+  }
+
+
+  /**
+   * With a forwarding table, packets addressed to other peers are relayed
+   * to the next hop in the table, or dropped if there is none. Without one,
+   * all packets are processed locally.
+   */
+  inline void set_forwarding_table(forwarding_table_type const * forwarding)
   {
+    m_forwarding = forwarding;
   }
 
 
@@ -79,9 +94,9 @@ struct route_filter
   {
     auto in = event_as<input_event>("ingress:route", ev.get(), ET_PARSED_HEADER);
 
-    // If there is no data passed, we should also throw.
+    // If there is no data passed, report an error.
     if (nullptr == in->data.data()) {
-      throw exception{ERR_INVALID_REFERENCE};
+      return error_actions(ERR_INVALID_REFERENCE);
     }
 
     // Do the actual filtering.
@@ -94,16 +109,28 @@ struct route_filter
       return {};
     }
 
-    // At the next event, we expect a packet not just a header. This means
-    // parsing the header a second time for now.
-    // TODO: new packet constructor
-    // https://gitlab.com/interpeer/channeler/-/issues/25
-    auto next = std::make_unique<next_eventT>(
-        in->transport.source,
-        in->transport.destination,
-        channeler::packet_wrapper{in->data.data(), in->data.size()},
-        in->data);
-    auto res = m_next->consume(std::move(next));
+    // Relay packets for other peers in the slot they arrived in, without
+    // parsing more than the public header.
+    if (m_forwarding && !m_forwarding->is_self(in->header.recipient)) {
+      auto next_hop = m_forwarding->lookup(in->header.recipient);
+      if (!next_hop) {
+        return {};
+      }
+      action_list_type res;
+      res.push_back(std::make_unique<forward_action>(*next_hop, in->data));
+      return res;
+    }
+
+    // Reject malformed packets before anyone reads further into the buffer.
+    ::channeler::packet_view view{in->data.data(), in->data.size()};
+    char const * reason = nullptr;
+    auto err = view.validate(reason);
+    if (ERR_SUCCESS != err) {
+      LIBLOG_DEBUG("Dropping malformed packet: " << reason);
+      return error_actions(err);
+    }
+
+    auto res = m_next->consume(std::move(ev));
 
     // We do have to handle some action types.
     for (auto & action : res) {
@@ -122,7 +149,8 @@ struct route_filter
   }
 
 
-  next_filterT *  m_next;
+  next_filterT *                  m_next;
+  forwarding_table_type const *   m_forwarding;
 
   // The route filter currently mostly drops packets if their source or
   // destination peer address is not acceptable.
@@ -35,6 +35,8 @@
 #include "../filter_classifier.h"
 #include "../event_as.h"
 
+#include "../../packet_view.h"
+
 #include <channeler/packet.h>
 #include <channeler/error.h>
 
@@ -55,6 +57,12 @@ namespace channeler::pipe {
  * policy to decide whether to institute filtering at the level of the peerid,
  * and the transport failure policy whether to filter at the transport level.
  *
+ * Checksums are verified on a packet_view of the slot, so that packets that
+ * are dropped never have their header fields decoded. The route filter has
+ * already rejected malformed packets, so the size fields are not checked
+ * again here. Only valid packets are wrapped in a packet_wrapper for the
+ * next filter.
+ *
  * Expects the next_eventT constructor to take
  * - transport source address
  * - transport destination address
@@ -73,7 +81,7 @@ template <
 >
 struct validate_filter
 {
-  using input_event = decrypted_packet_event<addressT, POOL_BLOCK_SIZE>;
+  using input_event = parsed_header_event<addressT, POOL_BLOCK_SIZE>;
   using classifier = filter_classifier<addressT, peer_failure_policyT, transport_failure_policyT>;
 
   inline validate_filter(next_filterT * next,
@@ -87,25 +95,36 @@ struct validate_filter
 
   inline action_list_type consume(std::unique_ptr<event> ev)
   {
-    auto in = event_as<input_event>("ingress:validate", ev.get(), ET_DECRYPTED_PACKET);
+    auto in = event_as<input_event>("ingress:validate", ev.get(), ET_PARSED_HEADER);
 
-    // If there is no data passed, we should also throw.
+    // If there is no data passed, report an error.
     if (nullptr == in->data.data()) {
-      throw exception{ERR_INVALID_REFERENCE};
+      return error_actions(ERR_INVALID_REFERENCE);
     }
 
     // We need to validate the packet. For now, this just means verifying the
-    // checksum.
-    if (!in->packet.has_valid_checksum()) {
+    // checksum; the route filter validated the packet's structure.
+    ::channeler::packet_view view{in->data.data(), in->data.size()};
+    if (!view.has_valid_checksum()) {
       // If the checksum is invalid, we know we want to exit the pipe here. The
       // classifier provides actions, if so desired.
       return m_classifier.process(in->transport.source,
-          in->transport.destination, in->packet);
+          in->transport.destination, view);
+    }
+
+    // At the next filter, we require full packets.
+    auto packet = ::channeler::packet_wrapper::create(in->data.data(),
+        in->data.size());
+    if (!packet) {
+      return error_actions(packet.error());
     }
 
-    // At the next filter, we require full packets again. Let's just move
-    // the event, then.
-    return m_next->consume(std::move(ev));
+    auto next = std::make_unique<next_eventT>(
+        in->transport.source,
+        in->transport.destination,
+        std::move(*packet),
+        in->data);
+    return m_next->consume(std::move(next));
   }
 
 
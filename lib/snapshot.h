@@ -0,0 +1,279 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SNAPSHOT_H
+#define CHANNELER_SNAPSHOT_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <cstring>
+#include <vector>
+
+#include <liberate/checksum/crc32.h>
+
+#include <channeler/capabilities.h>
+#include <channeler/channelid.h>
+#include <channeler/cookie.h>
+#include <channeler/error.h>
+#include <channeler/peerid.h>
+
+#include "support/wire.h"
+
+namespace channeler {
+
+/**
+ * Connection state snapshots let a node restart without its peers
+ * noticing: the established channels are restored in the new process, so
+ * there is no need to handshake again.
+ *
+ * A snapshot holds:
+ * - the node's and the peer's identifiers,
+ * - the cookie secret; the restored node's secret generator must produce
+ *   it, or resumption cookies issued before the restart become invalid,
+ * - the established channels, with their capabilities and resumption
+ *   cookies, and
+ * - optionally, file descriptors of sockets handed over to the new process
+ *   (e.g. inherited across exec()), so that transports can resume on the
+ *   same addresses.
+ *
+ * Pending channels are not part of a snapshot; peers retry those anyway.
+ * Neither is the responder's memory of resumed channels, which rejects
+ * replayed resumption packets; see fsm::channel_responder.
+ *
+ * Snapshots are (de-)serialized to memory here; see snapshot_file.h for
+ * saving them to and loading them from files.
+ */
+struct channel_snapshot
+{
+  channelid       id = DEFAULT_CHANNELID;
+  capabilities_t  capabilities = {};
+  cookie          resumption_cookie = {};
+};
+
+
+struct connection_snapshot
+{
+  peerid                        self = {};
+  peerid                        peer = {};
+  std::vector<byte>             secret = {};
+  std::vector<channel_snapshot> channels = {};
+  std::vector<int>              fds = {};
+};
+
+
+/**
+ * The binary format is compact: a fixed header, the two peer identifiers,
+ * varint-prefixed lists with fixed size entries, and a CRC32C over all of
+ * it to detect truncated or corrupted files.
+ */
+constexpr uint32_t SNAPSHOT_MAGIC = 0x4348534e; // "CHSN"
+constexpr uint16_t SNAPSHOT_VERSION = 1;
+
+namespace detail {
+
+using snapshot_header_layout = support::fixed_layout<
+  uint32_t,                 // magic
+  uint16_t                  // version
+>;
+
+using snapshot_channel_layout = support::fixed_layout<
+  channelid::full_type,     // channel id
+  capability_bits_t,        // capabilities
+  cookie_serialize          // resumption cookie
+>;
+
+using snapshot_fd_layout = support::fixed_layout<
+  int32_t                   // file descriptor
+>;
+
+using snapshot_footer_layout = support::fixed_layout<
+  liberate::checksum::crc32_serialize
+>;
+
+} // namespace detail
+
+
+inline std::size_t
+serialized_size(connection_snapshot const & snap)
+{
+  using namespace detail;
+  return snapshot_header_layout::size
+    + 2 * peerid::size()
+    + support::varint_size(snap.secret.size()) + snap.secret.size()
+    + support::varint_size(snap.channels.size())
+      + snap.channels.size() * snapshot_channel_layout::size
+    + support::varint_size(snap.fds.size())
+      + snap.fds.size() * snapshot_fd_layout::size
+    + snapshot_footer_layout::size;
+}
+
+
+/**
+ * Serialize the snapshot into the buffer, which must hold at least
+ * serialized_size() Bytes.
+ */
+inline error_t
+serialize_snapshot(byte * buf, std::size_t max,
+    connection_snapshot const & snap)
+{
+  using namespace detail;
+  if (max < serialized_size(snap)) {
+    return ERR_INSUFFICIENT_BUFFER_SIZE;
+  }
+
+  byte * offset = buf;
+  snapshot_header_layout::write(offset, SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+  offset += snapshot_header_layout::size;
+
+  std::memcpy(offset, snap.self.buffer, peerid::size());
+  offset += peerid::size();
+  std::memcpy(offset, snap.peer.buffer, peerid::size());
+  offset += peerid::size();
+
+  offset += support::encode_varint(offset, max - (offset - buf),
+      snap.secret.size());
+  if (!snap.secret.empty()) {
+    std::memcpy(offset, snap.secret.data(), snap.secret.size());
+    offset += snap.secret.size();
+  }
+
+  offset += support::encode_varint(offset, max - (offset - buf),
+      snap.channels.size());
+  for (auto & ch : snap.channels) {
+    snapshot_channel_layout::write(offset, ch.id.full,
+        static_cast<capability_bits_t>(ch.capabilities.to_ulong()),
+        ch.resumption_cookie);
+    offset += snapshot_channel_layout::size;
+  }
+
+  offset += support::encode_varint(offset, max - (offset - buf),
+      snap.fds.size());
+  for (auto fd : snap.fds) {
+    snapshot_fd_layout::write(offset, fd);
+    offset += snapshot_fd_layout::size;
+  }
+
+  using namespace liberate::checksum;
+  snapshot_footer_layout::write(offset, crc32<CRC32C>(buf, offset));
+  return ERR_SUCCESS;
+}
+
+
+/**
+ * Deserialize a snapshot. Any inconsistency, including a checksum
+ * mismatch, results in ERR_DECODE.
+ */
+inline error_t
+deserialize_snapshot(connection_snapshot & snap, byte const * buf,
+    std::size_t size)
+{
+  using namespace detail;
+  if (size < snapshot_header_layout::size + 2 * peerid::size()
+      + snapshot_footer_layout::size)
+  {
+    return ERR_DECODE;
+  }
+
+  // Check the checksum first; everything after that is consistent, or
+  // a programming error.
+  using namespace liberate::checksum;
+  std::size_t body = size - snapshot_footer_layout::size;
+  crc32_serialize expected = 0;
+  snapshot_footer_layout::read(buf + body, expected);
+  if (expected != crc32<CRC32C>(buf, buf + body)) {
+    return ERR_DECODE;
+  }
+
+  byte const * offset = buf;
+  byte const * end = buf + body;
+
+  uint32_t magic = 0;
+  uint16_t version = 0;
+  snapshot_header_layout::read(offset, magic, version);
+  if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+    return ERR_DECODE;
+  }
+  offset += snapshot_header_layout::size;
+
+  connection_snapshot result;
+  result.self = peerid{offset, peerid::size()};
+  offset += peerid::size();
+  result.peer = peerid{offset, peerid::size()};
+  offset += peerid::size();
+
+  // Read a varint count, and ensure that count entries of the given size
+  // fit into the remaining buffer.
+  auto read_count = [&offset, end](std::size_t & count,
+      std::size_t entry_size) -> bool
+  {
+    auto used = support::decode_varint(count, offset, end - offset);
+    if (!used) {
+      return false;
+    }
+    offset += used;
+    return count <= static_cast<std::size_t>(end - offset) / entry_size;
+  };
+
+  std::size_t count = 0;
+  if (!read_count(count, 1)) {
+    return ERR_DECODE;
+  }
+  result.secret.assign(offset, offset + count);
+  offset += count;
+
+  if (!read_count(count, snapshot_channel_layout::size)) {
+    return ERR_DECODE;
+  }
+  result.channels.resize(count);
+  for (auto & ch : result.channels) {
+    capability_bits_t caps = 0;
+    cookie_serialize cookie2 = 0;
+    snapshot_channel_layout::read(offset, ch.id.full, caps, cookie2);
+    ch.capabilities = capabilities_t{caps};
+    ch.resumption_cookie = cookie2;
+    offset += snapshot_channel_layout::size;
+  }
+
+  if (!read_count(count, snapshot_fd_layout::size)) {
+    return ERR_DECODE;
+  }
+  result.fds.resize(count);
+  for (auto & fd : result.fds) {
+    int32_t tmp = 0;
+    snapshot_fd_layout::read(offset, tmp);
+    fd = tmp;
+    offset += snapshot_fd_layout::size;
+  }
+
+  if (offset != end) {
+    return ERR_DECODE;
+  }
+
+  snap = std::move(result);
+  return ERR_SUCCESS;
+}
+
+
+} // namespace channeler
+
+#endif // guard
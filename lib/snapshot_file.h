@@ -0,0 +1,110 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SNAPSHOT_FILE_H
+#define CHANNELER_SNAPSHOT_FILE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#if !defined(CHANNELER_POSIX)
+#error Snapshot files are written through POSIX memory mappings.
+#endif
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <channeler/error.h>
+
+#include "snapshot.h"
+
+namespace channeler {
+
+/**
+ * Write the snapshot to a file, through a shared memory mapping of it.
+ */
+inline error_t
+save_snapshot(std::string const & path, connection_snapshot const & snap)
+{
+  auto size = serialized_size(snap);
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    return ERR_WRITE;
+  }
+  if (::ftruncate(fd, size) < 0) {
+    ::close(fd);
+    return ERR_WRITE;
+  }
+
+  void * mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+      fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    return ERR_WRITE;
+  }
+
+  auto err = serialize_snapshot(static_cast<byte *>(mem), size, snap);
+  if (ERR_SUCCESS == err && ::msync(mem, size, MS_SYNC) < 0) {
+    err = ERR_WRITE;
+  }
+  ::munmap(mem, size);
+  return err;
+}
+
+
+/**
+ * Read a snapshot from a file, through a private memory mapping of it.
+ */
+inline error_t
+load_snapshot(connection_snapshot & snap, std::string const & path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ERR_READ;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || st.st_size <= 0) {
+    ::close(fd);
+    return ERR_READ;
+  }
+  std::size_t size = st.st_size;
+
+  void * mem = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    return ERR_READ;
+  }
+
+  auto err = deserialize_snapshot(snap, static_cast<byte const *>(mem), size);
+  ::munmap(mem, size);
+  return err;
+}
+
+} // namespace channeler
+
+#endif // guard
@@ -0,0 +1,168 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_ASYNC_WRITER_H
+#define CHANNELER_SUPPORT_ASYNC_WRITER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace channeler::support {
+
+/**
+ * Double-buffered asynchronous writer.
+ *
+ * Producers append records to the front buffer; a background thread swaps
+ * buffers and hands the back buffer to the sink. The lock is only ever held
+ * for copying a single record or swapping two vectors, so producers are not
+ * held up by slow sinks.
+ *
+ * If the front buffer has no room for a record, the record is dropped and
+ * counted instead: a writer that falls behind loses records, it does not
+ * slow down its producers.
+ */
+class async_writer
+{
+public:
+  using sink = std::function<void (byte const *, std::size_t)>;
+
+  inline async_writer(sink output, std::size_t buffer_size = 1024 * 1024)
+    : m_sink{output}
+    , m_buffer_size{buffer_size}
+  {
+    m_front.reserve(m_buffer_size);
+    m_back.reserve(m_buffer_size);
+    m_thread = std::thread{[this]() { run(); }};
+  }
+
+  inline ~async_writer()
+  {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      m_stop = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+  }
+
+  /**
+   * Append a record of the given size; fill is invoked with a pointer to
+   * size Bytes to write the record into. Returns false if the record was
+   * dropped.
+   */
+  template <typename fillT>
+  inline bool write(std::size_t size, fillT && fill)
+  {
+    {
+      std::lock_guard<std::mutex> lock{m_mutex};
+      if (m_front.size() + size > m_buffer_size) {
+        ++m_dropped;
+        return false;
+      }
+      auto offset = m_front.size();
+      m_front.resize(offset + size);
+      fill(m_front.data() + offset);
+    }
+    m_wakeup.notify_one();
+    return true;
+  }
+
+  inline bool write(byte const * data, std::size_t size)
+  {
+    return write(size, [data, size](byte * out)
+    {
+      std::copy(data, data + size, out);
+    });
+  }
+
+  /**
+   * Block until everything written so far has been passed to the sink.
+   */
+  inline void flush()
+  {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_idle.wait(lock, [this]() { return m_front.empty() && !m_busy; });
+  }
+
+  inline std::size_t dropped() const
+  {
+    return m_dropped;
+  }
+
+  inline std::size_t written() const
+  {
+    return m_written;
+  }
+
+private:
+  inline void run()
+  {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+      m_wakeup.wait(lock, [this]() { return m_stop || !m_front.empty(); });
+      if (m_front.empty()) {
+        // Stopped, and nothing left to write.
+        break;
+      }
+
+      m_front.swap(m_back);
+      m_busy = true;
+      lock.unlock();
+
+      m_sink(m_back.data(), m_back.size());
+      m_written += m_back.size();
+      m_back.clear();
+
+      lock.lock();
+      m_busy = false;
+      m_idle.notify_all();
+    }
+  }
+
+  sink                      m_sink;
+  std::size_t               m_buffer_size;
+
+  std::mutex                m_mutex;
+  std::condition_variable   m_wakeup;
+  std::condition_variable   m_idle;
+  std::vector<byte>         m_front;
+  std::vector<byte>         m_back;
+  bool                      m_busy = false;
+  bool                      m_stop = false;
+
+  std::atomic<std::size_t>  m_dropped = 0;
+  std::atomic<std::size_t>  m_written = 0;
+
+  std::thread               m_thread;
+};
+
+} // namespace channeler::support
+
+#endif // guard
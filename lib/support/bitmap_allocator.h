@@ -0,0 +1,216 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_BITMAP_ALLOCATOR_H
+#define CHANNELER_SUPPORT_BITMAP_ALLOCATOR_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace channeler::support {
+
+/**
+ * Allocate identifiers from the full value range of a small unsigned integer
+ * type.
+ *
+ * Used identifiers are tracked in a bitmap of 64 bit words. A second level
+ * bitmap marks words that are entirely used, so that finding a free
+ * identifier takes a bounded number of word operations no matter how full the
+ * space is: for 16 bit identifiers, that's at most 17 summary and one bitmap
+ * word.
+ *
+ * allocate() takes a hint and returns the first free identifier at or after
+ * it, wrapping around at the end of the range. Passing a random hint keeps
+ * identifiers unpredictable.
+ */
+template <
+  typename idT
+>
+class bitmap_allocator
+{
+public:
+  static_assert(std::numeric_limits<idT>::is_integer
+      && !std::numeric_limits<idT>::is_signed
+      && sizeof(idT) <= 2,
+      "Bitmap allocation only makes sense for small unsigned types.");
+
+  using word_type = uint64_t;
+  static constexpr std::size_t WORD_BITS = 64;
+
+  static constexpr std::size_t CAPACITY =
+    std::size_t{1} << std::numeric_limits<idT>::digits;
+  static constexpr std::size_t WORDS =
+    (CAPACITY + WORD_BITS - 1) / WORD_BITS;
+  static constexpr std::size_t SUMMARY_WORDS =
+    (WORDS + WORD_BITS - 1) / WORD_BITS;
+
+  inline bitmap_allocator()
+    : m_words(WORDS, 0)
+    , m_full(SUMMARY_WORDS, 0)
+  {
+  }
+
+  inline bool test(idT id) const
+  {
+    return m_words[id / WORD_BITS] & bit(id % WORD_BITS);
+  }
+
+  /**
+   * Mark an identifier as used, e.g. because it was chosen elsewhere.
+   */
+  inline void set(idT id)
+  {
+    auto & word = m_words[id / WORD_BITS];
+    auto mask = bit(id % WORD_BITS);
+    if (word & mask) {
+      return;
+    }
+    word |= mask;
+    ++m_used;
+    if (word == FULL_WORD) {
+      auto w = id / WORD_BITS;
+      m_full[w / WORD_BITS] |= bit(w % WORD_BITS);
+    }
+  }
+
+  inline void reset(idT id)
+  {
+    auto & word = m_words[id / WORD_BITS];
+    auto mask = bit(id % WORD_BITS);
+    if (!(word & mask)) {
+      return;
+    }
+    word &= ~mask;
+    --m_used;
+    auto w = id / WORD_BITS;
+    m_full[w / WORD_BITS] &= ~bit(w % WORD_BITS);
+  }
+
+  /**
+   * Allocate the first free identifier at or after the hint. Returns false
+   * if all identifiers are in use.
+   */
+  inline bool allocate(idT & id, idT hint)
+  {
+    if (full()) {
+      return false;
+    }
+
+    // Try the hint's own word first, from the hint onwards; then any word
+    // with a free bit, found via the summary.
+    std::size_t w = hint / WORD_BITS;
+    auto free = ~m_words[w] & (FULL_WORD << (hint % WORD_BITS));
+    if (!free) {
+      w = next_free_word((w + 1) % WORDS);
+      free = ~m_words[w];
+    }
+
+    id = static_cast<idT>(w * WORD_BITS + lowest_bit(free));
+    set(id);
+    return true;
+  }
+
+  inline std::size_t size() const
+  {
+    return m_used;
+  }
+
+  inline bool full() const
+  {
+    return m_used >= CAPACITY;
+  }
+
+private:
+  static constexpr word_type FULL_WORD = ~word_type{0};
+
+  static constexpr word_type bit(std::size_t index)
+  {
+    return word_type{1} << index;
+  }
+
+  /**
+   * Index of the lowest set bit; the word must not be zero.
+   */
+  static inline std::size_t lowest_bit(word_type word)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index = 0;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    std::size_t index = 0;
+    while (!(word & 1)) {
+      word >>= 1;
+      ++index;
+    }
+    return index;
+#endif
+  }
+
+  /**
+   * Index of the first word at or after start (cyclically) that is not full.
+   * Must not be called when the bitmap is full.
+   */
+  inline std::size_t next_free_word(std::size_t start) const
+  {
+    std::size_t s = start / WORD_BITS;
+    auto candidates = ~m_full[s] & (FULL_WORD << (start % WORD_BITS));
+    for (std::size_t i = 0 ; i <= SUMMARY_WORDS ; ++i) {
+      candidates &= valid_summary_bits(s);
+      if (candidates) {
+        return s * WORD_BITS + lowest_bit(candidates);
+      }
+      s = (s + 1) % SUMMARY_WORDS;
+      candidates = ~m_full[s];
+    }
+    return 0; // Unreachable unless full
+  }
+
+  /**
+   * For types with fewer than 64 words, the summary word has bits that do
+   * not correspond to any word.
+   */
+  static constexpr word_type valid_summary_bits(std::size_t s)
+  {
+    return (WORDS - s * WORD_BITS >= WORD_BITS)
+      ? FULL_WORD
+      : (bit(WORDS - s * WORD_BITS) - 1);
+  }
+
+  std::vector<word_type>  m_words;
+  std::vector<word_type>  m_full;
+  std::size_t             m_used = 0;
+};
+
+} // namespace channeler::support
+
+#endif // guard
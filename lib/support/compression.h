@@ -0,0 +1,362 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_COMPRESSION_H
+#define CHANNELER_SUPPORT_COMPRESSION_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <vector>
+
+#if defined(CHANNELER_HAVE_LZ4)
+#include <lz4.h>
+#endif
+
+#if defined(CHANNELER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "wire.h"
+#include "siphash.h"
+
+namespace channeler::support {
+
+/**
+ * Compression of data message payloads.
+ *
+ * Both LZ4 and zstd are optional dependencies; the build defines
+ * CHANNELER_HAVE_LZ4 and CHANNELER_HAVE_ZSTD respectively if they are found.
+ * Without either, nothing is ever compressed, which is always a valid
+ * choice: compression is skipped for any payload that does not shrink.
+ *
+ * LZ4 is the default codec, as it is cheap on CPU. On small payloads it
+ * finds little to work with, however, so if a shared zstd dictionary is
+ * loaded, payloads up to a size threshold use zstd with that dictionary
+ * instead. Both peers must load the same dictionary; its dictionary_id()
+ * lets them check that before using it.
+ *
+ * Compressed payloads are framed as:
+ * - the codec (one Byte)
+ * - the original payload size (varint)
+ * - the compressed data
+ */
+enum compression_codec : uint8_t
+{
+  CODEC_NONE  = 0,
+  CODEC_LZ4   = 1,
+  CODEC_ZSTD  = 2,
+};
+
+
+class payload_compression
+{
+public:
+  static constexpr std::size_t DEFAULT_SMALL_SIZE = 256;
+  static constexpr int DEFAULT_ZSTD_LEVEL = 3;
+
+  inline explicit payload_compression(
+      std::size_t small_size = DEFAULT_SMALL_SIZE,
+      int zstd_level = DEFAULT_ZSTD_LEVEL)
+    : m_small_size{small_size}
+    , m_zstd_level{zstd_level}
+  {
+  }
+
+  inline ~payload_compression()
+  {
+#if defined(CHANNELER_HAVE_ZSTD)
+    ZSTD_freeCDict(m_cdict);
+    ZSTD_freeDDict(m_ddict);
+    ZSTD_freeCCtx(m_cctx);
+    ZSTD_freeDCtx(m_dctx);
+#endif
+  }
+
+  payload_compression(payload_compression const &) = delete;
+  payload_compression & operator=(payload_compression const &) = delete;
+
+
+  static inline bool available(compression_codec codec)
+  {
+    switch (codec) {
+#if defined(CHANNELER_HAVE_LZ4)
+      case CODEC_LZ4:
+        return true;
+#endif
+#if defined(CHANNELER_HAVE_ZSTD)
+      case CODEC_ZSTD:
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+
+  /**
+   * Load the shared zstd dictionary. Returns false if zstd is not available
+   * or the dictionary cannot be loaded.
+   */
+  inline bool set_dictionary(byte const * dict, std::size_t size)
+  {
+#if defined(CHANNELER_HAVE_ZSTD)
+    auto cdict = ZSTD_createCDict(dict, size, m_zstd_level);
+    auto ddict = ZSTD_createDDict(dict, size);
+    if (!cdict || !ddict) {
+      ZSTD_freeCDict(cdict);
+      ZSTD_freeDDict(ddict);
+      return false;
+    }
+    ZSTD_freeCDict(m_cdict);
+    ZSTD_freeDDict(m_ddict);
+    m_cdict = cdict;
+    m_ddict = ddict;
+
+    // Identify the dictionary by its contents; 0 means none.
+    auto hash = siphash24(siphash_key{}, dict, size);
+    m_dictionary_id = static_cast<uint32_t>(hash ^ (hash >> 32));
+    if (!m_dictionary_id) {
+      m_dictionary_id = 1;
+    }
+    return true;
+#else
+    (void) dict;
+    (void) size;
+    return false;
+#endif
+  }
+
+  inline bool has_dictionary() const
+  {
+#if defined(CHANNELER_HAVE_ZSTD)
+    return m_cdict != nullptr;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * Identifies the loaded dictionary, or is 0 if none is loaded.
+   */
+  inline uint32_t dictionary_id() const
+  {
+    return has_dictionary() ? m_dictionary_id : 0;
+  }
+
+
+  /**
+   * Select the codec for a payload of the given size, out of those the
+   * receiver can decode: LZ4, and/or zstd with the shared dictionary.
+   */
+  inline compression_codec select(std::size_t size, bool lz4 = true,
+      bool dictionary = true) const
+  {
+    if (dictionary && has_dictionary() && size <= m_small_size) {
+      return CODEC_ZSTD;
+    }
+    if (lz4 && available(CODEC_LZ4)) {
+      return CODEC_LZ4;
+    }
+    return CODEC_NONE;
+  }
+
+
+  /**
+   * Compress the payload with the selected codec, and frame it into out.
+   * Returns false - leaving out empty - if the framed result would not be
+   * smaller than the input, or if no codec is available.
+   */
+  inline bool compress(std::vector<byte> & out, byte const * in,
+      std::size_t size, bool lz4 = true, bool dictionary = true)
+  {
+    out.clear();
+    auto codec = select(size, lz4, dictionary);
+    if (CODEC_NONE == codec || !size) {
+      return false;
+    }
+
+    std::size_t header = 1 + varint_size(size);
+    if (header >= size) {
+      return false;
+    }
+
+    // There's no point in accepting compressed data that isn't smaller
+    // than the input, so that is all the room we give the codec.
+    std::size_t max = size - header;
+    out.resize(size);
+    out[0] = static_cast<byte>(codec);
+    encode_varint(out.data() + 1, header - 1, size);
+
+    auto used = compress_raw(codec, out.data() + header, max, in, size);
+    if (!used) {
+      out.clear();
+      return false;
+    }
+    out.resize(header + used);
+    return true;
+  }
+
+
+  /**
+   * Return the original size of a framed payload, or zero if the frame
+   * header cannot be decoded.
+   */
+  static inline std::size_t original_size(byte const * in, std::size_t size)
+  {
+    if (size < 2) {
+      return 0;
+    }
+    std::size_t original = 0;
+    if (!decode_varint(original, in + 1, size - 1)) {
+      return 0;
+    }
+    return original;
+  }
+
+
+  /**
+   * Decompress a framed payload into out. Returns the decompressed size,
+   * which is zero on any error, including insufficient output space.
+   */
+  inline std::size_t decompress(byte * out, std::size_t out_max,
+      byte const * in, std::size_t size)
+  {
+    auto original = original_size(in, size);
+    if (!original || original > out_max) {
+      return 0;
+    }
+    auto codec = static_cast<compression_codec>(in[0]);
+    std::size_t header = 1 + varint_size(original);
+
+    auto used = decompress_raw(codec, out, original, in + header,
+        size - header);
+    if (used != original) {
+      return 0;
+    }
+    return used;
+  }
+
+private:
+
+  inline std::size_t compress_raw(compression_codec codec, byte * out,
+      std::size_t out_max, byte const * in, std::size_t size)
+  {
+    switch (codec) {
+#if defined(CHANNELER_HAVE_LZ4)
+      case CODEC_LZ4:
+        {
+          auto ret = LZ4_compress_default(
+              reinterpret_cast<char const *>(in),
+              reinterpret_cast<char *>(out),
+              static_cast<int>(size), static_cast<int>(out_max));
+          return ret > 0 ? static_cast<std::size_t>(ret) : 0;
+        }
+#endif
+
+#if defined(CHANNELER_HAVE_ZSTD)
+      case CODEC_ZSTD:
+        {
+          if (!m_cctx) {
+            m_cctx = ZSTD_createCCtx();
+          }
+          std::size_t ret = 0;
+          if (m_cdict) {
+            ret = ZSTD_compress_usingCDict(m_cctx, out, out_max, in, size,
+                m_cdict);
+          }
+          else {
+            ret = ZSTD_compressCCtx(m_cctx, out, out_max, in, size,
+                m_zstd_level);
+          }
+          return ZSTD_isError(ret) ? 0 : ret;
+        }
+#endif
+
+      default:
+        (void) out;
+        (void) out_max;
+        (void) in;
+        (void) size;
+        return 0;
+    }
+  }
+
+
+  inline std::size_t decompress_raw(compression_codec codec, byte * out,
+      std::size_t out_max, byte const * in, std::size_t size)
+  {
+    switch (codec) {
+#if defined(CHANNELER_HAVE_LZ4)
+      case CODEC_LZ4:
+        {
+          auto ret = LZ4_decompress_safe(
+              reinterpret_cast<char const *>(in),
+              reinterpret_cast<char *>(out),
+              static_cast<int>(size), static_cast<int>(out_max));
+          return ret > 0 ? static_cast<std::size_t>(ret) : 0;
+        }
+#endif
+
+#if defined(CHANNELER_HAVE_ZSTD)
+      case CODEC_ZSTD:
+        {
+          if (!m_dctx) {
+            m_dctx = ZSTD_createDCtx();
+          }
+          std::size_t ret = 0;
+          if (m_ddict) {
+            ret = ZSTD_decompress_usingDDict(m_dctx, out, out_max, in, size,
+                m_ddict);
+          }
+          else {
+            ret = ZSTD_decompressDCtx(m_dctx, out, out_max, in, size);
+          }
+          return ZSTD_isError(ret) ? 0 : ret;
+        }
+#endif
+
+      default:
+        (void) out;
+        (void) out_max;
+        (void) in;
+        (void) size;
+        return 0;
+    }
+  }
+
+
+  std::size_t   m_small_size;
+  int           m_zstd_level;
+  uint32_t      m_dictionary_id = 0;
+
+#if defined(CHANNELER_HAVE_ZSTD)
+  ZSTD_CCtx *   m_cctx = nullptr;
+  ZSTD_DCtx *   m_dctx = nullptr;
+  ZSTD_CDict *  m_cdict = nullptr;
+  ZSTD_DDict *  m_ddict = nullptr;
+#endif
+};
+
+} // namespace channeler::support
+
+#endif // guard
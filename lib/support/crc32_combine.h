@@ -0,0 +1,159 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_CRC32_COMBINE_H
+#define CHANNELER_SUPPORT_CRC32_COMBINE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <cstdint>
+
+namespace channeler::support {
+
+/**
+ * Combine CRC32 checksums of adjacent buffers.
+ *
+ * Given crc(A) and crc(B), crc(A + B) can be computed without touching the
+ * data again: crc(A) is advanced by as many zero Bytes as B is long, and
+ * XORed with crc(B). The advance is a linear operator over GF(2), i.e. a
+ * 32x32 bit matrix, that depends only on the length of B.
+ *
+ * Building the operator costs O(log length) matrix squarings; applying it
+ * costs at most 32 XORs. When many checksums are combined with buffers of
+ * the same length, build it once and keep it around.
+ *
+ * The polynomial must be given in reflected form, e.g. 0x82F63B78 for
+ * CRC32C, which is what liberate's CRC32 implementations compute.
+ */
+template <
+  uint32_t REFLECTED_POLY
+>
+class crc32_shift
+{
+public:
+  inline explicit crc32_shift(std::size_t length)
+    : m_length{length}
+  {
+    // Start with the identity, then multiply in the operators for each bit
+    // set in the length. odd and even alternate between powers of two.
+    for (std::size_t n = 0 ; n < 32 ; ++n) {
+      m_op[n] = uint32_t{1} << n;
+    }
+    if (!length) {
+      return;
+    }
+
+    // Operator for a single zero bit.
+    uint32_t odd[32];
+    uint32_t even[32];
+    odd[0] = REFLECTED_POLY;
+    for (std::size_t n = 1 ; n < 32 ; ++n) {
+      odd[n] = uint32_t{1} << (n - 1);
+    }
+    square(even, odd); // two zero bits
+    square(odd, even); // four zero bits
+
+    // The first squaring in the loop yields one zero Byte.
+    std::size_t remaining = length;
+    uint32_t * current = even;
+    uint32_t * other = odd;
+    do {
+      square(current, other);
+      if (remaining & 1) {
+        compose(current);
+      }
+      remaining >>= 1;
+      auto tmp = current;
+      current = other;
+      other = tmp;
+    } while (remaining);
+  }
+
+  inline std::size_t length() const
+  {
+    return m_length;
+  }
+
+  /**
+   * Advance the checksum by length() zero Bytes.
+   */
+  inline uint32_t apply(uint32_t crc) const
+  {
+    return times(m_op, crc);
+  }
+
+  /**
+   * Return crc(A + B), given crc(A) and crc(B), where B is length() Bytes
+   * long.
+   */
+  inline uint32_t combine(uint32_t crc_a, uint32_t crc_b) const
+  {
+    return apply(crc_a) ^ crc_b;
+  }
+
+private:
+  static inline uint32_t times(uint32_t const * mat, uint32_t vec)
+  {
+    uint32_t sum = 0;
+    for (std::size_t n = 0 ; vec ; vec >>= 1, ++n) {
+      if (vec & 1) {
+        sum ^= mat[n];
+      }
+    }
+    return sum;
+  }
+
+  static inline void square(uint32_t * result, uint32_t const * mat)
+  {
+    for (std::size_t n = 0 ; n < 32 ; ++n) {
+      result[n] = times(mat, mat[n]);
+    }
+  }
+
+  inline void compose(uint32_t const * mat)
+  {
+    for (std::size_t n = 0 ; n < 32 ; ++n) {
+      m_op[n] = times(mat, m_op[n]);
+    }
+  }
+
+  std::size_t m_length;
+  uint32_t    m_op[32];
+};
+
+
+/**
+ * One-off combination; see crc32_shift for details.
+ */
+template <
+  uint32_t REFLECTED_POLY
+>
+inline uint32_t
+crc32_combine(uint32_t crc_a, uint32_t crc_b, std::size_t length_b)
+{
+  return crc32_shift<REFLECTED_POLY>{length_b}.combine(crc_a, crc_b);
+}
+
+} // namespace channeler::support
+
+#endif // guard
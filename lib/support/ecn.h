@@ -0,0 +1,206 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_ECN_H
+#define CHANNELER_SUPPORT_ECN_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "token_bucket.h"
+
+namespace channeler::support {
+
+/**
+ * Explicit Congestion Notification (ECN, RFC 3168) lets routers mark
+ * packets instead of dropping them when queues build up. Senders mark
+ * packets as ECN capable (ECT), routers set CE, receivers count the
+ * codepoints they see and feed the counts back, and senders slow down when
+ * the CE count rises - before any packet is lost.
+ *
+ * The codepoints are the two least significant bits of the IPv4 TOS or IPv6
+ * traffic class field.
+ */
+enum ecn_codepoint : uint8_t
+{
+  ECN_NOT_ECT = 0x00,
+  ECN_ECT1    = 0x01,
+  ECN_ECT0    = 0x02,
+  ECN_CE      = 0x03,
+};
+
+constexpr uint8_t ECN_MASK = 0x03;
+
+inline ecn_codepoint
+ecn_from_tos(int tos)
+{
+  return static_cast<ecn_codepoint>(tos & ECN_MASK);
+}
+
+
+/**
+ * Running counts of received ECN codepoints, as carried in
+ * MSG_ECN_FEEDBACK. Packets without ECT are not counted. The counts wrap
+ * around.
+ */
+struct ecn_counts
+{
+  uint32_t  ect0 = 0;
+  uint32_t  ect1 = 0;
+  uint32_t  ce = 0;
+
+  inline void record(ecn_codepoint codepoint)
+  {
+    switch (codepoint) {
+      case ECN_ECT0:
+        ++ect0;
+        break;
+
+      case ECN_ECT1:
+        ++ect1;
+        break;
+
+      case ECN_CE:
+        ++ce;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  inline uint32_t total() const
+  {
+    return ect0 + ect1 + ce;
+  }
+
+  inline bool operator==(ecn_counts const & other) const
+  {
+    return ect0 == other.ect0 && ect1 == other.ect1 && ce == other.ce;
+  }
+};
+
+
+/**
+ * A congestion controller driven by ECN feedback. It adjusts the rate of an
+ * egress token bucket: multiplicatively down when the peer reports new CE
+ * marks, additively up when it reports traffic without new marks (AIMD).
+ *
+ * As RFC 3168 requires, the rate is decreased at most once per round trip:
+ * marks reported within a round trip of a decrease were most likely caused
+ * by packets sent before it, and so belong to the same congestion event.
+ * They neither decrease nor increase the rate.
+ */
+class ecn_rate_controller
+{
+public:
+  /**
+   * The rate moves between min_rate and max_rate, in Bytes per second; it
+   * increases by increase per feedback, and is multiplied by decrease on
+   * congestion, at most once per rtt.
+   */
+  inline ecn_rate_controller(token_bucket & bucket, std::size_t min_rate,
+      std::size_t max_rate, std::size_t increase, double decrease = 0.5,
+      token_bucket::duration rtt = std::chrono::milliseconds{100})
+    : m_bucket{bucket}
+    , m_min_rate{min_rate}
+    , m_max_rate{max_rate}
+    , m_increase{increase}
+    , m_decrease{decrease}
+    , m_rtt{rtt}
+  {
+  }
+
+  /**
+   * Update the round trip time, e.g. from a measurement.
+   */
+  inline void set_rtt(token_bucket::duration rtt)
+  {
+    m_rtt = rtt;
+  }
+
+  inline token_bucket::duration rtt() const
+  {
+    return m_rtt;
+  }
+
+  /**
+   * Process the peer's feedback. Returns true if it decreased the rate.
+   */
+  inline bool on_feedback(ecn_counts const & counts,
+      token_bucket::time_point const & now = token_bucket::clock_type::now())
+  {
+    // Unsigned differences take care of wrap around.
+    uint32_t new_ce = counts.ce - m_last.ce;
+    uint32_t new_total = counts.total() - m_last.total();
+    m_last = counts;
+
+    std::size_t rate = m_bucket.rate();
+    bool congested = new_ce > 0;
+    if (congested) {
+      if (m_decreased && now < m_last_decrease + m_rtt) {
+        return false;
+      }
+      rate = static_cast<std::size_t>(rate * m_decrease);
+      ++m_congestion_events;
+      m_decreased = true;
+      m_last_decrease = now;
+    }
+    else if (new_total > 0) {
+      rate += m_increase;
+    }
+    else {
+      return false;
+    }
+
+    rate = std::clamp(rate, m_min_rate, m_max_rate);
+    m_bucket.set_rate(rate, m_bucket.burst(), now);
+    return congested;
+  }
+
+  /**
+   * The number of congestion events, i.e. of rate decreases.
+   */
+  inline std::size_t congestion_events() const
+  {
+    return m_congestion_events;
+  }
+
+private:
+  token_bucket &            m_bucket;
+  std::size_t               m_min_rate;
+  std::size_t               m_max_rate;
+  std::size_t               m_increase;
+  double                    m_decrease;
+  token_bucket::duration    m_rtt;
+  ecn_counts                m_last = {};
+  std::size_t               m_congestion_events = 0;
+  bool                      m_decreased = false;
+  token_bucket::time_point  m_last_decrease = {};
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -41,9 +41,8 @@ namespace channeler::support {
 inline std::size_t
 backoff_multiplier(std::size_t const & collisions)
 {
-  random_bits<std::size_t> rng;
   std::size_t clamp = exp2(collisions) - 1;
-  auto rand = rng.get_factor();
+  auto rand = random_bits<std::size_t>{}.get_factor();
   auto ret = std::nearbyint(rand * clamp);
   return ret;
 }
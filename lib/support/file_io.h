@@ -0,0 +1,155 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_FILE_IO_H
+#define CHANNELER_SUPPORT_FILE_IO_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#if !defined(CHANNELER_POSIX)
+#error File I/O support requires POSIX pread() and pwrite().
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <channeler/error.h>
+
+namespace channeler::support {
+
+/**
+ * Read exactly size Bytes at offset from the file descriptor, retrying on
+ * short reads and interrupts. Reading past the end of the file is an error.
+ */
+inline error_t
+pread_full(int fd, byte * buf, std::size_t size, off_t offset)
+{
+  while (size > 0) {
+    auto ret = ::pread(fd, buf, size, offset);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ERR_READ;
+    }
+    if (ret == 0) {
+      return ERR_READ;
+    }
+    buf += ret;
+    size -= ret;
+    offset += ret;
+  }
+  return ERR_SUCCESS;
+}
+
+
+/**
+ * Write exactly size Bytes at offset to the file descriptor, retrying on
+ * short writes and interrupts.
+ */
+inline error_t
+pwrite_full(int fd, byte const * buf, std::size_t size, off_t offset)
+{
+  while (size > 0) {
+    auto ret = ::pwrite(fd, buf, size, offset);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ERR_WRITE;
+    }
+    buf += ret;
+    size -= ret;
+    offset += ret;
+  }
+  return ERR_SUCCESS;
+}
+
+
+/**
+ * The fd_source reads a file for internal::api::channel_send_file() from a
+ * file descriptor.
+ */
+struct fd_source
+{
+  int fd;
+
+  inline error_t operator()(uint64_t offset, byte * buf, std::size_t size)
+  {
+    return pread_full(fd, buf, size, static_cast<off_t>(offset));
+  }
+};
+
+
+/**
+ * Data sinks receive a channel's file data in chunks, each with the offset
+ * at which it belongs. Chunks may arrive in any order, or more than once,
+ * so sinks write at the offset rather than appending. The fd_sink writes
+ * to a file descriptor; end is the end of the furthest chunk written.
+ */
+struct fd_sink
+{
+  int       fd;
+  uint64_t  end = 0;
+
+  inline error_t operator()(uint64_t offset, byte const * data,
+      std::size_t size)
+  {
+    auto err = pwrite_full(fd, data, size, static_cast<off_t>(offset));
+    if (ERR_SUCCESS == err) {
+      end = std::max(end, offset + size);
+    }
+    return err;
+  }
+};
+
+
+/**
+ * The memory_sink copies into a fixed memory region, e.g. a mapped file.
+ * Data beyond the end of the region is an error.
+ */
+struct memory_sink
+{
+  byte *      region;
+  std::size_t size;
+  uint64_t    end = 0;
+
+  inline error_t operator()(uint64_t offset, byte const * data,
+      std::size_t data_size)
+  {
+    if (offset > size || data_size > size - offset) {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+    std::memcpy(region + offset, data, data_size);
+    end = std::max(end, offset + data_size);
+    return ERR_SUCCESS;
+  }
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -0,0 +1,242 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_KEEPALIVE_H
+#define CHANNELER_SUPPORT_KEEPALIVE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <channeler/error.h>
+
+#include "timeouts.h"
+
+namespace channeler::support {
+
+/**
+ * Keepalives keep NAT bindings of idle connections open. A node may have a
+ * great many connections, so instead of one timer per connection, a single
+ * scheduler per node tracks all of them, and is advanced by the node's
+ * event loop like the timeouts class.
+ *
+ * Connections are kept in a timing wheel with the given number of slots per
+ * keepalive interval. Advancing the scheduler only visits the slots that
+ * became due, so the cost of a tick depends on the number of connections
+ * due, not the total number of connections.
+ *
+ * Real traffic on a connection is recorded with touch(), which just stores
+ * the current time. When a connection comes due, and there was traffic
+ * within the last interval, it is merely moved to a later slot; only
+ * connections that were idle for a whole interval are probed.
+ *
+ * Time is relative, as in the timeouts class: the scheduler's clock starts
+ * at zero, and advances by the durations passed to advance().
+ */
+template <
+  typename keyT,
+  typename hashT = std::hash<keyT>
+>
+class keepalive_scheduler
+{
+public:
+  using duration = timeouts::duration;
+
+  inline explicit keepalive_scheduler(duration interval,
+      std::size_t slots = 64)
+    : m_interval{interval}
+    , m_granularity{std::max(interval
+        / static_cast<duration::rep>(std::max<std::size_t>(slots, 1)),
+        duration{1})}
+  {
+    if (interval.count() <= 0) {
+      throw_exception(ERR_UNEXPECTED, "Keepalive interval must be positive.");
+    }
+    // Due slots lie at most one interval (rounded up) ahead of the current
+    // slot, so they never wrap around onto the current one.
+    m_wheel.resize(slot_of(m_interval) + 2);
+  }
+
+  /**
+   * Add a connection; it is due for a probe one interval from now. Returns
+   * false if the connection is already known.
+   */
+  inline bool add(keyT const & key)
+  {
+    auto [iter, inserted] = m_entries.insert({key, entry{}});
+    if (!inserted) {
+      return false;
+    }
+    iter->second.last_activity = m_now;
+    schedule(iter->first, iter->second, m_now + m_interval);
+    return true;
+  }
+
+  /**
+   * Remove a connection. Its wheel slot is cleaned up lazily.
+   */
+  inline void remove(keyT const & key)
+  {
+    m_entries.erase(key);
+  }
+
+  /**
+   * Record traffic on the connection, which suppresses the next probe.
+   */
+  inline void touch(keyT const & key)
+  {
+    auto iter = m_entries.find(key);
+    if (iter != m_entries.end()) {
+      iter->second.last_activity = m_now;
+    }
+  }
+
+  /**
+   * Advance the clock by the elapsed duration, and invoke probe with the key
+   * of every connection that was idle for a whole interval. Sending the
+   * probe counts as traffic. Returns the number of probes.
+   */
+  template <
+    typename probeT
+  >
+  inline std::size_t advance(duration const & elapsed, probeT && probe)
+  {
+    m_now += elapsed;
+    auto target = slot_of(m_now);
+
+    // Past one revolution, every slot has been visited; entries that are not
+    // yet due remain in their slots.
+    auto first = m_slot + 1;
+    if (target >= first + m_wheel.size()) {
+      first = target - m_wheel.size() + 1;
+    }
+
+    // Entries rescheduled while processing go into slots after the target.
+    m_slot = std::max(m_slot, target);
+
+    std::size_t probes = 0;
+    for (auto slot = first ; slot <= target ; ++slot) {
+      probes += process(slot, target, probe);
+    }
+    return probes;
+  }
+
+  /**
+   * The resolution of the scheduler; advancing it by less than this does not
+   * produce probes.
+   */
+  inline duration granularity() const
+  {
+    return m_granularity;
+  }
+
+  inline duration interval() const
+  {
+    return m_interval;
+  }
+
+  inline std::size_t size() const
+  {
+    return m_entries.size();
+  }
+
+private:
+  struct entry
+  {
+    duration    last_activity = {};
+    std::size_t due_slot = 0;
+  };
+
+  inline std::size_t slot_of(duration const & time) const
+  {
+    // Round up, so that nothing is probed before it is due.
+    return (time.count() + m_granularity.count() - 1) / m_granularity.count();
+  }
+
+  inline void schedule(keyT const & key, entry & ent, duration const & due)
+  {
+    ent.due_slot = std::max(slot_of(due), m_slot + 1);
+    m_wheel[ent.due_slot % m_wheel.size()].push_back(key);
+  }
+
+  template <
+    typename probeT
+  >
+  inline std::size_t process(std::size_t slot, std::size_t target,
+      probeT & probe)
+  {
+    auto & bucket = m_wheel[slot % m_wheel.size()];
+    if (bucket.empty()) {
+      return 0;
+    }
+
+    std::vector<keyT> keys;
+    keys.swap(bucket);
+
+    std::size_t probes = 0;
+    for (auto & key : keys) {
+      auto iter = m_entries.find(key);
+      if (iter == m_entries.end()) {
+        // Removed.
+        continue;
+      }
+      auto & ent = iter->second;
+      if (ent.due_slot % m_wheel.size() != slot % m_wheel.size()) {
+        // Stale; the entry was removed and added again elsewhere.
+        continue;
+      }
+      if (ent.due_slot > target) {
+        // Not yet due; the slot was visited early.
+        bucket.push_back(key);
+        continue;
+      }
+
+      auto due = ent.last_activity + m_interval;
+      if (due > m_now) {
+        // Traffic since the entry was scheduled; no probe necessary.
+        schedule(iter->first, ent, due);
+        continue;
+      }
+
+      ent.last_activity = m_now;
+      schedule(iter->first, ent, m_now + m_interval);
+      probe(iter->first);
+      ++probes;
+    }
+    return probes;
+  }
+
+  duration                                    m_interval;
+  duration                                    m_granularity;
+  duration                                    m_now = {};
+  std::size_t                                 m_slot = 0;
+  std::vector<std::vector<keyT>>              m_wheel = {};
+  std::unordered_map<keyT, entry, hashT>      m_entries = {};
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -26,43 +26,194 @@
 
 #include <channeler.h>
 
-#include <random>
-#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <type_traits>
+
+#if defined(CHANNELER_WIN32)
+#  include <bcrypt.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) \
+  || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__ANDROID__)
+#  include <stdlib.h>
+#elif defined(__linux__)
+#  include <sys/random.h>
+#else
+#  error No secure random source is known for this platform.
+#endif
+
+#include <channeler/error.h>
 
 namespace channeler::support {
 
 /**
- * Return a random value of type T.
+ * There are two kinds of random values in channeler:
+ *
+ * - Values that merely need to be well distributed, such as backoff
+ *   multipliers or channel identifiers. These come from a fast, thread-local
+ *   generator via random_bits<T>.
+ * - Values that must not be predictable by an attacker. These come from the
+ *   operating system's secure random source via secure_random_bits<T> or
+ *   secure_random_fill(): getrandom() on Linux, arc4random_buf() on the BSDs,
+ *   macOS and Android, and BCryptGenRandom() on Windows.
+ *
+ * std::random_device is not used, because it is not guaranteed to be
+ * non-deterministic.
+ *
+ * Neither requires any per-call setup.
+ */
+
+/**
+ * Fill a buffer from the operating system's secure random source. There is
+ * no sensible fallback if that fails, so failures throw - or abort, without
+ * exception support.
+ */
+inline void
+secure_random_fill(byte * buffer, std::size_t size)
+{
+#if defined(CHANNELER_WIN32)
+  auto status = ::BCryptGenRandom(nullptr, reinterpret_cast<PUCHAR>(buffer),
+      static_cast<ULONG>(size), BCRYPT_USE_SYSTEM_PREFERRED_RNG);
+  if (!BCRYPT_SUCCESS(status)) {
+    throw_exception(ERR_READ, "BCryptGenRandom() failed.");
+  }
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) \
+  || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__ANDROID__)
+  ::arc4random_buf(buffer, size);
+#else
+  // Large requests may be served partially, and interrupted by signals.
+  while (size > 0) {
+    auto ret = ::getrandom(buffer, size, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_exception(ERR_READ, "getrandom() failed.");
+    }
+    buffer += ret;
+    size -= ret;
+  }
+#endif
+}
+
+
+/**
+ * xoshiro256** by Blackman and Vigna; small state, fast, and good enough for
+ * anything that is not security relevant. Satisfies the
+ * UniformRandomBitGenerator requirements.
+ */
+class xoshiro256ss
+{
+public:
+  using result_type = uint64_t;
+
+  inline explicit xoshiro256ss(uint64_t seed)
+  {
+    // Expand the seed with splitmix64, as recommended by the authors; this
+    // also guarantees a non-zero state.
+    for (auto & s : m_state) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s = z ^ (z >> 31);
+    }
+  }
+
+  static constexpr result_type min()
+  {
+    return 0;
+  }
+
+  static constexpr result_type max()
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  inline result_type operator()()
+  {
+    auto result = rotl(m_state[1] * 5, 7) * 9;
+    auto t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    return result;
+  }
+
+private:
+  static constexpr uint64_t rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t m_state[4];
+};
+
+
+/**
+ * The thread's fast generator, seeded once from the secure random source on
+ * first use.
+ */
+inline xoshiro256ss &
+thread_generator()
+{
+  thread_local xoshiro256ss generator{[]
+    {
+      uint64_t seed;
+      secure_random_fill(reinterpret_cast<byte *>(&seed), sizeof(seed));
+      return seed;
+    }()
+  };
+  return generator;
+}
+
+
+/**
+ * Return a random value of type T from the thread's fast generator.
  */
 template <typename T>
 struct random_bits
 {
-  std::default_random_engine generator;
-  std::uniform_int_distribution<T> distribution;
-
-  inline random_bits()
-    : generator{
-        static_cast<std::default_random_engine::result_type>(
-            std::chrono::system_clock::now().time_since_epoch().count()
-        )
-      }
-    , distribution{
-        std::numeric_limits<T>::min(),
-        std::numeric_limits<T>::max()
-      }
+  static_assert(std::is_integral<T>::value && sizeof(T) <= sizeof(uint64_t),
+      "random_bits only produces integers of up to 64 bits.");
+
+  inline T get()
   {
+    return static_cast<T>(thread_generator()());
   }
 
-  T get()
+  /**
+   * A factor in [0, 1), with the full 53 bits of double precision.
+   */
+  inline double get_factor()
   {
-    return distribution(generator);
+    return static_cast<double>(thread_generator()() >> 11) * 0x1.0p-53;
   }
+};
+
+
+/**
+ * Return a random value of type T from the platform's secure random
+ * source.
+ */
+template <typename T>
+struct secure_random_bits
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+      "secure_random_bits can only produce trivially copyable types.");
 
-  double get_factor()
+  inline T get()
   {
-    return static_cast<long double>(get()) /
-      (std::numeric_limits<T>::max() - std::numeric_limits<T>::min());
+    T result;
+    secure_random_fill(reinterpret_cast<byte *>(&result), sizeof(T));
+    return result;
   }
 };
 
@@ -0,0 +1,127 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_SIPHASH_H
+#define CHANNELER_SUPPORT_SIPHASH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <cstdint>
+
+namespace channeler::support {
+
+/**
+ * 128 bit SipHash key, as two little endian 64 bit halves.
+ */
+struct siphash_key
+{
+  uint64_t k0 = 0;
+  uint64_t k1 = 0;
+
+  /**
+   * Build a key from arbitrary secret bytes. Up to 16 Bytes are used as
+   * they are (zero padded); longer secrets are XOR-folded into the key.
+   */
+  static inline siphash_key
+  from_bytes(byte const * secret, std::size_t size)
+  {
+    siphash_key key;
+    for (std::size_t i = 0 ; i < size ; ++i) {
+      auto shift = (i % 8) * 8;
+      auto val = static_cast<uint64_t>(secret[i]) << shift;
+      if ((i % 16) < 8) {
+        key.k0 ^= val;
+      }
+      else {
+        key.k1 ^= val;
+      }
+    }
+    return key;
+  }
+};
+
+
+/**
+ * SipHash-2-4, a keyed pseudo-random function that is suitable as a MAC for
+ * short inputs. See Aumasson & Bernstein, "SipHash: a fast short-input PRF".
+ */
+inline uint64_t
+siphash24(siphash_key const & key, byte const * data, std::size_t size)
+{
+  uint64_t v0 = key.k0 ^ 0x736f6d6570736575ULL;
+  uint64_t v1 = key.k1 ^ 0x646f72616e646f6dULL;
+  uint64_t v2 = key.k0 ^ 0x6c7967656e657261ULL;
+  uint64_t v3 = key.k1 ^ 0x7465646279746573ULL;
+
+  auto rotl = [](uint64_t x, int b) -> uint64_t
+  {
+    return (x << b) | (x >> (64 - b));
+  };
+
+  auto round = [&]()
+  {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+  };
+
+  auto load_le = [](byte const * p, std::size_t len) -> uint64_t
+  {
+    uint64_t res = 0;
+    for (std::size_t i = 0 ; i < len ; ++i) {
+      res |= static_cast<uint64_t>(p[i]) << (i * 8);
+    }
+    return res;
+  };
+
+  // Full 64 bit words
+  std::size_t full = size - (size % 8);
+  for (std::size_t i = 0 ; i < full ; i += 8) {
+    uint64_t m = load_le(data + i, 8);
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+
+  // Last word carries the remaining bytes and the input length.
+  uint64_t b = (static_cast<uint64_t>(size) << 56) | load_le(data + full, size % 8);
+  v3 ^= b;
+  round();
+  round();
+  v0 ^= b;
+
+  // Finalization
+  v2 ^= 0xff;
+  round();
+  round();
+  round();
+  round();
+
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+} // namespace channeler::support
+
+#endif // guard
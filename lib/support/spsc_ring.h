@@ -0,0 +1,143 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_SPSC_RING_H
+#define CHANNELER_SUPPORT_SPSC_RING_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <atomic>
+
+#include <channeler/error.h>
+
+namespace channeler::support {
+
+/**
+ * Lock-free single producer, single consumer ring of 32 bit values.
+ *
+ * The ring does not own its memory: its indices live in a spsc_ring_header,
+ * and its entries in a separate array. That way, the same ring can be used
+ * in process memory or in a region shared between processes, where each
+ * side constructs its own spsc_ring over the shared header and entries.
+ *
+ * Head and tail are free-running counters; the capacity must be a power of
+ * two, so that wrap-around is a mask.
+ */
+struct spsc_ring_header
+{
+  // Written by the consumer
+  alignas(64) std::atomic<uint32_t> head;
+  // Written by the producer
+  alignas(64) std::atomic<uint32_t> tail;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+    "Ring indices must be lock-free to be usable across processes.");
+
+
+class spsc_ring
+{
+public:
+  inline spsc_ring(spsc_ring_header * header, uint32_t * entries,
+      uint32_t capacity)
+    : m_header{header}
+    , m_entries{entries}
+    , m_capacity{capacity}
+    , m_mask{capacity - 1}
+  {
+    if (!m_capacity || (m_capacity & m_mask)) {
+      throw_exception(ERR_UNEXPECTED, "Ring capacity must be a power of two.");
+    }
+  }
+
+  /**
+   * Reset indices; only valid while neither side uses the ring.
+   */
+  inline void clear()
+  {
+    m_header->head.store(0);
+    m_header->tail.store(0);
+  }
+
+  /**
+   * Producer: append a value. Returns false if the ring is full.
+   *
+   * The tail is published with sequential consistency, so that a producer
+   * checking size() afterwards and a consumer checking for an empty ring
+   * after advancing the head cannot both miss each other's update. This is
+   * what allows coalescing wakeups (see shm_transport).
+   */
+  inline bool push(uint32_t value)
+  {
+    auto tail = m_header->tail.load(std::memory_order_relaxed);
+    auto head = m_header->head.load(std::memory_order_acquire);
+    if (tail - head >= m_capacity) {
+      return false;
+    }
+    m_entries[tail & m_mask] = value;
+    m_header->tail.store(tail + 1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  /**
+   * Consumer: remove the oldest value. Returns false if the ring is empty.
+   */
+  inline bool pop(uint32_t & value)
+  {
+    auto head = m_header->head.load(std::memory_order_relaxed);
+    auto tail = m_header->tail.load(std::memory_order_seq_cst);
+    if (head == tail) {
+      return false;
+    }
+    value = m_entries[head & m_mask];
+    m_header->head.store(head + 1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  inline uint32_t size() const
+  {
+    auto tail = m_header->tail.load(std::memory_order_seq_cst);
+    auto head = m_header->head.load(std::memory_order_seq_cst);
+    return tail - head;
+  }
+
+  inline bool empty() const
+  {
+    return size() == 0;
+  }
+
+  inline uint32_t capacity() const
+  {
+    return m_capacity;
+  }
+
+private:
+  spsc_ring_header *  m_header;
+  uint32_t *          m_entries;
+  uint32_t            m_capacity;
+  uint32_t            m_mask;
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -180,6 +180,7 @@ public:
       // return it.
       if (entry.first <= elapsed) {
         result.push_back(entry.second);
+        m_tags.erase(entry.second);
       }
       else {
         // Otherwise, the entry has to remain - but we adjust the expectation
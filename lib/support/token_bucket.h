@@ -0,0 +1,166 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_TOKEN_BUCKET_H
+#define CHANNELER_SUPPORT_TOKEN_BUCKET_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace channeler::support {
+
+/**
+ * A token bucket rate limiter for egress traffic. Tokens are Bytes; they
+ * accrue at the given rate (in Bytes per second) up to the burst size, and
+ * releasing a packet consumes as many tokens as the packet is large.
+ *
+ * Buckets do not queue anything; callers keep packets where they already
+ * are (in the channel's egress buffer), and ask the bucket whether and when
+ * they may be released. The same bucket can be shared between several
+ * channels or connections to limit their combined rate, e.g. per peer.
+ *
+ * A packet larger than the burst size can never accrue enough tokens; it is
+ * released when the bucket is full instead, leaving the bucket in debt.
+ */
+class token_bucket
+{
+public:
+  using clock_type = std::chrono::steady_clock;
+  using time_point = clock_type::time_point;
+  using duration = clock_type::duration;
+
+  /**
+   * The bucket starts out full.
+   */
+  inline token_bucket(std::size_t rate, std::size_t burst,
+      time_point const & now = clock_type::now())
+    : m_rate{rate}
+    , m_burst{burst}
+    , m_tokens{static_cast<double>(burst)}
+    , m_last{now}
+  {
+  }
+
+  /**
+   * Change rate and burst size. Tokens accrued so far at the previous rate
+   * are kept, up to the new burst size.
+   */
+  inline void set_rate(std::size_t rate, std::size_t burst,
+      time_point const & now = clock_type::now())
+  {
+    refill(now);
+    m_rate = rate;
+    m_burst = burst;
+    m_tokens = std::min(m_tokens, static_cast<double>(m_burst));
+  }
+
+  inline std::size_t rate() const
+  {
+    return m_rate;
+  }
+
+  inline std::size_t burst() const
+  {
+    return m_burst;
+  }
+
+  /**
+   * The number of tokens currently available.
+   */
+  inline std::size_t available(time_point const & now = clock_type::now())
+  {
+    refill(now);
+    return m_tokens > 0 ? static_cast<std::size_t>(m_tokens) : 0;
+  }
+
+  /**
+   * True if size Bytes may be released now; does not consume tokens.
+   */
+  inline bool allows(std::size_t size,
+      time_point const & now = clock_type::now())
+  {
+    refill(now);
+    return m_tokens >= required(size);
+  }
+
+  /**
+   * Consume tokens for size Bytes, if they may be released now. Returns
+   * false, and consumes nothing, otherwise.
+   */
+  inline bool consume(std::size_t size,
+      time_point const & now = clock_type::now())
+  {
+    if (!allows(size, now)) {
+      return false;
+    }
+    m_tokens -= static_cast<double>(size);
+    return true;
+  }
+
+  /**
+   * The time until size Bytes may be released; zero if they may be released
+   * now, and duration::max() if the bucket does not refill at all.
+   */
+  inline duration delay(std::size_t size,
+      time_point const & now = clock_type::now())
+  {
+    refill(now);
+    auto missing = required(size) - m_tokens;
+    if (missing <= 0) {
+      return duration::zero();
+    }
+    if (!m_rate) {
+      return duration::max();
+    }
+    std::chrono::duration<double> seconds{missing / m_rate};
+    return std::chrono::ceil<duration>(seconds);
+  }
+
+private:
+  inline double required(std::size_t size) const
+  {
+    return static_cast<double>(std::min(size, m_burst));
+  }
+
+  inline void refill(time_point const & now)
+  {
+    if (now <= m_last) {
+      return;
+    }
+    std::chrono::duration<double> elapsed = now - m_last;
+    m_tokens = std::min(static_cast<double>(m_burst),
+        m_tokens + elapsed.count() * m_rate);
+    m_last = now;
+  }
+
+  std::size_t m_rate;
+  std::size_t m_burst;
+  double      m_tokens;
+  time_point  m_last;
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -0,0 +1,85 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_VIRTUAL_CLOCK_H
+#define CHANNELER_SUPPORT_VIRTUAL_CLOCK_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <thread>
+
+#include "timeouts.h"
+
+namespace channeler::support {
+
+/**
+ * A clock for the timeouts subsystem that only advances when it is told to
+ * sleep. Passing its sleep_function() to a node makes timeout processing
+ * deterministic, which is what tests and trace replays need.
+ *
+ * If real time pacing is requested, sleeping also waits for the given
+ * duration on the wall clock, but the clock still advances by exactly the
+ * amount requested.
+ */
+class virtual_clock
+{
+public:
+  using duration = timeouts::duration;
+
+  inline explicit virtual_clock(bool realtime = false)
+    : m_realtime{realtime}
+  {
+  }
+
+  inline duration now() const
+  {
+    return m_now;
+  }
+
+  inline duration sleep(duration amount)
+  {
+    if (m_realtime && amount.count() > 0) {
+      std::this_thread::sleep_for(amount);
+    }
+    m_now += amount;
+    return amount;
+  }
+
+  inline timeouts::sleep_function sleep_function()
+  {
+    return [this](duration amount) { return sleep(amount); };
+  }
+
+  inline bool realtime() const
+  {
+    return m_realtime;
+  }
+
+private:
+  bool      m_realtime;
+  duration  m_now = {};
+};
+
+} // namespace channeler::support
+
+#endif // guard
@@ -0,0 +1,205 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_SUPPORT_WIRE_H
+#define CHANNELER_SUPPORT_WIRE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <build-config.h>
+
+#include <channeler.h>
+
+#include <cstring>
+#include <type_traits>
+
+#include <liberate/serialization/varint.h>
+
+namespace channeler::support {
+
+/**
+ * Codec for the integers in channeler's wire formats.
+ *
+ * Unlike the liberate serialization functions, the fixed width functions
+ * here do *not* check bounds; callers check once per message that the
+ * whole layout fits, and then read or write each field unconditionally.
+ * Integers are big endian on the wire.
+ */
+
+namespace detail {
+
+template <typename T>
+inline T
+byteswap(T value)
+{
+  static_assert(std::is_unsigned<T>::value, "Only unsigned types can be swapped.");
+  if constexpr (sizeof(T) == 1) {
+    return value;
+  }
+#if defined(__GNUC__) || defined(__clang__)
+  else if constexpr (sizeof(T) == 2) {
+    return __builtin_bswap16(value);
+  }
+  else if constexpr (sizeof(T) == 4) {
+    return __builtin_bswap32(value);
+  }
+  else if constexpr (sizeof(T) == 8) {
+    return __builtin_bswap64(value);
+  }
+#endif
+  else {
+    T result = 0;
+    for (std::size_t i = 0 ; i < sizeof(T) ; ++i) {
+      result = static_cast<T>((result << 8) | (value & 0xff));
+      value = static_cast<T>(value >> 8);
+    }
+    return result;
+  }
+}
+
+template <typename T>
+inline T
+to_big_endian(T value)
+{
+#if defined(CHANNELER_BIGENDIAN)
+  return value;
+#else
+  return byteswap(value);
+#endif
+}
+
+} // namespace detail
+
+
+/**
+ * Load a big endian integer from a possibly unaligned buffer.
+ */
+template <typename T>
+inline T
+load_be(byte const * buf)
+{
+  using unsigned_type = std::make_unsigned_t<T>;
+  unsigned_type tmp;
+  std::memcpy(&tmp, buf, sizeof(tmp));
+  return static_cast<T>(detail::to_big_endian(tmp));
+}
+
+
+/**
+ * Store an integer big endian into a possibly unaligned buffer.
+ */
+template <typename T>
+inline void
+store_be(byte * buf, T value)
+{
+  using unsigned_type = std::make_unsigned_t<T>;
+  auto tmp = detail::to_big_endian(static_cast<unsigned_type>(value));
+  std::memcpy(buf, &tmp, sizeof(tmp));
+}
+
+
+
+/**
+ * A fixed sequence of integer fields, i.e. the payload layout of a constant
+ * size message. The size is known at compile time, so the entire layout can
+ * be bounds checked at once.
+ */
+template <typename... fieldsT>
+struct fixed_layout
+{
+  static constexpr std::size_t size = (sizeof(fieldsT) + ... + 0);
+
+  /**
+   * Read all fields; the buffer must hold at least size bytes.
+   */
+  static inline void read(byte const * buf, fieldsT &... fields)
+  {
+    ((fields = load_be<fieldsT>(buf), buf += sizeof(fieldsT)), ...);
+  }
+
+  /**
+   * Write all fields; the buffer must hold at least size bytes.
+   */
+  static inline void write(byte * buf, fieldsT const &... fields)
+  {
+    ((store_be<fieldsT>(buf, fields), buf += sizeof(fieldsT)), ...);
+  }
+};
+
+
+
+/**
+ * Varints in channeler headers are message types and payload sizes, which
+ * are almost always below 128 and so take a single byte. Those are handled
+ * inline; anything larger is passed on to liberate.
+ *
+ * All functions return the number of bytes used, or zero on failure.
+ */
+constexpr std::size_t VARINT_SINGLE_BYTE_LIMIT = 0x80;
+
+inline std::size_t
+varint_size(std::size_t value)
+{
+  if (value < VARINT_SINGLE_BYTE_LIMIT) {
+    return 1;
+  }
+  return ::liberate::serialization::serialized_size(
+      static_cast<::liberate::types::varint>(value));
+}
+
+
+inline std::size_t
+decode_varint(std::size_t & value, byte const * buf, std::size_t max)
+{
+  if (max > 0) {
+    auto first = static_cast<std::size_t>(buf[0]);
+    if (first < VARINT_SINGLE_BYTE_LIMIT) {
+      value = first;
+      return 1;
+    }
+  }
+
+  ::liberate::types::varint tmp;
+  auto used = ::liberate::serialization::deserialize_varint(tmp, buf, max);
+  if (used) {
+    value = static_cast<std::size_t>(tmp);
+  }
+  return used;
+}
+
+
+inline std::size_t
+encode_varint(byte * buf, std::size_t max, std::size_t value)
+{
+  if (value < VARINT_SINGLE_BYTE_LIMIT) {
+    if (!max) {
+      return 0;
+    }
+    buf[0] = static_cast<byte>(value);
+    return 1;
+  }
+  return ::liberate::serialization::serialize_varint(buf, max,
+      static_cast<::liberate::types::varint>(value));
+}
+
+} // namespace channeler::support
+
+#endif // guard
@@ -0,0 +1,680 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_TRANSPORT_AF_XDP_H
+#define CHANNELER_TRANSPORT_AF_XDP_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#if !defined(CHANNELER_HAVE_AF_XDP)
+#error The AF_XDP transport requires Linux AF_XDP and BPF headers.
+#endif
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <channeler/channelid.h>
+#include <channeler/error.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+namespace channeler::transport {
+
+/**
+ * Where an AF_XDP transport sends from and to: the interface and queue to
+ * attach to, and the Ethernet and IPv4 addresses and UDP ports of either
+ * end. Addresses and ports are in network byte order, as in sockaddr_in.
+ */
+struct af_xdp_config
+{
+  int                       ifindex = 0;
+  uint32_t                  queue = 0;
+
+  std::array<uint8_t, 6>    local_mac = {};
+  std::array<uint8_t, 6>    peer_mac = {};
+  sockaddr_in               local = {};
+  sockaddr_in               peer = {};
+
+  // Generic (SKB) mode works with any driver, e.g. veth. Native mode
+  // requires driver support.
+  bool                      skb_mode = true;
+};
+
+
+/**
+ * Batched AF_XDP transport for a connection.
+ *
+ * An XDP program on the interface steers UDP datagrams for the local port
+ * to an AF_XDP socket; everything else is passed on to the kernel's network
+ * stack. The program is assembled here and loaded with the bpf() system
+ * call, so no libbpf is required.
+ *
+ * The transport owns the socket's UMEM: FRAME_COUNT frames of FRAME_SIZE
+ * Bytes, one half for the fill and RX rings, the other for the TX and
+ * completion rings. Received frames are unwrapped into packet pool slots,
+ * up to BATCH_SIZE at a time, and passed to the connection's
+ * received_packets(). Outgoing packets are drained from a channel with
+ * packets_to_send(), wrapped into TX frames, and sent with a single wakeup
+ * per batch.
+ *
+ * Only IPv4 without IP options is handled; fragmented datagrams are left to
+ * the kernel. Outgoing datagrams carry no UDP checksum.
+ *
+ * Like the socket based transports, this one is per peer: frames from other
+ * addresses are dropped.
+ */
+template <
+  typename apiT,
+  std::size_t BATCH_SIZE = 32,
+  std::size_t FRAME_COUNT = 1024,
+  std::size_t FRAME_SIZE = 2048
+>
+class af_xdp_transport
+{
+public:
+  using address_type = typename apiT::address_type;
+  using slot_type = typename apiT::slot_type;
+  using buffer_entry = typename apiT::buffer_entry;
+  using received_entry = typename apiT::received_entry;
+
+  static_assert(FRAME_SIZE >= 2048
+      && !(FRAME_SIZE & (FRAME_SIZE - 1)),
+      "UMEM frames must be a power of two of at least 2 KiB.");
+  static_assert(FRAME_COUNT >= 2 && !(FRAME_COUNT & (FRAME_COUNT - 1)),
+      "Ring sizes must be a power of two.");
+
+  // Ethernet, IPv4 and UDP headers
+  static constexpr std::size_t HEADER_SIZE = 14 + 20 + 8;
+
+  inline af_xdp_transport(apiT & api, af_xdp_config const & config,
+      address_type const & local = {}, address_type const & peer = {})
+    : m_api{api}
+    , m_config{config}
+    , m_local{local}
+    , m_peer{peer}
+  {
+    m_batch.reserve(BATCH_SIZE);
+    m_pending.reserve(BATCH_SIZE);
+    m_free_frames.reserve(FRAME_COUNT / 2);
+  }
+
+  inline ~af_xdp_transport()
+  {
+    close();
+  }
+
+
+  /**
+   * Set up the UMEM and socket, load the XDP program and attach it to the
+   * interface. Requires CAP_NET_RAW and CAP_BPF, or equivalent privileges.
+   */
+  inline error_t open()
+  {
+    if (m_fd >= 0) {
+      return ERR_STATE;
+    }
+    if (m_api.packet_size() + HEADER_SIZE > FRAME_SIZE - XDP_PACKET_HEADROOM)
+    {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+
+    auto err = open_socket();
+    if (ERR_SUCCESS == err) {
+      err = load_program();
+    }
+    if (ERR_SUCCESS != err) {
+      close();
+    }
+    return err;
+  }
+
+
+  /**
+   * Detach the XDP program and release the socket and UMEM. Packets not
+   * yet sent are dropped.
+   */
+  inline void close()
+  {
+    for (int * fd : {&m_link_fd, &m_prog_fd, &m_map_fd, &m_fd}) {
+      if (*fd >= 0) {
+        ::close(*fd);
+        *fd = -1;
+      }
+    }
+    for (auto r : {&m_fill, &m_completion, &m_rx, &m_tx}) {
+      if (r->map) {
+        munmap(r->map, r->map_size);
+      }
+      *r = {};
+    }
+    if (m_umem) {
+      munmap(m_umem, UMEM_SIZE);
+      m_umem = nullptr;
+    }
+    m_free_frames.clear();
+    m_pending.clear();
+  }
+
+
+  /**
+   * Receive one batch of datagrams, if any are available. The number of
+   * datagrams passed to the connection is returned in received.
+   *
+   * Datagrams larger than a pool slot are dropped.
+   */
+  inline error_t receive(std::size_t & received)
+  {
+    received = 0;
+    if (m_fd < 0) {
+      return ERR_STATE;
+    }
+
+    auto available = m_rx.consumable();
+    if (available > BATCH_SIZE) {
+      available = BATCH_SIZE;
+    }
+
+    m_batch.clear();
+    auto cons = *m_rx.consumer;
+    for (uint32_t i = 0 ; i < available ; ++i) {
+      auto & desc = m_rx.template desc<xdp_desc>(cons + i);
+      unwrap(m_umem + desc.addr, desc.len);
+
+      // The frame can be filled again right away.
+      auto fill = *m_fill.producer;
+      m_fill.template desc<uint64_t>(fill) = desc.addr & ~(FRAME_SIZE - 1);
+      __atomic_store_n(m_fill.producer, fill + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(m_rx.consumer, cons + available, __ATOMIC_RELEASE);
+
+    received = m_batch.size();
+    auto err = m_api.received_packets(m_batch.begin(), m_batch.end());
+    m_batch.clear();
+    return err;
+  }
+
+
+  /**
+   * Send packets ready on the channel, one batch per call. The number of
+   * packets placed on the TX ring is returned in sent.
+   *
+   * If TX frames run out, packets are kept, and sent first on the next
+   * call.
+   */
+  inline error_t send(channelid const & channel, std::size_t & sent)
+  {
+    sent = 0;
+    if (m_fd < 0) {
+      return ERR_STATE;
+    }
+
+    reclaim_frames();
+    m_api.packets_to_send(channel, m_pending, BATCH_SIZE - m_pending.size());
+
+    auto prod = *m_tx.producer;
+    std::size_t count = 0;
+    for ( ; count < m_pending.size() ; ++count) {
+      if (m_free_frames.empty() || !m_tx.producible()) {
+        break;
+      }
+      auto addr = m_free_frames.back();
+      m_free_frames.pop_back();
+
+      auto & packet = m_pending[count].packet;
+      auto & desc = m_tx.template desc<xdp_desc>(prod);
+      desc.addr = addr;
+      desc.len = static_cast<uint32_t>(wrap(m_umem + addr,
+            packet.buffer(), packet.packet_size()));
+      desc.options = 0;
+      __atomic_store_n(m_tx.producer, ++prod, __ATOMIC_RELEASE);
+    }
+    if (!count) {
+      return ERR_SUCCESS;
+    }
+
+    // In copy mode, frames are only sent when the kernel is woken up.
+    if (sendto(m_fd, nullptr, 0, MSG_DONTWAIT, nullptr, 0) < 0
+        && EAGAIN != errno && EBUSY != errno && ENOBUFS != errno
+        && EINTR != errno)
+    {
+      return ERR_WRITE;
+    }
+
+    sent = count;
+    m_pending.erase(m_pending.begin(), m_pending.begin() + count);
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Packets dequeued from the connection, but not yet sent.
+   */
+  inline std::size_t pending() const
+  {
+    return m_pending.size();
+  }
+
+
+  /**
+   * The AF_XDP socket, e.g. for polling.
+   */
+  inline int fd() const
+  {
+    return m_fd;
+  }
+
+private:
+  static constexpr std::size_t UMEM_SIZE = FRAME_COUNT * FRAME_SIZE;
+  static constexpr uint32_t RING_SIZE = FRAME_COUNT / 2;
+
+  /**
+   * One of the four rings shared with the kernel. The producer and
+   * consumer indices run freely, and are masked for access.
+   */
+  struct ring
+  {
+    uint32_t *  producer = nullptr;
+    uint32_t *  consumer = nullptr;
+    uint8_t *   descs = nullptr;
+    void *      map = nullptr;
+    std::size_t map_size = 0;
+
+    template <typename descT>
+    inline descT & desc(uint32_t index)
+    {
+      return reinterpret_cast<descT *>(descs)[index & (RING_SIZE - 1)];
+    }
+
+    inline uint32_t consumable() const
+    {
+      return __atomic_load_n(producer, __ATOMIC_ACQUIRE) - *consumer;
+    }
+
+    inline bool producible() const
+    {
+      return *producer - __atomic_load_n(consumer, __ATOMIC_ACQUIRE)
+        < RING_SIZE;
+    }
+  };
+
+
+  inline error_t open_socket()
+  {
+    m_umem = static_cast<uint8_t *>(mmap(nullptr, UMEM_SIZE,
+          PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (MAP_FAILED == m_umem) {
+      m_umem = nullptr;
+      return ERR_UNEXPECTED;
+    }
+
+    m_fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    xdp_umem_reg reg = {};
+    reg.addr = reinterpret_cast<uint64_t>(m_umem);
+    reg.len = UMEM_SIZE;
+    reg.chunk_size = FRAME_SIZE;
+    if (setsockopt(m_fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    int size = RING_SIZE;
+    for (int opt : {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING,
+        XDP_RX_RING, XDP_TX_RING})
+    {
+      if (setsockopt(m_fd, SOL_XDP, opt, &size, sizeof(size)) < 0) {
+        return ERR_UNEXPECTED;
+      }
+    }
+
+    xdp_mmap_offsets off = {};
+    socklen_t len = sizeof(off);
+    if (getsockopt(m_fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    if (!map_ring(m_fill, off.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(uint64_t))
+        || !map_ring(m_completion, off.cr, XDP_UMEM_PGOFF_COMPLETION_RING,
+          sizeof(uint64_t))
+        || !map_ring(m_rx, off.rx, XDP_PGOFF_RX_RING, sizeof(xdp_desc))
+        || !map_ring(m_tx, off.tx, XDP_PGOFF_TX_RING, sizeof(xdp_desc)))
+    {
+      return ERR_UNEXPECTED;
+    }
+
+    // The first half of the frames is for receiving, the second for
+    // sending.
+    for (uint32_t i = 0 ; i < RING_SIZE ; ++i) {
+      m_fill.template desc<uint64_t>(i) = i * FRAME_SIZE;
+      m_free_frames.push_back((RING_SIZE + i) * FRAME_SIZE);
+    }
+    __atomic_store_n(m_fill.producer, RING_SIZE, __ATOMIC_RELEASE);
+
+    sockaddr_xdp addr = {};
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = static_cast<uint32_t>(m_config.ifindex);
+    addr.sxdp_queue_id = m_config.queue;
+    addr.sxdp_flags = m_config.skb_mode ? XDP_COPY : 0;
+    if (bind(m_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+      return ERR_UNEXPECTED;
+    }
+    return ERR_SUCCESS;
+  }
+
+
+  inline bool map_ring(ring & r, xdp_ring_offset const & off, off_t pgoff,
+      std::size_t desc_size)
+  {
+    r.map_size = off.desc + RING_SIZE * desc_size;
+    r.map = mmap(nullptr, r.map_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, m_fd, pgoff);
+    if (MAP_FAILED == r.map) {
+      r = {};
+      return false;
+    }
+    auto base = static_cast<uint8_t *>(r.map);
+    r.producer = reinterpret_cast<uint32_t *>(base + off.producer);
+    r.consumer = reinterpret_cast<uint32_t *>(base + off.consumer);
+    r.descs = base + off.desc;
+    return true;
+  }
+
+
+  static inline int bpf(int cmd, bpf_attr & attr)
+  {
+    return static_cast<int>(syscall(__NR_bpf, cmd, &attr, sizeof(attr)));
+  }
+
+
+  /**
+   * Create the XSKMAP with our socket for our queue, and load and attach a
+   * program that redirects our UDP port to it.
+   */
+  inline error_t load_program()
+  {
+    bpf_attr attr = {};
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = m_config.queue + 1;
+    m_map_fd = bpf(BPF_MAP_CREATE, attr);
+    if (m_map_fd < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    uint32_t key = m_config.queue;
+    attr = {};
+    attr.map_fd = static_cast<uint32_t>(m_map_fd);
+    attr.key = reinterpret_cast<uint64_t>(&key);
+    attr.value = reinterpret_cast<uint64_t>(&m_fd);
+    attr.flags = BPF_ANY;
+    if (bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    auto insns = program();
+    static char const license[] = "GPL";
+    attr = {};
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<uint64_t>(insns.data());
+    attr.insn_cnt = static_cast<uint32_t>(insns.size());
+    attr.license = reinterpret_cast<uint64_t>(license);
+    m_prog_fd = bpf(BPF_PROG_LOAD, attr);
+    if (m_prog_fd < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    // A link detaches the program when it is closed, including when the
+    // process exits.
+    attr = {};
+    attr.link_create.prog_fd = static_cast<uint32_t>(m_prog_fd);
+    attr.link_create.target_ifindex = static_cast<uint32_t>(m_config.ifindex);
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = m_config.skb_mode ? XDP_FLAGS_SKB_MODE
+      : XDP_FLAGS_DRV_MODE;
+    m_link_fd = bpf(BPF_LINK_CREATE, attr);
+    if (m_link_fd < 0) {
+      return ERR_UNEXPECTED;
+    }
+    return ERR_SUCCESS;
+  }
+
+
+  static constexpr bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src,
+      int16_t off, int32_t imm)
+  {
+    bpf_insn ret = {};
+    ret.code = code;
+    ret.dst_reg = dst & 0x0f;
+    ret.src_reg = src & 0x0f;
+    ret.off = off;
+    ret.imm = imm;
+    return ret;
+  }
+
+
+  /**
+   * The XDP program, equivalent to:
+   *
+   *   if (ethernet, IPv4 without options or fragmentation, UDP to our port)
+   *     return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+   *   return XDP_PASS;
+   */
+  inline std::vector<bpf_insn> program() const
+  {
+    // Loads are in network byte order, so compare against that.
+    // Jumps to the final XDP_PASS are patched below.
+    constexpr int16_t PASS = 0x7fff;
+    std::vector<bpf_insn> insns = {
+      // r2 = ctx->data; r3 = ctx->data_end
+      insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, 0, 0),
+      insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, 4, 0),
+      // if (data + HEADER_SIZE > data_end) pass
+      insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+      insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, HEADER_SIZE),
+      insn(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, PASS, 0),
+      // Ethertype
+      insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, 12, 0),
+      insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, PASS, htons(ETH_P_IP)),
+      // IPv4 version and header length
+      insn(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_4, BPF_REG_2, 14, 0),
+      insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, PASS, 0x45),
+      // Fragment offset and more fragments flag
+      insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, 20, 0),
+      insn(BPF_ALU64 | BPF_AND | BPF_K, BPF_REG_4, 0, 0, htons(0x3fff)),
+      insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, PASS, 0),
+      // Protocol
+      insn(BPF_LDX | BPF_MEM | BPF_B, BPF_REG_4, BPF_REG_2, 23, 0),
+      insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, PASS, IPPROTO_UDP),
+      // Destination port
+      insn(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, 36, 0),
+      insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, PASS,
+          m_config.local.sin_port),
+      // return bpf_redirect_map(map, ctx->rx_queue_index, XDP_PASS)
+      insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, 16, 0),
+      insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0,
+          m_map_fd),
+      insn(0, 0, 0, 0, 0),
+      insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+      insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+      insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+      // return XDP_PASS
+      insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+      insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+
+    auto pass = static_cast<int16_t>(insns.size() - 2);
+    for (int16_t i = 0 ; i < pass ; ++i) {
+      if (PASS == insns[i].off) {
+        insns[i].off = static_cast<int16_t>(pass - i - 1);
+      }
+    }
+    return insns;
+  }
+
+
+  /**
+   * Return frames the kernel has finished sending to the free list.
+   */
+  inline void reclaim_frames()
+  {
+    auto available = m_completion.consumable();
+    auto cons = *m_completion.consumer;
+    for (uint32_t i = 0 ; i < available ; ++i) {
+      m_free_frames.push_back(m_completion.template desc<uint64_t>(cons + i));
+    }
+    __atomic_store_n(m_completion.consumer, cons + available,
+        __ATOMIC_RELEASE);
+  }
+
+
+  static inline uint16_t ip_checksum(uint8_t const * header, std::size_t size)
+  {
+    uint32_t sum = 0;
+    for (std::size_t i = 0 ; i < size ; i += 2) {
+      sum += (static_cast<uint32_t>(header[i]) << 8) | header[i + 1];
+    }
+    while (sum >> 16) {
+      sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(~sum);
+  }
+
+
+  /**
+   * Write Ethernet, IPv4 and UDP headers and the packet to the frame.
+   * Returns the frame length.
+   */
+  inline std::size_t wrap(uint8_t * frame, void const * packet,
+      std::size_t size)
+  {
+    auto put16 = [](uint8_t * buf, uint16_t value)
+    {
+      buf[0] = static_cast<uint8_t>(value >> 8);
+      buf[1] = static_cast<uint8_t>(value & 0xff);
+    };
+
+    std::memcpy(frame, m_config.peer_mac.data(), 6);
+    std::memcpy(frame + 6, m_config.local_mac.data(), 6);
+    put16(frame + 12, ETH_P_IP);
+
+    auto ip = frame + 14;
+    std::memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, static_cast<uint16_t>(20 + 8 + size));
+    put16(ip + 6, 0x4000); // Don't fragment
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    std::memcpy(ip + 12, &m_config.local.sin_addr, 4);
+    std::memcpy(ip + 16, &m_config.peer.sin_addr, 4);
+    put16(ip + 10, ip_checksum(ip, 20));
+
+    auto udp = ip + 20;
+    std::memcpy(udp, &m_config.local.sin_port, 2);
+    std::memcpy(udp + 2, &m_config.peer.sin_port, 2);
+    put16(udp + 4, static_cast<uint16_t>(8 + size));
+    put16(udp + 6, 0);
+
+    std::memcpy(frame + HEADER_SIZE, packet, size);
+    return HEADER_SIZE + size;
+  }
+
+
+  /**
+   * If the frame is a datagram from the peer, copy its payload into a pool
+   * slot and add it to the batch.
+   */
+  inline void unwrap(uint8_t const * frame, std::size_t len)
+  {
+    if (len < HEADER_SIZE) {
+      return;
+    }
+    auto ip = frame + 14;
+    auto udp = ip + 20;
+    if (std::memcmp(ip + 12, &m_config.peer.sin_addr, 4)
+        || std::memcmp(udp, &m_config.peer.sin_port, 2)
+        || std::memcmp(udp + 2, &m_config.local.sin_port, 2))
+    {
+      return;
+    }
+
+    // Short frames are padded; the UDP length tells the payload size.
+    std::size_t udp_len = (static_cast<std::size_t>(udp[4]) << 8) | udp[5];
+    if (udp_len < 8 || udp_len - 8 > len - HEADER_SIZE) {
+      return;
+    }
+    auto size = udp_len - 8;
+
+    auto slot = m_api.allocate();
+    if (size > slot.size()) {
+      return;
+    }
+    std::memcpy(slot.data(), frame + HEADER_SIZE, size);
+    m_batch.push_back({m_local, m_peer, std::move(slot)});
+  }
+
+
+  apiT &                      m_api;
+  af_xdp_config               m_config;
+  address_type                m_local;
+  address_type                m_peer;
+
+  uint8_t *                   m_umem = nullptr;
+  int                         m_fd = -1;
+  int                         m_map_fd = -1;
+  int                         m_prog_fd = -1;
+  int                         m_link_fd = -1;
+
+  ring                        m_fill;
+  ring                        m_completion;
+  ring                        m_rx;
+  ring                        m_tx;
+
+  std::vector<uint64_t>       m_free_frames;
+  std::vector<received_entry> m_batch;
+  std::vector<buffer_entry>   m_pending;
+};
+
+} // namespace channeler::transport
+
+#endif // guard
@@ -0,0 +1,251 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_TRANSPORT_EGRESS_ARBITER_H
+#define CHANNELER_TRANSPORT_EGRESS_ARBITER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <unordered_map>
+
+#include <channeler/channelid.h>
+#include <channeler/error.h>
+
+namespace channeler::transport {
+
+/**
+ * Fair egress for many connections sharing one transport, e.g. a single
+ * unconnected datagram socket.
+ *
+ * Connections notify the arbiter when a channel has packets to send, from
+ * their packet_to_send callback. Instead of sending right away, the
+ * transport asks the arbiter for a batch of packets, which it draws from all
+ * connections by deficit round robin: each round, every connection with
+ * packets may send up to its weight times the quantum in Bytes. A bulk
+ * sender therefore cannot starve other peers; each waits at most for one
+ * round of the other connections' quanta.
+ *
+ * Within a connection, ready channels take turns packet by packet.
+ *
+ * The arbiter does not own connections; remove them before they are
+ * destroyed. Channels whose packets are rate limited drop out of the
+ * rotation, and must be notified again once they can send.
+ */
+template <
+  typename apiT
+>
+class egress_arbiter
+{
+public:
+  using address_type = typename apiT::address_type;
+  using buffer_entry = typename apiT::buffer_entry;
+
+  /**
+   * Batches contain the packets along with the destination the connection
+   * was added with.
+   */
+  struct output_entry
+  {
+    address_type  destination;
+    buffer_entry  entry;
+  };
+
+  inline explicit egress_arbiter(std::size_t quantum)
+    : m_quantum{quantum}
+  {
+    if (!m_quantum) {
+      throw_exception(ERR_UNEXPECTED, "Arbiter quantum must be non-zero.");
+    }
+  }
+
+  /**
+   * Add a connection with the given weight; returns false if it is already
+   * known.
+   */
+  inline bool add(apiT & api, address_type const & destination,
+      std::size_t weight = 1)
+  {
+    if (!weight) {
+      throw_exception(ERR_UNEXPECTED, "Connection weight must be non-zero.");
+    }
+    auto [iter, inserted] = m_flows.insert({&api, flow{}});
+    if (!inserted) {
+      return false;
+    }
+    iter->second.api = &api;
+    iter->second.destination = destination;
+    iter->second.weight = weight;
+    return true;
+  }
+
+  inline void remove(apiT & api)
+  {
+    auto iter = m_flows.find(&api);
+    if (iter == m_flows.end()) {
+      return;
+    }
+
+    auto active = std::find(m_active.begin(), m_active.end(), &iter->second);
+    if (active != m_active.end()) {
+      if (active == m_active.begin()) {
+        m_head_granted = false;
+      }
+      m_active.erase(active);
+    }
+    m_flows.erase(iter);
+  }
+
+  /**
+   * Change a connection's weight; takes effect with its next quantum.
+   */
+  inline error_t set_weight(apiT & api, std::size_t weight)
+  {
+    if (!weight) {
+      return ERR_UNEXPECTED;
+    }
+    auto iter = m_flows.find(&api);
+    if (iter == m_flows.end()) {
+      return ERR_STATE;
+    }
+    iter->second.weight = weight;
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * Mark the channel of the connection as having packets to send. Call this
+   * from the connection's packet_to_send callback.
+   */
+  inline error_t notify(apiT & api, channelid const & channel)
+  {
+    auto iter = m_flows.find(&api);
+    if (iter == m_flows.end()) {
+      return ERR_STATE;
+    }
+
+    auto & f = iter->second;
+    if (f.ready_set.insert(channel).second) {
+      f.ready.push_back(channel);
+    }
+    if (!f.active) {
+      f.active = true;
+      f.deficit = 0;
+      m_active.push_back(&f);
+    }
+    return ERR_SUCCESS;
+  }
+
+  /**
+   * Draw up to max packets from the connections, appending them to the
+   * output container of output_entry. Returns the number of packets drawn.
+   *
+   * A partially served connection continues where it left off on the next
+   * call, without receiving another quantum.
+   */
+  template <
+    typename containerT
+  >
+  inline std::size_t packets_to_send(containerT & out, std::size_t max)
+  {
+    std::size_t count = 0;
+    while (count < max && !m_active.empty()) {
+      auto & f = *m_active.front();
+      if (!m_head_granted) {
+        f.deficit += f.weight * m_quantum;
+        m_head_granted = true;
+      }
+
+      auto size = f.api->packet_size();
+      while (count < max && !f.ready.empty() && f.deficit >= size) {
+        auto channel = f.ready.front();
+        f.ready.pop_front();
+
+        auto entry = f.api->packet_to_send(channel);
+        if (!entry.data.size()) {
+          // Drained, or rate limited.
+          f.ready_set.erase(channel);
+          continue;
+        }
+
+        f.deficit -= size;
+        out.push_back({f.destination, std::move(entry)});
+        ++count;
+
+        // Let the connection's other channels have a turn.
+        f.ready.push_back(channel);
+      }
+
+      if (count >= max && !f.ready.empty() && f.deficit >= size) {
+        // The batch is full; continue with this connection next time.
+        break;
+      }
+
+      m_active.pop_front();
+      m_head_granted = false;
+      if (f.ready.empty()) {
+        f.active = false;
+        f.deficit = 0;
+      }
+      else {
+        m_active.push_back(&f);
+      }
+    }
+    return count;
+  }
+
+  /**
+   * The number of connections with packets to send.
+   */
+  inline std::size_t active() const
+  {
+    return m_active.size();
+  }
+
+  inline std::size_t size() const
+  {
+    return m_flows.size();
+  }
+
+private:
+  struct flow
+  {
+    apiT *                api = nullptr;
+    address_type          destination = {};
+    std::size_t           weight = 1;
+    std::size_t           deficit = 0;
+    bool                  active = false;
+    std::deque<channelid> ready = {};
+    std::set<channelid>   ready_set = {};
+  };
+
+  std::size_t                       m_quantum;
+  std::unordered_map<apiT *, flow>  m_flows = {};
+  std::deque<flow *>                m_active = {};
+  bool                              m_head_granted = false;
+};
+
+} // namespace channeler::transport
+
+#endif // guard
@@ -0,0 +1,457 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_TRANSPORT_SHM_H
+#define CHANNELER_TRANSPORT_SHM_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#if !defined(__linux__)
+#error The shared memory transport requires memfd and eventfd support.
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <channeler/error.h>
+
+#include "../support/spsc_ring.h"
+
+namespace channeler::transport {
+
+/**
+ * Shared memory transport for peers on the same host.
+ *
+ * Two processes map the same memfd-backed region. It contains a packet slot
+ * area, split in half between the two sides, and four rings of slot
+ * indices: for each direction, one ring of slots ready for the receiver, and
+ * one ring of slots the receiver is done with, which returns them to their
+ * owner. Packets are written in place by the sender and read in place by the
+ * receiver; the kernel is only involved in eventfd wakeups, and those are
+ * coalesced so that only a send to an empty ring signals the receiver.
+ *
+ * The side creating the region passes descriptors() to the other side,
+ * e.g. by inheritance or SCM_RIGHTS. Each side dups the descriptors it is
+ * given, and closes its own on destruction.
+ *
+ * The peer is not trusted: slot indices and lengths read from the region
+ * are range checked.
+ */
+struct shm_descriptors
+{
+  int memory = -1;
+  // Signals the attaching side that the creator sent packets.
+  int to_peer = -1;
+  // Signals the creating side that the attached peer sent packets.
+  int to_creator = -1;
+};
+
+
+class shm_transport
+{
+public:
+  /**
+   * Create a region with the given number of packet slots per direction,
+   * which is rounded up to a power of two.
+   */
+  inline shm_transport(std::size_t packet_size, std::size_t slots)
+    : m_side{0}
+  {
+    uint32_t capacity = 1;
+    while (capacity < slots) {
+      capacity <<= 1;
+    }
+
+    m_fds.memory = memfd_create("channeler-shm", MFD_CLOEXEC);
+    m_fds.to_peer = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    m_fds.to_creator = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_fds.memory < 0 || m_fds.to_peer < 0 || m_fds.to_creator < 0) {
+      close_all();
+      throw_exception(ERR_UNEXPECTED, "Could not create shared memory transport.");
+    }
+
+    region_header header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.packet_size = static_cast<uint32_t>(packet_size);
+    header.slots = capacity;
+    header.stride = static_cast<uint32_t>(round_up(sizeof(uint32_t) + packet_size));
+
+    if (ftruncate(m_fds.memory, region_size(header)) < 0) {
+      close_all();
+      throw_exception(ERR_UNEXPECTED, "Could not size shared memory region.");
+    }
+    map(header);
+
+    std::memcpy(m_base, &header, sizeof(header));
+    for (std::size_t i = 0 ; i < RING_COUNT ; ++i) {
+      new (ring_header(i)) support::spsc_ring_header{};
+    }
+    setup_rings();
+
+    // Each side initially owns its half of the slots; they start out in its
+    // returned ring.
+    for (uint32_t i = 0 ; i < capacity ; ++i) {
+      m_rings[RING_CREATOR_RETURNED].push(i);
+      m_rings[RING_PEER_RETURNED].push(capacity + i);
+    }
+  }
+
+
+  /**
+   * Attach to a region created by the other side.
+   */
+  inline explicit shm_transport(shm_descriptors const & fds)
+    : m_side{1}
+  {
+    m_fds.memory = dup(fds.memory);
+    m_fds.to_peer = dup(fds.to_peer);
+    m_fds.to_creator = dup(fds.to_creator);
+    if (m_fds.memory < 0 || m_fds.to_peer < 0 || m_fds.to_creator < 0) {
+      close_all();
+      throw_exception(ERR_INVALID_REFERENCE, "Invalid shared memory descriptors.");
+    }
+
+    region_header header{};
+    struct stat st;
+    if (fstat(m_fds.memory, &st) < 0
+        || static_cast<std::size_t>(st.st_size) < sizeof(header)
+        || pread(m_fds.memory, &header, sizeof(header), 0) != sizeof(header)
+        || header.magic != MAGIC || header.version != VERSION
+        || !header.slots || (header.slots & (header.slots - 1))
+        || header.stride < sizeof(uint32_t) + header.packet_size
+        || static_cast<std::size_t>(st.st_size) < region_size(header))
+    {
+      close_all();
+      throw_exception(ERR_DECODE, "Not a shared memory transport region.");
+    }
+    map(header);
+    setup_rings();
+  }
+
+
+  inline ~shm_transport()
+  {
+    if (m_base) {
+      munmap(m_base, m_size);
+    }
+    close_all();
+  }
+
+  shm_transport(shm_transport const &) = delete;
+  shm_transport & operator=(shm_transport const &) = delete;
+
+
+  /**
+   * Descriptors to pass to the other side.
+   */
+  inline shm_descriptors const & descriptors() const
+  {
+    return m_fds;
+  }
+
+  inline std::size_t packet_size() const
+  {
+    return m_header.packet_size;
+  }
+
+
+  /**
+   * Copy a packet into a free slot, and make it available to the other side.
+   *
+   * Returns ERR_WRITE if no slot is free, i.e. the other side has not yet
+   * consumed enough packets.
+   */
+  inline error_t send(byte const * data, std::size_t size)
+  {
+    if (size > m_header.packet_size) {
+      return ERR_INSUFFICIENT_BUFFER_SIZE;
+    }
+
+    uint32_t index;
+    if (!tx_returned().pop(index)) {
+      return ERR_WRITE;
+    }
+    if (!owned_by(index, m_side)) {
+      return ERR_DECODE;
+    }
+
+    auto slot = slot_data(index);
+    auto length = static_cast<uint32_t>(size);
+    std::memcpy(slot, &length, sizeof(length));
+    std::memcpy(slot + sizeof(length), data, size);
+
+    auto & ready = tx_ready();
+    ready.push(index);
+
+    // If our packet is the only one in the ring, the receiver may have
+    // drained the ring and be waiting. Otherwise, it has yet to consume
+    // packets sent before, and will see ours.
+    if (ready.size() == 1) {
+      uint64_t one = 1;
+      auto ret = write(notify_fd(), &one, sizeof(one));
+      (void) ret; // EAGAIN only if the counter is saturated; still signalled
+    }
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Pass the next packet to func(byte const *, std::size_t) in place, then
+   * return its slot to the other side.
+   *
+   * Returns ERR_DATA_UNAVAILABLE if there are no packets.
+   */
+  template <typename funcT>
+  inline error_t receive(funcT && func)
+  {
+    uint32_t index;
+    if (!rx_ready().pop(index)) {
+      return ERR_DATA_UNAVAILABLE;
+    }
+
+    if (!owned_by(index, 1 - m_side)) {
+      return ERR_DECODE;
+    }
+
+    auto slot = slot_data(index);
+    uint32_t length;
+    std::memcpy(&length, slot, sizeof(length));
+
+    error_t err = ERR_DECODE;
+    if (length <= m_header.packet_size) {
+      func(slot + sizeof(length), static_cast<std::size_t>(length));
+      err = ERR_SUCCESS;
+    }
+
+    rx_returned().push(index);
+    return err;
+  }
+
+
+  /**
+   * Receive the next packet into a pool slot of the connection API, and pass
+   * it to received_packet().
+   *
+   * This is one copy: pool slots are process memory, and must outlive the
+   * shared slot, which we return to the other side immediately.
+   */
+  template <typename apiT>
+  inline error_t receive_packet(apiT & api,
+      typename apiT::address_type const & source = {},
+      typename apiT::address_type const & destination = {})
+  {
+    error_t result = ERR_SUCCESS;
+    auto err = receive([&](byte const * data, std::size_t size)
+    {
+      auto slot = api.allocate();
+      if (size > slot.size()) {
+        result = ERR_INSUFFICIENT_BUFFER_SIZE;
+        return;
+      }
+      std::memcpy(slot.data(), data, size);
+      result = api.received_packet(source, destination, slot);
+    });
+    if (ERR_SUCCESS != err) {
+      return err;
+    }
+    return result;
+  }
+
+
+  /**
+   * The descriptor becomes readable when packets arrive; for use with event
+   * loops. Call wait() with a zero timeout to reset it before receiving.
+   */
+  inline int wait_fd() const
+  {
+    return m_side ? m_fds.to_peer : m_fds.to_creator;
+  }
+
+  /**
+   * Wait up to the timeout for packets to arrive. Returns true if there are
+   * packets to receive.
+   *
+   * The wakeup is consumed here, so callers must receive until
+   * ERR_DATA_UNAVAILABLE before waiting again.
+   */
+  inline bool wait(std::chrono::milliseconds timeout)
+  {
+    if (!rx_ready().empty()) {
+      return true;
+    }
+
+    pollfd pfd{wait_fd(), POLLIN, 0};
+    if (poll(&pfd, 1, static_cast<int>(timeout.count())) > 0) {
+      uint64_t count;
+      auto ret = read(wait_fd(), &count, sizeof(count));
+      (void) ret; // Non-blocking; a spurious wakeup is harmless
+    }
+    return !rx_ready().empty();
+  }
+
+private:
+  static constexpr uint32_t MAGIC = 0x43534d31; // "CSM1"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr std::size_t ALIGNMENT = 64;
+  static constexpr std::size_t RING_COUNT = 4;
+
+  // Rings by sender; "returned" rings return the sender's slots.
+  enum ring_index : std::size_t
+  {
+    RING_CREATOR_READY = 0,
+    RING_CREATOR_RETURNED = 1,
+    RING_PEER_READY = 2,
+    RING_PEER_RETURNED = 3,
+  };
+
+  struct region_header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t packet_size;
+    uint32_t slots;     // Per direction
+    uint32_t stride;    // Length prefix, packet, padding
+  };
+
+  static constexpr std::size_t round_up(std::size_t size)
+  {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  }
+
+  static constexpr std::size_t rings_offset()
+  {
+    return round_up(sizeof(region_header));
+  }
+
+  static constexpr std::size_t entries_offset()
+  {
+    return rings_offset() + RING_COUNT * round_up(sizeof(support::spsc_ring_header));
+  }
+
+  static inline std::size_t slots_offset(region_header const & header)
+  {
+    return entries_offset()
+      + RING_COUNT * round_up(header.slots * sizeof(uint32_t));
+  }
+
+  static inline std::size_t region_size(region_header const & header)
+  {
+    return slots_offset(header) + 2 * std::size_t{header.slots} * header.stride;
+  }
+
+  inline void map(region_header const & header)
+  {
+    m_size = region_size(header);
+    auto addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        m_fds.memory, 0);
+    if (MAP_FAILED == addr) {
+      close_all();
+      throw_exception(ERR_UNEXPECTED, "Could not map shared memory region.");
+    }
+    m_base = static_cast<byte *>(addr);
+    m_header = header;
+  }
+
+  inline support::spsc_ring_header * ring_header(std::size_t ring)
+  {
+    return reinterpret_cast<support::spsc_ring_header *>(m_base + rings_offset()
+        + ring * round_up(sizeof(support::spsc_ring_header)));
+  }
+
+  inline void setup_rings()
+  {
+    for (std::size_t i = 0 ; i < RING_COUNT ; ++i) {
+      auto entries = reinterpret_cast<uint32_t *>(m_base + entries_offset()
+          + i * round_up(m_header.slots * sizeof(uint32_t)));
+      m_rings[i] = support::spsc_ring{ring_header(i), entries, m_header.slots};
+    }
+  }
+
+  inline byte * slot_data(uint32_t index)
+  {
+    return m_base + slots_offset(m_header) + std::size_t{index} * m_header.stride;
+  }
+
+  inline bool owned_by(uint32_t index, uint32_t side) const
+  {
+    return index >= side * m_header.slots
+      && index < (side + 1) * m_header.slots;
+  }
+
+  inline support::spsc_ring & tx_ready()
+  {
+    return m_rings[m_side ? RING_PEER_READY : RING_CREATOR_READY];
+  }
+
+  inline support::spsc_ring & tx_returned()
+  {
+    return m_rings[m_side ? RING_PEER_RETURNED : RING_CREATOR_RETURNED];
+  }
+
+  inline support::spsc_ring & rx_ready()
+  {
+    return m_rings[m_side ? RING_CREATOR_READY : RING_PEER_READY];
+  }
+
+  inline support::spsc_ring & rx_returned()
+  {
+    return m_rings[m_side ? RING_CREATOR_RETURNED : RING_PEER_RETURNED];
+  }
+
+  inline int notify_fd() const
+  {
+    return m_side ? m_fds.to_creator : m_fds.to_peer;
+  }
+
+  inline void close_all()
+  {
+    for (int fd : {m_fds.memory, m_fds.to_peer, m_fds.to_creator}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    m_fds = {};
+  }
+
+  uint32_t            m_side;
+  shm_descriptors     m_fds = {};
+  region_header       m_header = {};
+  byte *              m_base = nullptr;
+  std::size_t         m_size = 0;
+  support::spsc_ring  m_rings[RING_COUNT] = {
+    {nullptr, nullptr, 1}, {nullptr, nullptr, 1},
+    {nullptr, nullptr, 1}, {nullptr, nullptr, 1},
+  };
+};
+
+} // namespace channeler::transport
+
+#endif // guard
@@ -0,0 +1,295 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_TRANSPORT_UDP_BATCH_H
+#define CHANNELER_TRANSPORT_UDP_BATCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <channeler.h>
+
+#if !defined(__linux__)
+#error The batched UDP transport requires recvmmsg and sendmmsg support.
+#endif
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <channeler/channelid.h>
+#include <channeler/error.h>
+
+#include "../support/ecn.h"
+
+namespace channeler::transport {
+
+/**
+ * Batched datagram transport for a connection.
+ *
+ * Received datagrams are read by the kernel directly into packet pool
+ * slots, up to BATCH_SIZE per system call, and handed to the connection's
+ * received_packets() as one batch. Outgoing packets are drained from a
+ * channel with packets_to_send() and written with a single system call per
+ * batch.
+ *
+ * The transport does not own the socket. It is expected to be a datagram
+ * socket connected to the peer, matching the per-peer connection API, and
+ * should be non-blocking.
+ *
+ * With ECN enabled, outgoing packets are marked as ECN capable, and the
+ * ECN codepoints of received packets are counted, for feeding back to the
+ * peer.
+ */
+template <
+  typename apiT,
+  std::size_t BATCH_SIZE = 32
+>
+class udp_batch_transport
+{
+public:
+  using address_type = typename apiT::address_type;
+  using slot_type = typename apiT::slot_type;
+  using buffer_entry = typename apiT::buffer_entry;
+  using received_entry = typename apiT::received_entry;
+
+  inline udp_batch_transport(apiT & api, int fd,
+      address_type const & local = {}, address_type const & peer = {})
+    : m_api{api}
+    , m_fd{fd}
+    , m_local{local}
+    , m_peer{peer}
+  {
+    m_slots.reserve(BATCH_SIZE);
+    m_batch.reserve(BATCH_SIZE);
+    m_pending.reserve(BATCH_SIZE);
+  }
+
+
+  /**
+   * Receive one batch of datagrams, if any are available. The number of
+   * datagrams passed to the connection is returned in received.
+   *
+   * Datagrams larger than a pool slot are truncated by the kernel, and
+   * dropped.
+   */
+  inline error_t receive(std::size_t & received)
+  {
+    received = 0;
+
+    // Slots passed on may be kept by the connection; only replace those.
+    while (m_slots.size() < BATCH_SIZE) {
+      m_slots.push_back(m_api.allocate());
+    }
+
+    iovec iov[BATCH_SIZE];
+    mmsghdr msgs[BATCH_SIZE] = {};
+    control_buffer control[BATCH_SIZE];
+    for (std::size_t i = 0 ; i < BATCH_SIZE ; ++i) {
+      iov[i].iov_base = m_slots[i].data();
+      iov[i].iov_len = m_slots[i].size();
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      if (m_ecn) {
+        msgs[i].msg_hdr.msg_control = control[i].buf;
+        msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+      }
+    }
+
+    auto ret = recvmmsg(m_fd, msgs, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+    if (ret < 0) {
+      if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+        return ERR_SUCCESS;
+      }
+      return ERR_UNEXPECTED;
+    }
+
+    // Build the batch from the filled slots, and compact the rest.
+    m_batch.clear();
+    std::size_t keep = 0;
+    for (std::size_t i = 0 ; i < BATCH_SIZE ; ++i) {
+      if (i < static_cast<std::size_t>(ret)
+          && !(msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+      {
+        if (m_ecn) {
+          m_ecn_counts.record(received_codepoint(msgs[i].msg_hdr));
+        }
+        m_batch.push_back({m_local, m_peer, std::move(m_slots[i])});
+        continue;
+      }
+      if (keep != i) {
+        m_slots[keep] = std::move(m_slots[i]);
+      }
+      ++keep;
+    }
+    m_slots.erase(m_slots.begin() + keep, m_slots.end());
+
+    received = m_batch.size();
+    auto err = m_api.received_packets(m_batch.begin(), m_batch.end());
+    m_batch.clear();
+    return err;
+  }
+
+
+  /**
+   * Send packets ready on the channel, one batch per call. The number of
+   * packets written to the socket is returned in sent.
+   *
+   * Packets the socket does not accept are kept, and sent first on the
+   * next call.
+   */
+  inline error_t send(channelid const & channel, std::size_t & sent)
+  {
+    sent = 0;
+    m_api.packets_to_send(channel, m_pending, BATCH_SIZE - m_pending.size());
+    if (m_pending.empty()) {
+      return ERR_SUCCESS;
+    }
+
+    iovec iov[BATCH_SIZE];
+    mmsghdr msgs[BATCH_SIZE] = {};
+    for (std::size_t i = 0 ; i < m_pending.size() ; ++i) {
+      iov[i].iov_base = m_pending[i].packet.buffer();
+      iov[i].iov_len = m_pending[i].packet.packet_size();
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    auto ret = sendmmsg(m_fd, msgs, static_cast<unsigned>(m_pending.size()),
+        MSG_DONTWAIT);
+    if (ret < 0) {
+      if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+        return ERR_SUCCESS;
+      }
+      return ERR_WRITE;
+    }
+
+    sent = static_cast<std::size_t>(ret);
+    m_pending.erase(m_pending.begin(), m_pending.begin() + ret);
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * Packets dequeued from the connection, but not yet sent.
+   */
+  inline std::size_t pending() const
+  {
+    return m_pending.size();
+  }
+
+
+  /**
+   * Mark outgoing packets with the given ECN codepoint, keeping the
+   * socket's DSCP bits, and start counting the codepoints of received
+   * packets.
+   */
+  inline error_t enable_ecn(
+      support::ecn_codepoint codepoint = support::ECN_ECT0)
+  {
+    sockaddr_storage addr = {};
+    socklen_t len = sizeof(addr);
+    if (getsockname(m_fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+      return ERR_UNEXPECTED;
+    }
+
+    int level = IPPROTO_IP;
+    int mark = IP_TOS;
+    int receive = IP_RECVTOS;
+    if (AF_INET6 == addr.ss_family) {
+      level = IPPROTO_IPV6;
+      mark = IPV6_TCLASS;
+      receive = IPV6_RECVTCLASS;
+    }
+
+    int tos = 0;
+    len = sizeof(tos);
+    if (getsockopt(m_fd, level, mark, &tos, &len) < 0) {
+      return ERR_UNEXPECTED;
+    }
+    tos = (tos & ~support::ECN_MASK) | codepoint;
+
+    int on = 1;
+    if (setsockopt(m_fd, level, mark, &tos, sizeof(tos)) < 0
+        || setsockopt(m_fd, level, receive, &on, sizeof(on)) < 0)
+    {
+      return ERR_UNEXPECTED;
+    }
+
+    m_ecn = true;
+    return ERR_SUCCESS;
+  }
+
+
+  /**
+   * The counts of ECN codepoints in received packets, since ECN was
+   * enabled.
+   */
+  inline support::ecn_counts const & ecn_counts() const
+  {
+    return m_ecn_counts;
+  }
+
+private:
+  // Room for the TOS or traffic class control message.
+  struct control_buffer
+  {
+    alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(int))];
+  };
+
+  static inline support::ecn_codepoint received_codepoint(msghdr & hdr)
+  {
+    for (auto cmsg = CMSG_FIRSTHDR(&hdr) ; cmsg ;
+        cmsg = CMSG_NXTHDR(&hdr, cmsg))
+    {
+      // IPv4 delivers a single Byte, IPv6 an int.
+      if (IPPROTO_IP == cmsg->cmsg_level && IP_TOS == cmsg->cmsg_type) {
+        return support::ecn_from_tos(*CMSG_DATA(cmsg));
+      }
+      if (IPPROTO_IPV6 == cmsg->cmsg_level
+          && IPV6_TCLASS == cmsg->cmsg_type)
+      {
+        int tclass = 0;
+        std::memcpy(&tclass, CMSG_DATA(cmsg), sizeof(tclass));
+        return support::ecn_from_tos(tclass);
+      }
+    }
+    return support::ECN_NOT_ECT;
+  }
+
+  apiT &                      m_api;
+  int                         m_fd;
+  address_type                m_local;
+  address_type                m_peer;
+
+  std::vector<slot_type>      m_slots;
+  std::vector<received_entry> m_batch;
+  std::vector<buffer_entry>   m_pending;
+
+  bool                        m_ecn = false;
+  support::ecn_counts         m_ecn_counts = {};
+};
+
+} // namespace channeler::transport
+
+#endif // guard
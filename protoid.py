@@ -8,7 +8,7 @@ def protoid(version_string):
 
 if __name__ == '__main__':
   import sys
-  version_string = 'Testing v0.1'
+  version_string = 'Testing v0.2'
   if len(sys.argv) > 1:
     version_string = sys.argv[1]
   print('Version string:  ', version_string)
@@ -0,0 +1,137 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/compression.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+constexpr std::size_t ITERATIONS = 20'000;
+
+using channeler::byte;
+using namespace channeler::support;
+
+
+inline std::vector<byte>
+telemetry(std::size_t size, std::mt19937 & gen)
+{
+  // Similar records with varying readings, which is what compresses well
+  // in practice.
+  std::string text;
+  while (text.size() < size) {
+    text += "{\"sensor\":\"temp-" + std::to_string(gen() % 8)
+      + "\",\"value\":" + std::to_string(gen() % 400) + ",\"unit\":\"C\"}";
+  }
+  return {reinterpret_cast<byte const *>(text.data()),
+    reinterpret_cast<byte const *>(text.data()) + size};
+}
+
+
+inline std::vector<byte>
+noise(std::size_t size, std::mt19937 & gen)
+{
+  std::vector<byte> data(size);
+  for (auto & b : data) {
+    b = static_cast<byte>(gen());
+  }
+  return data;
+}
+
+
+/**
+ * Report CPU cost per payload against the Bytes saved, including payloads
+ * for which compression was skipped.
+ */
+void
+measure(std::string const & name, payload_compression & comp,
+    std::vector<std::vector<byte>> const & payloads)
+{
+  std::vector<byte> out;
+  std::size_t in_total = 0;
+  std::size_t saved = 0;
+  std::size_t skipped = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0 ; i < ITERATIONS ; ++i) {
+    auto & payload = payloads[i % payloads.size()];
+    in_total += payload.size();
+    if (comp.compress(out, payload.data(), payload.size())) {
+      saved += payload.size() - out.size();
+    }
+    else {
+      ++skipped;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  std::cout << name << ": "
+    << (static_cast<double>(ns) / ITERATIONS) << " ns/payload, "
+    << (100.0 * saved / in_total) << "% saved, "
+    << (static_cast<double>(saved) / ns * 1000) << " Bytes saved/us, "
+    << skipped << " skipped" << std::endl;
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  std::mt19937 gen{42};
+
+  if (!payload_compression::available(CODEC_LZ4)
+      && !payload_compression::available(CODEC_ZSTD))
+  {
+    std::cout << "No compression codecs available." << std::endl;
+    return 0;
+  }
+
+  auto dictionary = telemetry(4096, gen);
+
+  for (std::size_t size : { 64, 256, 1024 }) {
+    std::vector<std::vector<byte>> compressible;
+    std::vector<std::vector<byte>> incompressible;
+    for (std::size_t i = 0 ; i < 64 ; ++i) {
+      compressible.push_back(telemetry(size, gen));
+      incompressible.push_back(noise(size, gen));
+    }
+
+    auto suffix = " (" + std::to_string(size) + " Bytes)";
+
+    payload_compression plain;
+    measure("telemetry" + suffix, plain, compressible);
+    measure("random" + suffix, plain, incompressible);
+
+    // The dictionary applies up to the small size threshold, so raise it to
+    // cover all sizes for comparison.
+    payload_compression with_dict{size};
+    if (with_dict.set_dictionary(dictionary.data(), dictionary.size())) {
+      measure("telemetry, zstd dictionary" + suffix, with_dict,
+          compressible);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <channeler/packet.h>
+#include <channeler/message.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t ITERATIONS = 1'000'000;
+
+// Prevent the compiler from optimizing the loops away.
+volatile std::size_t sink = 0;
+
+template <typename funcT>
+void
+measure(char const * name, funcT && func)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0 ; i < ITERATIONS ; ++i) {
+    sink = sink + func();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  std::cout << name << ": " << (static_cast<double>(ns) / ITERATIONS)
+    << " ns/call" << std::endl;
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  using namespace channeler;
+
+  // A packet with a packet size below the envelope size, as an attacker
+  // might send.
+  std::vector<byte> packet(packet_wrapper::envelope_size(), byte{0});
+  auto offset = public_header_layout::PUB_OFFS_PACKET_SIZE;
+  packet[offset] = byte{0x00};
+  packet[offset + 1] = byte{0x10};
+
+  // A message of an unknown type.
+  std::vector<byte> message{byte{0x7f}, byte{0x00}};
+
+#if CHANNELER_EXCEPTIONS
+  // Baseline: validating constructors, as the ingress path used to do.
+  measure("reject malformed packet (exception)", [&]() -> std::size_t
+  {
+    try {
+      packet_wrapper pkt{packet.data(), packet.size()};
+      return pkt.packet_size();
+    } catch (exception const & ex) {
+      return ex.code();
+    }
+  });
+#endif
+
+  measure("reject malformed packet (result)", [&]() -> std::size_t
+  {
+    auto pkt = packet_wrapper::create(packet.data(), packet.size());
+    return pkt ? pkt->packet_size() : pkt.error();
+  });
+
+#if CHANNELER_EXCEPTIONS
+  measure("reject unknown message (exception)", [&]() -> std::size_t
+  {
+    try {
+      channeler::message msg{message.data(), message.size()};
+      return msg.buffer_size;
+    } catch (exception const & ex) {
+      return ex.code();
+    }
+  });
+#endif
+
+  measure("reject unknown message (parse)", [&]() -> std::size_t
+  {
+    channeler::message msg{message.data(), message.size(), false};
+    return msg.parse().first;
+  });
+
+  measure("reject unknown message (result)", [&]() -> std::size_t
+  {
+    auto msg = channeler::message::create(message.data(), message.size());
+    return msg ? msg->buffer_size : msg.error();
+  });
+
+  return 0;
+}
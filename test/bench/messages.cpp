@@ -0,0 +1,129 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/wire.h"
+
+#include <channeler/message.h>
+
+#include <liberate/serialization/integer.h>
+#include <liberate/serialization/varint.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+constexpr std::size_t ITERATIONS = 1'000'000;
+
+// Prevent the compiler from optimizing the loops away.
+volatile std::size_t sink = 0;
+
+template <typename funcT>
+void
+measure(char const * name, funcT && func)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0 ; i < ITERATIONS ; ++i) {
+    sink = sink + func();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  std::cout << name << ": " << (static_cast<double>(ns) / ITERATIONS)
+    << " ns/call" << std::endl;
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  using namespace channeler;
+
+  auto msg = std::unique_ptr<message>(new message_channel_acknowledge{
+      channelid{0xbeef, 0xd00d}, 0xbeefb4be, 0xdeadd00d});
+  byte buf[64] = {};
+  auto size = serialize_message(buf, sizeof(buf), msg);
+
+  // Baseline: per-field liberate calls, each bounds checked, as the
+  // message codec used to do.
+  measure("parse MSG_CHANNEL_ACKNOWLEDGE (liberate)", [&]() -> std::size_t
+  {
+    liberate::types::varint type;
+    auto used = liberate::serialization::deserialize_varint(type, buf, size);
+    byte const * offset = buf + used;
+    std::size_t remaining = size - used;
+
+    channelid::full_type id;
+    cookie_serialize c1;
+    cookie_serialize c2;
+    used = liberate::serialization::deserialize_int(id, offset, remaining);
+    if (used != sizeof(id)) return 0;
+    offset += used; remaining -= used;
+    used = liberate::serialization::deserialize_int(c1, offset, remaining);
+    if (used != sizeof(c1)) return 0;
+    offset += used; remaining -= used;
+    used = liberate::serialization::deserialize_int(c2, offset, remaining);
+    if (used != sizeof(c2)) return 0;
+    return id ^ c1 ^ c2;
+  });
+
+  measure("parse MSG_CHANNEL_ACKNOWLEDGE (wire)", [&]() -> std::size_t
+  {
+    std::size_t type;
+    auto used = support::decode_varint(type, buf, size);
+    using layout = support::fixed_layout<channelid::full_type,
+          cookie_serialize, cookie_serialize>;
+    if (used + layout::size > size) return 0;
+
+    channelid::full_type id;
+    cookie_serialize c1;
+    cookie_serialize c2;
+    layout::read(buf + used, id, c1, c2);
+    return id ^ c1 ^ c2;
+  });
+
+  // Includes allocating the message.
+  measure("parse_message MSG_CHANNEL_ACKNOWLEDGE", [&]() -> std::size_t
+  {
+    auto parsed = parse_message(buf, size);
+    return parsed->buffer_size;
+  });
+
+  measure("serialize MSG_CHANNEL_ACKNOWLEDGE", [&]() -> std::size_t
+  {
+    return serialize_message(buf, sizeof(buf), msg);
+  });
+
+  measure("serialized_size MSG_CHANNEL_ACKNOWLEDGE", [&]() -> std::size_t
+  {
+    return msg->serialized_size();
+  });
+
+  byte payload[32] = {};
+  auto data = message_data::create(payload, sizeof(payload));
+  measure("serialize MSG_DATA", [&]() -> std::size_t
+  {
+    return serialize_message(buf, sizeof(buf), data);
+  });
+
+  return 0;
+}
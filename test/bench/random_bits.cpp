@@ -0,0 +1,96 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/random_bits.h"
+#include "../lib/support/exponential_backoff.h"
+
+#include <channeler/channelid.h>
+#include <channeler/peerid.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace {
+
+constexpr std::size_t ITERATIONS = 1'000'000;
+
+// Prevent the compiler from optimizing the loops away.
+volatile uint64_t sink = 0;
+
+template <typename funcT>
+void
+measure(char const * name, std::size_t iterations, funcT && func)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0 ; i < iterations ; ++i) {
+    sink = sink + func();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  std::cout << name << ": " << (static_cast<double>(ns) / iterations)
+    << " ns/call" << std::endl;
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  using namespace channeler;
+
+  // Baseline: what we used to do per call.
+  measure("seeded default_random_engine", ITERATIONS, []
+  {
+    std::default_random_engine gen{static_cast<
+      std::default_random_engine::result_type>(
+        std::chrono::system_clock::now().time_since_epoch().count())};
+    return static_cast<uint64_t>(gen());
+  });
+
+  measure("random_bits<uint64_t>", ITERATIONS, []
+  {
+    return support::random_bits<uint64_t>{}.get();
+  });
+
+  measure("secure_random_bits<uint64_t>", ITERATIONS / 10, []
+  {
+    return support::secure_random_bits<uint64_t>{}.get();
+  });
+
+  measure("backoff_multiplier", ITERATIONS, []
+  {
+    return static_cast<uint64_t>(support::backoff_multiplier(5));
+  });
+
+  measure("create_new_channelid", ITERATIONS, []
+  {
+    return static_cast<uint64_t>(create_new_channelid().initiator);
+  });
+
+  measure("peerid", ITERATIONS / 10, []
+  {
+    return std::to_integer<uint64_t>(peerid{}.raw[0]);
+  });
+
+  return 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Replay a packet trace into a connection, and report throughput and
+ * per-stage timings.
+ *
+ * Usage: replay_bench [--realtime] [capture.pcapng]
+ *
+ * Without a capture file, a trace is recorded first from a local exchange
+ * between two connections, so the benchmark is self-contained.
+ *
+ * The replaying node takes the identity of the first inbound packet's
+ * recipient. Nodes here use an empty cookie secret; traces from nodes with
+ * other secrets replay, but channel establishment will fail.
+ */
+#include "../lib/internal/api.h"
+#include "../lib/context/node.h"
+#include "../lib/context/connection.h"
+#include "../lib/capture/pcapng.h"
+#include "../lib/capture/replay.h"
+#include "../lib/support/virtual_clock.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t PACKET_SIZE = 1500;
+constexpr std::size_t MESSAGES = 10'000;
+constexpr std::size_t MESSAGE_SIZE = 100;
+
+using address_t = int;
+
+using node_t = ::channeler::context::node<
+  3 // POOL_BLOCK_SIZE
+>;
+
+using connection_t = ::channeler::context::connection<
+  address_t,
+  node_t
+>;
+
+using api_t = channeler::internal::connection_api<
+  connection_t
+>;
+
+std::vector<channeler::byte>
+empty_secret()
+{
+  return {};
+}
+
+
+/**
+ * Forward each packet to the other connection's API.
+ */
+struct loop
+{
+  api_t * self = nullptr;
+  api_t * peer = nullptr;
+
+  void packet_to_send(channeler::channelid const & channel)
+  {
+    auto entry = self->packet_to_send(channel);
+    auto slot = peer->allocate();
+    std::memcpy(slot.data(), entry.packet.buffer(), slot.size());
+    peer->received_packet(123, 321, slot);
+  }
+};
+
+
+/**
+ * Record the responder's side of a channel establishment followed by data
+ * transfer.
+ */
+std::vector<channeler::byte>
+record_trace()
+{
+  using namespace channeler;
+  using namespace std::placeholders;
+
+  std::vector<byte> trace;
+  capture::packet_capture cap{
+    [&trace](byte const * buf, std::size_t size)
+    {
+      trace.insert(trace.end(), buf, buf + size);
+    }};
+
+  peerid initiator_id;
+  peerid responder_id;
+  support::virtual_clock clock;
+
+  node_t initiator_node{initiator_id, PACKET_SIZE, empty_secret,
+    clock.sleep_function()};
+  node_t responder_node{responder_id, PACKET_SIZE, empty_secret,
+    clock.sleep_function()};
+  connection_t ctx1{initiator_node, responder_id};
+  connection_t ctx2{responder_node, initiator_id};
+
+  loop loop1;
+  loop loop2;
+  channelid established = DEFAULT_CHANNELID;
+
+  api_t initiator{ctx1,
+    [&established](channeler::error_t, channelid const & id) { established = id; },
+    std::bind(&loop::packet_to_send, &loop1, _1),
+    [](channelid const &, std::size_t) {}};
+  api_t responder{ctx2,
+    [](channeler::error_t, channelid const &) {},
+    std::bind(&loop::packet_to_send, &loop2, _1),
+    [&responder = loop2.self](channelid const & id, std::size_t size)
+    {
+      // Drain, so buffers do not grow.
+      std::vector<byte> buf(size);
+      std::size_t read = 0;
+      responder->channel_read(id, buf.data(), buf.size(), read);
+    }};
+  loop1 = {&initiator, &responder};
+  loop2 = {&responder, &initiator};
+
+  responder.set_packet_capture(&cap);
+
+  if (ERR_SUCCESS != initiator.establish_channel(responder_id)
+      || DEFAULT_CHANNELID == established)
+  {
+    std::cerr << "Could not establish channel." << std::endl;
+    return {};
+  }
+
+  std::vector<byte> message(MESSAGE_SIZE, byte{0x42});
+  for (std::size_t i = 0 ; i < MESSAGES ; ++i) {
+    std::size_t written = 0;
+    initiator.channel_write(established, message.data(), message.size(),
+        written);
+    initiator.process_timeouts(std::chrono::microseconds{10});
+  }
+
+  responder.set_packet_capture(nullptr);
+  cap.flush();
+  if (cap.dropped()) {
+    std::cerr << "Dropped " << cap.dropped() << " packets while recording."
+      << std::endl;
+  }
+  return trace;
+}
+
+
+std::vector<channeler::byte>
+read_file(char const * path)
+{
+  std::ifstream in{path, std::ios::binary};
+  if (!in) {
+    std::cerr << "Could not open " << path << std::endl;
+    return {};
+  }
+  std::vector<char> raw{std::istreambuf_iterator<char>{in},
+    std::istreambuf_iterator<char>{}};
+  std::vector<channeler::byte> ret(raw.size());
+  std::memcpy(ret.data(), raw.data(), raw.size());
+  return ret;
+}
+
+
+double
+ms(std::chrono::nanoseconds const & ns)
+{
+  return ns.count() / 1e6;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char ** argv)
+{
+  using namespace channeler;
+
+  bool realtime = false;
+  char const * path = nullptr;
+  for (int i = 1 ; i < argc ; ++i) {
+    if (std::string{"--realtime"} == argv[i]) {
+      realtime = true;
+    }
+    else {
+      path = argv[i];
+    }
+  }
+
+  auto trace = path ? read_file(path) : record_trace();
+  std::vector<capture::capture_record> records;
+  auto err = capture::pcapng_read(trace.data(), trace.size(), records);
+  if (ERR_SUCCESS != err) {
+    std::cerr << "Could not read trace: " << error_name(err) << std::endl;
+    return 1;
+  }
+
+  // Take on the identity of the recipient.
+  peerid self;
+  peerid peer;
+  for (auto & rec : records) {
+    if (capture::CAPTURE_OUTBOUND != rec.direction
+        && rec.captured >= public_header_layout::PUB_SIZE)
+    {
+      public_header_fields header{rec.data};
+      self = header.recipient.copy();
+      peer = header.sender.copy();
+      break;
+    }
+  }
+
+  support::virtual_clock clock{realtime};
+  node_t node{self, PACKET_SIZE, empty_secret, clock.sleep_function()};
+  connection_t ctx{node, peer};
+
+  std::size_t responses = 0;
+  api_t * api_ptr = nullptr;
+  api_t api{ctx,
+    [](channeler::error_t, channelid const &) {},
+    [&](channelid const & id)
+    {
+      api_ptr->packet_to_send(id);
+      ++responses;
+    },
+    [&](channelid const & id, std::size_t size)
+    {
+      std::vector<byte> buf(size);
+      std::size_t read = 0;
+      api_ptr->channel_read(id, buf.data(), buf.size(), read);
+    }};
+  api_ptr = &api;
+
+  auto stats = capture::replay(api, records);
+
+  std::cout << "Records:        " << records.size() << std::endl;
+  std::cout << "Replayed:       " << stats.packets << " packets, "
+    << stats.bytes << " Bytes" << std::endl;
+  std::cout << "Skipped:        " << stats.skipped << std::endl;
+  std::cout << "Errors:         " << stats.errors << std::endl;
+  std::cout << "Responses:      " << responses << std::endl;
+  std::cout << "Trace time:     " << ms(stats.trace_time) << " ms" << std::endl;
+  std::cout << "Replay time:    " << ms(stats.total_time) << " ms" << std::endl;
+  std::cout << "  ingress:      " << ms(stats.ingress_time) << " ms" << std::endl;
+  std::cout << "  timeouts:     " << ms(stats.timeouts_time) << " ms" << std::endl;
+  std::cout << "Throughput:     " << stats.packets_per_second() << " packets/s, "
+    << (stats.bytes_per_second() / 1e6) << " MB/s" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2019-2020 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef CHANNELER_TEST_EXCEPTIONS_H
+#define CHANNELER_TEST_EXCEPTIONS_H
+
+#include <gtest/gtest.h>
+
+#include <channeler.h>
+
+/**
+ * The library can be built without exception support, in which case it
+ * aborts where it would otherwise throw. These macros let the same tests run
+ * in either configuration; without exceptions, expected exceptions become
+ * expected deaths.
+ */
+#if CHANNELER_EXCEPTIONS
+#  define CHANNELER_ASSERT_THROW(statement, exception_type) \
+  ASSERT_THROW(statement, exception_type)
+#  define CHANNELER_ASSERT_NO_THROW(statement) ASSERT_NO_THROW(statement)
+#  define CHANNELER_EXPECT_NO_THROW(statement) EXPECT_NO_THROW(statement)
+#else
+#  define CHANNELER_ASSERT_THROW(statement, exception_type) \
+  ASSERT_DEATH(statement, "")
+#  define CHANNELER_ASSERT_NO_THROW(statement) { statement; }
+#  define CHANNELER_EXPECT_NO_THROW(statement) { statement; }
+#endif
+
+#endif // guard
@@ -42,6 +42,10 @@ channeler::byte const message_channel_new[] = {
   0xbe_b, 0xef_b, // Half channel ID
 
   0xbe_b, 0xef_b, 0xb4_b, 0xbe_b, // crc32 (cookie)
+
+  0x00_b, 0x00_b, // Capabilities
+
+  0x00_b, 0x00_b, 0xd1_b, 0xc7_b, // Dictionary id
 };
 std::size_t const message_channel_new_size = sizeof(message_channel_new);
 
@@ -54,6 +58,8 @@ channeler::byte const message_channel_acknowledge[] = {
 
   0xbe_b, 0xef_b, 0xb4_b, 0xbe_b, // crc32 (cookie1)
   0xde_b, 0xad_b, 0xd0_b, 0x0d_b, // crc32 (cookie2)
+
+  0x00_b, 0x00_b, // Capabilities
 };
 std::size_t const message_channel_acknowledge_size = sizeof(message_channel_acknowledge);
 
@@ -64,7 +70,7 @@ channeler::byte const message_channel_finalize[] = {
 
   0xbe_b, 0xef_b, 0xd0_b, 0x0d_b, // Channel ID
 
-  0x39_b, 0x87_b, 0x88_b, 0x6e_b, // crc32 (cookie); used in FSM for channel responder
+  0x59_b, 0x9e_b, 0x64_b, 0x47_b, // crc32 (cookie); used in FSM for channel responder
 
   0x00_b, 0x00_b, // Capabilities
 };
@@ -85,6 +91,17 @@ std::size_t const message_channel_cookie_size = sizeof(message_channel_cookie);
 
 
 
+channeler::byte const message_ecn_feedback[] = {
+  0x1e_b, // MSG_ECN_FEEDBACK
+
+  0x00_b, 0x00_b, 0x01_b, 0x00_b, // ECT(0) count
+  0x00_b, 0x00_b, 0x00_b, 0x00_b, // ECT(1) count
+  0x00_b, 0x00_b, 0x00_b, 0x03_b, // CE count
+};
+std::size_t const message_ecn_feedback_size = sizeof(message_ecn_feedback);
+
+
+
 
 channeler::byte const message_data[] = {
   0x14_b, // MSG_DATA
@@ -113,6 +130,10 @@ channeler::byte const message_block[] = {
 
   0xbe_b, 0xef_b, 0xb4_b, 0xbe_b, // crc32 (cookie)
 
+  0x00_b, 0x00_b, // Capabilities
+
+  0x00_b, 0x00_b, 0x00_b, 0x00_b, // Dictionary id
+
   // ---
   0x0d_b, // MSG_CHANNEL_COOKIE
 
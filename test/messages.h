@@ -42,6 +42,9 @@ extern std::size_t const message_channel_finalize_size;
 extern channeler::byte const message_channel_cookie[];
 extern std::size_t const message_channel_cookie_size;
 
+extern channeler::byte const message_ecn_feedback[];
+extern std::size_t const message_ecn_feedback_size;
+
 extern channeler::byte const message_data[];
 extern std::size_t const message_data_size;
 
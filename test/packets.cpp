@@ -251,14 +251,14 @@ channeler::byte const packet_with_messages[] = {
   0xa0_b, 0x0a_b,
 
   // Packet size
-  0x00_b, 0x4e_b,
+  0x00_b, 0x54_b,
 
   // **** private header
   // Sequence number - a random one is fine
   0x01_b, 0xfa_b,
 
   // Payload size - no payload
-  0x00_b, 0x1a_b,
+  0x00_b, 0x20_b,
  
   // **** payload
   0x14_b, // MSG_DATA
@@ -275,6 +275,10 @@ channeler::byte const packet_with_messages[] = {
 
   0xbe_b, 0xef_b, 0xb4_b, 0xbe_b, // crc32 (cookie)
 
+  0x00_b, 0x00_b, // Capabilities
+
+  0x00_b, 0x00_b, 0x00_b, 0x00_b, // Dictionary id
+
   // ---
   0x0d_b, // MSG_CHANNEL_COOKIE
 
@@ -289,7 +293,7 @@ channeler::byte const packet_with_messages[] = {
 
   // **** footer
   // Checksum
-  0x02_b, 0xdd_b, 0x6d_b, 0xe1_b,
+  0xcc_b, 0x4e_b, 0x55_b, 0xc4_b,
 };
 std::size_t const packet_with_messages_size = sizeof(packet_with_messages);
 
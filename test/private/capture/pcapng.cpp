@@ -0,0 +1,273 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/capture/pcapng.h"
+
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../exceptions.h"
+
+namespace {
+
+using namespace channeler::capture;
+
+struct vector_sink
+{
+  std::mutex                    mutex;
+  std::vector<channeler::byte>  data;
+
+  inline channeler::support::async_writer::sink sink()
+  {
+    return [this](channeler::byte const * buf, std::size_t size)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      data.insert(data.end(), buf, buf + size);
+    };
+  }
+};
+
+template <typename T>
+inline T
+read(std::vector<channeler::byte> const & buf, std::size_t offset)
+{
+  T ret;
+  std::memcpy(&ret, buf.data() + offset, sizeof(ret));
+  return ret;
+}
+
+constexpr std::size_t HEADER_SIZE = PCAPNG_SECTION_HEADER_SIZE
+  + PCAPNG_INTERFACE_DESCRIPTION_SIZE;
+
+std::vector<channeler::byte> const packet(13, channeler::byte{0xab});
+
+} // anonymous namespace
+
+
+TEST(CapturePcapng, header_blocks)
+{
+  vector_sink out;
+  {
+    capture_options opts;
+    opts.snaplen = 100;
+    packet_capture cap{out.sink(), opts};
+    cap.flush();
+  }
+
+  ASSERT_EQ(HEADER_SIZE, out.data.size());
+
+  // Section header
+  ASSERT_EQ(PCAPNG_BLOCK_SECTION_HEADER, read<uint32_t>(out.data, 0));
+  ASSERT_EQ(PCAPNG_SECTION_HEADER_SIZE, read<uint32_t>(out.data, 4));
+  ASSERT_EQ(PCAPNG_BYTE_ORDER_MAGIC, read<uint32_t>(out.data, 8));
+  ASSERT_EQ(1, read<uint16_t>(out.data, 12));
+  ASSERT_EQ(0, read<uint16_t>(out.data, 14));
+  ASSERT_EQ(-1, read<int64_t>(out.data, 16));
+  ASSERT_EQ(PCAPNG_SECTION_HEADER_SIZE, read<uint32_t>(out.data, 24));
+
+  // Interface description
+  auto idb = PCAPNG_SECTION_HEADER_SIZE;
+  ASSERT_EQ(PCAPNG_BLOCK_INTERFACE_DESCRIPTION, read<uint32_t>(out.data, idb));
+  ASSERT_EQ(PCAPNG_INTERFACE_DESCRIPTION_SIZE, read<uint32_t>(out.data, idb + 4));
+  ASSERT_EQ(PCAPNG_LINKTYPE_USER0, read<uint16_t>(out.data, idb + 8));
+  ASSERT_EQ(100, read<uint32_t>(out.data, idb + 12));
+  ASSERT_EQ(PCAPNG_INTERFACE_DESCRIPTION_SIZE, read<uint32_t>(out.data, idb + 16));
+}
+
+
+TEST(CapturePcapng, enhanced_packet_block)
+{
+  vector_sink out;
+  packet_capture cap{out.sink()};
+
+  auto when = std::chrono::system_clock::time_point{
+    std::chrono::microseconds{0x100000002}};
+  ASSERT_TRUE(cap.capture(CAPTURE_OUTBOUND, packet.data(), packet.size(), when));
+  cap.flush();
+
+  ASSERT_EQ(1, cap.captured());
+  ASSERT_EQ(HEADER_SIZE + pcapng_enhanced_packet_size(packet.size()),
+      out.data.size());
+
+  auto epb = HEADER_SIZE;
+  uint32_t total = 32 + 16 + 12;
+  ASSERT_EQ(PCAPNG_BLOCK_ENHANCED_PACKET, read<uint32_t>(out.data, epb));
+  ASSERT_EQ(total, read<uint32_t>(out.data, epb + 4));
+  ASSERT_EQ(0, read<uint32_t>(out.data, epb + 8));
+  ASSERT_EQ(1, read<uint32_t>(out.data, epb + 12));
+  ASSERT_EQ(2, read<uint32_t>(out.data, epb + 16));
+  ASSERT_EQ(packet.size(), read<uint32_t>(out.data, epb + 20));
+  ASSERT_EQ(packet.size(), read<uint32_t>(out.data, epb + 24));
+  ASSERT_EQ(0, std::memcmp(packet.data(), out.data.data() + epb + 28,
+        packet.size()));
+
+  // Padding, then the flags option.
+  ASSERT_EQ(channeler::byte{0}, out.data[epb + 28 + packet.size()]);
+  ASSERT_EQ(PCAPNG_OPT_EPB_FLAGS, read<uint16_t>(out.data, epb + 44));
+  ASSERT_EQ(4, read<uint16_t>(out.data, epb + 46));
+  ASSERT_EQ(CAPTURE_OUTBOUND, read<uint32_t>(out.data, epb + 48));
+  ASSERT_EQ(PCAPNG_OPT_ENDOFOPT, read<uint16_t>(out.data, epb + 52));
+  ASSERT_EQ(total, read<uint32_t>(out.data, epb + total - 4));
+}
+
+
+TEST(CapturePcapng, snaplen)
+{
+  vector_sink out;
+  capture_options opts;
+  opts.snaplen = 5;
+  packet_capture cap{out.sink(), opts};
+
+  ASSERT_TRUE(cap.capture(CAPTURE_INBOUND, packet.data(), packet.size()));
+  cap.flush();
+
+  ASSERT_EQ(HEADER_SIZE + pcapng_enhanced_packet_size(5), out.data.size());
+  ASSERT_EQ(5, read<uint32_t>(out.data, HEADER_SIZE + 20));
+  ASSERT_EQ(packet.size(), read<uint32_t>(out.data, HEADER_SIZE + 24));
+}
+
+
+TEST(CapturePcapng, sampling)
+{
+  vector_sink out;
+  capture_options opts;
+  opts.sample_every = 3;
+  packet_capture cap{out.sink(), opts};
+
+  for (std::size_t i = 0 ; i < 9 ; ++i) {
+    cap.capture(CAPTURE_INBOUND, packet.data(), packet.size());
+  }
+  cap.flush();
+
+  ASSERT_EQ(9, cap.seen());
+  ASSERT_EQ(3, cap.captured());
+  ASSERT_EQ(HEADER_SIZE + 3 * pcapng_enhanced_packet_size(packet.size()),
+      out.data.size());
+
+  opts.sample_every = 0;
+  CHANNELER_ASSERT_THROW((packet_capture{out.sink(), opts}), channeler::exception);
+}
+
+
+TEST(CapturePcapng, drop_when_behind)
+{
+  // A sink that does not return until released keeps the writer busy; the
+  // buffer then fills up and further packets are dropped rather than
+  // blocking the caller.
+  std::mutex gate;
+  std::unique_lock<std::mutex> held{gate};
+  std::size_t received = 0;
+
+  capture_options opts;
+  opts.buffer_size = HEADER_SIZE + 2 * pcapng_enhanced_packet_size(packet.size());
+  packet_capture cap{
+    [&](channeler::byte const *, std::size_t size)
+    {
+      std::lock_guard<std::mutex> lock{gate};
+      received += size;
+    },
+    opts};
+
+  // Wait for the writer to pick up the header and block in the sink.
+  while (cap.dropped() == 0
+      && cap.capture(CAPTURE_INBOUND, packet.data(), packet.size()))
+  {
+    std::this_thread::yield();
+  }
+
+  // Nothing could be written while blocked, so at most two buffers' worth
+  // of packets made it.
+  ASSERT_GT(cap.dropped(), 0);
+  ASSERT_LE(cap.captured(), 4);
+
+  held.unlock();
+  cap.flush();
+  ASSERT_EQ(HEADER_SIZE + cap.captured() * pcapng_enhanced_packet_size(packet.size()),
+      received);
+}
+
+
+TEST(CapturePcapng, read_back)
+{
+  vector_sink out;
+  {
+    capture_options opts;
+    opts.snaplen = 5;
+    packet_capture cap{out.sink(), opts};
+
+    auto when = std::chrono::system_clock::time_point{
+      std::chrono::microseconds{1000}};
+    cap.capture(CAPTURE_INBOUND, packet.data(), 3, when);
+    cap.capture(CAPTURE_OUTBOUND, packet.data(), packet.size(),
+        when + std::chrono::microseconds{1});
+    cap.flush();
+  }
+
+  std::vector<capture_record> records;
+  ASSERT_EQ(channeler::ERR_SUCCESS,
+      pcapng_read(out.data.data(), out.data.size(), records));
+  ASSERT_EQ(2, records.size());
+
+  ASSERT_EQ(CAPTURE_INBOUND, records[0].direction);
+  ASSERT_EQ(std::chrono::microseconds{1000}, records[0].timestamp);
+  ASSERT_EQ(3, records[0].captured);
+  ASSERT_EQ(3, records[0].original);
+  ASSERT_EQ(0, std::memcmp(packet.data(), records[0].data, 3));
+
+  ASSERT_EQ(CAPTURE_OUTBOUND, records[1].direction);
+  ASSERT_EQ(std::chrono::microseconds{1001}, records[1].timestamp);
+  ASSERT_EQ(5, records[1].captured);
+  ASSERT_EQ(packet.size(), records[1].original);
+}
+
+
+TEST(CapturePcapng, read_malformed)
+{
+  vector_sink out;
+  {
+    packet_capture cap{out.sink()};
+    cap.capture(CAPTURE_INBOUND, packet.data(), packet.size());
+    cap.flush();
+  }
+
+  std::vector<capture_record> records;
+  ASSERT_EQ(channeler::ERR_INVALID_REFERENCE,
+      pcapng_read(nullptr, out.data.size(), records));
+
+  // Truncated
+  ASSERT_EQ(channeler::ERR_DECODE,
+      pcapng_read(out.data.data(), out.data.size() - 4, records));
+
+  // Packet before section header
+  ASSERT_EQ(channeler::ERR_DECODE,
+      pcapng_read(out.data.data() + HEADER_SIZE,
+        out.data.size() - HEADER_SIZE, records));
+
+  // Byte order we cannot read
+  auto swapped = out.data;
+  std::swap(swapped[8], swapped[11]);
+  std::swap(swapped[9], swapped[10]);
+  ASSERT_EQ(channeler::ERR_DECODE,
+      pcapng_read(swapped.data(), swapped.size(), records));
+}
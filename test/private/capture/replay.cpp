@@ -0,0 +1,114 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/capture/replay.h"
+#include "../lib/internal/api.h"
+#include "../lib/context/node.h"
+#include "../lib/context/connection.h"
+#include "../lib/support/virtual_clock.h"
+
+#include <gtest/gtest.h>
+
+#include "../../packets.h"
+
+namespace {
+
+using address_t = int;
+
+using node_t = ::channeler::context::node<
+  3 // POOL_BLOCK_SIZE
+>;
+
+using connection_t = ::channeler::context::connection<
+  address_t,
+  node_t
+>;
+
+using api_t = channeler::internal::connection_api<
+  connection_t
+>;
+
+} // anonymous namespace
+
+
+TEST(CaptureReplay, virtual_clock)
+{
+  using namespace std::chrono_literals;
+  channeler::support::virtual_clock clock;
+  auto sleep = clock.sleep_function();
+
+  ASSERT_EQ(0ns, clock.now());
+  ASSERT_EQ(5ms, sleep(5ms));
+  ASSERT_EQ(5ms, clock.now());
+  sleep(1ns);
+  ASSERT_EQ(5000001ns, clock.now());
+}
+
+
+TEST(CaptureReplay, replay_records)
+{
+  using namespace channeler;
+  using namespace channeler::capture;
+  using namespace std::chrono_literals;
+
+  support::virtual_clock clock;
+  peerid self;
+  peerid peer;
+  node_t node{self, 120,
+    []() -> std::vector<byte> { return {}; },
+    clock.sleep_function()};
+  connection_t ctx{node, peer};
+  api_t api{ctx,
+    [](channeler::error_t, channelid const &) {},
+    [](channelid const &) {},
+    [](channelid const &, std::size_t) {}};
+
+  auto packet = [](capture_direction dir, std::chrono::nanoseconds ts,
+      std::size_t captured = test::packet_default_channel_size)
+  {
+    capture_record rec;
+    rec.direction = dir;
+    rec.timestamp = ts;
+    rec.data = test::packet_default_channel;
+    rec.captured = captured;
+    rec.original = test::packet_default_channel_size;
+    return rec;
+  };
+
+  std::vector<capture_record> records = {
+    packet(CAPTURE_INBOUND, 10ms),
+    packet(CAPTURE_OUTBOUND, 11ms),   // Skipped; not counted at all
+    packet(CAPTURE_UNKNOWN, 15ms),
+    packet(CAPTURE_INBOUND, 14ms),    // Out of order; no time passes
+    packet(CAPTURE_INBOUND, 20ms, 5), // Truncated
+  };
+
+  auto stats = replay(api, records);
+
+  ASSERT_EQ(3, stats.packets);
+  ASSERT_EQ(3 * test::packet_default_channel_size, stats.bytes);
+  ASSERT_EQ(1, stats.skipped);
+  ASSERT_EQ(0, stats.errors);
+
+  // The virtual clock advanced by the gaps between inbound packets.
+  ASSERT_EQ(10ms, stats.trace_time);
+  ASSERT_EQ(10ms, clock.now());
+  ASSERT_GT(stats.total_time.count(), 0);
+}
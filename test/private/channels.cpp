@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include "../exceptions.h"
+
 namespace {
 
 struct channel
@@ -168,3 +170,32 @@ TEST(Channels, add_default_channel)
   auto ptr = chs.get(id);
   ASSERT_TRUE(ptr);
 }
+
+
+
+TEST(Channels, exhaust_identifiers)
+{
+  using namespace channeler;
+
+  channels<channel> chs;
+
+  // Every initiator part except the default one can be allocated exactly
+  // once; after that, allocation fails rather than looping forever.
+  std::size_t count = 0;
+  channelid::half_type initiator;
+  while (ERR_SUCCESS == chs.new_pending_channel(initiator)) {
+    ASSERT_NE(DEFAULT_CHANNELID.initiator, initiator);
+    ++count;
+  }
+  ASSERT_EQ(65535, count);
+  ASSERT_EQ(65535, chs.size());
+  ASSERT_EQ(ERR_CHANNELID_EXHAUSTED, chs.new_pending_channel(initiator));
+  CHANNELER_ASSERT_THROW(chs.new_pending_channel(), exception);
+
+  // Freeing a single identifier makes exactly that one available again.
+  channelid::half_type freed = 0x1234;
+  chs.remove(freed);
+  ASSERT_EQ(ERR_SUCCESS, chs.new_pending_channel(initiator));
+  ASSERT_EQ(freed, initiator);
+  ASSERT_TRUE(chs.has_pending_channel(freed));
+}
@@ -0,0 +1,99 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/fixed_packet.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../packets.h"
+
+using namespace channeler;
+
+
+TEST(FixedPacket, constants)
+{
+  using pkt_t = fixed_packet<128>;
+
+  static_assert(pkt_t::envelope_size == packet_wrapper::envelope_size());
+  static_assert(pkt_t::MAX_PAYLOAD_SIZE == 128 - packet_wrapper::envelope_size());
+  static_assert(pkt_t::FOOTER_OFFSET == 128 - packet_wrapper::footer_size());
+  static_assert(pkt_t::PAYLOAD_OFFSET == packet_wrapper::public_header_size()
+      + packet_wrapper::private_header_size());
+}
+
+
+TEST(FixedPacket, read_existing_packet)
+{
+  // The test packet is empty, i.e. consists only of the envelope.
+  std::vector<byte> data{test::packet_default_channel,
+    test::packet_default_channel + test::packet_default_channel_size};
+  ASSERT_EQ(packet_wrapper::envelope_size(), data.size());
+
+  fixed_packet<packet_wrapper::envelope_size()> fixed{data.data()};
+  packet_wrapper pkt{data.data(), data.size()};
+
+  ASSERT_EQ(pkt.proto(), fixed.proto());
+  ASSERT_EQ(pkt.sender(), fixed.sender());
+  ASSERT_EQ(pkt.recipient(), fixed.recipient());
+  ASSERT_EQ(pkt.channel(), fixed.channel());
+  ASSERT_EQ(pkt.flags(), fixed.flags());
+  ASSERT_EQ(pkt.packet_size(), fixed.encoded_packet_size());
+  ASSERT_EQ(pkt.payload_size(), fixed.payload_size());
+  ASSERT_EQ(pkt.checksum(), fixed.checksum());
+  ASSERT_EQ(0, fixed.padding_size());
+  ASSERT_TRUE(fixed.has_valid_checksum());
+}
+
+
+TEST(FixedPacket, write_packet)
+{
+  using pkt_t = fixed_packet<128>;
+
+  std::vector<byte> data(pkt_t::packet_size, byte{0});
+  pkt_t fixed{data.data()};
+
+  peerid sender;
+  peerid recipient;
+  channelid id{0xbeef, 0xd00d};
+  fixed.initialize(sender, recipient, id);
+  fixed.set_sequence_no(0x1234);
+
+  byte payload[] = { byte{0x0a}, byte{0x0b}, byte{0x0c} };
+  std::memcpy(fixed.payload(), payload, sizeof(payload));
+  ASSERT_EQ(ERR_SUCCESS, fixed.finalize(sizeof(payload)));
+  ASSERT_EQ(ERR_INSUFFICIENT_BUFFER_SIZE, fixed.finalize(pkt_t::MAX_PAYLOAD_SIZE + 1));
+
+  ASSERT_EQ(ERR_SUCCESS, fixed.validate().first);
+  ASSERT_EQ(pkt_t::MAX_PAYLOAD_SIZE - sizeof(payload), fixed.padding_size());
+  ASSERT_TRUE(fixed.has_valid_checksum());
+
+  // The runtime-sized wrapper must agree.
+  auto pkt = fixed.wrapper();
+  ASSERT_TRUE(pkt.has_valid_proto());
+  ASSERT_EQ(sender, pkt.sender());
+  ASSERT_EQ(recipient, pkt.recipient());
+  ASSERT_EQ(id, pkt.channel());
+  ASSERT_EQ(pkt_t::packet_size, pkt.packet_size());
+  ASSERT_EQ(sizeof(payload), pkt.payload_size());
+  ASSERT_TRUE(pkt.has_valid_checksum());
+  ASSERT_EQ(0, std::memcmp(payload, pkt.payload(), sizeof(payload)));
+}
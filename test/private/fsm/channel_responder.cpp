@@ -43,13 +43,15 @@ TEST(FSMChannelResponder, process_bad_event)
   using namespace channeler::fsm;
   using namespace channeler::pipe;
   using namespace channeler;
+  using namespace channeler::support;
 
   // TODO I don't like having to pass the pool block size here at all.
   using channel_t = channel_data<TEST_POOL_BLOCK_SIZE>;
   using fsm_t = fsm_channel_responder<int, TEST_POOL_BLOCK_SIZE, channel_t>;
 
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
   fsm_t::channel_set chs;
-  fsm_t fsm{chs, []() {
+  fsm_t fsm{t, chs, []() {
     return fsm_t::secret_type{};
   }};
 
@@ -68,6 +70,7 @@ TEST(FSMChannelResponder, process_bad_message)
   using namespace channeler::fsm;
   using namespace channeler::pipe;
   using namespace channeler;
+  using namespace channeler::support;
 
   // TODO I don't like having to pass the pool block size here at all.
   using channel_t = channel_data<TEST_POOL_BLOCK_SIZE>;
@@ -75,8 +78,9 @@ TEST(FSMChannelResponder, process_bad_message)
   using event_t = message_event<int, TEST_POOL_BLOCK_SIZE, channel_t>;
 
   pool_type pool{TEST_PACKET_SIZE};
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
   fsm_t::channel_set chs;
-  fsm_t fsm{chs, []() { return fsm_t::secret_type{}; }};
+  fsm_t fsm{t, chs, []() { return fsm_t::secret_type{}; }};
 
   // If we feed the FSM anything other than a ET_MESSAGE event, it will return
   // false.
@@ -96,6 +100,7 @@ TEST(FSMChannelResponder, process_msg_channel_new)
   using namespace channeler::fsm;
   using namespace channeler::pipe;
   using namespace channeler;
+  using namespace channeler::support;
   using namespace test;
 
   // We create the packet just so we have a packet slot for the FSM.
@@ -111,8 +116,9 @@ TEST(FSMChannelResponder, process_msg_channel_new)
   using event_t = message_event<int, TEST_POOL_BLOCK_SIZE, channel_t>;
 
   pool_type pool{TEST_PACKET_SIZE};
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
   fsm_t::channel_set chs;
-  fsm_t fsm{chs, []() { return fsm_t::secret_type{}; }};
+  fsm_t fsm{t, chs, []() { return fsm_t::secret_type{}; }};
 
   // MSG_CHANNEL_NEW should be processed, and at this point we'll expect a
   // MSG_CHANNEL_ACKNOWLEDGE in return.
@@ -139,8 +145,12 @@ TEST(FSMChannelResponder, process_msg_channel_new)
   // Check the cookie.
   auto secret = fsm_t::secret_type{};
   auto cookie = create_cookie_responder(secret.data(), secret.size(),
-        pkt.sender(), pkt.recipient(), convmsg->id);
+        pkt.sender(), pkt.recipient(), convmsg->id, convmsg->capabilities,
+        fsm.epoch());
   ASSERT_EQ(cookie, convmsg->cookie2);
+
+  // Without supported capabilities, none are granted.
+  ASSERT_TRUE(convmsg->capabilities.none());
 }
 
 
@@ -149,6 +159,7 @@ TEST(FSMChannelResponder, process_msg_channel_finalize)
   using namespace channeler::fsm;
   using namespace channeler::pipe;
   using namespace channeler;
+  using namespace channeler::support;
   using namespace test;
 
   // We create the packet just so we have a packet slot for the FSM.
@@ -164,8 +175,9 @@ TEST(FSMChannelResponder, process_msg_channel_finalize)
   using event_t = message_event<int, TEST_POOL_BLOCK_SIZE, channel_t>;
 
   pool_type pool{TEST_PACKET_SIZE};
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
   fsm_t::channel_set chs;
-  fsm_t fsm{chs, []() { return fsm_t::secret_type{}; }};
+  fsm_t fsm{t, chs, []() { return fsm_t::secret_type{}; }};
 
   // MSG_CHANNEL_FINALIZE should be processed, but we should not get output
   // events in return. However, our channel set should afterwards contain the
@@ -175,6 +187,7 @@ TEST(FSMChannelResponder, process_msg_channel_finalize)
   auto msg = parse_message(test::message_channel_finalize, test::message_channel_finalize_size);
   auto convmsg = reinterpret_cast<channeler::message_channel_finalize *>(msg.get());
   auto expected_channel = convmsg->id;
+  auto expected_caps = convmsg->capabilities;
   ASSERT_FALSE(chs.has_established_channel(expected_channel));
 
   event_t ev{123, 321, pkt, pool.allocate(), {}, std::move(msg)};
@@ -184,8 +197,9 @@ TEST(FSMChannelResponder, process_msg_channel_finalize)
   ASSERT_EQ(0, events.size());
 
   // We need to have the channel with the given channel identifier in the set
-  // now.
+  // now, with the capabilities from the message.
   ASSERT_TRUE(chs.has_established_channel(expected_channel));
+  ASSERT_EQ(expected_caps, chs.get(expected_channel)->capabilities());
 
   // The returned action should notify us of this channel.
   auto & act = *actions.begin();
@@ -193,3 +207,134 @@ TEST(FSMChannelResponder, process_msg_channel_finalize)
   auto actconv = reinterpret_cast<notify_channel_established_action *>(act.get());
   ASSERT_EQ(actconv->channel, expected_channel);
 }
+
+
+TEST(FSMChannelResponder, reject_altered_or_expired_cookie)
+{
+  using namespace channeler::fsm;
+  using namespace channeler::pipe;
+  using namespace channeler;
+  using namespace channeler::support;
+  using namespace test;
+
+  std::vector<channeler::byte> data{packet_with_messages,
+    packet_with_messages + packet_with_messages_size};
+  channeler::packet_wrapper pkt{data.data(), data.size()};
+
+  using channel_t = channel_data<TEST_POOL_BLOCK_SIZE>;
+  using fsm_t = fsm_channel_responder<int, TEST_POOL_BLOCK_SIZE, channel_t>;
+  using event_t = message_event<int, TEST_POOL_BLOCK_SIZE, channel_t>;
+
+  capabilities_t supported;
+  supported[CAP_COMPRESSION] = true;
+
+  pool_type pool{TEST_PACKET_SIZE};
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
+  fsm_t::channel_set chs;
+  fsm_t fsm{t, chs, []() { return fsm_t::secret_type{}; },
+    [supported]() { return supported; }};
+
+  // Request more than is supported; only the supported part is granted.
+  capabilities_t requested = supported;
+  requested[CAP_RESEND] = true;
+
+  action_list_type actions;
+  event_list_type events;
+  event_t ev{123, 321, pkt, pool.allocate(), {},
+    std::make_unique<channeler::message_channel_new>(0xbeef, cookie{}, requested)
+  };
+  ASSERT_TRUE(fsm.process(&ev, actions, events));
+  ASSERT_EQ(1, events.size());
+  auto out = reinterpret_cast<message_out_event *>(events.begin()->get());
+  auto ack = reinterpret_cast<channeler::message_channel_acknowledge *>(out->message.get());
+  ASSERT_EQ(supported, ack->capabilities);
+
+  auto finalize = [&](capabilities_t const & caps)
+  {
+    action_list_type fin_actions;
+    event_list_type fin_events;
+    event_t fin{123, 321, pkt, pool.allocate(), {},
+      std::make_unique<channeler::message_channel_finalize>(ack->id, ack->cookie2, caps)
+    };
+    fsm.process(&fin, fin_actions, fin_events);
+    return chs.has_established_channel(ack->id);
+  };
+
+  auto advance_epoch = [&]()
+  {
+    auto expired = t.wait(std::chrono::microseconds{DEFAULT_RESUMPTION_LIFETIME / 2});
+    ASSERT_EQ(1, expired.size());
+    timeout_event<timeout_scoped_tag_type> tev{expired[0]};
+    action_list_type to_actions;
+    event_list_type to_events;
+    ASSERT_TRUE(fsm.process(&tev, to_actions, to_events));
+  };
+
+  // The capabilities are covered by the cookie; the initiator cannot alter
+  // them.
+  ASSERT_FALSE(finalize(requested));
+
+  // The cookie remains valid in the next epoch.
+  advance_epoch();
+  ASSERT_EQ(1, fsm.epoch());
+  ASSERT_TRUE(finalize(supported));
+  ASSERT_EQ(supported, chs.get(ack->id)->capabilities());
+
+  // But it expires in the one after.
+  chs.remove(ack->id);
+  advance_epoch();
+  ASSERT_FALSE(finalize(supported));
+}
+
+
+TEST(FSMChannelResponder, grant_dictionary_only_if_shared)
+{
+  using namespace channeler::fsm;
+  using namespace channeler::pipe;
+  using namespace channeler;
+  using namespace channeler::support;
+  using namespace test;
+
+  std::vector<channeler::byte> data{packet_with_messages,
+    packet_with_messages + packet_with_messages_size};
+  channeler::packet_wrapper pkt{data.data(), data.size()};
+
+  using channel_t = channel_data<TEST_POOL_BLOCK_SIZE>;
+  using fsm_t = fsm_channel_responder<int, TEST_POOL_BLOCK_SIZE, channel_t>;
+  using event_t = message_event<int, TEST_POOL_BLOCK_SIZE, channel_t>;
+
+  capabilities_t supported;
+  supported[CAP_COMPRESSION] = true;
+  supported[CAP_COMPRESSION_DICTIONARY] = true;
+
+  pool_type pool{TEST_PACKET_SIZE};
+  timeouts t{[] (timeouts::duration a) -> timeouts::duration { return a; }};
+  fsm_t::channel_set chs;
+  fsm_t fsm{t, chs, []() { return fsm_t::secret_type{}; },
+    [supported]() { return supported; },
+    []() -> uint32_t { return 0xd1c7; }};
+
+  auto grant = [&](channelid::half_type initiator, uint32_t dictionary)
+  {
+    action_list_type actions;
+    event_list_type events;
+    event_t ev{123, 321, pkt, pool.allocate(), {},
+      std::make_unique<channeler::message_channel_new>(initiator, cookie{},
+          supported, dictionary)
+    };
+    EXPECT_TRUE(fsm.process(&ev, actions, events));
+    EXPECT_EQ(1, events.size());
+    auto out = reinterpret_cast<message_out_event *>(events.begin()->get());
+    auto ack = reinterpret_cast<channeler::message_channel_acknowledge *>(out->message.get());
+    return ack->capabilities;
+  };
+
+  // The same dictionary; everything is granted.
+  ASSERT_EQ(supported, grant(0xbeef, 0xd1c7));
+
+  // A different or no dictionary; only LZ4 is granted.
+  capabilities_t lz4;
+  lz4[CAP_COMPRESSION] = true;
+  ASSERT_EQ(lz4, grant(0xbeee, 0x1234));
+  ASSERT_EQ(lz4, grant(0xbeed, 0));
+}
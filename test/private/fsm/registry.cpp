@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include "../../exceptions.h"
+
 namespace {
 
 struct foo {};
@@ -74,7 +76,7 @@ TEST(FSMRegistry, add)
   // reg.add<foo>();
 
   // Succeed!
-  ASSERT_NO_THROW(reg.add<test_fsm>());
+  CHANNELER_ASSERT_NO_THROW(reg.add<test_fsm>());
 }
 
 
@@ -88,7 +90,7 @@ TEST(FSMRegistry, add_with_ctor_args)
   // reg.add<test_fsm_with_ctor>();
 
   // Succeed!
-  ASSERT_NO_THROW(reg.add<test_fsm_with_ctor>(42));
+  CHANNELER_ASSERT_NO_THROW(reg.add<test_fsm_with_ctor>(42));
 }
 
 
@@ -102,7 +104,7 @@ TEST(FSMRegistry, with_ctx_add)
   // reg.add<foo>();
 
   // Succeed!
-  ASSERT_NO_THROW(reg.add<test_fsm>());
+  CHANNELER_ASSERT_NO_THROW(reg.add<test_fsm>());
 }
 
 
@@ -116,7 +118,7 @@ TEST(FSMRegistry, with_ctx_add_with_ctor_args)
   // reg.add<test_fsm_with_ctor>();
 
   // Succeed!
-  ASSERT_NO_THROW(reg.add<test_fsm_with_ctor>(42));
+  CHANNELER_ASSERT_NO_THROW(reg.add<test_fsm_with_ctor>(42));
 }
 TEST(FSMRegistry, process_without_fsm)
 {
@@ -143,7 +145,7 @@ TEST(FSMRegistry, process_with_fsm)
   using namespace channeler::fsm;
 
   registry reg;
-  EXPECT_NO_THROW(reg.add<test_fsm>());
+  CHANNELER_EXPECT_NO_THROW(reg.add<test_fsm>());
 
   // With a FSM registered, process() must produce results
   event ev;
@@ -164,7 +166,7 @@ TEST(FSMRegistry, process_with_fsm_empty_event)
   using namespace channeler::fsm;
 
   registry reg;
-  EXPECT_NO_THROW(reg.add<test_fsm>());
+  CHANNELER_EXPECT_NO_THROW(reg.add<test_fsm>());
 
   // With a FSM registered, but no input event, we don't get results.
   action_list_type actions;
@@ -22,10 +22,21 @@
 #include "../lib/context/node.h"
 #include "../lib/context/connection.h"
 
+#if defined(CHANNELER_POSIX)
+#include "../lib/support/file_io.h"
+#include "../lib/snapshot_file.h"
+#endif
+
+#include <memory>
+#include <set>
+#include <thread>
+
 #include <liberate/string/hexencode.h>
 
 #include <gtest/gtest.h>
 
+#include "../../packets.h"
+
 namespace {
 
 static constexpr std::size_t PACKET_SIZE = 120;
@@ -163,6 +174,115 @@ static node_t peer_node{
 };
 
 
+/**
+ * Two connected peers, whose packets are delivered to each other
+ * synchronously. Peer 1 initiates, peer 2 responds.
+ */
+class InternalAPIPair : public ::testing::Test
+{
+protected:
+  InternalAPIPair()
+  {
+    peer_api1 = create_api(ctx1, 1);
+    peer_api2 = create_api(ctx2, 2);
+  }
+
+  /**
+   * Replace peer 1 with a fresh API instance on a fresh connection context,
+   * as if the process had been restarted.
+   */
+  connection_t & restart_peer1()
+  {
+    peer_api1.reset();
+    restarted1 = std::make_unique<connection_t>(self_node, peer);
+    peer_api1 = create_api(*restarted1, 1);
+    return *restarted1;
+  }
+
+  /**
+   * Pass the next packet for the channel from one peer to the other.
+   */
+  void deliver(api_t & from, api_t & to, channeler::channelid const & id)
+  {
+    auto entry = from.packet_to_send(id);
+    if (&from == peer_api1.get()) {
+      ++sent1;
+      for (auto msg : entry.packet.get_messages()) {
+        sent_types1.insert(msg->type);
+      }
+    }
+    else {
+      ++sent2;
+    }
+
+    auto slot = to.allocate();
+    ASSERT_EQ(entry.packet.buffer_size(), slot.size());
+    memcpy(slot.data(), entry.packet.buffer(), slot.size());
+    to.received_packet(123, 321, slot);
+  }
+
+  connection_t ctx1{self_node, peer};
+  connection_t ctx2{peer_node, self};
+  std::unique_ptr<connection_t> restarted1;
+
+  // Peer 1's packets are only delivered while deliver1 is set, otherwise
+  // they wait in the egress buffer.
+  bool deliver1 = true;
+  std::size_t sent1 = 0;
+  std::size_t sent2 = 0;
+  std::set<channeler::message_type> sent_types1;
+
+  // All channels established on either side
+  std::set<channeler::channelid> established1;
+  std::set<channeler::channelid> established2;
+  channel_establishment_callback ccb1;
+  channel_establishment_callback ccb2;
+
+  // All channels with data available on either side
+  std::set<channeler::channelid> data_ids1;
+  std::set<channeler::channelid> data_ids2;
+  data_available_callback dcb1;
+  data_available_callback dcb2;
+
+  std::unique_ptr<api_t> peer_api1;
+  std::unique_ptr<api_t> peer_api2;
+
+private:
+  std::unique_ptr<api_t> create_api(connection_t & ctx, int which)
+  {
+    using namespace channeler;
+    auto & established = (which == 1) ? established1 : established2;
+    auto & ccb = (which == 1) ? ccb1 : ccb2;
+    auto & data_ids = (which == 1) ? data_ids1 : data_ids2;
+    auto & dcb = (which == 1) ? dcb1 : dcb2;
+
+    return std::make_unique<api_t>(
+      ctx,
+      [&established, &ccb](channeler::error_t err, channelid const & id)
+      {
+        ccb.callback(err, id);
+        established.insert(id);
+      },
+      [this, which](channelid const & id)
+      {
+        if (which == 1) {
+          if (deliver1) {
+            deliver(*peer_api1, *peer_api2, id);
+          }
+        }
+        else {
+          deliver(*peer_api2, *peer_api1, id);
+        }
+      },
+      [&data_ids, &dcb](channelid const & id, std::size_t size)
+      {
+        dcb.callback(id, size);
+        data_ids.insert(id);
+      }
+    );
+  }
+};
+
 
 } // anonymous namespace
 
@@ -305,3 +425,654 @@ TEST(InternalAPI, send_data_on_established_channel)
   delete peer_api1;
   delete peer_api2;
 }
+
+
+TEST_F(InternalAPIPair, resume_channel_with_early_data)
+{
+  using namespace channeler;
+
+  // *** Establish channel the usual way, and grab a ticket.
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  api_t::resumption_ticket ticket;
+  ASSERT_EQ(ERR_SUCCESS, peer_api1->get_resumption_ticket(id, ticket));
+  ASSERT_EQ(id, ticket.id);
+
+  // The responder has no ticket to offer.
+  api_t::resumption_ticket dummy;
+  ASSERT_EQ(ERR_STATE, peer_api2->get_resumption_ticket(id, dummy));
+
+  // While the channel exists, it cannot be resumed.
+  std::size_t written = 0;
+  ASSERT_EQ(ERR_INVALID_CHANNELID,
+      peer_api1->resume_channel(ticket, hello, hello_size, written));
+
+  // *** Forget the channel on both sides, then resume it with data. A single
+  //     packet must suffice.
+  ctx1.channels().remove(id);
+  ctx2.channels().remove(id);
+  ccb2.m_id = DEFAULT_CHANNELID;
+  auto packets_before = sent1;
+
+  err = peer_api1->resume_channel(ticket, hello, hello_size, written);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(hello_size, written);
+  ASSERT_EQ(packets_before + 1, sent1);
+
+  ASSERT_EQ(id, ccb2.m_id);
+  ASSERT_TRUE(ctx2.channels().has_established_channel(id));
+  ASSERT_EQ(id, dcb2.m_id);
+  ASSERT_EQ(hello_size, dcb2.m_size);
+
+  char buf[hello_size];
+  std::size_t read = 0;
+  ASSERT_EQ(ERR_SUCCESS, peer_api2->channel_read(id, buf, sizeof(buf), read));
+  ASSERT_EQ(hello_size, read);
+  ASSERT_EQ(std::string{hello}, std::string{buf});
+
+  // The resumed channel carries data both ways.
+  test_data_exchange(id, "Test #1", *peer_api2, dcb1, *peer_api1);
+
+  // *** Resuming the same channel again right away looks like a replay to
+  //     the responder, and is rejected.
+  ctx1.channels().remove(id);
+  ctx2.channels().remove(id);
+  ccb2.m_id = DEFAULT_CHANNELID;
+
+  err = peer_api1->resume_channel(ticket, hello, hello_size, written);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(DEFAULT_CHANNELID, ccb2.m_id);
+  ASSERT_FALSE(ctx2.channels().has_channel(id));
+}
+
+
+TEST_F(InternalAPIPair, restore_connection_from_snapshot)
+{
+  using namespace channeler;
+
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  // *** Snapshot peer1, and save it to a file, or to memory where file
+  //     snapshots are not supported.
+  connection_snapshot snap;
+  peer_api1->snapshot(snap);
+  ASSERT_EQ(2, snap.channels.size()); // default and established channel
+
+#if defined(CHANNELER_POSIX)
+  char name[] = "/tmp/channeler-snapshot-XXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  ::close(fd);
+  ASSERT_EQ(ERR_SUCCESS, save_snapshot(name, snap));
+#else
+  std::vector<byte> buf(serialized_size(snap));
+  ASSERT_EQ(ERR_SUCCESS, serialize_snapshot(buf.data(), buf.size(), snap));
+#endif
+
+  // *** "Restart" peer1 with a fresh connection context, and restore it
+  //     from the saved snapshot.
+  auto & restarted = restart_peer1();
+  ASSERT_FALSE(restarted.channels().has_established_channel(id));
+
+  connection_snapshot loaded;
+#if defined(CHANNELER_POSIX)
+  ASSERT_EQ(ERR_SUCCESS, load_snapshot(loaded, name));
+  ::unlink(name);
+#else
+  ASSERT_EQ(ERR_SUCCESS, deserialize_snapshot(loaded, buf.data(),
+        buf.size()));
+#endif
+  ASSERT_EQ(ERR_SUCCESS, peer_api1->restore(loaded));
+  ASSERT_TRUE(restarted.channels().has_established_channel(id));
+
+  // *** The channel carries data both ways, without another handshake.
+  auto packets_before = sent1;
+  test_data_exchange(id, "Test #1", *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(packets_before + 1, sent1);
+  test_data_exchange(id, "Test #2", *peer_api2, dcb1, *peer_api1);
+
+  // *** Snapshots of other connections are rejected.
+  connection_snapshot other = loaded;
+  other.peer = peerid{};
+  ASSERT_EQ(ERR_STATE, peer_api1->restore(other));
+
+  // *** So are snapshots taken with another secret.
+  other = loaded;
+  other.secret.push_back(std::byte{42});
+  other.channels.push_back({channelid{0x1234, 0x5678}, {}, {}});
+  ASSERT_EQ(ERR_STATE, peer_api1->restore(other));
+  ASSERT_FALSE(restarted.channels().has_channel(channelid{0x1234, 0x5678}));
+
+  // *** If a channel conflicts with an existing one, the channels restored
+  //     before it are removed again.
+  other = loaded;
+  other.channels.push_back({channelid{0x1234, 0x5678}, {}, {}});
+  other.channels.push_back({channelid{id.initiator,
+      static_cast<channelid::half_type>(id.responder + 1)}, {}, {}});
+  ASSERT_EQ(ERR_INVALID_CHANNELID, peer_api1->restore(other));
+  ASSERT_FALSE(restarted.channels().has_channel(channelid{0x1234, 0x5678}));
+  ASSERT_TRUE(restarted.channels().has_established_channel(id));
+}
+
+
+TEST_F(InternalAPIPair, establish_many_channels)
+{
+  using namespace channeler;
+
+  constexpr std::size_t COUNT = 20;
+  auto err = peer_api1->establish_channels(ctx2.node().id(), COUNT);
+  ASSERT_EQ(ERR_SUCCESS, err);
+
+  // All channels are established on both sides.
+  ASSERT_EQ(COUNT, established1.size());
+  ASSERT_EQ(established1, established2);
+
+  // Several messages fit into each packet, so we must have sent fewer
+  // packets than channels in either direction.
+  ASSERT_LT(sent1, COUNT);
+  ASSERT_LT(sent2, COUNT);
+}
+
+
+TEST_F(InternalAPIPair, roll_back_failed_channel_initiation)
+{
+  using namespace channeler;
+
+  // Leave only three channel identifiers free; the fourth channel cannot be
+  // initiated.
+  std::set<channelid::half_type> free{1, 2, 3};
+  for (std::size_t half = 0 ; half <= 0xffff ; ++half) {
+    channelid id{static_cast<channelid::half_type>(half), 0xf0f0};
+    if (!free.count(id.initiator) && id.has_initiator()) {
+      ASSERT_EQ(ERR_SUCCESS, ctx1.channels().add(id));
+    }
+  }
+  auto size = ctx1.channels().size();
+
+  auto err = peer_api1->establish_channels(ctx2.node().id(), 5);
+  ASSERT_EQ(ERR_CHANNELID_EXHAUSTED, err);
+
+  // The three channels initiated before the failure are gone, along with
+  // their timeouts, and nothing was sent.
+  ASSERT_EQ(size + 1, ctx1.channels().size()); // DEFAULT_CHANNELID
+  for (auto half : free) {
+    ASSERT_FALSE(ctx1.channels().has_channel(half));
+    ASSERT_TRUE(ctx1.timeouts().add({fsm::CHANNEL_NEW_TIMEOUT_TAG, half},
+          std::chrono::seconds{1}));
+  }
+  ASSERT_EQ(0, sent1);
+  ASSERT_TRUE(established1.empty());
+}
+
+
+TEST_F(InternalAPIPair, write_to_many_channels)
+{
+  using namespace channeler;
+
+  constexpr std::size_t COUNT = 5;
+  auto err = peer_api1->establish_channels(ctx2.node().id(), COUNT);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto const & ids = established1;
+  ASSERT_EQ(COUNT, ids.size());
+
+  // Unknown channels are rejected before anything is sent.
+  std::vector<channelid> bad{ids.begin(), ids.end()};
+  bad.push_back(create_new_channelid());
+  std::size_t written = 0;
+  err = peer_api1->channel_write_many(bad.begin(), bad.end(),
+      reinterpret_cast<byte const *>(hello), hello_size, written);
+  ASSERT_EQ(ERR_INVALID_CHANNELID, err);
+  ASSERT_EQ(0, written);
+  ASSERT_TRUE(data_ids2.empty());
+
+  // Data that does not fit into a packet is rejected, too.
+  std::vector<byte> large(PACKET_SIZE);
+  err = peer_api1->channel_write_many(ids.begin(), ids.end(),
+      large.data(), large.size(), written);
+  ASSERT_EQ(ERR_INSUFFICIENT_BUFFER_SIZE, err);
+  ASSERT_EQ(0, written);
+  ASSERT_TRUE(data_ids2.empty());
+
+  // One packet per channel; the peer validates each packet's checksum, so
+  // arriving data means the combined checksums are correct.
+  auto before = sent1;
+  err = peer_api1->channel_write_many(ids.begin(), ids.end(),
+      reinterpret_cast<byte const *>(hello), hello_size, written);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(COUNT, written);
+  ASSERT_EQ(before + COUNT, sent1);
+  ASSERT_EQ(ids, data_ids2);
+  ASSERT_EQ(hello_size, dcb2.m_size);
+
+  for (auto & id : ids) {
+    char buf[hello_size * 2];
+    std::size_t read = 0;
+    err = peer_api2->channel_read(id, buf, sizeof(buf), read);
+    ASSERT_EQ(ERR_SUCCESS, err);
+    ASSERT_EQ(hello_size, read);
+    ASSERT_EQ(0, std::memcmp(hello, buf, hello_size));
+  }
+}
+
+
+TEST_F(InternalAPIPair, compress_data_on_capable_channels)
+{
+  using namespace channeler;
+
+  if (!support::payload_compression::available(support::CODEC_LZ4)) {
+    GTEST_SKIP() << "LZ4 not available";
+  }
+
+  support::payload_compression comp1;
+  support::payload_compression comp2;
+  peer_api1->set_compression(&comp1);
+  peer_api2->set_compression(&comp2);
+
+  // Both sides support compression, so a channel requesting it gets it.
+  capabilities_t caps;
+  caps[CAP_COMPRESSION] = true;
+  auto err = peer_api1->establish_channel(ctx2.node().id(), caps);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+  ASSERT_EQ(caps, ctx1.channels().get(id)->capabilities());
+  ASSERT_EQ(caps, ctx2.channels().get(id)->capabilities());
+
+  // Compressible data is sent compressed, and arrives as written.
+  sent_types1.clear();
+  std::string message(60, 'x');
+  test_data_exchange(id, message, *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(std::set<message_type>{MSG_DATA_COMPRESSED}, sent_types1);
+
+  // Incompressible data is sent as is.
+  sent_types1.clear();
+  test_data_exchange(id, "Test #1", *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(std::set<message_type>{MSG_DATA}, sent_types1);
+
+  // Channels that do not request compression do not get it.
+  err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto plain = ccb1.m_id;
+  ASSERT_NE(id, plain);
+  ASSERT_TRUE(ctx1.channels().get(plain)->capabilities().none());
+  ASSERT_TRUE(ctx2.channels().get(plain)->capabilities().none());
+
+  sent_types1.clear();
+  test_data_exchange(plain, message, *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(std::set<message_type>{MSG_DATA}, sent_types1);
+
+  // If the responder does not support compression, it is not granted.
+  peer_api2->set_compression(nullptr);
+  err = peer_api1->establish_channel(ctx2.node().id(), caps);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto refused = ccb1.m_id;
+  ASSERT_TRUE(ctx1.channels().get(refused)->capabilities().none());
+  ASSERT_TRUE(ctx2.channels().get(refused)->capabilities().none());
+
+  sent_types1.clear();
+  test_data_exchange(refused, message, *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(std::set<message_type>{MSG_DATA}, sent_types1);
+}
+
+
+#if defined(CHANNELER_POSIX)
+TEST_F(InternalAPIPair, send_file_to_sink)
+{
+  using namespace channeler;
+
+  // Source and destination files
+  char src_name[] = "/tmp/channeler-send-file-XXXXXX";
+  char dst_name[] = "/tmp/channeler-recv-file-XXXXXX";
+  int src = mkstemp(src_name);
+  int dst = mkstemp(dst_name);
+  ASSERT_GE(src, 0);
+  ASSERT_GE(dst, 0);
+  unlink(src_name);
+  unlink(dst_name);
+
+  constexpr std::size_t FILE_SIZE = 64 * 1024;
+  std::vector<byte> contents(FILE_SIZE);
+  for (std::size_t i = 0 ; i < FILE_SIZE ; ++i) {
+    contents[i] = static_cast<byte>(i * 13 + i / 251);
+  }
+  ASSERT_EQ(ERR_SUCCESS, support::pwrite_full(src, contents.data(),
+        contents.size(), 0));
+
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  support::fd_sink sink{dst};
+  peer_api2->set_channel_sink(id, [&sink](uint64_t offset, byte const * data,
+        std::size_t size)
+  {
+    return sink(offset, data, size);
+  });
+  ASSERT_TRUE(peer_api2->has_channel_sink(id));
+
+  auto capacity1 = self_node.packet_pool().capacity();
+  auto capacity2 = peer_node.packet_pool().capacity();
+
+  // With a transport that does not keep up, sending stops early.
+  deliver1 = false;
+  std::size_t written = 0;
+  support::fd_source source{src};
+  err = peer_api1->channel_send_file(id, source, 0, FILE_SIZE, written, 4);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_GT(written, 0);
+  ASSERT_LT(written, FILE_SIZE);
+  ASSERT_EQ(4, ctx1.channels().get(id)->egress_buffer().size());
+
+  // Drain in reverse order; each chunk still lands at its offset.
+  deliver1 = true;
+  std::vector<api_t::buffer_entry> pending;
+  while (!ctx1.channels().get(id)->egress_buffer().empty()) {
+    pending.push_back(peer_api1->packet_to_send(id));
+  }
+  for (auto iter = pending.rbegin() ; iter != pending.rend() ; ++iter) {
+    auto slot = peer_api2->allocate();
+    memcpy(slot.data(), iter->packet.buffer(), slot.size());
+    peer_api2->received_packet(123, 321, slot);
+  }
+  pending.clear();
+  ASSERT_EQ(written, sink.end);
+
+  std::size_t offset = written;
+  err = peer_api1->channel_send_file(id, source, offset, FILE_SIZE - offset,
+      written, 4);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(FILE_SIZE - offset, written);
+
+  // All data went to the file, none was buffered.
+  ASSERT_EQ(FILE_SIZE, sink.end);
+  ASSERT_TRUE(data_ids2.empty());
+  std::vector<byte> received(FILE_SIZE);
+  ASSERT_EQ(ERR_SUCCESS, support::pread_full(dst, received.data(),
+        received.size(), 0));
+  ASSERT_EQ(contents, received);
+
+  // Pool slots were reused throughout, rather than growing with the file.
+  ASSERT_LE(self_node.packet_pool().capacity(), capacity1 + 6);
+  ASSERT_LE(peer_node.packet_pool().capacity(), capacity2 + 6);
+
+  // Reading past the end of the file is an error.
+  err = peer_api1->channel_send_file(id, source, FILE_SIZE - 10, 20, written);
+  ASSERT_EQ(ERR_READ, err);
+  ASSERT_EQ(0, written);
+
+  close(src);
+  close(dst);
+}
+#endif
+
+
+TEST_F(InternalAPIPair, notify_rate_limited_packets)
+{
+  using namespace channeler;
+  using namespace std::chrono_literals;
+
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  // One packet every 10ms
+  support::token_bucket limiter{PACKET_SIZE * 100, PACKET_SIZE};
+  ASSERT_EQ(ERR_SUCCESS, peer_api1->set_channel_rate_limiter(id, &limiter));
+
+  auto sent = sent1;
+  std::string message{"hello"};
+  for (int i = 0 ; i < 3 ; ++i) {
+    std::size_t written = 0;
+    err = peer_api1->channel_write(id, message.c_str(), message.size(),
+        written);
+    ASSERT_EQ(ERR_SUCCESS, err);
+  }
+
+  // Only the first packet could be sent right away.
+  ASSERT_EQ(sent + 1, sent1);
+  ASSERT_EQ(2, ctx1.channels().get(id)->egress_buffer().size());
+
+  // The others are announced as the limiter refills.
+  for (int i = 0 ; i < 1000 && sent1 < sent + 3 ; ++i) {
+    std::this_thread::sleep_for(1ms);
+    peer_api1->process_timeouts(1ms);
+  }
+  ASSERT_EQ(sent + 3, sent1);
+  ASSERT_TRUE(ctx1.channels().get(id)->egress_buffer().empty());
+
+  peer_api1->set_channel_rate_limiter(id, nullptr);
+}
+
+
+TEST_F(InternalAPIPair, drop_packets_expired_in_buffer)
+{
+  using namespace channeler;
+  using namespace std::chrono_literals;
+
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  // A limiter that allows one packet, and never refills.
+  support::token_bucket limiter{0, PACKET_SIZE};
+  ASSERT_EQ(ERR_SUCCESS, peer_api1->set_channel_rate_limiter(id, &limiter));
+
+  // The first write is sent, the second is held back by the limiter. Its
+  // deadline passes while it waits.
+  auto sent = sent1;
+  std::string message{"hello"};
+  auto data = reinterpret_cast<byte const *>(message.c_str());
+  std::size_t written = 0;
+  err = peer_api1->channel_write(id, data, message.size(), written, 10ms);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  err = peer_api1->channel_write(id, data, message.size(), written, 10ms);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(sent + 1, sent1);
+  ASSERT_EQ(1, ctx1.channels().get(id)->egress_buffer().size());
+
+  std::this_thread::sleep_for(20ms);
+  limiter.set_rate(1'000'000'000, PACKET_SIZE);
+
+  // Once the limiter allows it, the packet is dropped rather than sent.
+  ASSERT_EQ(support::token_bucket::duration::max(),
+      peer_api1->release_delay(id));
+  ASSERT_EQ(0, peer_api1->packet_to_send(id).data.size());
+  ASSERT_TRUE(ctx1.channels().get(id)->egress_buffer().empty());
+  ASSERT_EQ(1, ctx1.channels().get(id)->expired_egress_packets());
+  ASSERT_EQ(sent + 1, sent1);
+}
+
+
+TEST_F(InternalAPIPair, keepalive_idle_connections)
+{
+  using namespace channeler;
+  using namespace std::chrono_literals;
+
+  api_t::keepalive_type keepalive{10s, 10};
+  peer_api1->set_keepalive(&keepalive);
+  ASSERT_EQ(1, keepalive.size());
+
+  auto probe = [&](api_t * conn)
+  {
+    ASSERT_EQ(peer_api1.get(), conn);
+    conn->send_keepalive();
+  };
+
+  auto err = peer_api1->establish_channel(ctx2.node().id());
+  ASSERT_EQ(ERR_SUCCESS, err);
+  auto id = ccb1.m_id;
+
+  // *** Traffic within the interval suppresses the probe.
+  keepalive.advance(5s, probe);
+  test_data_exchange(id, "Test #1", *peer_api1, dcb2, *peer_api2);
+  ASSERT_EQ(0, keepalive.advance(5s, probe));
+
+  // *** An idle connection is probed with a single packet, which the peer
+  //     accepts without any visible effect.
+  auto packets_before = sent1;
+  dcb2.m_id = DEFAULT_CHANNELID;
+  ASSERT_EQ(1, keepalive.advance(5s, probe));
+  ASSERT_EQ(packets_before + 1, sent1);
+  ASSERT_EQ(DEFAULT_CHANNELID, dcb2.m_id);
+
+  // The connection is unaffected.
+  test_data_exchange(id, "Test #2", *peer_api2, dcb1, *peer_api1);
+
+  // *** Another connection to the same peer is tracked separately.
+  {
+    connection_t ctx3{self_node, peer};
+    api_t other{ctx3,
+      [](channeler::error_t, channelid const &) {},
+      [](channelid const &) {},
+      [](channelid const &, std::size_t) {}
+    };
+    other.set_keepalive(&keepalive);
+    ASSERT_EQ(2, keepalive.size());
+  }
+  ASSERT_EQ(1, keepalive.size());
+
+  // *** Connections unregister when they are gone.
+  peer_api1.reset();
+  ASSERT_EQ(0, keepalive.size());
+}
+
+
+TEST_F(InternalAPIPair, warm_channel_pool)
+{
+  using namespace channeler;
+
+  // An empty pool has nothing to hand out.
+  channelid id;
+  ASSERT_EQ(ERR_DATA_UNAVAILABLE, peer_api1->acquire_warm_channel(id));
+
+  // Fill the pool; the packet loop is synchronous, so it is full right away.
+  auto idle = std::chrono::seconds(1);
+  auto err = peer_api1->set_warm_pool(ctx2.node().id(), 3, 2, idle);
+  ASSERT_EQ(ERR_SUCCESS, err);
+  ASSERT_EQ(3, peer_api1->warm_channels());
+  ASSERT_TRUE(established1.empty());
+
+  // Acquiring hands out an established channel, and refills the pool.
+  ASSERT_EQ(ERR_SUCCESS, peer_api1->acquire_warm_channel(id));
+  ASSERT_TRUE(ctx1.channels().has_established_channel(id));
+  ASSERT_TRUE(ctx2.channels().has_established_channel(id));
+  ASSERT_EQ(3, peer_api1->warm_channels());
+
+  // The acquired channel is usable.
+  test_data_exchange(id, "Test #1", *peer_api1, dcb2, *peer_api2);
+
+  // Idle warm channels expire, but the acquired one stays.
+  peer_api1->process_timeouts(idle + std::chrono::milliseconds(1));
+  ASSERT_EQ(0, peer_api1->warm_channels());
+  ASSERT_TRUE(ctx1.channels().has_established_channel(id));
+}
+
+
+
+TEST(InternalAPI, forward_packets_for_other_peers)
+{
+  using namespace channeler;
+
+  connection_t ctx{self_node, peer};
+
+  api_t api{
+    ctx,
+    [](channeler::error_t, channelid) {},
+    [](channeler::channelid){},
+    [](channelid, std::size_t) {}
+  };
+
+  api_t::forwarding_table_type table{self_node.id()};
+
+  std::size_t forwarded = 0;
+  address_t hop = 0;
+  byte const * forwarded_data = nullptr;
+  api.set_forwarding(&table, [&](address_t const & next_hop,
+        api_t::slot_type const & slot)
+  {
+    ++forwarded;
+    hop = next_hop;
+    forwarded_data = slot.data();
+  });
+
+  auto slot = api.allocate();
+  memcpy(slot.data(), test::packet_default_channel,
+      test::packet_default_channel_size);
+
+  // No route for the recipient; dropped.
+  ASSERT_EQ(ERR_SUCCESS, api.received_packet(123, 321, slot));
+  ASSERT_EQ(0, forwarded);
+
+  // With a route, the packet is relayed in the slot it arrived in.
+  public_header_fields header{slot.data()};
+  table.add(header.recipient.copy(), 42);
+  ASSERT_EQ(ERR_SUCCESS, api.received_packet(123, 321, slot));
+  ASSERT_EQ(1, forwarded);
+  ASSERT_EQ(42, hop);
+  ASSERT_EQ(slot.data(), forwarded_data);
+}
+
+
+TEST(InternalAPI, reject_malformed_packet)
+{
+  using namespace channeler;
+
+  connection_t ctx{self_node, peer};
+
+  api_t api{
+    ctx,
+    [](channeler::error_t, channelid) {},
+    [](channeler::channelid){},
+    [](channelid, std::size_t) {}
+  };
+
+  auto slot = api.allocate();
+  memcpy(slot.data(), test::packet_default_channel,
+      test::packet_default_channel_size);
+
+  // A packet size below the envelope size is reported, not thrown.
+  auto offset = public_header_layout::PUB_OFFS_PACKET_SIZE;
+  slot.data()[offset] = byte{0x00};
+  slot.data()[offset + 1] = byte{0x10};
+  ASSERT_EQ(ERR_DECODE, api.received_packet(123, 321, slot));
+}
+
+
+
+TEST(InternalAPI, ignore_message_with_bad_length)
+{
+  using namespace channeler;
+
+  connection_t ctx{self_node, peer};
+
+  std::size_t data_calls = 0;
+  api_t api{
+    ctx,
+    [](channeler::error_t, channelid) {},
+    [](channeler::channelid){},
+    [&data_calls](channelid, std::size_t) { ++data_calls; }
+  };
+
+  auto slot = api.allocate();
+  memcpy(slot.data(), test::packet_default_channel,
+      test::packet_default_channel_size);
+
+  // A well-formed packet carrying a data message whose length exceeds the
+  // payload.
+  byte const payload[] = { byte{0x14}, byte{0x7f}, byte{0xbe} };
+  packet_wrapper pkt{slot.data(), slot.size(), false};
+  ASSERT_EQ(ERR_SUCCESS, pkt.validate().first);
+  memcpy(pkt.payload(), payload, sizeof(payload));
+  pkt.payload_size() = static_cast<payload_size_t>(sizeof(payload));
+  pkt.packet_size() = static_cast<packet_size_t>(pkt.envelope_size()
+      + sizeof(payload));
+  ASSERT_EQ(ERR_SUCCESS, pkt.update_checksum());
+  pkt.buffer();
+
+  // The message is dropped without reading past the packet.
+  ASSERT_EQ(ERR_SUCCESS, api.received_packet(123, 321, slot));
+  ASSERT_EQ(0, data_calls);
+}
@@ -0,0 +1,114 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/packet_view.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../packets.h"
+
+using namespace channeler;
+
+
+TEST(PacketView, read_existing_packet)
+{
+  std::vector<byte> data{test::packet_default_channel,
+    test::packet_default_channel + test::packet_default_channel_size};
+
+  packet_view view{data.data(), data.size()};
+  char const * reason = nullptr;
+  ASSERT_EQ(ERR_SUCCESS, view.validate(reason));
+
+  packet_wrapper pkt{data.data(), data.size()};
+  ASSERT_EQ(pkt.proto(), view.proto());
+  ASSERT_EQ(pkt.sender(), view.sender());
+  ASSERT_EQ(pkt.recipient(), view.recipient());
+  ASSERT_EQ(pkt.channel(), view.channel());
+  ASSERT_EQ(pkt.flags(), view.flags());
+  ASSERT_EQ(pkt.packet_size(), view.packet_size());
+  ASSERT_EQ(0x01fa, view.sequence_no());
+  ASSERT_EQ(pkt.payload_size(), view.payload_size());
+  ASSERT_EQ(pkt.payload(), view.payload());
+  ASSERT_EQ(pkt.checksum(), view.checksum());
+  ASSERT_TRUE(view.has_valid_checksum());
+}
+
+
+TEST(PacketView, read_fields_from_buffer)
+{
+  // The packet sits in a larger buffer, as in a pool slot.
+  std::vector<byte> data{test::packet_default_channel,
+    test::packet_default_channel + test::packet_default_channel_size};
+  data.resize(data.size() + 32, byte{0xff});
+
+  packet_view view{data.data(), data.size()};
+  char const * reason = nullptr;
+  ASSERT_EQ(ERR_SUCCESS, view.validate(reason));
+  ASSERT_EQ(test::packet_default_channel_size, view.packet_size());
+  ASSERT_TRUE(view.has_valid_checksum());
+
+  // Fields are read whenever they are accessed, so changes to the buffer
+  // show right away.
+  auto offset = public_header_layout::PUB_SIZE
+    + private_header_layout::PRIV_OFFS_SEQUENCE_NO;
+  data[offset] ^= byte{0x01};
+  ASSERT_EQ(0x00fa, view.sequence_no());
+  ASSERT_FALSE(view.has_valid_checksum());
+
+  offset = public_header_layout::PUB_OFFS_CHANNELID;
+  data[offset] = byte{0xbe};
+  data[offset + 1] = byte{0xef};
+  ASSERT_EQ(0xbeef, view.channel().initiator);
+}
+
+
+TEST(PacketView, reject_malformed_packet)
+{
+  std::vector<byte> data{test::packet_default_channel,
+    test::packet_default_channel + test::packet_default_channel_size};
+  char const * reason = nullptr;
+
+  // The buffer is too small for the envelope.
+  packet_view small{data.data(), packet_wrapper::public_header_size()};
+  ASSERT_EQ(ERR_INSUFFICIENT_BUFFER_SIZE, small.validate(reason));
+  ASSERT_NE(nullptr, reason);
+
+  // The packet size exceeds the buffer.
+  packet_view view{data.data(), data.size()};
+  auto offset = public_header_layout::PUB_OFFS_PACKET_SIZE;
+  data[offset] = byte{0xff};
+  ASSERT_EQ(ERR_DECODE, view.validate(reason));
+
+  // The packet size is smaller than the envelope.
+  data[offset] = byte{0x00};
+  data[offset + 1] = byte{0x10};
+  ASSERT_EQ(ERR_DECODE, view.validate(reason));
+
+  // The payload size exceeds the packet.
+  data[offset] = static_cast<byte>(test::packet_default_channel_size >> 8);
+  data[offset + 1] = static_cast<byte>(test::packet_default_channel_size & 0xff);
+  ASSERT_EQ(ERR_SUCCESS, view.validate(reason));
+  offset = public_header_layout::PUB_SIZE
+    + private_header_layout::PRIV_OFFS_PAYLOAD_SIZE;
+  data[offset] = byte{0x01};
+  ASSERT_EQ(ERR_DECODE, view.validate(reason));
+}
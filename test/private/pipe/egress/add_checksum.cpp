@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 namespace {
@@ -67,10 +68,10 @@ TEST(PipeEgressAddChecksumFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
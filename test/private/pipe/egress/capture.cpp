@@ -0,0 +1,107 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/pipe/egress/capture.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "../../../packets.h"
+
+namespace {
+
+// For testing
+using address_t = uint16_t;
+constexpr std::size_t POOL_BLOCK_SIZE = 3;
+constexpr std::size_t PACKET_SIZE = 200;
+
+using pool_type = ::channeler::memory::packet_pool<POOL_BLOCK_SIZE>;
+
+struct next
+{
+  using input_event = channeler::pipe::packet_out_event<POOL_BLOCK_SIZE>;
+
+  inline channeler::pipe::action_list_type consume(std::unique_ptr<channeler::pipe::event> event)
+  {
+    m_event = std::move(event);
+    return {};
+  }
+  std::unique_ptr<channeler::pipe::event> m_event;
+};
+
+using filter_t = channeler::pipe::egress_capture_filter<
+  address_t,
+  POOL_BLOCK_SIZE,
+  next,
+  next::input_event
+>;
+
+} // anonymous namespace
+
+
+
+TEST(PipeEgressCaptureFilter, capture_packet)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  std::vector<channeler::byte> written;
+  channeler::capture::packet_capture cap{
+    [&written](channeler::byte const * buf, std::size_t size)
+    {
+      written.insert(written.end(), buf, buf + size);
+    }};
+
+  next n;
+  filter_t filter{&n};
+
+  auto make_event = [&pool]()
+  {
+    auto slot = pool.allocate();
+    std::memcpy(slot.data(), test::packet_default_channel,
+        test::packet_default_channel_size);
+    auto packet = channeler::packet_wrapper(slot.data(), slot.size(), true);
+    return std::make_unique<packet_out_event<POOL_BLOCK_SIZE>>(
+        std::move(slot), std::move(packet));
+  };
+
+  // Not capturing yet
+  filter.consume(make_event());
+  ASSERT_EQ(n.m_event->type, ET_PACKET_OUT);
+  ASSERT_EQ(0, cap.seen());
+
+  // Capturing
+  filter.set_capture(&cap);
+  n.m_event.reset();
+  filter.consume(make_event());
+  ASSERT_EQ(n.m_event->type, ET_PACKET_OUT);
+  ASSERT_EQ(1, cap.captured());
+
+  cap.flush();
+  auto epb = channeler::capture::PCAPNG_SECTION_HEADER_SIZE
+      + channeler::capture::PCAPNG_INTERFACE_DESCRIPTION_SIZE;
+  ASSERT_EQ(epb + channeler::capture::pcapng_enhanced_packet_size(
+        test::packet_default_channel_size),
+      written.size());
+  ASSERT_EQ(0, std::memcmp(test::packet_default_channel,
+        written.data() + epb + 28, test::packet_default_channel_size));
+}
@@ -0,0 +1,138 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/pipe/egress/compress.h"
+#include "../lib/channel_data.h"
+
+#include <gtest/gtest.h>
+
+#include "../../../exceptions.h"
+
+namespace {
+
+constexpr std::size_t PACKET_SIZE = 200;
+constexpr std::size_t POOL_BLOCK_SIZE = 3;
+
+struct next
+{
+  using input_event = channeler::pipe::message_out_event;
+
+  inline channeler::pipe::action_list_type consume(std::unique_ptr<channeler::pipe::event> event)
+  {
+    m_event = std::move(event);
+    return {};
+  }
+
+  inline channeler::pipe::action_list_type consume_all(channeler::pipe::event_list_type events)
+  {
+    m_event = std::move(events.front());
+    return {};
+  }
+
+  std::unique_ptr<channeler::pipe::event> m_event;
+};
+
+
+using filter_t = channeler::pipe::compress_filter<
+  ::channeler::channel_data<POOL_BLOCK_SIZE>,
+  next,
+  next::input_event
+>;
+
+
+inline std::unique_ptr<channeler::pipe::message_out_event>
+compressible_event(channeler::channelid const & channel)
+{
+  channeler::byte buf[150] = {};
+  return std::make_unique<channeler::pipe::message_out_event>(channel,
+      channeler::message_data::create(buf, sizeof(buf)));
+}
+
+
+inline channeler::pipe::message_out_event *
+result(next & n)
+{
+  EXPECT_TRUE(n.m_event);
+  EXPECT_EQ(n.m_event->type, channeler::pipe::ET_MESSAGE_OUT);
+  return reinterpret_cast<channeler::pipe::message_out_event *>(
+      n.m_event.get());
+}
+
+} // anonymous namespace
+
+
+TEST(PipeEgressCompressFilter, throw_on_invalid_event)
+{
+  using namespace channeler::pipe;
+
+  next n;
+  filter_t::channel_set chs;
+  filter_t filter{&n, chs, PACKET_SIZE};
+
+  auto ev = std::make_unique<event>();
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+}
+
+
+TEST(PipeEgressCompressFilter, compress_on_capable_channels_only)
+{
+  using namespace channeler::pipe;
+  if (!channeler::support::payload_compression::available(
+        channeler::support::CODEC_LZ4))
+  {
+    GTEST_SKIP() << "LZ4 not available";
+  }
+
+  next n;
+  filter_t::channel_set chs;
+  channeler::support::payload_compression comp;
+  filter_t filter{&n, chs, PACKET_SIZE, &comp};
+
+  auto channel = channeler::create_new_channelid();
+  channeler::complete_channelid(channel);
+  ASSERT_EQ(channeler::ERR_SUCCESS, chs.add(channel));
+
+  // Without the capability, messages pass unchanged.
+  filter.consume(compressible_event(channel));
+  ASSERT_EQ(channeler::MSG_DATA, result(n)->message->type);
+
+  // With it, they are compressed.
+  channeler::capabilities_t caps;
+  caps[channeler::CAP_COMPRESSION] = true;
+  chs.get(channel)->set_capabilities(caps);
+
+  filter.consume(compressible_event(channel));
+  auto msg = result(n)->message.get();
+  ASSERT_EQ(channeler::MSG_DATA_COMPRESSED, msg->type);
+  ASSERT_LT(msg->payload_size, 150);
+  ASSERT_EQ(150, channeler::support::payload_compression::original_size(
+        msg->payload, msg->payload_size));
+
+  // Batches are compressed as well.
+  event_list_type events;
+  events.push_back(compressible_event(channel));
+  filter.consume_all(std::move(events));
+  ASSERT_EQ(channeler::MSG_DATA_COMPRESSED, result(n)->message->type);
+
+  // Messages that would not fit into a packet uncompressed are left alone.
+  filter_t small_filter{&n, chs, 100, &comp};
+  small_filter.consume(compressible_event(channel));
+  ASSERT_EQ(channeler::MSG_DATA, result(n)->message->type);
+}
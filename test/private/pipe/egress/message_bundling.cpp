@@ -21,8 +21,12 @@
 #include "../lib/pipe/egress/message_bundling.h"
 #include "../lib/channel_data.h"
 
+#include <limits>
+
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
+
 namespace {
 
 // For testing
@@ -38,10 +42,17 @@ struct next
 
   inline channeler::pipe::action_list_type consume(std::unique_ptr<channeler::pipe::event> event)
   {
+    if (m_consumed++ >= m_fail_after) {
+      return channeler::pipe::error_actions(channeler::ERR_INVALID_CHANNELID);
+    }
     m_event = std::move(event);
     return {};
   }
   std::unique_ptr<channeler::pipe::event> m_event;
+
+  // Report an error for every event after the first m_fail_after ones.
+  std::size_t m_consumed = 0;
+  std::size_t m_fail_after = std::numeric_limits<std::size_t>::max();
 };
 
 
@@ -71,10 +82,10 @@ TEST(PipeEgressMessageBundlingFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -125,3 +136,155 @@ TEST(PipeEgressMessageBundlingFilter, bundle_message)
   // We have one message type and two length bytes
   ASSERT_EQ(sizeof(buf) + 3, ptr->packet.payload_size());
 }
+
+
+TEST(PipeEgressMessageBundlingFilter, drop_expired_messages)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  filter_t::channel_set chs;
+  next n;
+  filter_t filter{&n, chs, pool,
+    []() { return channeler::peerid{}; },
+    []() { return channeler::peerid{}; }
+  };
+
+  auto channel = channeler::create_new_channelid();
+  channeler::complete_channelid(channel);
+  auto err = chs.add(channel);
+  EXPECT_EQ(channeler::ERR_SUCCESS, err);
+  auto ch = chs.get(channel);
+
+  // One message has expired already, the other never expires.
+  auto now = std::chrono::steady_clock::now();
+  channeler::byte buf[10];
+  ch->enqueue_egress_message(channeler::message_data::create(buf, 5),
+      now - std::chrono::milliseconds(1));
+  ch->enqueue_egress_message(channeler::message_data::create(buf, sizeof(buf)));
+
+  auto ret = filter.consume(std::make_unique<message_out_enqueued_event>(channel));
+  ASSERT_EQ(0, ret.size());
+  ASSERT_EQ(1, ch->expired_egress_messages());
+
+  // Only the second message should have been bundled; it has one message
+  // type and one length byte.
+  ASSERT_TRUE(n.m_event);
+  auto ptr = reinterpret_cast<next::input_event *>(n.m_event.get());
+  ASSERT_EQ(sizeof(buf) + 2, ptr->packet.payload_size());
+  ASSERT_FALSE(ch->has_egress_data_pending());
+
+  // The packet never expires, either.
+  ASSERT_EQ(message_deadline::max(), ptr->deadline);
+}
+
+
+TEST(PipeEgressMessageBundlingFilter, packet_deadline)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  filter_t::channel_set chs;
+  next n;
+  filter_t filter{&n, chs, pool,
+    []() { return channeler::peerid{}; },
+    []() { return channeler::peerid{}; }
+  };
+
+  auto channel = channeler::create_new_channelid();
+  channeler::complete_channelid(channel);
+  chs.add(channel);
+  auto ch = chs.get(channel);
+
+  // Both messages end up in the same packet, which is worth sending until
+  // the later one expires.
+  auto now = std::chrono::steady_clock::now();
+  channeler::byte buf[10];
+  ch->enqueue_egress_message(channeler::message_data::create(buf, sizeof(buf)),
+      now + std::chrono::seconds(2));
+  ch->enqueue_egress_message(channeler::message_data::create(buf, sizeof(buf)),
+      now + std::chrono::seconds(1));
+
+  auto ret = filter.consume(std::make_unique<message_out_enqueued_event>(channel));
+  ASSERT_EQ(0, ret.size());
+  ASSERT_TRUE(n.m_event);
+  auto ptr = reinterpret_cast<next::input_event *>(n.m_event.get());
+  ASSERT_EQ(2 * (sizeof(buf) + 2), ptr->packet.payload_size());
+  ASSERT_EQ(now + std::chrono::seconds(2), ptr->deadline);
+}
+
+
+TEST(PipeEgressMessageBundlingFilter, all_messages_expired)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  filter_t::channel_set chs;
+  next n;
+  filter_t filter{&n, chs, pool,
+    []() { return channeler::peerid{}; },
+    []() { return channeler::peerid{}; }
+  };
+
+  auto channel = channeler::create_new_channelid();
+  channeler::complete_channelid(channel);
+  chs.add(channel);
+  auto ch = chs.get(channel);
+
+  channeler::byte buf[10];
+  ch->enqueue_egress_message(channeler::message_data::create(buf, sizeof(buf)),
+      std::chrono::steady_clock::now());
+
+  // Nothing is left to send, so no packet must be produced.
+  auto ret = filter.consume(std::make_unique<message_out_enqueued_event>(channel));
+  ASSERT_EQ(0, ret.size());
+  ASSERT_FALSE(n.m_event);
+  ASSERT_EQ(1, ch->expired_egress_messages());
+}
+
+
+TEST(PipeEgressMessageBundlingFilter, fan_out_stops_at_error)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  filter_t::channel_set chs;
+  next n;
+  filter_t filter{&n, chs, pool,
+    []() { return channeler::peerid{}; },
+    []() { return channeler::peerid{}; }
+  };
+
+  std::vector<channeler::channelid> channels;
+  for (std::size_t i = 0 ; i < 4 ; ++i) {
+    auto channel = channeler::create_new_channelid();
+    channeler::complete_channelid(channel);
+    channels.push_back(channel);
+  }
+
+  channeler::byte buf[20] = {};
+  auto msg = channeler::message_data::create(buf, sizeof(buf));
+
+  // All packets pass.
+  std::size_t sent = 0;
+  auto ret = filter.fan_out(channels.begin(), channels.end(), msg, sent);
+  ASSERT_EQ(channeler::ERR_SUCCESS, first_error(ret));
+  ASSERT_EQ(channels.size(), sent);
+
+  // The third packet fails; only the first two count.
+  n.m_consumed = 0;
+  n.m_fail_after = 2;
+  ret = filter.fan_out(channels.begin(), channels.end(), msg, sent);
+  ASSERT_EQ(channeler::ERR_INVALID_CHANNELID, first_error(ret));
+  ASSERT_EQ(2, sent);
+  ASSERT_EQ(3, n.m_consumed);
+
+  // A message that does not fit into a packet produces none.
+  channeler::byte large[PACKET_SIZE] = {};
+  auto too_large = channeler::message_data::create(large, sizeof(large));
+  n.m_consumed = 0;
+  ret = filter.fan_out(channels.begin(), channels.end(), too_large, sent);
+  ASSERT_EQ(channeler::ERR_INSUFFICIENT_BUFFER_SIZE, first_error(ret));
+  ASSERT_EQ(0, sent);
+  ASSERT_EQ(0, n.m_consumed);
+}
@@ -21,8 +21,11 @@
 #include "../lib/pipe/egress/out_buffer.h"
 #include "../lib/channel_data.h"
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 namespace {
@@ -78,14 +81,39 @@ TEST(PipeEgressOutBufferFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+}
+
+
+TEST(PipeEgressOutBufferFilter, enqueue_bad_channel)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  channel_set chs;
+  next n;
+  filter_t filter{&n, chs};
+
+  auto slot = pool.allocate();
+  memcpy(slot.data(), test::packet_default_channel,
+      test::packet_default_channel_size);
+  auto packet = channeler::packet_wrapper(slot.data(), slot.size(), true);
+
+  // The channel does not exist; the packet is dropped with an error.
+  auto ev = std::make_unique<packet_out_event<POOL_BLOCK_SIZE>>(
+      std::move(slot),
+      std::move(packet)
+  );
+  auto ret = filter.consume(std::move(ev));
+
+  ASSERT_EQ(channeler::ERR_INVALID_CHANNELID, first_error(ret));
+  ASSERT_FALSE(n.m_event);
 }
 
 
-// TODO enqueue_bad_channel
 TEST(PipeEgressOutBufferFilter, enqueue)
 {
   using namespace channeler::pipe;
@@ -123,3 +151,133 @@ TEST(PipeEgressOutBufferFilter, enqueue)
   // We could check that the packet is in the buffer
   ASSERT_FALSE(ptr->channel->egress_buffer().empty());
 }
+
+
+TEST(PipeEgressOutBufferFilter, rate_limit)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  channel_set chs;
+  next n;
+  filter_t filter{&n, chs};
+
+  // A connection limiter that allows one packet, and never refills.
+  channeler::support::token_bucket limiter{0, PACKET_SIZE};
+  filter.set_rate_limiter(&limiter);
+
+  auto enqueue = [&]()
+  {
+    auto slot = pool.allocate();
+    memcpy(slot.data(), test::packet_default_channel,
+        test::packet_default_channel_size);
+    auto packet = channeler::packet_wrapper(slot.data(), slot.size(), true);
+    auto channel = packet.channel();
+    chs.add(channel);
+
+    n.m_event.reset();
+    filter.consume(std::make_unique<packet_out_event<POOL_BLOCK_SIZE>>(
+        std::move(slot), std::move(packet)));
+    return channel;
+  };
+
+  // The first packet can be released, and is announced.
+  auto id = enqueue();
+  ASSERT_TRUE(n.m_event);
+  ASSERT_EQ(filter_t::rate_limiter::duration::zero(),
+      filter.release_delay(id));
+
+  auto entry = filter.release(id);
+  ASSERT_EQ(PACKET_SIZE, entry.data.size());
+  ASSERT_EQ(filter_t::rate_limiter::duration::max(),
+      filter.release_delay(id));
+
+  // The second is buffered, but announced as delayed, and cannot be
+  // released.
+  enqueue();
+  ASSERT_TRUE(n.m_event);
+  ASSERT_EQ(n.m_event->type, ET_PACKET_OUT_DELAYED);
+  ASSERT_EQ(1, chs.get(id)->egress_buffer().size());
+  ASSERT_EQ(0, filter.release(id).data.size());
+  ASSERT_EQ(filter_t::rate_limiter::duration::max(),
+      filter.release_delay(id));
+
+  // Raising the rate at run-time lets it through eventually.
+  limiter.set_rate(1'000'000'000, PACKET_SIZE);
+  ASSERT_LT(filter.release_delay(id), std::chrono::seconds{1});
+
+  // A channel limiter applies in addition to the connection limiter.
+  channeler::support::token_bucket channel_limiter{0, PACKET_SIZE};
+  ASSERT_TRUE(channel_limiter.consume(PACKET_SIZE));
+  chs.get(id)->set_rate_limiter(&channel_limiter);
+  ASSERT_EQ(0, filter.release(id).data.size());
+
+  chs.get(id)->set_rate_limiter(nullptr);
+  while (!filter.release(id).data.size()) {
+    // Wait for the connection limiter to refill.
+  }
+  ASSERT_TRUE(chs.get(id)->egress_buffer().empty());
+}
+
+
+TEST(PipeEgressOutBufferFilter, drop_expired_packets)
+{
+  using namespace channeler::pipe;
+  using namespace std::chrono_literals;
+
+  pool_type pool{PACKET_SIZE};
+  channel_set chs;
+  next n;
+  filter_t filter{&n, chs};
+
+  // A connection limiter that allows one packet, and never refills.
+  channeler::support::token_bucket limiter{0, PACKET_SIZE};
+  filter.set_rate_limiter(&limiter);
+
+  auto enqueue = [&](message_deadline const & deadline)
+  {
+    auto slot = pool.allocate();
+    memcpy(slot.data(), test::packet_default_channel,
+        test::packet_default_channel_size);
+    auto packet = channeler::packet_wrapper(slot.data(), slot.size(), true);
+    auto channel = packet.channel();
+    chs.add(channel);
+
+    filter.consume(std::make_unique<packet_out_event<POOL_BLOCK_SIZE>>(
+        std::move(slot), std::move(packet), false, deadline));
+    return channel;
+  };
+
+  // The first packet uses up the limiter. The second is held back, and
+  // expires while it waits; the third does not expire.
+  auto id = enqueue(message_deadline::max());
+  ASSERT_EQ(PACKET_SIZE, filter.release(id).data.size());
+
+  enqueue(message_deadline::clock::now() + 10ms);
+  enqueue(message_deadline::max());
+  ASSERT_EQ(2, chs.get(id)->egress_buffer().size());
+  ASSERT_EQ(0, filter.release(id).data.size());
+  ASSERT_EQ(0, chs.get(id)->expired_egress_packets());
+
+  std::this_thread::sleep_for(20ms);
+  limiter.set_rate(1'000'000'000, PACKET_SIZE);
+
+  // Only the third packet is released; the second is dropped and counted.
+  while (!filter.release(id).data.size()) {
+    // Wait for the connection limiter to refill.
+  }
+  ASSERT_TRUE(chs.get(id)->egress_buffer().empty());
+  ASSERT_EQ(1, chs.get(id)->expired_egress_packets());
+
+  // Packets that are not collected in time are dropped, too, even when no
+  // limiter holds them back.
+  filter.set_rate_limiter(nullptr);
+  enqueue(message_deadline::clock::now() + 10ms);
+  ASSERT_EQ(filter_t::rate_limiter::duration::zero(),
+      filter.release_delay(id));
+  std::this_thread::sleep_for(20ms);
+  ASSERT_EQ(filter_t::rate_limiter::duration::max(),
+      filter.release_delay(id));
+  ASSERT_EQ(0, filter.release(id).data.size());
+  ASSERT_EQ(2, chs.get(id)->expired_egress_packets());
+}
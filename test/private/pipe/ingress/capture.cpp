@@ -0,0 +1,117 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/pipe/ingress/capture.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "../../../exceptions.h"
+#include "../../../packets.h"
+
+namespace {
+
+// For testing
+using address_t = uint16_t;
+constexpr std::size_t POOL_BLOCK_SIZE = 3;
+constexpr std::size_t PACKET_SIZE = 200;
+
+using pool_type = ::channeler::memory::packet_pool<POOL_BLOCK_SIZE>;
+
+struct next
+{
+  using input_event = channeler::pipe::raw_buffer_event<address_t, POOL_BLOCK_SIZE>;
+
+  inline channeler::pipe::action_list_type consume(std::unique_ptr<channeler::pipe::event> event)
+  {
+    m_event = std::move(event);
+    return {};
+  }
+  std::unique_ptr<channeler::pipe::event> m_event;
+};
+
+using filter_t = channeler::pipe::ingress_capture_filter<
+  address_t,
+  POOL_BLOCK_SIZE,
+  next,
+  next::input_event
+>;
+
+} // anonymous namespace
+
+
+
+TEST(PipeIngressCaptureFilter, pass_through_without_capture)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  auto data = pool.allocate();
+
+  next n;
+  filter_t filter{&n};
+
+  // Without a capture, events are not even inspected.
+  auto ev = std::make_unique<event>();
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  ASSERT_TRUE(n.m_event);
+  ASSERT_EQ(n.m_event->type, ET_UNKNOWN);
+}
+
+
+
+TEST(PipeIngressCaptureFilter, capture_packet)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+  auto data = pool.allocate();
+  std::memcpy(data.data(), test::packet_default_channel,
+      test::packet_default_channel_size);
+
+  std::size_t written = 0;
+  channeler::capture::packet_capture cap{
+    [&written](channeler::byte const *, std::size_t size)
+    {
+      written += size;
+    }};
+
+  next n;
+  filter_t filter{&n, &cap};
+
+  // Invalid events are rejected when capturing.
+  CHANNELER_ASSERT_THROW(filter.consume(std::make_unique<event>()),
+      ::channeler::exception);
+
+  auto ev = std::make_unique<filter_t::input_event>(123, 321, data);
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
+
+  ASSERT_EQ(n.m_event->type, ET_RAW_BUFFER);
+  ASSERT_EQ(1, cap.captured());
+
+  // Only the packet is captured, not the remainder of the slot.
+  cap.flush();
+  ASSERT_EQ(channeler::capture::PCAPNG_SECTION_HEADER_SIZE
+      + channeler::capture::PCAPNG_INTERFACE_DESCRIPTION_SIZE
+      + channeler::capture::pcapng_enhanced_packet_size(
+        test::packet_default_channel_size),
+      written);
+}
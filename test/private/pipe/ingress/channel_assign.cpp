@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 using namespace test;
@@ -78,10 +79,10 @@ TEST(PipeIngressChannelAssignFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -103,7 +104,7 @@ TEST(PipeIngressChannelAssignFilter, pass_packet_default_channel)
 
   // No data added to event.
   auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event.
@@ -134,7 +135,7 @@ TEST(PipeIngressChannelAssignFilter, drop_packet_unknown_channel)
 
   // No data added to event.
   auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event.
@@ -164,7 +165,7 @@ TEST(PipeIngressChannelAssignFilter, pass_packet_known_channel)
 
   // No data added to event.
   auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event.
@@ -198,7 +199,7 @@ TEST(PipeIngressChannelAssignFilter, pass_packet_pending_channel)
 
   // No data added to event.
   auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the packet to be passed on without a channel structure. This is
   // to avoid creating buffers, but is necessary for support of early data.
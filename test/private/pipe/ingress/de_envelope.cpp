@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
+
 namespace {
 
 // For testing
@@ -63,10 +65,10 @@ TEST(PipeIngressDeEnvelopeFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -84,7 +86,7 @@ TEST(PipeIngressDeEnvelopeFilter, parse_data)
 
   // No data added to event.
   auto ev = std::make_unique<filter_t::input_event>(123, 321, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // No need to actually test packet header parsing - that's been tested
   // elsewhere. This tests that the filter passes on things well.
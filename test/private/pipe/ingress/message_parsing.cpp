@@ -23,6 +23,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 using namespace test;
@@ -79,10 +80,10 @@ TEST(PipeIngressMessageParsingFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -110,7 +111,7 @@ TEST(PipeIngressMessageParsingFilter, produce_message_events)
   auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data,
       channel_set::channel_ptr{});
   ASSERT_EQ(2, data.use_count());
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event. The data slot has a use count of 4 - one for the
@@ -154,7 +155,7 @@ TEST(PipeIngressMessageParsingFilter, empty_packet)
       channel_set::channel_ptr{});
   ASSERT_TRUE(ev);
   ASSERT_EQ(2, data.use_count());
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
   ASSERT_FALSE(ev);
   ASSERT_EQ(1, data.use_count());
 
@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 using namespace test;
@@ -37,14 +38,14 @@ using pool_type = ::channeler::memory::packet_pool<POOL_BLOCK_SIZE>;
 
 struct next
 {
-  using input_event = channeler::pipe::decrypted_packet_event<address_t, POOL_BLOCK_SIZE>;
+  using input_event = channeler::pipe::parsed_header_event<address_t, POOL_BLOCK_SIZE>;
 
   inline channeler::pipe::action_list_type consume(std::unique_ptr<channeler::pipe::event> event)
   {
     m_event = std::move(event);
     auto ptr = reinterpret_cast<input_event *>(m_event.get());
     channeler::pipe::action_list_type al;
-    al.push_back(std::make_unique<channeler::pipe::peer_filter_request_action>(ptr->packet.sender()));
+    al.push_back(std::make_unique<channeler::pipe::peer_filter_request_action>(ptr->header.sender));
     return al;
   }
 
@@ -69,10 +70,10 @@ TEST(PipeIngressRouteFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -93,16 +94,46 @@ TEST(PipeIngressRouteFilter, pass_packet)
 
   // No data added to event.
   auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event.
-  ASSERT_EQ(n.m_event->type, ET_DECRYPTED_PACKET);
+  ASSERT_EQ(n.m_event->type, ET_PARSED_HEADER);
   next::input_event * ptr = reinterpret_cast<next::input_event *>(n.m_event.get());
   ASSERT_EQ(123, ptr->transport.source);
   ASSERT_EQ(321, ptr->transport.destination);
-  ASSERT_EQ(ptr->packet.sender().display(), "0x000000000000000000000000000a11c3");
-  ASSERT_EQ(ptr->packet.recipient().display(), "0x00000000000000000000000000000b0b");
+  ASSERT_EQ(ptr->header.sender.display(), "0x000000000000000000000000000a11c3");
+  ASSERT_EQ(ptr->header.recipient.display(), "0x00000000000000000000000000000b0b");
+}
+
+
+
+TEST(PipeIngressRouteFilter, reject_malformed_packet)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  // Corrupt the packet size; it is smaller than the envelope.
+  auto data = pool.allocate();
+  ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
+  auto offset = channeler::public_header_layout::PUB_OFFS_PACKET_SIZE;
+  data.data()[offset] = channeler::byte{0x00};
+  data.data()[offset + 1] = channeler::byte{0x10};
+  channeler::public_header_fields header{data.data()};
+
+  next n;
+  filter_t filter{&n};
+
+  auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
+  auto res = filter.consume(std::move(ev));
+
+  // The packet is reported as an error, and not passed on.
+  ASSERT_EQ(1, res.size());
+  ASSERT_EQ(AT_ERROR, res.front()->type);
+  auto act = reinterpret_cast<error_action *>(res.front().get());
+  ASSERT_EQ(channeler::ERR_DECODE, act->error);
+  ASSERT_FALSE(n.m_event);
 }
 
 
@@ -126,7 +157,7 @@ TEST(PipeIngressRouteFilter, drop_sender)
 
   // No data added to event.
   auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the next filter not to be called based on the filtered sender
   ASSERT_FALSE(n.m_event);
@@ -153,7 +184,7 @@ TEST(PipeIngressRouteFilter, drop_recipient)
 
   // No data added to event.
   auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the next filter not to be called based on the filtered sender
   ASSERT_FALSE(n.m_event);
@@ -182,7 +213,7 @@ TEST(PipeIngressRouteFilter, pass_first_drop_second)
   // We expect the event to be passed on verbatim, so we'll test what there
   // is in the output event.
   ASSERT_EQ(res.size(), 1);
-  EXPECT_EQ(n.m_event->type, ET_DECRYPTED_PACKET);
+  EXPECT_EQ(n.m_event->type, ET_PARSED_HEADER);
 
   // However, the packet should have resulted in sender ban action from the
   // test next filter. That means a second packet with the same payload should
@@ -200,3 +231,85 @@ TEST(PipeIngressRouteFilter, pass_first_drop_second)
   ASSERT_FALSE(n.m_event);
 }
 
+
+
+
+TEST(PipeIngressRouteFilter, forward_packet)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  auto data = pool.allocate();
+  ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
+  channeler::public_header_fields header{data.data()};
+
+  // The table belongs to some other node than the packet's recipient.
+  channeler::peerid self;
+  filter_t::forwarding_table_type table{self};
+  table.add(header.recipient.copy(), 42);
+
+  next n;
+  filter_t filter{&n, &table};
+
+  auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
+  auto res = filter.consume(std::move(ev));
+
+  // Not passed on; the slot is returned unchanged with the next hop.
+  ASSERT_FALSE(n.m_event);
+  ASSERT_EQ(res.size(), 1);
+  ASSERT_EQ(res.front()->type, AT_FORWARD_PACKET);
+  auto act = reinterpret_cast<filter_t::forward_action *>(res.front().get());
+  ASSERT_EQ(42, act->next_hop);
+  ASSERT_EQ(data, act->slot);
+}
+
+
+
+TEST(PipeIngressRouteFilter, forward_unroutable)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  auto data = pool.allocate();
+  ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
+  channeler::public_header_fields header{data.data()};
+
+  channeler::peerid self;
+  filter_t::forwarding_table_type table{self};
+
+  next n;
+  filter_t filter{&n, &table};
+
+  // No route for the recipient: dropped.
+  auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
+  auto res = filter.consume(std::move(ev));
+  ASSERT_EQ(res.size(), 0);
+  ASSERT_FALSE(n.m_event);
+}
+
+
+
+TEST(PipeIngressRouteFilter, forwarding_passes_own_packets)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  auto data = pool.allocate();
+  ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
+  channeler::public_header_fields header{data.data()};
+
+  // We are the recipient.
+  filter_t::forwarding_table_type table{header.recipient.copy()};
+  table.add(header.recipient.copy(), 42);
+
+  next n;
+  filter_t filter{&n, &table};
+
+  auto ev = std::make_unique<filter_t::input_event>(123, 321, header, data);
+  filter.consume(std::move(ev));
+  ASSERT_TRUE(n.m_event);
+  ASSERT_EQ(n.m_event->type, ET_PARSED_HEADER);
+}
@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../../../exceptions.h"
 #include "../../../packets.h"
 
 using namespace test;
@@ -84,10 +85,10 @@ TEST(PipeIngressValidateFilter, throw_on_invalid_event)
 
   // Create a default event; this should not be handled.
   auto ev = std::make_unique<event>();
-  ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(std::move(ev)), ::channeler::exception);
 
   // The filter should also throw on a null event
-  ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
+  CHANNELER_ASSERT_THROW(filter.consume(nullptr), ::channeler::exception);
 }
 
 
@@ -101,17 +102,17 @@ TEST(PipeIngressValidateFilter, pass_packet)
   // Copy packet data before parsing header
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   simple_filter_t filter{&n};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
-  // We expect the event to be passed on verbatim, so we'll test what there
-  // is in the output event.
+  // We expect the packet to be passed on, so we'll test what there is in the
+  // output event.
   ASSERT_EQ(n.m_event->type, ET_DECRYPTED_PACKET);
   next::input_event * ptr = reinterpret_cast<next::input_event *>(n.m_event.get());
   ASSERT_EQ(123, ptr->transport.source);
@@ -122,6 +123,45 @@ TEST(PipeIngressValidateFilter, pass_packet)
 
 
 
+TEST(PipeIngressValidateFilter, reject_malformed_packet)
+{
+  using namespace channeler::pipe;
+
+  pool_type pool{PACKET_SIZE};
+
+  // Corrupt the payload size; it exceeds the packet. The route filter would
+  // reject this, but the checksum matches, so the packet is only caught when
+  // it is wrapped for the next filter.
+  auto data = pool.allocate();
+  ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
+  auto offset = channeler::public_header_layout::PUB_SIZE
+    + channeler::private_header_layout::PRIV_OFFS_PAYLOAD_SIZE;
+  data.data()[offset] = channeler::byte{0x01};
+
+  channeler::packet_view view{data.data(), data.size()};
+  auto sum = view.calculate_checksum();
+  auto footer = data.data() + packet_default_channel_size - 4;
+  for (std::size_t i = 0 ; i < 4 ; ++i) {
+    footer[i] = static_cast<channeler::byte>(sum >> (8 * (3 - i)));
+  }
+  channeler::public_header_fields header{data.data()};
+
+  next n;
+  simple_filter_t filter{&n};
+
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
+  auto res = filter.consume(std::move(ev));
+
+  // The packet is reported as an error, and not passed on.
+  ASSERT_EQ(1, res.size());
+  ASSERT_EQ(AT_ERROR, res.front()->type);
+  auto act = reinterpret_cast<error_action *>(res.front().get());
+  ASSERT_EQ(channeler::ERR_DECODE, act->error);
+  ASSERT_FALSE(n.m_event);
+}
+
+
+
 TEST(PipeIngressValidateFilter, drop_packet)
 {
   using namespace channeler::pipe;
@@ -132,14 +172,14 @@ TEST(PipeIngressValidateFilter, drop_packet)
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
   data.data()[packet_default_channel_size - 1] = 0x00_b; // Bad checksum - null the last byte
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   simple_filter_t filter{&n};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
-  ASSERT_NO_THROW(filter.consume(std::move(ev)));
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
+  CHANNELER_ASSERT_NO_THROW(filter.consume(std::move(ev)));
 
   // We expect the event not to be passed on.
   ASSERT_FALSE(n.m_event);
@@ -168,14 +208,14 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_transport_source)
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
   data.data()[packet_default_channel_size - 1] = 0x00_b; // Bad checksum - null the last byte
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   transport_policy_t t{true};
   test_filter_t filter{&n, nullptr, &t};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
   auto res = filter.consume(std::move(ev));
 
   // We expect the event not to be passed on.
@@ -214,14 +254,14 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_transport_destination)
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
   data.data()[packet_default_channel_size - 1] = 0x00_b; // Bad checksum - null the last byte
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   transport_policy_t t{false};
   test_filter_t filter{&n, nullptr, &t};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
   auto res = filter.consume(std::move(ev));
 
   // We expect the event not to be passed on.
@@ -260,14 +300,14 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_peer_sender)
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
   data.data()[packet_default_channel_size - 1] = 0x00_b; // Bad checksum - null the last byte
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   peer_policy_t t{true};
   test_filter_t filter{&n, &t};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
   auto res = filter.consume(std::move(ev));
 
   // We expect the event not to be passed on.
@@ -279,7 +319,7 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_peer_sender)
   auto & action = *res.begin();
   ASSERT_EQ(action->type, AT_FILTER_PEER);
   auto * ptr = reinterpret_cast<peer_filter_request_action *>(action.get());
-  ASSERT_EQ(ptr->peer, packet.sender());
+  ASSERT_EQ(ptr->peer, header.sender);
   ASSERT_TRUE(ptr->ingress);
 }
 
@@ -306,14 +346,14 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_peer_recipient)
   auto data = pool.allocate();
   ::memcpy(data.data(), packet_default_channel, packet_default_channel_size);
   data.data()[packet_default_channel_size - 1] = 0x00_b; // Bad checksum - null the last byte
-  channeler::packet_wrapper packet{data.data(), data.size()};
+  channeler::public_header_fields header{data.data()};
 
   next n;
   peer_policy_t t{false};
   test_filter_t filter{&n, &t};
 
   // No data added to event.
-  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, packet, data);
+  auto ev = std::make_unique<simple_filter_t::input_event>(123, 321, header, data);
   auto res = filter.consume(std::move(ev));
 
   // We expect the event not to be passed on.
@@ -325,6 +365,6 @@ TEST(PipeIngressValidateFilter, drop_packet_ban_peer_recipient)
   auto & action = *res.begin();
   ASSERT_EQ(action->type, AT_FILTER_PEER);
   auto * ptr = reinterpret_cast<peer_filter_request_action *>(action.get());
-  ASSERT_EQ(ptr->peer, packet.recipient());
+  ASSERT_EQ(ptr->peer, header.recipient);
   ASSERT_FALSE(ptr->ingress);
 }
@@ -0,0 +1,158 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/snapshot.h"
+
+#if defined(CHANNELER_POSIX)
+#include "../lib/snapshot_file.h"
+
+#include <unistd.h>
+#endif
+
+#include <gtest/gtest.h>
+
+namespace {
+
+inline channeler::connection_snapshot
+make_snapshot()
+{
+  using namespace channeler;
+
+  connection_snapshot snap;
+  snap.secret = {byte{0xde}, byte{0xad}, byte{0xbe}, byte{0xef}};
+
+  channel_snapshot ch1;
+  ch1.id = create_new_channelid();
+  complete_channelid(ch1.id);
+  ch1.capabilities[CAP_RESEND] = true;
+  ch1.resumption_cookie = 0x12345678;
+  snap.channels.push_back(ch1);
+
+  channel_snapshot ch2;
+  ch2.id = DEFAULT_CHANNELID;
+  snap.channels.push_back(ch2);
+
+  snap.fds = {3, 42};
+  return snap;
+}
+
+
+inline void
+assert_equal(channeler::connection_snapshot const & expected,
+    channeler::connection_snapshot const & actual)
+{
+  ASSERT_EQ(expected.self, actual.self);
+  ASSERT_EQ(expected.peer, actual.peer);
+  ASSERT_EQ(expected.secret, actual.secret);
+  ASSERT_EQ(expected.fds, actual.fds);
+  ASSERT_EQ(expected.channels.size(), actual.channels.size());
+  for (std::size_t i = 0 ; i < expected.channels.size() ; ++i) {
+    ASSERT_EQ(expected.channels[i].id, actual.channels[i].id);
+    ASSERT_EQ(expected.channels[i].capabilities,
+        actual.channels[i].capabilities);
+    ASSERT_EQ(expected.channels[i].resumption_cookie,
+        actual.channels[i].resumption_cookie);
+  }
+}
+
+} // anonymous namespace
+
+
+TEST(Snapshot, round_trip)
+{
+  using namespace channeler;
+
+  auto snap = make_snapshot();
+  std::vector<byte> buf(serialized_size(snap));
+
+  ASSERT_EQ(ERR_INSUFFICIENT_BUFFER_SIZE,
+      serialize_snapshot(buf.data(), buf.size() - 1, snap));
+  ASSERT_EQ(ERR_SUCCESS, serialize_snapshot(buf.data(), buf.size(), snap));
+
+  connection_snapshot result;
+  ASSERT_EQ(ERR_SUCCESS, deserialize_snapshot(result, buf.data(), buf.size()));
+  assert_equal(snap, result);
+}
+
+
+TEST(Snapshot, empty)
+{
+  using namespace channeler;
+
+  connection_snapshot snap;
+  std::vector<byte> buf(serialized_size(snap));
+  ASSERT_EQ(ERR_SUCCESS, serialize_snapshot(buf.data(), buf.size(), snap));
+
+  connection_snapshot result = make_snapshot();
+  ASSERT_EQ(ERR_SUCCESS, deserialize_snapshot(result, buf.data(), buf.size()));
+  assert_equal(snap, result);
+}
+
+
+TEST(Snapshot, detect_corruption)
+{
+  using namespace channeler;
+
+  auto snap = make_snapshot();
+  std::vector<byte> buf(serialized_size(snap));
+  ASSERT_EQ(ERR_SUCCESS, serialize_snapshot(buf.data(), buf.size(), snap));
+
+  // Flipping any bit must be detected, and must leave the output untouched.
+  for (std::size_t i = 0 ; i < buf.size() ; ++i) {
+    auto copy = buf;
+    copy[i] ^= byte{0x01};
+
+    connection_snapshot result;
+    ASSERT_EQ(ERR_DECODE, deserialize_snapshot(result, copy.data(),
+          copy.size()));
+    ASSERT_TRUE(result.channels.empty());
+  }
+
+  // Truncated snapshots are rejected, too.
+  for (std::size_t size = 0 ; size < buf.size() ; ++size) {
+    connection_snapshot result;
+    ASSERT_EQ(ERR_DECODE, deserialize_snapshot(result, buf.data(), size));
+  }
+}
+
+
+#if defined(CHANNELER_POSIX)
+TEST(Snapshot, save_and_load)
+{
+  using namespace channeler;
+
+  char name[] = "/tmp/channeler-snapshot-XXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  ::close(fd);
+
+  auto snap = make_snapshot();
+  ASSERT_EQ(ERR_SUCCESS, save_snapshot(name, snap));
+
+  connection_snapshot result;
+  ASSERT_EQ(ERR_SUCCESS, load_snapshot(result, name));
+  assert_equal(snap, result);
+
+  ::unlink(name);
+
+  // Missing files cannot be loaded.
+  ASSERT_EQ(ERR_READ, load_snapshot(result, name));
+}
+#endif
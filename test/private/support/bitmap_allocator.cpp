@@ -0,0 +1,79 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/bitmap_allocator.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+using namespace channeler::support;
+
+TEST(SupportBitmapAllocator, allocate_from_hint)
+{
+  bitmap_allocator<uint16_t> alloc;
+
+  uint16_t id = 0;
+  ASSERT_TRUE(alloc.allocate(id, 0x1234));
+  ASSERT_EQ(0x1234, id);
+  ASSERT_TRUE(alloc.test(0x1234));
+
+  // The same hint yields the next free identifier.
+  ASSERT_TRUE(alloc.allocate(id, 0x1234));
+  ASSERT_EQ(0x1235, id);
+  ASSERT_EQ(2, alloc.size());
+
+  alloc.reset(0x1234);
+  ASSERT_FALSE(alloc.test(0x1234));
+  ASSERT_EQ(1, alloc.size());
+}
+
+
+TEST(SupportBitmapAllocator, wrap_around)
+{
+  bitmap_allocator<uint8_t> alloc;
+
+  for (unsigned i = 0xf0 ; i <= 0xff ; ++i) {
+    alloc.set(static_cast<uint8_t>(i));
+  }
+
+  uint8_t id = 0;
+  ASSERT_TRUE(alloc.allocate(id, 0xf8));
+  ASSERT_EQ(0, id);
+}
+
+
+TEST(SupportBitmapAllocator, exhaustion)
+{
+  bitmap_allocator<uint16_t> alloc;
+
+  std::set<uint16_t> seen;
+  uint16_t id = 0;
+  for (std::size_t i = 0 ; i < 65536 ; ++i) {
+    ASSERT_TRUE(alloc.allocate(id, static_cast<uint16_t>(i * 7919)));
+    ASSERT_TRUE(seen.insert(id).second);
+  }
+  ASSERT_TRUE(alloc.full());
+  ASSERT_FALSE(alloc.allocate(id, 0));
+
+  alloc.reset(0xbeef);
+  ASSERT_TRUE(alloc.allocate(id, 0));
+  ASSERT_EQ(0xbeef, id);
+}
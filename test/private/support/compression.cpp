@@ -0,0 +1,156 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/compression.h"
+
+#include <cstring>
+#include <random>
+
+#include <gtest/gtest.h>
+
+using namespace channeler::support;
+using channeler::byte;
+
+namespace {
+
+inline std::vector<byte>
+telemetry(std::size_t size)
+{
+  // Highly repetitive, like a stream of similar readings.
+  static char const record[] = "{\"sensor\":\"temp-01\",\"value\":21.5,\"unit\":\"C\"}";
+  std::vector<byte> data(size);
+  for (std::size_t i = 0 ; i < size ; ++i) {
+    data[i] = static_cast<byte>(record[i % (sizeof(record) - 1)]);
+  }
+  return data;
+}
+
+} // anonymous namespace
+
+
+TEST(SupportCompression, round_trip)
+{
+  if (!payload_compression::available(CODEC_LZ4)) {
+    GTEST_SKIP() << "LZ4 not available";
+  }
+
+  payload_compression comp;
+  auto data = telemetry(1000);
+  ASSERT_EQ(CODEC_LZ4, comp.select(data.size()));
+
+  std::vector<byte> compressed;
+  ASSERT_TRUE(comp.compress(compressed, data.data(), data.size()));
+  ASSERT_LT(compressed.size(), data.size());
+  ASSERT_EQ(CODEC_LZ4, static_cast<compression_codec>(compressed[0]));
+  ASSERT_EQ(data.size(), payload_compression::original_size(
+        compressed.data(), compressed.size()));
+
+  std::vector<byte> out(data.size());
+  ASSERT_EQ(data.size(), comp.decompress(out.data(), out.size(),
+        compressed.data(), compressed.size()));
+  ASSERT_EQ(data, out);
+
+  // Too little output space is an error.
+  ASSERT_EQ(0, comp.decompress(out.data(), out.size() - 1,
+        compressed.data(), compressed.size()));
+}
+
+
+TEST(SupportCompression, skip_incompressible)
+{
+  payload_compression comp;
+
+  std::vector<byte> data(500);
+  std::mt19937 gen{42};
+  for (auto & b : data) {
+    b = static_cast<byte>(gen());
+  }
+
+  std::vector<byte> compressed;
+  ASSERT_FALSE(comp.compress(compressed, data.data(), data.size()));
+  ASSERT_TRUE(compressed.empty());
+}
+
+
+TEST(SupportCompression, small_payloads_with_dictionary)
+{
+  if (!payload_compression::available(CODEC_ZSTD)) {
+    GTEST_SKIP() << "zstd not available";
+  }
+
+  payload_compression sender;
+  payload_compression receiver;
+  auto dict = telemetry(2000);
+  ASSERT_TRUE(sender.set_dictionary(dict.data(), dict.size()));
+  ASSERT_TRUE(receiver.set_dictionary(dict.data(), dict.size()));
+
+  // A single record; too short for much gain without the dictionary.
+  auto data = telemetry(45);
+  ASSERT_EQ(CODEC_ZSTD, sender.select(data.size()));
+
+  std::vector<byte> compressed;
+  ASSERT_TRUE(sender.compress(compressed, data.data(), data.size()));
+  ASSERT_EQ(CODEC_ZSTD, static_cast<compression_codec>(compressed[0]));
+  ASSERT_LT(compressed.size(), data.size() / 2);
+
+  std::vector<byte> out(data.size());
+  ASSERT_EQ(data.size(), receiver.decompress(out.data(), out.size(),
+        compressed.data(), compressed.size()));
+  ASSERT_EQ(data, out);
+
+  // Larger payloads still use LZ4, if available.
+  if (payload_compression::available(CODEC_LZ4)) {
+    ASSERT_EQ(CODEC_LZ4, sender.select(1000));
+  }
+}
+
+
+
+TEST(SupportCompression, restrict_codecs)
+{
+  if (!payload_compression::available(CODEC_ZSTD)) {
+    GTEST_SKIP() << "zstd not available";
+  }
+
+  payload_compression comp;
+  ASSERT_EQ(0, comp.dictionary_id());
+
+  auto dict = telemetry(2000);
+  ASSERT_TRUE(comp.set_dictionary(dict.data(), dict.size()));
+  ASSERT_NE(0, comp.dictionary_id());
+
+  // The id depends only on the dictionary contents.
+  payload_compression same;
+  ASSERT_TRUE(same.set_dictionary(dict.data(), dict.size()));
+  ASSERT_EQ(comp.dictionary_id(), same.dictionary_id());
+
+  payload_compression other;
+  auto other_dict = telemetry(1999);
+  ASSERT_TRUE(other.set_dictionary(other_dict.data(), other_dict.size()));
+  ASSERT_NE(comp.dictionary_id(), other.dictionary_id());
+
+  // Without the dictionary, small payloads use LZ4 or nothing; zstd is
+  // never used without the dictionary.
+  auto expected = payload_compression::available(CODEC_LZ4)
+    ? CODEC_LZ4 : CODEC_NONE;
+  ASSERT_EQ(expected, comp.select(45, true, false));
+  ASSERT_EQ(CODEC_NONE, comp.select(45, false, false));
+  ASSERT_EQ(CODEC_NONE, comp.select(1000, false, true));
+}
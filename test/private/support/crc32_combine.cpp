@@ -0,0 +1,81 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/crc32_combine.h"
+
+#include <vector>
+
+#include <liberate/checksum/crc32.h>
+
+#include <gtest/gtest.h>
+
+using namespace channeler::support;
+using namespace liberate::checksum;
+
+namespace {
+
+constexpr uint32_t CRC32C_REFLECTED = 0x82F63B78;
+
+inline std::vector<uint8_t>
+test_data(std::size_t size)
+{
+  std::vector<uint8_t> data(size);
+  for (std::size_t i = 0 ; i < size ; ++i) {
+    data[i] = static_cast<uint8_t>(i * 7 + 3);
+  }
+  return data;
+}
+
+} // anonymous namespace
+
+
+TEST(SupportCRC32Combine, combine_matches_whole_buffer)
+{
+  auto data = test_data(1500);
+  auto expected = crc32<CRC32C>(data.begin(), data.end());
+
+  for (std::size_t split : { 0, 1, 7, 80, 1024, 1499, 1500 }) {
+    auto a = crc32<CRC32C>(data.begin(), data.begin() + split);
+    auto b = crc32<CRC32C>(data.begin() + split, data.end());
+    ASSERT_EQ(expected,
+        crc32_combine<CRC32C_REFLECTED>(a, b, data.size() - split))
+      << "split at " << split;
+  }
+}
+
+
+TEST(SupportCRC32Combine, shared_tail)
+{
+  // The use case: many different heads, one shared tail, and the shift
+  // operator is built once.
+  auto tail = test_data(1000);
+  auto tail_crc = crc32<CRC32C>(tail.begin(), tail.end());
+  crc32_shift<CRC32C_REFLECTED> shift{tail.size()};
+  ASSERT_EQ(tail.size(), shift.length());
+
+  for (uint8_t i = 0 ; i < 10 ; ++i) {
+    std::vector<uint8_t> whole(40, i);
+    auto head_crc = crc32<CRC32C>(whole.begin(), whole.end());
+    whole.insert(whole.end(), tail.begin(), tail.end());
+
+    ASSERT_EQ(crc32<CRC32C>(whole.begin(), whole.end()),
+        shift.combine(head_crc, tail_crc));
+  }
+}
@@ -0,0 +1,130 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/ecn.h"
+
+#include <gtest/gtest.h>
+
+using namespace channeler::support;
+
+TEST(SupportECN, counts)
+{
+  ASSERT_EQ(ECN_CE, ecn_from_tos(0xff));
+  ASSERT_EQ(ECN_ECT0, ecn_from_tos(0xb8 | 0x02));
+  ASSERT_EQ(ECN_NOT_ECT, ecn_from_tos(0xb8));
+
+  ecn_counts counts;
+  counts.record(ECN_ECT0);
+  counts.record(ECN_ECT0);
+  counts.record(ECN_ECT1);
+  counts.record(ECN_CE);
+  counts.record(ECN_NOT_ECT);
+
+  ASSERT_EQ(2, counts.ect0);
+  ASSERT_EQ(1, counts.ect1);
+  ASSERT_EQ(1, counts.ce);
+  ASSERT_EQ(4, counts.total());
+}
+
+
+TEST(SupportECN, rate_controller)
+{
+  auto now = token_bucket::clock_type::now();
+  token_bucket bucket{10000, 1000, now};
+  ecn_rate_controller ctrl{bucket, 1000, 20000, 500};
+
+  // Without new packets, nothing changes.
+  ASSERT_FALSE(ctrl.on_feedback({}, now));
+  ASSERT_EQ(10000, bucket.rate());
+
+  // Unmarked packets increase the rate additively, up to the maximum.
+  ASSERT_FALSE(ctrl.on_feedback({10, 0, 0}, now));
+  ASSERT_EQ(10500, bucket.rate());
+
+  // CE marks halve it, once per feedback.
+  ASSERT_TRUE(ctrl.on_feedback({20, 0, 5}, now));
+  ASSERT_EQ(5250, bucket.rate());
+  ASSERT_EQ(1, ctrl.congestion_events());
+  ASSERT_EQ(1000, bucket.burst());
+
+  // Repeated counts are not new marks.
+  ASSERT_FALSE(ctrl.on_feedback({30, 0, 5}, now));
+  ASSERT_EQ(5750, bucket.rate());
+
+  // The rate does not fall below the minimum.
+  for (uint32_t ce = 6 ; ce < 20 ; ++ce) {
+    now += ctrl.rtt();
+    ctrl.on_feedback({30, 0, ce}, now);
+  }
+  ASSERT_EQ(1000, bucket.rate());
+}
+
+
+TEST(SupportECN, rate_controller_once_per_rtt)
+{
+  using namespace std::chrono_literals;
+
+  auto now = token_bucket::clock_type::now();
+  token_bucket bucket{16000, 1000, now};
+  ecn_rate_controller ctrl{bucket, 1000, 20000, 500, 0.5, 50ms};
+  ASSERT_EQ(50ms, ctrl.rtt());
+
+  ASSERT_TRUE(ctrl.on_feedback({10, 0, 1}, now));
+  ASSERT_EQ(8000, bucket.rate());
+
+  // Marks within a round trip belong to the same congestion event; they
+  // neither decrease nor increase the rate.
+  ASSERT_FALSE(ctrl.on_feedback({20, 0, 2}, now + 10ms));
+  ASSERT_FALSE(ctrl.on_feedback({30, 0, 3}, now + 49ms));
+  ASSERT_EQ(8000, bucket.rate());
+  ASSERT_EQ(1, ctrl.congestion_events());
+
+  // Unmarked traffic still increases it.
+  ASSERT_FALSE(ctrl.on_feedback({40, 0, 3}, now + 20ms));
+  ASSERT_EQ(8500, bucket.rate());
+
+  // After a round trip, marks are a new congestion event.
+  ASSERT_TRUE(ctrl.on_feedback({50, 0, 4}, now + 50ms));
+  ASSERT_EQ(4250, bucket.rate());
+  ASSERT_EQ(2, ctrl.congestion_events());
+
+  // A shorter round trip shortens the window.
+  ctrl.set_rtt(5ms);
+  ASSERT_TRUE(ctrl.on_feedback({60, 0, 5}, now + 55ms));
+  ASSERT_EQ(2125, bucket.rate());
+}
+
+
+TEST(SupportECN, rate_controller_wrap_around)
+{
+  auto now = token_bucket::clock_type::now();
+  token_bucket bucket{10000, 1000, now};
+  ecn_rate_controller ctrl{bucket, 1000, 20000, 500};
+
+  ctrl.on_feedback({0xfffffff0, 0, 0xffffffff}, now);
+  auto rate = bucket.rate();
+
+  // Counts wrapped around; the CE count did not increase.
+  ASSERT_FALSE(ctrl.on_feedback({0x10, 0, 0xffffffff}, now));
+  ASSERT_EQ(rate + 500, bucket.rate());
+
+  // Now it did.
+  ASSERT_TRUE(ctrl.on_feedback({0x20, 0, 0}, now + ctrl.rtt()));
+}
@@ -0,0 +1,158 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/keepalive.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using scheduler = channeler::support::keepalive_scheduler<int>;
+
+} // anonymous namespace
+
+
+TEST(SupportKeepalive, probe_idle_connections)
+{
+  scheduler sched{10s, 10};
+  ASSERT_EQ(1s, sched.granularity());
+
+  ASSERT_TRUE(sched.add(1));
+  ASSERT_TRUE(sched.add(2));
+  ASSERT_FALSE(sched.add(2));
+  ASSERT_EQ(2, sched.size());
+
+  std::multiset<int> probed;
+  auto probe = [&probed](int key) { probed.insert(key); };
+
+  // Nothing is due before the interval elapsed.
+  for (int i = 0 ; i < 9 ; ++i) {
+    ASSERT_EQ(0, sched.advance(1s, probe));
+  }
+
+  // Both are probed once at the interval...
+  ASSERT_EQ(2, sched.advance(1s, probe));
+  ASSERT_EQ((std::multiset<int>{1, 2}), probed);
+
+  // ... and once per interval thereafter.
+  ASSERT_EQ(0, sched.advance(9s, probe));
+  ASSERT_EQ(2, sched.advance(1s, probe));
+  ASSERT_EQ(4, probed.size());
+}
+
+
+TEST(SupportKeepalive, traffic_suppresses_probes)
+{
+  scheduler sched{10s, 10};
+  sched.add(1);
+  sched.add(2);
+
+  std::multiset<int> probed;
+  auto probe = [&probed](int key) { probed.insert(key); };
+
+  // Traffic on 1 halfway through the interval postpones its probe by half
+  // an interval.
+  sched.advance(5s, probe);
+  sched.touch(1);
+  ASSERT_EQ(1, sched.advance(5s, probe));
+  ASSERT_EQ((std::multiset<int>{2}), probed);
+
+  ASSERT_EQ(0, sched.advance(4s, probe));
+  ASSERT_EQ(1, sched.advance(1s, probe));
+  ASSERT_EQ((std::multiset<int>{1, 2}), probed);
+
+  // Continuous traffic means no probes at all.
+  probed.clear();
+  for (int i = 0 ; i < 100 ; ++i) {
+    sched.touch(1);
+    sched.touch(2);
+    sched.advance(1s, probe);
+  }
+  ASSERT_TRUE(probed.empty());
+}
+
+
+TEST(SupportKeepalive, remove_connections)
+{
+  scheduler sched{10s, 10};
+  sched.add(1);
+  sched.add(2);
+
+  std::multiset<int> probed;
+  auto probe = [&probed](int key) { probed.insert(key); };
+
+  sched.remove(2);
+  ASSERT_EQ(1, sched.size());
+  ASSERT_EQ(1, sched.advance(10s, probe));
+  ASSERT_EQ((std::multiset<int>{1}), probed);
+
+  // Adding a removed connection again schedules it anew, once.
+  sched.advance(5s, probe);
+  sched.remove(1);
+  sched.add(1);
+  probed.clear();
+  ASSERT_EQ(0, sched.advance(5s, probe));
+  ASSERT_EQ(1, sched.advance(5s, probe));
+  ASSERT_EQ((std::multiset<int>{1}), probed);
+}
+
+
+TEST(SupportKeepalive, long_pauses)
+{
+  scheduler sched{10s, 10};
+  sched.add(1);
+
+  std::size_t count = 0;
+  auto probe = [&count](int) { ++count; };
+
+  // Many intervals pass in one step; still only a single probe is due.
+  ASSERT_EQ(1, sched.advance(1000s, probe));
+  ASSERT_EQ(0, sched.advance(9s, probe));
+  ASSERT_EQ(1, sched.advance(1s, probe));
+  ASSERT_EQ(2, count);
+}
+
+
+TEST(SupportKeepalive, spread_probes)
+{
+  // Connections added over the course of an interval are probed in the
+  // slots they are due, not all at once.
+  constexpr std::size_t CONNECTIONS = 1000;
+  scheduler sched{10s, 10};
+
+  std::size_t count = 0;
+  auto probe = [&count](int) { ++count; };
+
+  for (std::size_t i = 0 ; i < CONNECTIONS ; ++i) {
+    sched.advance(10ms, probe);
+    sched.add(i);
+  }
+  ASSERT_EQ(0, count);
+
+  for (int i = 0 ; i < 10 ; ++i) {
+    auto probes = sched.advance(1s, probe);
+    ASSERT_EQ(CONNECTIONS / 10, probes);
+  }
+  ASSERT_EQ(CONNECTIONS, count);
+}
@@ -0,0 +1,76 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/random_bits.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace channeler::support;
+
+
+TEST(SupportRandomBits, secure_fill)
+{
+  // Large fills may be served in parts; odd sizes leave a partial word.
+  for (std::size_t size : {1, 7, 32, 1000, 100 * 1000}) {
+    std::vector<channeler::byte> first(size);
+    std::vector<channeler::byte> second(size);
+    secure_random_fill(first.data(), first.size());
+    secure_random_fill(second.data(), second.size());
+
+    if (size >= 32) {
+      ASSERT_NE(first, second);
+      ASSERT_TRUE(std::any_of(first.begin(), first.end(),
+            [](channeler::byte b) { return b != channeler::byte{0}; }));
+    }
+  }
+
+  // The last Byte of a large fill is random, too.
+  std::vector<channeler::byte> buf(100 * 1000 + 1);
+  std::size_t zeroes = 0;
+  for (std::size_t i = 0 ; i < 64 ; ++i) {
+    buf.back() = channeler::byte{0};
+    secure_random_fill(buf.data(), buf.size());
+    zeroes += (buf.back() == channeler::byte{0});
+  }
+  ASSERT_LT(zeroes, 8);
+}
+
+
+TEST(SupportRandomBits, secure_bits)
+{
+  secure_random_bits<uint64_t> bits;
+  ASSERT_NE(bits.get(), bits.get());
+}
+
+
+TEST(SupportRandomBits, fast_bits)
+{
+  random_bits<uint64_t> bits;
+  ASSERT_NE(bits.get(), bits.get());
+
+  for (std::size_t i = 0 ; i < 1000 ; ++i) {
+    auto factor = bits.get_factor();
+    ASSERT_GE(factor, 0.0);
+    ASSERT_LT(factor, 1.0);
+  }
+}
@@ -0,0 +1,85 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/siphash.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace channeler;
+using namespace channeler::support;
+
+namespace {
+
+inline std::vector<byte>
+sequence(std::size_t size)
+{
+  std::vector<byte> data(size);
+  for (std::size_t i = 0 ; i < size ; ++i) {
+    data[i] = static_cast<byte>(i);
+  }
+  return data;
+}
+
+} // anonymous namespace
+
+
+TEST(SupportSipHash, reference_vectors)
+{
+  // Key 00 01 .. 0f, input 00 01 .. (n - 1); from the SipHash paper and its
+  // reference implementation.
+  auto key_bytes = sequence(16);
+  auto key = siphash_key::from_bytes(key_bytes.data(), key_bytes.size());
+
+  auto empty = sequence(0);
+  ASSERT_EQ(0x726fdb47dd0e0e31ULL, siphash24(key, empty.data(), empty.size()));
+
+  auto msg = sequence(15);
+  ASSERT_EQ(0xa129ca6149be45e5ULL, siphash24(key, msg.data(), msg.size()));
+}
+
+
+TEST(SupportSipHash, key_changes_result)
+{
+  auto msg = sequence(32);
+
+  auto key_bytes = sequence(16);
+  auto key1 = siphash_key::from_bytes(key_bytes.data(), key_bytes.size());
+  key_bytes[3] ^= 0x01;
+  auto key2 = siphash_key::from_bytes(key_bytes.data(), key_bytes.size());
+
+  ASSERT_NE(siphash24(key1, msg.data(), msg.size()),
+      siphash24(key2, msg.data(), msg.size()));
+}
+
+
+TEST(SupportSipHash, long_secrets_are_folded)
+{
+  auto key_bytes = sequence(16);
+  auto key = siphash_key::from_bytes(key_bytes.data(), key_bytes.size());
+
+  auto long_bytes = sequence(20);
+  auto long_key = siphash_key::from_bytes(long_bytes.data(), long_bytes.size());
+
+  // Bytes 16..19 are folded into the low half of k0.
+  ASSERT_EQ(key.k1, long_key.k1);
+  ASSERT_EQ(key.k0 ^ 0x13121110ULL, long_key.k0);
+}
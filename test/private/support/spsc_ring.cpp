@@ -0,0 +1,110 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/spsc_ring.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../exceptions.h"
+
+using namespace channeler::support;
+
+TEST(SupportSPSCRing, capacity)
+{
+  spsc_ring_header header{};
+  uint32_t entries[4];
+
+  CHANNELER_ASSERT_THROW((spsc_ring{&header, entries, 0}), channeler::exception);
+  CHANNELER_ASSERT_THROW((spsc_ring{&header, entries, 3}), channeler::exception);
+
+  spsc_ring ring{&header, entries, 4};
+  ASSERT_TRUE(ring.empty());
+  for (uint32_t i = 0 ; i < 4 ; ++i) {
+    ASSERT_TRUE(ring.push(i));
+  }
+  ASSERT_FALSE(ring.push(4));
+  ASSERT_EQ(4, ring.size());
+
+  uint32_t value = 0;
+  for (uint32_t i = 0 ; i < 4 ; ++i) {
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(i, value);
+  }
+  ASSERT_FALSE(ring.pop(value));
+  ASSERT_TRUE(ring.empty());
+}
+
+
+TEST(SupportSPSCRing, wrap_around)
+{
+  spsc_ring_header header{};
+  uint32_t entries[2];
+  spsc_ring ring{&header, entries, 2};
+
+  // Start close to the counter wrapping around.
+  header.head = header.tail = 0xfffffffe;
+  for (uint32_t i = 0 ; i < 10 ; ++i) {
+    ASSERT_TRUE(ring.push(i));
+    ASSERT_EQ(1, ring.size());
+    uint32_t value = 42;
+    ASSERT_TRUE(ring.pop(value));
+    ASSERT_EQ(i, value);
+  }
+}
+
+
+TEST(SupportSPSCRing, threads)
+{
+  constexpr uint32_t COUNT = 100'000;
+
+  spsc_ring_header header{};
+  std::vector<uint32_t> entries(16);
+  spsc_ring producer{&header, entries.data(), 16};
+  spsc_ring consumer{&header, entries.data(), 16};
+
+  std::thread t{[&producer]()
+  {
+    for (uint32_t i = 0 ; i < COUNT ; ) {
+      if (producer.push(i)) {
+        ++i;
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  uint32_t expected = 0;
+  while (expected < COUNT) {
+    uint32_t value;
+    if (consumer.pop(value)) {
+      ASSERT_EQ(expected, value);
+      ++expected;
+    }
+    else {
+      std::this_thread::yield();
+    }
+  }
+  t.join();
+  ASSERT_TRUE(consumer.empty());
+}
@@ -0,0 +1,100 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/token_bucket.h"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using bucket = channeler::support::token_bucket;
+
+} // anonymous namespace
+
+
+TEST(SupportTokenBucket, burst)
+{
+  auto now = bucket::clock_type::now();
+  bucket b{1000, 3000, now};
+  ASSERT_EQ(1000, b.rate());
+  ASSERT_EQ(3000, b.burst());
+
+  // The bucket starts full, and allows a burst.
+  ASSERT_EQ(3000, b.available(now));
+  ASSERT_TRUE(b.consume(1000, now));
+  ASSERT_TRUE(b.consume(2000, now));
+  ASSERT_EQ(0, b.available(now));
+
+  ASSERT_FALSE(b.allows(1, now));
+  ASSERT_FALSE(b.consume(1, now));
+}
+
+
+TEST(SupportTokenBucket, refill)
+{
+  auto now = bucket::clock_type::now();
+  bucket b{1000, 3000, now};
+  ASSERT_TRUE(b.consume(3000, now));
+
+  // Tokens accrue at the rate...
+  ASSERT_EQ(500, b.available(now + 500ms));
+  ASSERT_EQ(1000, b.delay(1500, now + 500ms).count() / 1'000'000);
+  ASSERT_FALSE(b.consume(1000, now + 500ms));
+  ASSERT_TRUE(b.consume(1000, now + 1s));
+
+  // ... up to the burst size.
+  ASSERT_EQ(3000, b.available(now + 1h));
+  ASSERT_EQ(bucket::duration::zero(), b.delay(3000, now + 1h));
+}
+
+
+TEST(SupportTokenBucket, change_rate)
+{
+  auto now = bucket::clock_type::now();
+  bucket b{1000, 3000, now};
+  ASSERT_TRUE(b.consume(3000, now));
+
+  // Tokens accrued at the old rate are kept.
+  b.set_rate(2000, 1000, now + 500ms);
+  ASSERT_EQ(500, b.available(now + 500ms));
+  ASSERT_EQ(1000, b.available(now + 1s));
+
+  // Without a rate, the bucket never refills.
+  b.set_rate(0, 1000, now + 1s);
+  ASSERT_TRUE(b.consume(1000, now + 1s));
+  ASSERT_EQ(0, b.available(now + 1h));
+  ASSERT_EQ(bucket::duration::max(), b.delay(1, now + 1h));
+}
+
+
+TEST(SupportTokenBucket, oversized)
+{
+  auto now = bucket::clock_type::now();
+  bucket b{1000, 1000, now};
+
+  // A packet larger than the burst is released from a full bucket, and
+  // leaves it in debt.
+  ASSERT_TRUE(b.consume(1500, now));
+  ASSERT_EQ(0, b.available(now + 500ms));
+  ASSERT_FALSE(b.allows(1500, now + 1s));
+  ASSERT_TRUE(b.allows(1500, now + 1500ms));
+}
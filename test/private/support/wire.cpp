@@ -0,0 +1,97 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/support/wire.h"
+
+#include <liberate/serialization/integer.h>
+
+#include <gtest/gtest.h>
+
+using namespace channeler;
+using namespace channeler::support;
+using namespace liberate::types::literals;
+
+TEST(SupportWire, fixed_width_big_endian)
+{
+  byte buf[7] = {};
+
+  // Unaligned on purpose
+  store_be<uint32_t>(buf + 1, 0xbeefd00d);
+  ASSERT_EQ(0xbe_b, buf[1]);
+  ASSERT_EQ(0xef_b, buf[2]);
+  ASSERT_EQ(0xd0_b, buf[3]);
+  ASSERT_EQ(0x0d_b, buf[4]);
+  ASSERT_EQ(0xbeefd00d, load_be<uint32_t>(buf + 1));
+
+  // Must agree with liberate
+  uint32_t other = 0;
+  liberate::serialization::deserialize_int(other, buf + 1, 4);
+  ASSERT_EQ(0xbeefd00d, other);
+}
+
+
+TEST(SupportWire, fixed_layout)
+{
+  using layout = fixed_layout<uint16_t, uint32_t, uint8_t>;
+  static_assert(layout::size == 7);
+
+  byte buf[layout::size] = {};
+  layout::write(buf, uint16_t{0x1234}, uint32_t{0xdeadbeef}, uint8_t{0x42});
+
+  uint16_t a = 0;
+  uint32_t b = 0;
+  uint8_t c = 0;
+  layout::read(buf, a, b, c);
+  ASSERT_EQ(0x1234, a);
+  ASSERT_EQ(0xdeadbeef, b);
+  ASSERT_EQ(0x42, c);
+}
+
+
+TEST(SupportWire, varint_single_byte)
+{
+  byte buf[2] = {};
+  ASSERT_EQ(1, encode_varint(buf, sizeof(buf), 0x14));
+  ASSERT_EQ(0x14_b, buf[0]);
+  ASSERT_EQ(1, varint_size(0x14));
+
+  std::size_t value = 0;
+  ASSERT_EQ(1, decode_varint(value, buf, sizeof(buf)));
+  ASSERT_EQ(0x14, value);
+
+  // No room
+  ASSERT_EQ(0, encode_varint(buf, 0, 0x14));
+  ASSERT_EQ(0, decode_varint(value, buf, 0));
+}
+
+
+TEST(SupportWire, varint_fallback)
+{
+  byte buf[liberate::serialization::VARINT_MAX_BUFSIZE] = {};
+
+  std::size_t const large = 0x12345;
+  auto used = encode_varint(buf, sizeof(buf), large);
+  ASSERT_GT(used, 1);
+  ASSERT_EQ(used, varint_size(large));
+
+  std::size_t value = 0;
+  ASSERT_EQ(used, decode_varint(value, buf, sizeof(buf)));
+  ASSERT_EQ(large, value);
+}
@@ -0,0 +1,327 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <gtest/gtest.h>
+
+#if defined(CHANNELER_HAVE_AF_XDP)
+
+#include "../lib/transport/af_xdp.h"
+#include "../lib/internal/api.h"
+#include "../lib/context/node.h"
+#include "../lib/context/connection.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+
+using namespace channeler;
+
+namespace {
+
+using address_t = int;
+using node_t = context::node<3>;
+using connection_t = context::connection<address_t, node_t>;
+using api_t = internal::connection_api<connection_t>;
+using transport_t = transport::af_xdp_transport<api_t, 4, 64>;
+
+constexpr std::size_t PACKET_SIZE = 200;
+
+
+inline transport::af_xdp_config
+veth_config(char const * local, char const * peer, char const * local_ip,
+    char const * peer_ip)
+{
+  transport::af_xdp_config config;
+  config.ifindex = static_cast<int>(if_nametoindex(local));
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ifreq req = {};
+  for (auto [name, mac] : {std::make_pair(local, &config.local_mac),
+      std::make_pair(peer, &config.peer_mac)})
+  {
+    std::strncpy(req.ifr_name, name, IFNAMSIZ - 1);
+    EXPECT_EQ(0, ioctl(fd, SIOCGIFHWADDR, &req));
+    std::memcpy(mac->data(), req.ifr_hwaddr.sa_data, mac->size());
+  }
+  close(fd);
+
+  config.local.sin_family = config.peer.sin_family = AF_INET;
+  inet_pton(AF_INET, local_ip, &config.local.sin_addr);
+  inet_pton(AF_INET, peer_ip, &config.peer.sin_addr);
+  config.local.sin_port = htons(4242);
+  config.peer.sin_port = htons(4242);
+  return config;
+}
+
+
+/**
+ * One side of the connection: API and transport.
+ */
+struct side
+{
+  node_t                  node;
+  connection_t            ctx;
+  std::set<channelid>     ready;
+  channelid               established = DEFAULT_CHANNELID;
+  std::string             data;
+  api_t                   api;
+  transport_t             transport;
+
+  side(peerid const & self, peerid const & peer,
+      transport::af_xdp_config const & config)
+    : node{self, PACKET_SIZE,
+        []() -> std::vector<byte> { return {}; },
+        [](support::timeouts::duration d) { return d; }}
+    , ctx{node, peer}
+    , api{ctx,
+        [this](channeler::error_t, channelid const & id) { established = id; },
+        [this](channelid const & id) { ready.insert(id); },
+        [this](channelid const & id, std::size_t size)
+        {
+          std::vector<char> buf(size);
+          std::size_t read = 0;
+          api.channel_read(id, buf.data(), buf.size(), read);
+          data.append(buf.data(), read);
+        }}
+    , transport{api, config, 1, 2}
+  {
+  }
+
+  std::size_t flush()
+  {
+    std::size_t total = 0;
+    for (auto & id : ready) {
+      std::size_t sent = 0;
+      do {
+        EXPECT_EQ(ERR_SUCCESS, transport.send(id, sent));
+        total += sent;
+      } while (sent);
+    }
+    ready.clear();
+    return total;
+  }
+
+  std::size_t receive()
+  {
+    std::size_t total = 0;
+    std::size_t received = 0;
+    do {
+      EXPECT_EQ(ERR_SUCCESS, transport.receive(received));
+      total += received;
+    } while (received);
+    return total;
+  }
+};
+
+
+/**
+ * Frames cross the veth pair asynchronously, so keep pumping for a while
+ * after nothing moved.
+ */
+inline void
+pump(side & a, side & b)
+{
+  std::size_t idle = 0;
+  for (std::size_t i = 0 ; i < 1000 && idle < 20 ; ++i) {
+    auto moved = a.flush() + b.flush();
+    moved += a.receive() + b.receive();
+    if (moved || !a.ready.empty() || !b.ready.empty()
+        || a.transport.pending() || b.transport.pending())
+    {
+      idle = 0;
+      continue;
+    }
+    ++idle;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+
+/**
+ * Run each test in a fresh network namespace with a veth pair, and return
+ * to the original namespace afterwards.
+ */
+struct TransportAFXDP : public ::testing::Test
+{
+  int original = -1;
+
+  void SetUp() override
+  {
+    original = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (original < 0 || unshare(CLONE_NEWNET) < 0) {
+      GTEST_SKIP() << "Cannot create a network namespace.";
+    }
+
+    if (0 != std::system("ip link add xdp0 type veth peer name xdp1"
+          " && ip link set xdp0 up && ip link set xdp1 up"))
+    {
+      GTEST_SKIP() << "Cannot create a veth pair.";
+    }
+
+    int fd = socket(AF_XDP, SOCK_RAW, 0);
+    if (fd < 0) {
+      GTEST_SKIP() << "AF_XDP is not available.";
+    }
+    close(fd);
+  }
+
+  void TearDown() override
+  {
+    if (original >= 0) {
+      setns(original, CLONE_NEWNET);
+      close(original);
+    }
+  }
+};
+
+} // anonymous namespace
+
+
+TEST_F(TransportAFXDP, exchange)
+{
+  peerid id1;
+  peerid id2;
+  side s1{id1, id2, veth_config("xdp0", "xdp1", "10.0.0.1", "10.0.0.2")};
+  side s2{id2, id1, veth_config("xdp1", "xdp0", "10.0.0.2", "10.0.0.1")};
+
+  // Not yet open.
+  std::size_t count = 42;
+  ASSERT_EQ(ERR_STATE, s1.transport.receive(count));
+  ASSERT_EQ(0, count);
+
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.open());
+  ASSERT_EQ(ERR_SUCCESS, s2.transport.open());
+  ASSERT_EQ(ERR_STATE, s1.transport.open());
+
+  // Nothing to receive or send yet.
+  count = 42;
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.receive(count));
+  ASSERT_EQ(0, count);
+
+  // Establish a channel
+  ASSERT_EQ(ERR_SUCCESS, s1.api.establish_channel(id2));
+  pump(s1, s2);
+  ASSERT_NE(DEFAULT_CHANNELID, s1.established);
+  ASSERT_EQ(s1.established, s2.established);
+
+  // Send more packets than fit into one batch, and more than there are
+  // TX frames.
+  std::string expected;
+  for (std::size_t i = 0 ; i < 100 ; ++i) {
+    auto msg = "message #" + std::to_string(i) + ";";
+    std::size_t written = 0;
+    ASSERT_EQ(ERR_SUCCESS, s1.api.channel_write(s1.established,
+          msg.c_str(), msg.size(), written));
+    expected += msg;
+  }
+  pump(s1, s2);
+
+  ASSERT_EQ(expected, s2.data);
+  ASSERT_EQ(0, s1.transport.pending());
+}
+
+
+TEST_F(TransportAFXDP, other_traffic_passes)
+{
+  peerid id1;
+  peerid id2;
+  side s1{id1, id2, veth_config("xdp0", "xdp1", "10.0.0.1", "10.0.0.2")};
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.open());
+
+  // Datagrams to other ports still reach sockets through the kernel.
+  ASSERT_EQ(0, std::system("ip addr add 10.0.0.1/24 dev xdp0"));
+
+  int rfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(4343);
+  inet_pton(AF_INET, "10.0.0.1", &addr.sin_addr);
+  ASSERT_EQ(0, bind(rfd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+
+  // Write the frame on the peer's end, so it crosses the veth pair.
+  auto config = veth_config("xdp0", "xdp1", "10.0.0.1", "10.0.0.2");
+  uint8_t frame[14 + 20 + 8 + 5] = {};
+  std::memcpy(frame, config.local_mac.data(), 6);
+  std::memcpy(frame + 6, config.peer_mac.data(), 6);
+  frame[12] = 0x08;
+  frame[14] = 0x45;
+  frame[17] = sizeof(frame) - 14;
+  frame[22] = 64;
+  frame[23] = IPPROTO_UDP;
+  std::memcpy(frame + 26, &config.peer.sin_addr, 4);
+  std::memcpy(frame + 30, &config.local.sin_addr, 4);
+  uint32_t sum = 0;
+  for (std::size_t i = 14 ; i < 34 ; i += 2) {
+    sum += (frame[i] << 8) | frame[i + 1];
+  }
+  sum = (sum & 0xffff) + (sum >> 16);
+  frame[24] = static_cast<uint8_t>(~sum >> 8);
+  frame[25] = static_cast<uint8_t>(~sum & 0xff);
+  std::memcpy(frame + 34, &config.peer.sin_port, 2);
+  std::memcpy(frame + 36, &addr.sin_port, 2);
+  frame[39] = 8 + 5;
+  std::memcpy(frame + 42, "hello", 5);
+
+  int sfd = socket(AF_PACKET, SOCK_RAW, 0);
+  ASSERT_GE(sfd, 0);
+  sockaddr_ll ll = {};
+  ll.sll_family = AF_PACKET;
+  ll.sll_ifindex = static_cast<int>(if_nametoindex("xdp1"));
+  ll.sll_halen = 6;
+  std::memcpy(ll.sll_addr, config.local_mac.data(), 6);
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(frame)), sendto(sfd, frame,
+        sizeof(frame), 0, reinterpret_cast<sockaddr *>(&ll), sizeof(ll)));
+
+  char buf[16] = {};
+  ssize_t got = -1;
+  for (std::size_t i = 0 ; i < 1000 && got < 0 ; ++i) {
+    got = recv(rfd, buf, sizeof(buf), 0);
+    if (got < 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  ASSERT_EQ(5, got);
+  ASSERT_EQ(std::string{"hello"}, std::string(buf, 5));
+
+  std::size_t count = 42;
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.receive(count));
+  ASSERT_EQ(0, count);
+
+  close(sfd);
+  close(rfd);
+}
+
+#else
+
+TEST(TransportAFXDP, unavailable)
+{
+  GTEST_SKIP() << "AF_XDP support not built.";
+}
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/transport/egress_arbiter.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace channeler;
+
+namespace {
+
+constexpr std::size_t PACKET_SIZE = 100;
+
+/**
+ * Stands in for a connection; packets are just tagged with the connection
+ * name and channel.
+ */
+struct fake_api
+{
+  using address_type = int;
+
+  struct buffer_entry
+  {
+    std::string       packet;
+    std::vector<byte> data;
+  };
+
+  std::string                             name;
+  std::map<channelid, std::size_t>        queued = {};
+
+  inline std::size_t packet_size() const
+  {
+    return PACKET_SIZE;
+  }
+
+  inline buffer_entry packet_to_send(channelid const & channel)
+  {
+    auto & count = queued[channel];
+    if (!count) {
+      return {};
+    }
+    --count;
+    return {name, std::vector<byte>(PACKET_SIZE)};
+  }
+};
+
+using arbiter_t = transport::egress_arbiter<fake_api>;
+
+
+inline std::string
+drain(arbiter_t & arbiter, std::size_t max)
+{
+  std::vector<arbiter_t::output_entry> out;
+  arbiter.packets_to_send(out, max);
+
+  std::string result;
+  for (auto & e : out) {
+    result += e.entry.packet;
+  }
+  return result;
+}
+
+} // anonymous namespace
+
+
+TEST(TransportEgressArbiter, round_robin)
+{
+  fake_api a{"a"};
+  fake_api b{"b"};
+  arbiter_t arbiter{PACKET_SIZE};
+  ASSERT_TRUE(arbiter.add(a, 1));
+  ASSERT_TRUE(arbiter.add(b, 2));
+  ASSERT_FALSE(arbiter.add(b, 2));
+
+  // A bulk sender notifies first, but does not get to send everything
+  // before the other connection.
+  auto id = create_new_channelid();
+  a.queued[id] = 100;
+  b.queued[id] = 3;
+  ASSERT_EQ(ERR_SUCCESS, arbiter.notify(a, id));
+  ASSERT_EQ(ERR_SUCCESS, arbiter.notify(b, id));
+  ASSERT_EQ(2, arbiter.active());
+
+  ASSERT_EQ("ababab", drain(arbiter, 6));
+  ASSERT_EQ("aaaa", drain(arbiter, 4));
+
+  // Connections drop out once they have nothing left to send.
+  ASSERT_EQ(1, arbiter.active());
+
+  // Destinations are passed on.
+  std::vector<arbiter_t::output_entry> out;
+  arbiter.packets_to_send(out, 1);
+  ASSERT_EQ(1, out.size());
+  ASSERT_EQ(1, out[0].destination);
+}
+
+
+TEST(TransportEgressArbiter, weights)
+{
+  fake_api a{"a"};
+  fake_api b{"b"};
+  arbiter_t arbiter{PACKET_SIZE};
+  arbiter.add(a, 1, 3);
+  arbiter.add(b, 2);
+
+  auto id = create_new_channelid();
+  a.queued[id] = 100;
+  b.queued[id] = 100;
+  arbiter.notify(a, id);
+  arbiter.notify(b, id);
+
+  ASSERT_EQ("aaabaaab", drain(arbiter, 8));
+
+  // Weight changes apply from the next quantum on.
+  ASSERT_EQ(ERR_SUCCESS, arbiter.set_weight(a, 1));
+  ASSERT_EQ("abab", drain(arbiter, 4));
+}
+
+
+TEST(TransportEgressArbiter, resume_partial_quantum)
+{
+  fake_api a{"a"};
+  fake_api b{"b"};
+  arbiter_t arbiter{PACKET_SIZE};
+  arbiter.add(a, 1, 4);
+  arbiter.add(b, 2);
+
+  auto id = create_new_channelid();
+  a.queued[id] = 100;
+  b.queued[id] = 100;
+  arbiter.notify(a, id);
+  arbiter.notify(b, id);
+
+  // Small batches do not reset the connection's quantum.
+  ASSERT_EQ("aa", drain(arbiter, 2));
+  ASSERT_EQ("aab", drain(arbiter, 3));
+}
+
+
+TEST(TransportEgressArbiter, small_quantum)
+{
+  fake_api a{"a"};
+  fake_api b{"b"};
+
+  // A quantum smaller than a packet accrues over several rounds.
+  arbiter_t arbiter{PACKET_SIZE / 2};
+  arbiter.add(a, 1);
+  arbiter.add(b, 2, 2);
+
+  auto id = create_new_channelid();
+  a.queued[id] = 100;
+  b.queued[id] = 100;
+  arbiter.notify(a, id);
+  arbiter.notify(b, id);
+
+  ASSERT_EQ("babbab", drain(arbiter, 6));
+}
+
+
+TEST(TransportEgressArbiter, channels_take_turns)
+{
+  fake_api a{"a"};
+  arbiter_t arbiter{PACKET_SIZE};
+  arbiter.add(a, 1, 10);
+
+  auto id1 = create_new_channelid();
+  auto id2 = create_new_channelid();
+  a.queued[id1] = 3;
+  a.queued[id2] = 1;
+  arbiter.notify(a, id1);
+  arbiter.notify(a, id2);
+  arbiter.notify(a, id1); // duplicate
+
+  std::vector<arbiter_t::output_entry> out;
+  ASSERT_EQ(4, arbiter.packets_to_send(out, 10));
+  ASSERT_EQ(0, arbiter.active());
+  ASSERT_EQ(0, a.queued[id1]);
+  ASSERT_EQ(0, a.queued[id2]);
+
+  // Nothing left.
+  ASSERT_EQ(0, arbiter.packets_to_send(out, 10));
+}
+
+
+TEST(TransportEgressArbiter, remove)
+{
+  fake_api a{"a"};
+  fake_api b{"b"};
+  arbiter_t arbiter{PACKET_SIZE};
+  arbiter.add(a, 1);
+  arbiter.add(b, 2);
+
+  auto id = create_new_channelid();
+  a.queued[id] = 100;
+  b.queued[id] = 100;
+  arbiter.notify(a, id);
+  arbiter.notify(b, id);
+
+  arbiter.remove(a);
+  ASSERT_EQ(1, arbiter.size());
+  ASSERT_EQ(ERR_STATE, arbiter.notify(a, id));
+  ASSERT_EQ("bbb", drain(arbiter, 3));
+}
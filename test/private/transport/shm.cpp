@@ -0,0 +1,189 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/transport/shm.h"
+#include "../lib/internal/api.h"
+#include "../lib/context/node.h"
+#include "../lib/context/connection.h"
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../../exceptions.h"
+#include "../../packets.h"
+
+using namespace channeler;
+using namespace channeler::transport;
+
+namespace {
+
+inline std::string
+receive_string(shm_transport & t)
+{
+  std::string ret;
+  auto err = t.receive([&ret](byte const * data, std::size_t size)
+  {
+    ret.assign(reinterpret_cast<char const *>(data), size);
+  });
+  EXPECT_EQ(ERR_SUCCESS, err);
+  return ret;
+}
+
+inline channeler::error_t
+send_string(shm_transport & t, std::string const & s)
+{
+  return t.send(reinterpret_cast<byte const *>(s.c_str()), s.size());
+}
+
+} // anonymous namespace
+
+
+TEST(TransportSHM, exchange)
+{
+  shm_transport creator{100, 3};
+  shm_transport peer{creator.descriptors()};
+  ASSERT_EQ(100, peer.packet_size());
+
+  ASSERT_FALSE(peer.wait(std::chrono::milliseconds{0}));
+  ASSERT_EQ(ERR_DATA_UNAVAILABLE, peer.receive([](byte const *, std::size_t) {}));
+
+  ASSERT_EQ(ERR_SUCCESS, send_string(creator, "hello"));
+  ASSERT_EQ(ERR_SUCCESS, send_string(creator, "world"));
+  ASSERT_TRUE(peer.wait(std::chrono::milliseconds{100}));
+  ASSERT_EQ("hello", receive_string(peer));
+  ASSERT_EQ("world", receive_string(peer));
+  ASSERT_FALSE(peer.wait(std::chrono::milliseconds{0}));
+
+  ASSERT_EQ(ERR_SUCCESS, send_string(peer, "back"));
+  ASSERT_TRUE(creator.wait(std::chrono::milliseconds{100}));
+  ASSERT_EQ("back", receive_string(creator));
+
+  // Too large
+  std::vector<byte> large(101);
+  ASSERT_EQ(ERR_INSUFFICIENT_BUFFER_SIZE, creator.send(large.data(), large.size()));
+}
+
+
+TEST(TransportSHM, backpressure)
+{
+  // Slots are rounded up to four.
+  shm_transport creator{10, 3};
+  shm_transport peer{creator.descriptors()};
+
+  for (std::size_t i = 0 ; i < 4 ; ++i) {
+    ASSERT_EQ(ERR_SUCCESS, send_string(creator, std::to_string(i)));
+  }
+  ASSERT_EQ(ERR_WRITE, send_string(creator, "x"));
+
+  // Receiving returns the slot.
+  ASSERT_EQ("0", receive_string(peer));
+  ASSERT_EQ(ERR_SUCCESS, send_string(creator, "4"));
+  for (std::size_t i = 1 ; i < 5 ; ++i) {
+    ASSERT_EQ(std::to_string(i), receive_string(peer));
+  }
+}
+
+
+TEST(TransportSHM, wakeup_across_threads)
+{
+  constexpr std::size_t COUNT = 10'000;
+
+  shm_transport creator{16, 8};
+  shm_transport peer{creator.descriptors()};
+
+  std::thread t{[&creator]()
+  {
+    for (std::size_t i = 0 ; i < COUNT ; ) {
+      if (ERR_SUCCESS == send_string(creator, std::to_string(i))) {
+        ++i;
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  // The receiver only ever blocks in wait(), so lost wakeups would hang
+  // here; the timeout turns them into a failure instead.
+  std::size_t expected = 0;
+  while (expected < COUNT) {
+    ASSERT_TRUE(peer.wait(std::chrono::milliseconds{5000}));
+    while (true) {
+      std::string s;
+      auto err = peer.receive([&s](byte const * data, std::size_t size)
+      {
+        s.assign(reinterpret_cast<char const *>(data), size);
+      });
+      if (ERR_DATA_UNAVAILABLE == err) {
+        break;
+      }
+      ASSERT_EQ(std::to_string(expected), s);
+      ++expected;
+    }
+  }
+  t.join();
+}
+
+
+TEST(TransportSHM, reject_invalid_region)
+{
+  shm_descriptors bad;
+  CHANNELER_ASSERT_THROW((shm_transport{bad}), exception);
+
+  // An empty memfd is not a transport region.
+  shm_transport creator{10, 1};
+  auto fds = creator.descriptors();
+  fds.memory = memfd_create("test", MFD_CLOEXEC);
+  CHANNELER_ASSERT_THROW((shm_transport{fds}), exception);
+  close(fds.memory);
+}
+
+
+TEST(TransportSHM, receive_packet)
+{
+  using address_t = int;
+  using node_t = context::node<3>;
+  using connection_t = context::connection<address_t, node_t>;
+  using api_t = internal::connection_api<connection_t>;
+
+  peerid self;
+  peerid peer_id;
+  node_t node{self, 120,
+    []() -> std::vector<byte> { return {}; },
+    [](support::timeouts::duration d) { return d; }};
+  connection_t ctx{node, peer_id};
+  api_t api{ctx,
+    [](channeler::error_t, channelid const &) {},
+    [](channelid const &) {},
+    [](channelid const &, std::size_t) {}};
+
+  shm_transport creator{120, 2};
+  shm_transport peer{creator.descriptors()};
+
+  ASSERT_EQ(ERR_DATA_UNAVAILABLE, peer.receive_packet(api));
+
+  ASSERT_EQ(ERR_SUCCESS, creator.send(test::packet_default_channel,
+        test::packet_default_channel_size));
+  ASSERT_EQ(ERR_SUCCESS, peer.receive_packet(api));
+}
@@ -0,0 +1,237 @@
+/**
+ * This file is part of channeler.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2021 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include "../lib/transport/udp_batch.h"
+#include "../lib/internal/api.h"
+#include "../lib/context/node.h"
+#include "../lib/context/connection.h"
+
+#include <set>
+#include <string>
+
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+using namespace channeler;
+
+namespace {
+
+using address_t = int;
+using node_t = context::node<3>;
+using connection_t = context::connection<address_t, node_t>;
+using api_t = internal::connection_api<connection_t>;
+using transport_t = transport::udp_batch_transport<api_t, 4>;
+
+constexpr std::size_t PACKET_SIZE = 200;
+
+inline int
+bound_socket(sockaddr_in & addr)
+{
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  EXPECT_EQ(0, bind(fd, reinterpret_cast<sockaddr *>(&addr), len));
+  EXPECT_EQ(0, getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len));
+  return fd;
+}
+
+
+/**
+ * One side of the connection: API, socket and transport.
+ */
+struct side
+{
+  node_t                  node;
+  connection_t            ctx;
+  std::set<channelid>     ready;
+  channelid               established = DEFAULT_CHANNELID;
+  std::string             data;
+  api_t                   api;
+  int                     fd;
+  transport_t             transport;
+
+  side(peerid const & self, peerid const & peer, int _fd)
+    : node{self, PACKET_SIZE,
+        []() -> std::vector<byte> { return {}; },
+        [](support::timeouts::duration d) { return d; }}
+    , ctx{node, peer}
+    , api{ctx,
+        [this](channeler::error_t, channelid const & id) { established = id; },
+        [this](channelid const & id) { ready.insert(id); },
+        [this](channelid const & id, std::size_t size)
+        {
+          std::vector<char> buf(size);
+          std::size_t read = 0;
+          api.channel_read(id, buf.data(), buf.size(), read);
+          data.append(buf.data(), read);
+        }}
+    , fd{_fd}
+    , transport{api, fd, 1, 2}
+  {
+  }
+
+  ~side()
+  {
+    close(fd);
+  }
+
+  std::size_t flush()
+  {
+    std::size_t total = 0;
+    for (auto & id : ready) {
+      std::size_t sent = 0;
+      do {
+        EXPECT_EQ(ERR_SUCCESS, transport.send(id, sent));
+        total += sent;
+      } while (sent);
+    }
+    ready.clear();
+    return total;
+  }
+
+  std::size_t receive()
+  {
+    std::size_t total = 0;
+    std::size_t received = 0;
+    do {
+      EXPECT_EQ(ERR_SUCCESS, transport.receive(received));
+      total += received;
+    } while (received);
+    return total;
+  }
+};
+
+
+inline void
+pump(side & a, side & b)
+{
+  for (std::size_t i = 0 ; i < 20 ; ++i) {
+    auto moved = a.flush() + b.flush();
+    moved += a.receive() + b.receive();
+    if (!moved && a.ready.empty() && b.ready.empty()) {
+      return;
+    }
+  }
+}
+
+} // anonymous namespace
+
+
+TEST(TransportUDPBatch, exchange)
+{
+  sockaddr_in addr1;
+  sockaddr_in addr2;
+  int fd1 = bound_socket(addr1);
+  int fd2 = bound_socket(addr2);
+  ASSERT_EQ(0, connect(fd1, reinterpret_cast<sockaddr *>(&addr2), sizeof(addr2)));
+  ASSERT_EQ(0, connect(fd2, reinterpret_cast<sockaddr *>(&addr1), sizeof(addr1)));
+
+  peerid id1;
+  peerid id2;
+  side s1{id1, id2, fd1};
+  side s2{id2, id1, fd2};
+
+  // Nothing to receive or send yet.
+  std::size_t count = 42;
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.receive(count));
+  ASSERT_EQ(0, count);
+
+  // Establish a channel
+  ASSERT_EQ(ERR_SUCCESS, s1.api.establish_channel(id2));
+  pump(s1, s2);
+  ASSERT_NE(DEFAULT_CHANNELID, s1.established);
+  ASSERT_EQ(s1.established, s2.established);
+
+  // Send more packets than fit into one batch.
+  std::string expected;
+  for (std::size_t i = 0 ; i < 10 ; ++i) {
+    auto msg = "message #" + std::to_string(i) + ";";
+    std::size_t written = 0;
+    ASSERT_EQ(ERR_SUCCESS, s1.api.channel_write(s1.established,
+          msg.c_str(), msg.size(), written));
+    expected += msg;
+  }
+  pump(s1, s2);
+
+  ASSERT_EQ(expected, s2.data);
+  ASSERT_EQ(0, s1.transport.pending());
+}
+
+
+TEST(TransportUDPBatch, ecn)
+{
+  sockaddr_in addr1;
+  sockaddr_in addr2;
+  int fd1 = bound_socket(addr1);
+  int fd2 = bound_socket(addr2);
+  ASSERT_EQ(0, connect(fd1, reinterpret_cast<sockaddr *>(&addr2), sizeof(addr2)));
+  ASSERT_EQ(0, connect(fd2, reinterpret_cast<sockaddr *>(&addr1), sizeof(addr1)));
+
+  peerid id1;
+  peerid id2;
+  side s1{id1, id2, fd1};
+  side s2{id2, id1, fd2};
+
+  ASSERT_EQ(ERR_SUCCESS, s1.transport.enable_ecn(support::ECN_ECT0));
+  ASSERT_EQ(ERR_SUCCESS, s2.transport.enable_ecn(support::ECN_ECT1));
+
+  ASSERT_EQ(ERR_SUCCESS, s1.api.establish_channel(id2));
+  pump(s1, s2);
+  ASSERT_NE(DEFAULT_CHANNELID, s1.established);
+
+  for (std::size_t i = 0 ; i < 5 ; ++i) {
+    std::size_t written = 0;
+    ASSERT_EQ(ERR_SUCCESS, s1.api.channel_write(s1.established,
+          "hello", 5, written));
+  }
+  pump(s1, s2);
+
+  // Loopback does not mark CE, so each side sees the other's codepoint.
+  auto counts = s2.transport.ecn_counts();
+  ASSERT_GE(counts.ect0, 6);
+  ASSERT_EQ(0, counts.ect1);
+  ASSERT_EQ(0, counts.ce);
+  ASSERT_GE(s1.transport.ecn_counts().ect1, 1);
+  ASSERT_EQ(0, s1.transport.ecn_counts().ect0);
+
+  // Feed the counts back, with a CE mark as a queue would set it; the
+  // sender's controller lowers its rate.
+  support::token_bucket bucket{100000, 10000};
+  support::ecn_rate_controller ctrl{bucket, 1000, 200000, 1000};
+  s1.api.set_congestion_controller(&ctrl);
+
+  ASSERT_EQ(ERR_SUCCESS, s2.api.send_ecn_feedback(s2.established, counts));
+  pump(s1, s2);
+  ASSERT_EQ(101000, bucket.rate());
+
+  counts.ce += 1;
+  ASSERT_EQ(ERR_SUCCESS, s2.api.send_ecn_feedback(s2.established, counts));
+  pump(s1, s2);
+  ASSERT_EQ(1, ctrl.congestion_events());
+  ASSERT_EQ(50500, bucket.rate());
+
+  // Feedback requires an established channel.
+  ASSERT_EQ(ERR_INVALID_CHANNELID,
+      s2.api.send_ecn_feedback(DEFAULT_CHANNELID, counts));
+}
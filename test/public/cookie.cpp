@@ -62,13 +62,44 @@ TEST(Cookie, responder_cookie_calculation)
   channelid id = create_new_channelid();
   complete_channelid(id);
 
+  capabilities_t caps;
+  caps[CAP_RESEND] = true;
+
   cookie c2 = create_cookie_responder(secret2.data(), secret2.size(),
-      p1, p2, id);
+      p1, p2, id, caps, 42);
 
   ASSERT_NE(c2, cookie{});
 
   ASSERT_TRUE(validate_cookie(c2, secret2.data(), secret2.size(),
-        p1, p2, id));
+        p1, p2, id, caps, 42));
   ASSERT_FALSE(validate_cookie(c2 + 1, secret2.data(), secret2.size(),
-        p1, p2, id));
+        p1, p2, id, caps, 42));
+
+  // Capabilities and epoch are part of the cookie.
+  ASSERT_FALSE(validate_cookie(c2, secret2.data(), secret2.size(),
+        p1, p2, id, capabilities_t{}, 42));
+  ASSERT_FALSE(validate_cookie(c2, secret2.data(), secret2.size(),
+        p1, p2, id, caps, 43));
+}
+
+
+TEST(Cookie, responder_cookie_requires_secret)
+{
+  using namespace channeler;
+
+  peerid p1;
+  peerid p2;
+
+  channelid id = create_new_channelid();
+  complete_channelid(id);
+
+  capabilities_t caps;
+  caps[CAP_RESEND] = true;
+
+  cookie c2 = create_cookie_responder(secret2.data(), secret2.size(),
+      p1, p2, id, caps, 42);
+
+  // The same inputs under another secret do not validate.
+  ASSERT_FALSE(validate_cookie(c2, secret1.data(), secret1.size(),
+        p1, p2, id, caps, 42));
 }
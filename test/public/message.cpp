@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../exceptions.h"
 #include "../messages.h"
 
 using namespace test;
@@ -35,7 +36,7 @@ assert_message(std::vector<channeler::byte> const & buf,
     std::size_t type_bytes,
     std::size_t length_bytes)
 {
-  ASSERT_NO_THROW((channeler::message{buf.data(), buf.size()}));
+  CHANNELER_ASSERT_NO_THROW((channeler::message{buf.data(), buf.size()}));
 
   // Validate later
   channeler::message msg{buf.data(), buf.size(), false};
@@ -95,13 +96,50 @@ TEST(Message, fail_parse_unknown)
   std::vector<channeler::byte> b{message_unknown, message_unknown + message_unknown_size};
 
   // Exception
-  ASSERT_THROW((channeler::message{b.data(), b.size()}),
+  CHANNELER_ASSERT_THROW((channeler::message{b.data(), b.size()}),
       channeler::exception);
 
   // Error code
   channeler::message msg{b.data(), b.size(), false};
   auto err = msg.parse();
   ASSERT_EQ(err.first, channeler::ERR_INVALID_MESSAGE_TYPE);
+
+  // Result
+  auto res = channeler::message::create(b.data(), b.size());
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_INVALID_MESSAGE_TYPE);
+  ASSERT_FALSE(channeler::parse_message(b.data(), b.size()));
+}
+
+
+
+TEST(Message, fail_parse_oversized_length)
+{
+  // A data message whose length varint claims more payload than the buffer
+  // holds.
+  std::vector<channeler::byte> b{message_data, message_data + message_data_size};
+  b[1] = channeler::byte{0x7f};
+
+  // Exception
+  CHANNELER_ASSERT_THROW((channeler::message{b.data(), b.size()}),
+      channeler::exception);
+
+  // Error code
+  channeler::message msg{b.data(), b.size(), false};
+  auto err = msg.parse();
+  ASSERT_EQ(err.first, channeler::ERR_INSUFFICIENT_BUFFER_SIZE);
+
+  // Result
+  auto res = channeler::message::create(b.data(), b.size());
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_INSUFFICIENT_BUFFER_SIZE);
+  ASSERT_FALSE(channeler::parse_message(b.data(), b.size()));
+
+  // Iteration stops at the malformed message.
+  channeler::messages msgs{b.data(), b.size()};
+  auto iter = msgs.begin();
+  ASSERT_TRUE(iter == msgs.end());
+  ASSERT_EQ(iter.remaining(), b.size());
 }
 
 
@@ -119,6 +157,7 @@ TEST(Message, parse_and_serialize_channel_new)
   auto ptr = reinterpret_cast<channeler::message_channel_new *>(msg.get());
   ASSERT_EQ(0xbeef, ptr->initiator_part);
   ASSERT_EQ(0xbeefb4be, ptr->cookie1);
+  ASSERT_EQ(0xd1c7, ptr->dictionary);
 
   // Serialize
   std::vector<channeler::byte> out;
@@ -163,7 +202,7 @@ TEST(Message, parse_and_serialize_channel_finalize)
 
   auto ptr = reinterpret_cast<channeler::message_channel_finalize *>(msg.get());
   ASSERT_EQ(0xbeefd00d, ptr->id.full);
-  ASSERT_EQ(0x3987886e, ptr->cookie2);
+  ASSERT_EQ(0x599e6447, ptr->cookie2);
   ASSERT_TRUE(ptr->capabilities.none());
 
   // Serialize
@@ -196,6 +235,29 @@ TEST(Message, parse_and_serialize_channel_cookie)
 
 
 
+TEST(Message, parse_and_serialize_ecn_feedback)
+{
+  std::vector<channeler::byte> b{message_ecn_feedback, message_ecn_feedback + message_ecn_feedback_size};
+
+  assert_single_byte_type_fixed_size_message(b, channeler::MSG_ECN_FEEDBACK);
+
+  auto msg = channeler::parse_message(b.data(), b.size());
+  ASSERT_TRUE(msg);
+  ASSERT_EQ(msg->type, channeler::MSG_ECN_FEEDBACK);
+
+  auto ptr = reinterpret_cast<channeler::message_ecn_feedback *>(msg.get());
+  ASSERT_EQ(256, ptr->ect0);
+  ASSERT_EQ(0, ptr->ect1);
+  ASSERT_EQ(3, ptr->ce);
+
+  // Serialize
+  std::vector<channeler::byte> out;
+  out.resize(200);
+  assert_serialization_ok(out, msg, b);
+}
+
+
+
 TEST(Message, parse_and_serialize_data)
 {
   std::vector<channeler::byte> b{message_data, message_data + message_data_size};
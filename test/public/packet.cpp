@@ -22,6 +22,7 @@
 
 #include <gtest/gtest.h>
 
+#include "../exceptions.h"
 #include "../packets.h"
 
 using namespace test;
@@ -33,8 +34,8 @@ TEST(PacketWrapper, construct_from_buffer_failure_too_small)
 
   channeler::byte buf[] = { 0xab_b, 0xcd_b };
 
-  ASSERT_THROW((channeler::packet_wrapper{buf, 0}), channeler::exception);
-  ASSERT_THROW((channeler::packet_wrapper{buf, sizeof(buf)}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::packet_wrapper{buf, 0}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::packet_wrapper{buf, sizeof(buf)}), channeler::exception);
 }
 
 
@@ -121,8 +122,8 @@ TEST(PacketWrapper, message_iteration)
 
   channeler::packet_wrapper pkt{data.data(), data.size()};
 
-  // We have a payload of 26 Bytes
-  ASSERT_EQ(pkt.payload_size(), 26);
+  // We have a payload of 32 Bytes
+  ASSERT_EQ(pkt.payload_size(), 32);
 
   // Iterate over messages and count up message sizes
   std::size_t sum = 0;
@@ -133,3 +134,77 @@ TEST(PacketWrapper, message_iteration)
   auto diff = pkt.payload_size() - sum;
   ASSERT_EQ(4, diff); // The payload is 4 Bytes larger than the messages
 }
+
+
+
+TEST(PacketWrapper, decode_on_validation)
+{
+  std::vector<channeler::byte> data{packet_default_channel_trailing_bytes,
+    packet_default_channel_trailing_bytes + packet_default_channel_trailing_bytes_size};
+
+  channeler::packet_wrapper pkt{data.data(), data.size()};
+  auto const & cpkt = pkt;
+  auto flags = cpkt.flags();
+
+  // All fields were decoded on validation; modifying the buffer behind the
+  // wrapper's back does not change them, and buffer() writes them back.
+  auto flags_offset = channeler::public_header_layout::PUB_OFFS_FLAGS;
+  data[flags_offset] = channeler::byte{0xff};
+  ASSERT_EQ(flags, cpkt.flags());
+
+  pkt.channel() = channeler::channelid{0xbeef, 0xd00d};
+  pkt.buffer();
+  ASSERT_NE(channeler::byte{0xff}, data[flags_offset]);
+
+  channeler::packet_wrapper pkt2{data.data(), data.size()};
+  ASSERT_EQ(pkt2.channel(), (channeler::channelid{0xbeef, 0xd00d}));
+  ASSERT_EQ(flags, pkt2.flags());
+}
+
+
+
+TEST(PacketWrapper, packet_size_below_envelope)
+{
+  std::vector<channeler::byte> data{packet_default_channel_trailing_bytes,
+    packet_default_channel_trailing_bytes + packet_default_channel_trailing_bytes_size};
+
+  // Packet size is the last field in the public header.
+  auto offset = channeler::public_header_layout::PUB_OFFS_PACKET_SIZE;
+  data[offset] = channeler::byte{0x00};
+  data[offset + 1] = channeler::byte{0x10};
+
+  CHANNELER_ASSERT_THROW((channeler::packet_wrapper{data.data(), data.size()}),
+      channeler::exception);
+}
+
+
+
+TEST(PacketWrapper, create_without_throwing)
+{
+  using namespace liberate::types::literals;
+
+  channeler::byte buf[] = { 0xab_b, 0xcd_b };
+  auto res = channeler::packet_wrapper::create(buf, sizeof(buf));
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_INSUFFICIENT_BUFFER_SIZE);
+
+  res = channeler::packet_wrapper::create(nullptr, 0);
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_INVALID_REFERENCE);
+
+  std::vector<channeler::byte> data{packet_default_channel_trailing_bytes,
+    packet_default_channel_trailing_bytes + packet_default_channel_trailing_bytes_size};
+  res = channeler::packet_wrapper::create(data.data(), data.size());
+  ASSERT_TRUE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_SUCCESS);
+  ASSERT_EQ(res->sender().display(), "0x000000000000000000000000000a11c3");
+  ASSERT_EQ(res->packet_size(), res->envelope_size());
+
+  // Packet size below the envelope size
+  auto offset = channeler::public_header_layout::PUB_OFFS_PACKET_SIZE;
+  data[offset] = channeler::byte{0x00};
+  data[offset + 1] = channeler::byte{0x10};
+  res = channeler::packet_wrapper::create(data.data(), data.size());
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_DECODE);
+}
@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include "../exceptions.h"
+
 TEST(PeerID, default_constructed_random)
 {
   auto id = channeler::peerid{};
@@ -74,8 +76,26 @@ TEST(PeerID, construction_failure_from_buffer)
 {
   channeler::byte * buf = nullptr;
 
-  ASSERT_THROW((channeler::peerid{buf, 0}), channeler::exception);
-  ASSERT_THROW((channeler::peerid{buf, 1}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::peerid{buf, 0}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::peerid{buf, 1}), channeler::exception);
+}
+
+
+
+TEST(PeerID, create_wrapper_without_throwing)
+{
+  channeler::byte buf[channeler::PEERID_SIZE_BYTES] = {};
+
+  auto res = channeler::peerid_wrapper::create(buf, 1);
+  ASSERT_FALSE(res);
+  ASSERT_EQ(res.error(), channeler::ERR_INSUFFICIENT_BUFFER_SIZE);
+
+  res = channeler::peerid_wrapper::create(nullptr, sizeof(buf));
+  ASSERT_FALSE(res);
+
+  res = channeler::peerid_wrapper::create(buf, sizeof(buf));
+  ASSERT_TRUE(res);
+  ASSERT_EQ(res->raw, buf);
 }
 
 
@@ -83,10 +103,10 @@ TEST(PeerID, construction_failure_from_buffer)
 TEST(PeerID, construction_failure_from_short_hex)
 {
   char const * const foo = "0xd00d";
-  ASSERT_THROW((channeler::peerid{foo, strlen(foo)}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::peerid{foo, strlen(foo)}), channeler::exception);
 
   char const * const bar = "0xthis-is-not-a-valid-hex-string-is-it-now?";
-  ASSERT_THROW((channeler::peerid{bar, strlen(bar)}), channeler::exception);
+  CHANNELER_ASSERT_THROW((channeler::peerid{bar, strlen(bar)}), channeler::exception);
 }
 
 
@@ -31,12 +31,16 @@ int main(int argc, char **argv)
 {
   std::cout << channeler::copyright_string() << std::endl;
 
+#if CHANNELER_EXCEPTIONS
   try {
+#endif
     test_env = new TestEnvironment();
+#if CHANNELER_EXCEPTIONS
   } catch (std::exception const & ex) {
     std::cerr << ex.what() << std::endl;
     return 1;
   }
+#endif
 
   // Ownership passes to gtest here.
   ::testing::AddGlobalTestEnvironment(test_env);